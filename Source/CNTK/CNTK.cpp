@@ -106,6 +106,15 @@ void ForceDeterministicAlgorithmsOnCPU()
     LOGPRINTF(stderr, "WARNING: forceDeterministcAlgorithms flag is specified. Using 1 CPU thread for processing.\n");
     CPUMatrix<float /*any type will do*/>::SetNumThreads(1);
     CPUMatrix<float /*any type will do*/>::SetCompatibleMode();
+    CPUMatrix<float /*any type will do*/>::SetDeterministicTensorReductions(true);
+}
+
+// smallest per-thread share of a CPU tensor op worth a parallel loop (0 = default)
+// This is read the same way from the BrainScript and the legacy config.
+template <class ConfigRecordType>
+static void SetTensorOpMinWorkPerThread(const ConfigRecordType& config)
+{
+    CPUMatrix<float /*any type will do*/>::SetTensorOpMinWorkPerThread(config(L"tensorOpMinWorkPerThread", (size_t) 0));
 }
 
 #ifndef CPUONLY
@@ -179,6 +188,7 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
         {
             LOGPRINTF(stderr, "Using %d CPU threads.\n", numCPUThreads);
         }
+        SetTensorOpMinWorkPerThread(config);
     }
 
     bool progressTracing = config(L"progressTracing", false);
@@ -597,6 +607,7 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
         numCPUThreads = CPUMatrix<float /*any will do*/>::SetNumThreads(numCPUThreads);
         if (numCPUThreads > 0)
             LOGPRINTF(stderr, "Using %d CPU threads.\n", numCPUThreads);
+        SetTensorOpMinWorkPerThread(config);
     }
 
     bool progressTracing = config(L"progressTracing", false);
@@ -3133,6 +3133,14 @@ namespace CNTK
 #endif
         double gradientClippingThresholdPerSample = std::numeric_limits<double>::infinity();
         bool gradientClippingWithTruncation = true;
+
+        // Apply block-column sparse gradients on the CPU (e.g. those of embeddings with sparse input) lazily: only the columns
+        // present in a minibatch are updated, and the steps a column missed are applied when it is next updated or by
+        // Learner::ApplyPendingUpdates(). Until then, columns that lag behind differ from those of the regular update.
+        // The missed steps are applied with the current learning rate and momentum, so with schedules that change these
+        // the result only approximates the regular update. Supported by the momentum SGD, Nesterov, FSAdaGrad (Adam) and
+        // RMSProp (without the average multiplier) learners; the others ignore it.
+        bool lazySparseUpdates = false;
     };
 
     ///
@@ -3188,6 +3196,13 @@ namespace CNTK
         ///
         virtual void ResetSmoothedGradients() = 0;
 
+        ///
+        /// Applies the steps pending for lazily updated parameters (see AdditionalLearningOptions::lazySparseUpdates),
+        /// so that the parameter values are those of the regular update. The Trainer calls this before it evaluates
+        /// or saves the model; call it before reading the parameter values otherwise.
+        ///
+        virtual void ApplyPendingUpdates() {}
+
         ///
         /// Returns current learning rate.
         ///
@@ -3385,6 +3400,7 @@ namespace CNTK
     private:
         void Save(const std::wstring& modelFilePath, bool usingLegacyModelFormat, const Dictionary& state);
         bool UpdateLearners(const std::unordered_map<Parameter, NDArrayViewPtr>& gradients);
+        void ApplyPendingUpdates();
         bool HandleEmptyMinibatch(bool atEndOfData);
 
         FunctionPtr m_combinedTrainingFunction;
@@ -20,4 +20,86 @@
 /// Please be aware that these are subject to frequent changes and even removal.
 ///
 namespace CNTK { namespace Experimental {
+
+    ///
+    /// Configuration of a BatchingEvaluator.
+    ///
+    struct BatchingEvaluatorConfig
+    {
+        ///
+        /// Maximum number of requests (sequences) packed into one minibatch.
+        ///
+        size_t m_maxBatchSizeInSequences = 32;
+
+        ///
+        /// Maximum time the oldest queued request waits for more requests to arrive before a partial batch is evaluated.
+        ///
+        size_t m_maxWaitTimeInMicroseconds = 1000;
+
+        ///
+        /// Number of most recent requests that the latency percentiles of BatchingEvaluatorStatistics are computed over.
+        ///
+        size_t m_latencyWindowSize = 10000;
+
+        ///
+        /// Device on which the batched forward passes are run.
+        ///
+        DeviceDescriptor m_device = DeviceDescriptor::UseDefaultDevice();
+    };
+
+    ///
+    /// Counters of a BatchingEvaluator, accumulated since its creation or the last ResetStatistics() call.
+    /// Latencies are measured from the Evaluate() call to the completion of its future.
+    ///
+    struct BatchingEvaluatorStatistics
+    {
+        size_t m_numRequests;
+        size_t m_numBatches;
+        size_t m_numSamples;
+        size_t m_maxBatchSizeInSequences;
+        double m_averageBatchSizeInSequences;
+        double m_p50LatencyInMilliseconds;
+        double m_p99LatencyInMilliseconds;
+        double m_maxLatencyInMilliseconds;
+    };
+
+    ///
+    /// Front end for serving a Function to many concurrent callers that each submit a single (variable length) sequence.
+    /// Queued requests are packed into one minibatch, evaluated with a single Forward call and the outputs are scattered
+    /// back to the callers' futures. A batch is evaluated once it holds m_maxBatchSizeInSequences requests or its oldest
+    /// request has waited m_maxWaitTimeInMicroseconds, whichever happens first.
+    /// The Function is evaluated on a worker thread owned by the BatchingEvaluator; it must not be evaluated by anybody else
+    /// while the BatchingEvaluator exists.
+    ///
+    class BatchingEvaluator : public std::enable_shared_from_this<BatchingEvaluator>
+    {
+    public:
+        ///
+        /// Queues the evaluation of one sequence. 'arguments' must contain a dense Value for each argument the outputs depend on,
+        /// holding exactly one complete sequence (or one sample for arguments without a sequence axis). The argument data is
+        /// copied before this call returns. The returned future yields a Value (on the CPU) of the single sequence for each output.
+        ///
+        virtual std::future<std::unordered_map<Variable, ValuePtr>> Evaluate(const std::unordered_map<Variable, ValuePtr>& arguments) = 0;
+
+        ///
+        /// Returns the current counters.
+        ///
+        virtual BatchingEvaluatorStatistics GetStatistics() const = 0;
+
+        ///
+        /// Resets the counters.
+        ///
+        virtual void ResetStatistics() = 0;
+
+        ///
+        /// Destruct 'this' BatchingEvaluator after evaluating all requests that are still queued.
+        ///
+        virtual ~BatchingEvaluator() {}
+    };
+    typedef std::shared_ptr<BatchingEvaluator> BatchingEvaluatorPtr;
+
+    ///
+    /// Creates a BatchingEvaluator computing the specified 'outputs' of 'function'. All outputs must have a batch axis.
+    ///
+    CNTK_API BatchingEvaluatorPtr CreateBatchingEvaluator(const FunctionPtr& function, const std::vector<Variable>& outputs, const BatchingEvaluatorConfig& config = BatchingEvaluatorConfig());
 }}
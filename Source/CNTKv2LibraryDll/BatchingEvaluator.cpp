@@ -0,0 +1,348 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "CNTKLibrary.h"
+#include "Utils.h"
+#include "BatchingEvaluator.h"
+
+namespace CNTK { namespace Experimental {
+
+    BatchingEvaluatorPtr CreateBatchingEvaluator(const FunctionPtr& function, const std::vector<Variable>& outputs, const BatchingEvaluatorConfig& config)
+    {
+        return MakeSharedObject<BatchingEvaluatorImpl>(function, outputs, config);
+    }
+
+    BatchingEvaluatorImpl::BatchingEvaluatorImpl(const FunctionPtr& function, const std::vector<Variable>& outputs, const BatchingEvaluatorConfig& config)
+        : m_function(function),
+          m_outputs(outputs),
+          m_dataType(DataType::Unknown),
+          m_config(config),
+          m_stopRequested(false)
+    {
+        if (!m_function)
+            InvalidArgument("BatchingEvaluator: A Function to evaluate must be specified");
+
+        if (m_outputs.empty())
+            InvalidArgument("BatchingEvaluator: At least one output has to be specified");
+
+        if (m_config.m_maxBatchSizeInSequences == 0)
+            InvalidArgument("BatchingEvaluator: The maximum batch size must be at least one sequence");
+
+        if (m_config.m_latencyWindowSize == 0)
+            InvalidArgument("BatchingEvaluator: The latency window size must be at least one request");
+
+        for (auto& output : m_outputs)
+        {
+            // the outputs of a batch are split along the batch axis
+            if (output.DynamicAxes().empty())
+                InvalidArgument("BatchingEvaluator: The output%S has no batch axis", ParanthesizedName(output.Name()).c_str());
+
+            if (m_dataType == DataType::Unknown)
+                m_dataType = output.GetDataType();
+            else if (m_dataType != output.GetDataType())
+                InvalidArgument("BatchingEvaluator: The DataType of all outputs must be the same");
+        }
+
+        if ((m_dataType != DataType::Float) && (m_dataType != DataType::Double))
+            InvalidArgument("BatchingEvaluator: Unsupported DataType %s", DataTypeName(m_dataType));
+
+        m_arguments = Combine(m_outputs)->Arguments();
+
+        ResetStatistics();
+        m_worker = std::thread([this] { WorkerLoop(); });
+    }
+
+    BatchingEvaluatorImpl::~BatchingEvaluatorImpl()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            m_stopRequested = true;
+        }
+        m_queueChanged.notify_all();
+        m_worker.join();
+    }
+
+    std::future<std::unordered_map<Variable, ValuePtr>> BatchingEvaluatorImpl::Evaluate(const std::unordered_map<Variable, ValuePtr>& arguments)
+    {
+        auto request = std::make_shared<Request>();
+        for (auto& argument : m_arguments)
+        {
+            auto argumentValue = arguments.find(argument);
+            if (argumentValue == arguments.end() || !argumentValue->second)
+                InvalidArgument("BatchingEvaluator::Evaluate: Required argument's%S value has not been provided", ParanthesizedName(argument.Name()).c_str());
+
+            auto& value = argumentValue->second;
+            if (value->GetDataType() != m_dataType)
+                InvalidArgument("BatchingEvaluator::Evaluate: The DataType %s of the argument%S value does not match the DataType %s of the outputs",
+                                DataTypeName(value->GetDataType()), ParanthesizedName(argument.Name()).c_str(), DataTypeName(m_dataType));
+
+            if (value->IsSparse())
+                InvalidArgument("BatchingEvaluator::Evaluate: Sparse data supplied for the argument%S; only dense data is currently supported", ParanthesizedName(argument.Name()).c_str());
+
+            auto& sampleShape = argument.Shape();
+            auto& valueShape = value->Shape();
+            if ((valueShape.Rank() < sampleShape.Rank()) || (valueShape.Rank() > sampleShape.Rank() + 2) || (valueShape.SubShape(0, sampleShape.Rank()) != sampleShape))
+                InvalidArgument("BatchingEvaluator::Evaluate: The shape %S of the argument%S value does not match the shape %S of the argument",
+                                AsStringForErrorReporting(valueShape).c_str(), ParanthesizedName(argument.Name()).c_str(), AsStringForErrorReporting(sampleShape).c_str());
+
+            if ((valueShape.Rank() == sampleShape.Rank() + 2) && (valueShape[valueShape.Rank() - 1] != 1))
+                InvalidArgument("BatchingEvaluator::Evaluate: The value of the argument%S contains %d sequences; each request must contain exactly one",
+                                ParanthesizedName(argument.Name()).c_str(), (int)valueShape[valueShape.Rank() - 1]);
+
+            // masked steps can only be trailing steps of the sequence, so the valid samples are the leading ones
+            size_t numSamples = valueShape.SubShape(sampleShape.Rank()).TotalSize() - value->MaskedCount();
+            bool hasSequenceAxis = argument.DynamicAxes().size() > 1;
+            if ((numSamples == 0) || (!hasSequenceAxis && (numSamples != 1)))
+                InvalidArgument("BatchingEvaluator::Evaluate: The value of the argument%S contains %d samples; expected %s",
+                                ParanthesizedName(argument.Name()).c_str(), (int)numSamples, hasSequenceAxis ? "at least one" : "exactly one");
+
+            request->m_arguments[argument] = std::make_pair(value->Data()->DeepClone(DeviceDescriptor::CPUDevice(), /*readOnly =*/ true), numSamples);
+        }
+
+        auto result = request->m_result.get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            if (m_stopRequested)
+                LogicError("BatchingEvaluator::Evaluate: The evaluator is being destroyed");
+
+            request->m_enqueueTime = Clock::now();
+            m_queue.push_back(request);
+        }
+        m_queueChanged.notify_one();
+
+        return result;
+    }
+
+    void BatchingEvaluatorImpl::WorkerLoop()
+    {
+        const auto maxWaitTime = std::chrono::microseconds(m_config.m_maxWaitTimeInMicroseconds);
+        for (;;)
+        {
+            std::vector<RequestPtr> batch;
+            {
+                std::unique_lock<std::mutex> lock(m_queueMutex);
+                m_queueChanged.wait(lock, [this] { return m_stopRequested || !m_queue.empty(); });
+                if (m_queue.empty())
+                    return; // stop requested and nothing left to evaluate
+
+                // Give more requests the chance to join the batch, but not beyond the deadline of the oldest one.
+                // When stopping, the remaining requests are evaluated without waiting.
+                auto deadline = m_queue.front()->m_enqueueTime + maxWaitTime;
+                m_queueChanged.wait_until(lock, deadline, [this] { return m_stopRequested || (m_queue.size() >= m_config.m_maxBatchSizeInSequences); });
+
+                size_t batchSize = std::min(m_queue.size(), m_config.m_maxBatchSizeInSequences);
+                batch.assign(m_queue.begin(), m_queue.begin() + batchSize);
+                m_queue.erase(m_queue.begin(), m_queue.begin() + batchSize);
+            }
+
+            EvaluateBatch(batch);
+        }
+    }
+
+    void BatchingEvaluatorImpl::EvaluateBatch(std::vector<RequestPtr>& batch)
+    {
+        std::vector<std::unordered_map<Variable, ValuePtr>> results(batch.size());
+        size_t numSamples = 0;
+        try
+        {
+            std::unordered_map<Variable, ValuePtr> arguments;
+            for (auto& argument : m_arguments)
+            {
+                if (m_dataType == DataType::Float)
+                    arguments[argument] = PackArgument<float>(argument, batch);
+                else
+                    arguments[argument] = PackArgument<double>(argument, batch);
+            }
+
+            std::unordered_map<Variable, ValuePtr> outputs;
+            for (auto& output : m_outputs)
+                outputs[output] = nullptr;
+
+            m_function->Forward(arguments, outputs, m_config.m_device);
+
+            for (auto& output : m_outputs)
+            {
+                if (m_dataType == DataType::Float)
+                    ScatterOutput<float>(output, outputs[output], results);
+                else
+                    ScatterOutput<double>(output, outputs[output], results);
+            }
+
+            if (!m_arguments.empty())
+            {
+                for (auto& request : batch)
+                    numSamples += request->m_arguments[m_arguments.front()].second;
+            }
+        }
+        catch (...)
+        {
+            // a failing batch fails all of its requests
+            auto exception = std::current_exception();
+            for (auto& request : batch)
+                request->m_result.set_exception(exception);
+            return;
+        }
+
+        RecordCompletedBatch(batch, numSamples);
+        for (size_t i = 0; i < batch.size(); ++i)
+            batch[i]->m_result.set_value(std::move(results[i]));
+    }
+
+    // Packs the argument's sequences of all requests of a batch into a single Value, one sequence per request in request order
+    template <typename ElementType>
+    ValuePtr BatchingEvaluatorImpl::PackArgument(const Variable& argument, const std::vector<RequestPtr>& batch) const
+    {
+        size_t numElementsPerSample = argument.Shape().TotalSize();
+        size_t numSequences = batch.size();
+        size_t maxSequenceLength = 0;
+        for (auto& request : batch)
+            maxSequenceLength = std::max(maxSequenceLength, request->m_arguments.at(argument).second);
+
+        NDShape valueDataShape = argument.Shape().AppendShape({ maxSequenceLength, numSequences });
+        auto valueData = MakeSharedObject<NDArrayView>(m_dataType, valueDataShape, DeviceDescriptor::CPUDevice());
+        ElementType* dataBuffer = valueData->WritableDataBuffer<ElementType>();
+        std::fill(dataBuffer, dataBuffer + valueDataShape.TotalSize(), (ElementType)0);
+
+        NDMaskPtr valueMask;
+        for (size_t i = 0; i < numSequences; ++i)
+        {
+            auto& sequence = batch[i]->m_arguments.at(argument);
+            const ElementType* sequenceData = sequence.first->DataBuffer<ElementType>();
+            std::copy(sequenceData, sequenceData + (sequence.second * numElementsPerSample), dataBuffer + (i * maxSequenceLength * numElementsPerSample));
+
+            if (sequence.second < maxSequenceLength)
+            {
+                if (!valueMask)
+                {
+                    valueMask = MakeSharedObject<NDMask>(NDShape({ maxSequenceLength, numSequences }), DeviceDescriptor::CPUDevice());
+                    for (size_t j = 0; j < numSequences; ++j)
+                        valueMask->MarkSequenceBegin({ 0, j });
+                }
+
+                valueMask->InvalidateSection({ sequence.second, i }, { NDShape::InferredDimension, 1 });
+            }
+        }
+
+        if (m_config.m_device != DeviceDescriptor::CPUDevice())
+        {
+            auto deviceValueData = MakeSharedObject<NDArrayView>(m_dataType, valueDataShape, m_config.m_device);
+            deviceValueData->CopyFrom(*valueData);
+            valueData = deviceValueData;
+        }
+
+        return MakeSharedObject<Value>(valueData, valueMask);
+    }
+
+    // Splits a batched output Value into per-request Values holding the valid steps of each sequence
+    template <typename ElementType>
+    void BatchingEvaluatorImpl::ScatterOutput(const Variable& output, const ValuePtr& value, std::vector<std::unordered_map<Variable, ValuePtr>>& results) const
+    {
+        auto valueData = value->Data();
+        if (valueData->Device() != DeviceDescriptor::CPUDevice())
+            valueData = valueData->DeepClone(DeviceDescriptor::CPUDevice(), /*readOnly =*/ true);
+
+        auto& sampleShape = output.Shape();
+        size_t numElementsPerSample = sampleShape.TotalSize();
+        size_t numSequences = results.size();
+        size_t numColumns = valueData->Shape().SubShape(sampleShape.Rank()).TotalSize();
+        if ((numColumns % numSequences) != 0)
+            LogicError("BatchingEvaluator: The output%S value has %d columns, which is not a multiple of the number of sequences %d", ParanthesizedName(output.Name()).c_str(), (int)numColumns, (int)numSequences);
+
+        size_t maxSequenceLength = numColumns / numSequences;
+
+        const MaskKind* maskBuffer = nullptr;
+        auto valueMask = value->Mask();
+        if (valueMask)
+        {
+            if (valueMask->Device() != DeviceDescriptor::CPUDevice())
+                valueMask = valueMask->DeepClone(DeviceDescriptor::CPUDevice());
+
+            if (valueMask->Shape().TotalSize() != numColumns)
+                LogicError("BatchingEvaluator: The mask of the output%S value does not match its data", ParanthesizedName(output.Name()).c_str());
+
+            maskBuffer = valueMask->DataBuffer();
+        }
+
+        const ElementType* dataBuffer = valueData->DataBuffer<ElementType>();
+        for (size_t i = 0; i < numSequences; ++i)
+        {
+            size_t sequenceLength = maxSequenceLength;
+            if (maskBuffer)
+            {
+                sequenceLength = 0;
+                while ((sequenceLength < maxSequenceLength) && (maskBuffer[(i * maxSequenceLength) + sequenceLength] != MaskKind::Invalid))
+                    sequenceLength++;
+            }
+
+            auto sequenceData = MakeSharedObject<NDArrayView>(m_dataType, sampleShape.AppendShape({ sequenceLength, 1 }), DeviceDescriptor::CPUDevice());
+            const ElementType* sequenceBegin = dataBuffer + (i * maxSequenceLength * numElementsPerSample);
+            std::copy(sequenceBegin, sequenceBegin + (sequenceLength * numElementsPerSample), sequenceData->WritableDataBuffer<ElementType>());
+            results[i][output] = MakeSharedObject<Value>(sequenceData);
+        }
+    }
+
+    void BatchingEvaluatorImpl::RecordCompletedBatch(const std::vector<RequestPtr>& batch, size_t numSamples)
+    {
+        auto now = Clock::now();
+
+        std::lock_guard<std::mutex> lock(m_statisticsMutex);
+        m_numBatches++;
+        m_numRequests += batch.size();
+        m_numSamples += numSamples;
+        m_maxBatchSize = std::max(m_maxBatchSize, batch.size());
+        for (auto& request : batch)
+        {
+            double latency = std::chrono::duration<double, std::milli>(now - request->m_enqueueTime).count();
+            m_maxLatency = std::max(m_maxLatency, latency);
+            if (m_recentLatencies.size() < m_config.m_latencyWindowSize)
+                m_recentLatencies.push_back(latency);
+            else
+                m_recentLatencies[m_nextLatencyIndex] = latency;
+
+            m_nextLatencyIndex = (m_nextLatencyIndex + 1) % m_config.m_latencyWindowSize;
+        }
+    }
+
+    BatchingEvaluatorStatistics BatchingEvaluatorImpl::GetStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(m_statisticsMutex);
+
+        BatchingEvaluatorStatistics statistics;
+        statistics.m_numRequests = m_numRequests;
+        statistics.m_numBatches = m_numBatches;
+        statistics.m_numSamples = m_numSamples;
+        statistics.m_maxBatchSizeInSequences = m_maxBatchSize;
+        statistics.m_averageBatchSizeInSequences = (m_numBatches > 0) ? ((double)m_numRequests / m_numBatches) : 0.0;
+        statistics.m_maxLatencyInMilliseconds = m_maxLatency;
+
+        auto latencies = m_recentLatencies;
+        auto percentile = [&latencies](double p)
+        {
+            if (latencies.empty())
+                return 0.0;
+
+            size_t rank = std::min(latencies.size() - 1, (size_t)std::ceil(p * latencies.size()) - 1);
+            std::nth_element(latencies.begin(), latencies.begin() + rank, latencies.end());
+            return latencies[rank];
+        };
+        statistics.m_p50LatencyInMilliseconds = percentile(0.50);
+        statistics.m_p99LatencyInMilliseconds = percentile(0.99);
+
+        return statistics;
+    }
+
+    void BatchingEvaluatorImpl::ResetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_statisticsMutex);
+        m_numRequests = 0;
+        m_numBatches = 0;
+        m_numSamples = 0;
+        m_maxBatchSize = 0;
+        m_recentLatencies.clear();
+        m_nextLatencyIndex = 0;
+        m_maxLatency = 0;
+    }
+}}
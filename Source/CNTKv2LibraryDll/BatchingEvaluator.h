@@ -0,0 +1,74 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "stdafx.h"
+#include "CNTKLibraryExperimental.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+namespace CNTK { namespace Experimental {
+
+    class BatchingEvaluatorImpl final : public BatchingEvaluator
+    {
+    public:
+        BatchingEvaluatorImpl(const FunctionPtr& function, const std::vector<Variable>& outputs, const BatchingEvaluatorConfig& config);
+        ~BatchingEvaluatorImpl();
+
+        virtual std::future<std::unordered_map<Variable, ValuePtr>> Evaluate(const std::unordered_map<Variable, ValuePtr>& arguments) override;
+
+        virtual BatchingEvaluatorStatistics GetStatistics() const override;
+        virtual void ResetStatistics() override;
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        // A queued sequence. The argument data is kept in a private CPU copy so that the caller may reuse its buffers.
+        struct Request
+        {
+            std::unordered_map<Variable, std::pair<NDArrayViewPtr, size_t /*numSamples*/>> m_arguments;
+            std::promise<std::unordered_map<Variable, ValuePtr>> m_result;
+            Clock::time_point m_enqueueTime;
+        };
+        typedef std::shared_ptr<Request> RequestPtr;
+
+        void WorkerLoop();
+        void EvaluateBatch(std::vector<RequestPtr>& batch);
+
+        template <typename ElementType>
+        ValuePtr PackArgument(const Variable& argument, const std::vector<RequestPtr>& batch) const;
+
+        template <typename ElementType>
+        void ScatterOutput(const Variable& output, const ValuePtr& value, std::vector<std::unordered_map<Variable, ValuePtr>>& results) const;
+
+        void RecordCompletedBatch(const std::vector<RequestPtr>& batch, size_t numSamples);
+
+    private:
+        FunctionPtr m_function;
+        std::vector<Variable> m_outputs;
+        std::vector<Variable> m_arguments; // the arguments that 'm_outputs' depend on; each request must supply all of them
+        DataType m_dataType;
+        BatchingEvaluatorConfig m_config;
+
+        std::mutex m_queueMutex;
+        std::condition_variable m_queueChanged;
+        std::deque<RequestPtr> m_queue;
+        bool m_stopRequested;
+
+        mutable std::mutex m_statisticsMutex;
+        size_t m_numRequests;
+        size_t m_numBatches;
+        size_t m_numSamples;
+        size_t m_maxBatchSize;
+        std::vector<double> m_recentLatencies; // ring buffer of the last m_config.m_latencyWindowSize latencies in milliseconds
+        size_t m_nextLatencyIndex;
+        double m_maxLatency;
+
+        std::thread m_worker;
+    };
+}}
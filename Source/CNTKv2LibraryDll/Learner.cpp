@@ -84,6 +84,7 @@ namespace CNTK
             else
                 LogicError("Unsupported DataType %s", DataTypeName(v.second->GetDataType()));
         }
+        m_lazyUpdateTimestamps.clear();
     }
 
     // Clipping gradients to prevent outliers,
@@ -175,6 +176,7 @@ namespace CNTK
                              bool allocateSmoothGradients /* = true */)
                              : Learner(parameters, learningRateSchedule),
                              m_minibatchCount(0),
+                             m_lastTrainingSampleCount(0),
                              m_additionalOptions(additionalOptions)
     {
         std::unordered_set<Parameter> uniqueParameters(parameters.begin(), parameters.end());
@@ -222,6 +224,86 @@ namespace CNTK
         }
     }
 
+    template <typename ElementType>
+    bool LearnerBase::UseLazyUpdate(const Matrix<ElementType>& gradient) const
+    {
+        return m_additionalOptions.lazySparseUpdates &&
+               gradient.GetMatrixType() == MatrixType::SPARSE &&
+               gradient.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol &&
+               gradient.GetDeviceId() == CPUDEVICE;
+    }
+
+    vector<size_t>& LearnerBase::LazyUpdateTimestamps(const Parameter& parameter, size_t numColumns) const
+    {
+        auto& timestamps = m_lazyUpdateTimestamps[parameter];
+        // a parameter seen for the first time is up to date (any earlier updates were not lazy)
+        if (timestamps.size() != numColumns)
+            timestamps.assign(numColumns, m_minibatchCount);
+        return timestamps;
+    }
+
+    /*virtual*/ void LearnerBase::ApplyPendingUpdates() /*override*/
+    {
+        for (const auto& parameter : Parameters())
+        {
+            auto timestamps = m_lazyUpdateTimestamps.find(parameter);
+            if (timestamps == m_lazyUpdateTimestamps.end())
+                continue;
+
+            switch (parameter.GetDataType())
+            {
+            case DataType::Float:
+                ApplyPendingUpdates<float>(parameter, timestamps->second);
+                break;
+            case DataType::Double:
+                ApplyPendingUpdates<double>(parameter, timestamps->second);
+                break;
+            default:
+                LogicError("Unsupported DataType %s", DataTypeName(parameter.GetDataType()));
+            }
+        }
+    }
+
+    // A step with a zero gradient is exactly a step that a lazily updated column missed. Hence the lazy update of the last
+    // minibatch with zero gradients for the columns that lag behind brings these up to date, and leaves all others as they are.
+    template <typename ElementType>
+    void LearnerBase::ApplyPendingUpdates(const Parameter& parameter, const vector<size_t>& timestamps)
+    {
+        vector<CPUSPARSE_INDEX_TYPE> columnStarts(1, 0), laggingColumns;
+        for (size_t j = 0; j < timestamps.size(); j++)
+        {
+            if (timestamps[j] < m_minibatchCount)
+            {
+                laggingColumns.push_back((CPUSPARSE_INDEX_TYPE) j);
+                columnStarts.push_back((CPUSPARSE_INDEX_TYPE) laggingColumns.size());
+            }
+        }
+        if (laggingColumns.empty())
+            return;
+
+        // zeros [rows x k] times the transposed one-hot [columns x k] of the k lagging columns has a block for each of them
+        const auto shape = GetMatrixShape(parameter);
+        const size_t numLaggingColumns = laggingColumns.size();
+        vector<ElementType> ones(numLaggingColumns, 1);
+        Matrix<ElementType> oneHot(shape[1], numLaggingColumns, CPUDEVICE, MatrixType::SPARSE, MatrixFormat::matrixFormatSparseCSC);
+        oneHot.SetMatrixFromCSCFormat(columnStarts.data(), laggingColumns.data(), ones.data(), numLaggingColumns, shape[1], numLaggingColumns);
+        Matrix<ElementType> zeros(shape[0], numLaggingColumns, CPUDEVICE);
+        zeros.SetValue(0);
+        auto gradientMatrix = make_shared<Matrix<ElementType>>(shape[0], shape[1], CPUDEVICE, MatrixType::SPARSE, MatrixFormat::matrixFormatSparseBlockCol);
+        Matrix<ElementType>::MultiplyAndWeightedAdd(1, zeros, false, oneHot, true, 0, *gradientMatrix);
+
+        auto tensorView = new TensorView<ElementType>(gradientMatrix, AsTensorViewShape(parameter.Shape()));
+        auto gradientValue = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), parameter.Value()->Device(), StorageFormat::SparseBlockCol, parameter.Shape(), false, tensorView);
+
+        // the lazy update takes m_minibatchCount as the current step
+        m_minibatchCount--;
+        ApplyPendingSteps(parameter, gradientValue, m_smoothedGradientValues.at(parameter), m_lastTrainingSampleCount);
+        m_minibatchCount++;
+
+        auto paramRef = parameter;
+        paramRef.RecordValueUpdate();
+    }
+
     /*virtual*/ bool LearnerBase::Update(const unordered_map<Parameter, NDArrayViewPtr>& gradientValues, size_t trainingSampleCount) /*override*/
     {
         if (LearningRate(trainingSampleCount) == 0.0)
@@ -270,6 +352,7 @@ namespace CNTK
         }
         m_sampleCount += trainingSampleCount;
         m_minibatchCount++;
+        m_lastTrainingSampleCount = trainingSampleCount;
         // TODO: sweep count also needs to be updated.
         return true;
     }
@@ -320,6 +403,15 @@ namespace CNTK
             checkpoint[parameter.Uid()] = *smoothedGradientValue;
         }
 
+        Dictionary lazyUpdateTimestamps;
+        for (const auto& parameterTimestamps : m_lazyUpdateTimestamps)
+        {
+            const auto& timestamps = parameterTimestamps.second;
+            lazyUpdateTimestamps[parameterTimestamps.first.Uid()] = vector<DictionaryValue>(timestamps.begin(), timestamps.end());
+        }
+        checkpoint[lazyUpdateTimestampsKey] = lazyUpdateTimestamps;
+        checkpoint[lazyUpdateSampleCountKey] = m_lastTrainingSampleCount;
+
         return checkpoint;
     }
 
@@ -362,6 +454,23 @@ namespace CNTK
 
             smoothedGradientValue->CopyFrom(checkpointedValue);
         }
+
+        // Checkpoints written before lazy updates have none, all columns are then up to date.
+        m_lazyUpdateTimestamps.clear();
+        m_lastTrainingSampleCount = checkpoint.Contains(lazyUpdateSampleCountKey) ? checkpoint[lazyUpdateSampleCountKey].Value<size_t>() : 0;
+        if (checkpoint.Contains(lazyUpdateTimestampsKey))
+        {
+            const Dictionary& lazyUpdateTimestamps = checkpoint[lazyUpdateTimestampsKey].Value<Dictionary>();
+            for (const auto& parameter : parameters)
+            {
+                if (!lazyUpdateTimestamps.Contains(parameter.Uid()))
+                    continue;
+
+                auto& timestamps = m_lazyUpdateTimestamps[parameter];
+                for (const auto& timestamp : lazyUpdateTimestamps[parameter.Uid()].Value<vector<DictionaryValue>>())
+                    timestamps.push_back(timestamp.Value<size_t>());
+            }
+        }
     }
 
     /*virtual*/ void LearnerSGD::Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const /*override*/
@@ -383,8 +492,17 @@ namespace CNTK
         // TODO: break up the NormalGrad into 3 different functions, each with its own set of parameters
         // Also, come up with a better name for NormalGrad (Default? Regular? Plain?).
         // (one for vanilla SGD, the other for momentum SGD, and the third one for NAG).
-        smoothedGradientMatrix->NormalGrad(*gradientMatrix, *parameterMatrix,
-                                           learningRate, momentum, UseNesterovMomentum());
+        // Without momentum, NormalGrad() adds the sparse gradient directly and there are no steps to catch up on.
+        if (momentum != 0 && UseLazyUpdate(*gradientMatrix))
+            smoothedGradientMatrix->LazyNormalGrad(*gradientMatrix, *parameterMatrix, learningRate, momentum, UseNesterovMomentum(),
+                                                   LazyUpdateTimestamps(parameter, parameterMatrix->GetNumCols()), m_minibatchCount);
+        else
+        {
+            // the columns are up to date if the momentum becomes nonzero again
+            m_lazyUpdateTimestamps.erase(parameter);
+            smoothedGradientMatrix->NormalGrad(*gradientMatrix, *parameterMatrix,
+                                               learningRate, momentum, UseNesterovMomentum());
+        }
     }
 
     double LearnerMomentumSGD::MomentumValueForMB(const MomentumSchedule& schedule, size_t minibatchSize) const
@@ -457,7 +575,24 @@ namespace CNTK
 
         double& smoothedCount = m_smoothedCounts.at(parameter);
 
-        smoothedGradientMatrix->FSAdagradUpdate(trainingSampleCount, *gradientMatrix, *parameterMatrix, smoothedCount, learningRate, s_targetAdagradAvDenom, momentum, varMomentum);
+        if (UseLazyUpdate(*gradientMatrix))
+            smoothedGradientMatrix->LazyFSAdagradUpdate(trainingSampleCount, *gradientMatrix, *parameterMatrix, smoothedCount, learningRate, s_targetAdagradAvDenom, momentum, varMomentum,
+                                                        LazyUpdateTimestamps(parameter, parameterMatrix->GetNumCols()), m_minibatchCount);
+        else
+        {
+            // a later lazy update continues from the state of this dense one
+            m_lazyUpdateTimestamps.erase(parameter);
+            smoothedGradientMatrix->FSAdagradUpdate(trainingSampleCount, *gradientMatrix, *parameterMatrix, smoothedCount, learningRate, s_targetAdagradAvDenom, momentum, varMomentum);
+        }
+    }
+
+    /*virtual*/ void LearnerFSAdaGrad::ApplyPendingSteps(const Parameter& parameter, const NDArrayViewPtr& zeroGradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const /*override*/
+    {
+        // the pending steps are part of minibatches that were already counted
+        double& smoothedCount = m_smoothedCounts.at(parameter);
+        const double countedSmoothedCount = smoothedCount;
+        LearnerMomentumSGD::ApplyPendingSteps(parameter, zeroGradientValue, smoothedGradientValue, trainingSampleCount);
+        smoothedCount = countedSmoothedCount;
     }
 
     LearnerRMSProp::LearnerRMSProp(const vector<Parameter>& parameters,
@@ -501,14 +636,40 @@ namespace CNTK
 
         const auto learningRate = LearningRate(trainingSampleCount);
 
-        const auto aveMultiplier = smoothedGradientMatrix->RmsProp(*gradientMatrix,
+        // The average multiplier is taken over all elements, including the columns a lazy update would not visit,
+        // so in that case a block-column gradient is made dense and the dense update is used.
+        if (UseLazyUpdate(*gradientMatrix) && !m_needAveMultiplier)
+        {
+            smoothedGradientMatrix->LazyRmsProp(*gradientMatrix,
+                                                ElementType(m_gamma),
+                                                ElementType(m_inc),
+                                                ElementType(m_max),
+                                                ElementType(m_dec),
+                                                ElementType(m_min),
+                                                LazyUpdateTimestamps(parameter, parameterMatrix->GetNumCols()), m_minibatchCount);
+            Matrix<ElementType>::ScaleAndAdd(ElementType(-learningRate), *gradientMatrix, *parameterMatrix);
+            return;
+        }
+
+        // a later lazy update continues from the state of this dense one
+        m_lazyUpdateTimestamps.erase(parameter);
+
+        auto denseGradientMatrix = gradientMatrix;
+        if (UseLazyUpdate(*gradientMatrix))
+        {
+            denseGradientMatrix = make_shared<Matrix<ElementType>>(gradientMatrix->GetNumRows(), gradientMatrix->GetNumCols(), gradientMatrix->GetDeviceId());
+            denseGradientMatrix->SetValue(0);
+            Matrix<ElementType>::ScaleAndAdd(1, *gradientMatrix, *denseGradientMatrix);
+        }
+
+        const auto aveMultiplier = smoothedGradientMatrix->RmsProp(*denseGradientMatrix,
                                                                    ElementType(m_gamma),
                                                                    ElementType(m_inc),
                                                                    ElementType(m_max),
                                                                    ElementType(m_dec),
                                                                    ElementType(m_min),
                                                                    m_needAveMultiplier);
-        Matrix<ElementType>::ScaleAndAdd(ElementType(-learningRate / aveMultiplier), *gradientMatrix, *parameterMatrix);
+        Matrix<ElementType>::ScaleAndAdd(ElementType(-learningRate / aveMultiplier), *denseGradientMatrix, *parameterMatrix);
     }
 
     // Explicit template instantiations
@@ -27,6 +27,8 @@ namespace CNTK
 
         virtual void ResetSmoothedGradients() override final;
 
+        virtual void ApplyPendingUpdates() override final;
+
     protected:
         // allocateSmoothGradients flag specifies whether NDArrayViews for smoothed gradients can be allocated 
         // in the base class constructor (in which case they are allocated with the shapes identical to the shapes of
@@ -92,14 +94,41 @@ namespace CNTK
         // Retrieves the shape of the matrix corresponding to the parameter value.
         static NDShape GetMatrixShape(const Parameter& parameter);
 
+        // Returns true if the gradient is applied lazily, i.e. only to the columns of the parameter it contains.
+        // This is the case for block-column sparse gradients on the CPU (e.g. those of embeddings) if lazySparseUpdates
+        // is set; the optimizer cost is then proportional to the number of columns used in the minibatch rather than
+        // the size of the table.
+        template <typename ElementType>
+        bool UseLazyUpdate(const Microsoft::MSR::CNTK::Matrix<ElementType>& gradient) const;
+
+        // Returns, for each column of the parameter, the number of minibatches it is up to date with, so that the
+        // steps a column missed can be applied the next time it is updated lazily.
+        std::vector<size_t>& LazyUpdateTimestamps(const Parameter& parameter, size_t numColumns) const;
+
+        // Applies the zero gradients of the columns that lag behind as the (lazy) update of the last minibatch,
+        // see ApplyPendingUpdates().
+        virtual void ApplyPendingSteps(const Parameter& parameter, const NDArrayViewPtr& zeroGradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const
+        {
+            Update(parameter, zeroGradientValue, smoothedGradientValue, trainingSampleCount);
+        }
+
         size_t m_minibatchCount;
 
+        // Checkpointed with the smoothed gradients, so that the steps pending for the columns of lazily updated parameters
+        // are still applied after a restore. The pending steps are applied with the hyperparameters of the last minibatch,
+        // whose sample count is kept for that.
+        mutable std::unordered_map<Parameter, std::vector<size_t>> m_lazyUpdateTimestamps;
+        size_t m_lastTrainingSampleCount;
+
     private:
         // Templatized update function, it invokes preprocess and postprocess using the provided
         // template parameter and also invokes virtual Update method implemented in one of the subclasses.
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
 
+        template <typename ElementType>
+        void ApplyPendingUpdates(const Parameter& parameter, const std::vector<size_t>& timestamps);
+
         // TODO: make these functions friends of NDViewArray and move to Utils?
         static bool HasNan(const NDArrayViewPtr& value, const char* name);
         static void Print(const NDArrayViewPtr& value, const char* msg);
@@ -221,6 +250,8 @@ namespace CNTK
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
 
+        virtual void ApplyPendingSteps(const Parameter& parameter, const NDArrayViewPtr& zeroGradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
+
     private:
         static const double s_targetAdagradAvDenom;
 
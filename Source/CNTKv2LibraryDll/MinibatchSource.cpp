@@ -88,10 +88,11 @@ namespace CNTK
         for (auto& deserializerConfig : deserializerConfigurations)
         {
             static const std::unordered_map<std::wstring, std::wstring> deserializerTypeNameToModuleNameMap = {
-                { L"CNTKTextFormatDeserializer", L"CNTKTextFormatReader" },
-                { L"ImageDeserializer",          L"ImageReader"          },
-                { L"HTKFeatureDeserializer",     L"HTKDeserializers"     },
-                { L"HTKMLFDeserializer",         L"HTKDeserializers"     },
+                { L"CNTKTextFormatDeserializer",   L"CNTKTextFormatReader" },
+                { L"CNTKBinaryFormatDeserializer", L"CNTKTextFormatReader" },
+                { L"ImageDeserializer",            L"ImageReader"          },
+                { L"HTKFeatureDeserializer",       L"HTKDeserializers"     },
+                { L"HTKMLFDeserializer",           L"HTKDeserializers"     },
             };
 
             auto& deserializerConfigDict = deserializerConfig.Value<Dictionary>();
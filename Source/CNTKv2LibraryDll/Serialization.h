@@ -36,6 +36,8 @@ namespace CNTK
     const std::wstring stateKey = L"state";
     const std::wstring rngSeedKey = L"rng_seed";
     const std::wstring rngOffsetKey = L"rng_offset";
+    const std::wstring lazyUpdateTimestampsKey = L"lazy_update_timestamps";
+    const std::wstring lazyUpdateSampleCountKey = L"lazy_update_sample_count";
 
     template <typename T> 
     inline std::string GetVersionsString(size_t currentVersion, size_t dictVersion)
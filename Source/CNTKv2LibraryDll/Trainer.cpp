@@ -142,6 +142,8 @@ namespace CNTK
         if (!m_aggregatedEvaluationFunction)
             InvalidArgument("Trainer::TestMinibatch: Cannot test when no evaluation function was specified during 'this' trainer's construction");
 
+        ApplyPendingUpdates();
+
         // TODO: Should we refactor this code that is somewhat similar to the prologue of the TrainMinibatch function
         std::unordered_map<Variable, ValuePtr> outputs = { { m_aggregatedEvaluationFunction, nullptr }, { m_testSampleCountVar, nullptr } };
         m_combinedTrainingFunction->Forward(arguments, outputs, computeDevice);
@@ -311,6 +313,9 @@ namespace CNTK
 
     void Trainer::SaveCheckpoint(const std::wstring& modelFilePath, bool usinglegacyModelFormat)
     {
+        // (on all workers, which update their parameters the same way)
+        ApplyPendingUpdates();
+
         // TODO: Need to pass currect state of the minibatch source here.
         if (!m_distributedTrainer)
             return Save(modelFilePath, usinglegacyModelFormat, Dictionary());
@@ -328,6 +333,12 @@ namespace CNTK
         m_distributedTrainer->GetCommunicator()->Barrier();
     }
 
+    void Trainer::ApplyPendingUpdates()
+    {
+        for (const auto& learner : m_parameterLearners)
+            learner->ApplyPendingUpdates();
+    }
+
     void Trainer::Save(const std::wstring& modelFilePath, bool usinglegacyModelFormat, const Dictionary& distributedLearnerState)
     {
         vector<DictionaryValue> learnerStates;
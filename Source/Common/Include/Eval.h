@@ -362,4 +362,17 @@ void EVAL_API GetEvalExtended(IEvaluateModelExtended<ElemType>** peval);
 extern "C" EVAL_API void GetEvalExtendedF(IEvaluateModelExtended<float>** peval);
 extern "C" EVAL_API void GetEvalExtendedD(IEvaluateModelExtended<double>** peval);
 
+//
+// GetSharedEvalExtended - create another evaluator for the model of eval (obtained from GetEvalExtended() and
+// CreateNetwork()) that shares its parameters and precomputed statistics (they are neither copied nor reloaded), but
+// has its own activations, MBLayouts and memory pool. Different evaluators created this way can call ForwardPass()
+// concurrently, one thread per evaluator; e.g. a server creates one per worker thread. If StartForwardEvaluation()
+// has been called on eval, the new one is started for the same outputs. The new evaluator must be released with
+// Destroy(); it stays valid after eval has been destroyed.
+//
+template <typename ElemType>
+void EVAL_API GetSharedEvalExtended(IEvaluateModelExtended<ElemType>* eval, IEvaluateModelExtended<ElemType>** peval);
+extern "C" EVAL_API void GetSharedEvalExtendedF(IEvaluateModelExtended<float>* eval, IEvaluateModelExtended<float>** peval);
+extern "C" EVAL_API void GetSharedEvalExtendedD(IEvaluateModelExtended<double>* eval, IEvaluateModelExtended<double>** peval);
+
 } } }
@@ -22,6 +22,8 @@ enum class NetworkOperationMode
     preComputing // precomputation is a part of training where most nodes should behave like they are inferring
 };
 
+class NodeProfiler;
+
 // class to store global properties of the network that are of interest to the nodes
 // For example, a network can be in 'training' or 'inference' mode, which affects what nodes like Dropout and BN do,
 // or what the seq-2-seq decoder feedback signal is.
@@ -48,6 +50,9 @@ struct ComputationEnvironment
     // Extreme tracing of node outputs. Make space on your disk.
     bool IsLogLevelNodeTrace() const { return traceLevel >= 1000000; }
 
+    // per-node profiling of the forward and backward passes; null if not profiling
+    std::shared_ptr<NodeProfiler> nodeProfiler;
+
     // more properties should be added here as needed
 };
 typedef std::shared_ptr<ComputationEnvironment> ComputationEnvironmentPtr;
@@ -36,13 +36,13 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // -----------------------------------------------------------------------
 
 template <>
-vector<shared_ptr<Matrix<float>>>& MatrixPool::GetReleasedMatrices<float>()
+MatrixPool::ReleasedMatrices<float>& MatrixPool::GetReleasedMatrices<float>()
 {
     return m_releasedFloatMatrices;
 }
 
 template <>
-vector<shared_ptr<Matrix<double>>>& MatrixPool::GetReleasedMatrices<double>()
+MatrixPool::ReleasedMatrices<double>& MatrixPool::GetReleasedMatrices<double>()
 {
     return m_releasedDoubleMatrices;
 }
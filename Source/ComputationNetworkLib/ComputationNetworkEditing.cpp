@@ -103,6 +103,55 @@ void ComputationNetwork::CopyInputs(const std::wstring fromName, std::wstring to
     CopyNode(*this, fromName, toName, CopyNodeFlags::copyNodeInputLinks);
 }
 
+// CloneWithSharedParameters - create a network with the same structure whose model state (learnable parameters,
+// other non-input leaves and precomputed statistics) shares its value matrices with this network. All other state
+// (node values, MBLayouts, matrix pool) is owned by the clone, so that clones can be evaluated concurrently on
+// different threads, as long as the shared parameters are not modified meanwhile.
+ComputationNetworkPtr ComputationNetwork::CloneWithSharedParameters() const
+{
+    VerifyIsCompiled("CloneWithSharedParameters");
+
+    auto net = make_shared<ComputationNetwork>(GetDeviceId());
+    net->SetTraceLevel(TraceLevel());
+
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const auto& node = iter.second;
+        // The model state is held by the leaves other than the inputs (parameters, constants), except for leaves
+        // that recompute their value in every forward pass (e.g. EnvironmentInput), and by the precompute nodes,
+        // whose value is fixed once computed although they have inputs.
+        bool isModelState = (node->IsLeaf() && !node->Is<ITakesDynamicAxis>() && !node->IsOutOfDateWrtInputs()) || node->Is<IPreComputeNode>();
+        // All other nodes only take over their layout and configuration; the clone's AllocateAllMatrices() gives them
+        // their own (pooled) value and gradient matrices rather than copies of this network's.
+        auto flags = (CopyNodeFlags)(CopyNodeFlags::copyNodeValue | (isModelState ? CopyNodeFlags::copyNodeShareValue : CopyNodeFlags::copyNodeWithoutValue));
+        net->AddNodeToNet(node->Duplicate(node->NodeName(), flags));
+    }
+
+    // connect the new nodes in the same way
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        std::vector<ComputationNodeBasePtr> inputs;
+        for (const auto& input : iter.second->GetInputs())
+            inputs.push_back(net->GetNodeFromName(input->NodeName()));
+        net->GetNodeFromName(iter.first)->AttachInputs(inputs);
+    }
+
+    // Duplicate() has copied the node tags; this puts the nodes into the node groups accordingly
+    auto addToNodeGroup = [&](const std::wstring& groupTag, const std::vector<ComputationNodeBasePtr>& nodeGroup)
+    {
+        for (const auto& node : nodeGroup)
+            net->AddToNodeGroup(groupTag, net->GetNodeFromName(node->NodeName()));
+    };
+    addToNodeGroup(L"feature",    m_featureNodes);
+    addToNodeGroup(L"label",      m_labelNodes);
+    addToNodeGroup(L"criterion",  m_criterionNodes);
+    addToNodeGroup(L"evaluation", m_evaluationNodes);
+    addToNodeGroup(L"output",     m_outputNodes);
+
+    net->CompileNetwork();
+    return net;
+}
+
 // RenameNode - Rename a node to another name
 // nodeNameOrig - original node name
 // nodeNameNew - new node name
@@ -11,6 +11,7 @@
 #include "RecurrentNodes.h"
 #include "InputAndParamNodes.h"
 #include "LinearAlgebraNodes.h"
+#include "NodeProfiler.h"
 #include <string>
 #include <vector>
 #include <list>
@@ -105,6 +106,12 @@ ComputationNodeBasePtr ComputationNetwork::GetNestedNetwork(const ComputationNod
 
 template<class ElemType> static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient);
 
+// returns the profiler the nodes should report to, or null if not profiling
+static NodeProfiler* GetNodeProfiler(const ComputationNodeBasePtr& node)
+{
+    return node->HasEnvironmentPtr() ? node->Environment().nodeProfiler.get() : nullptr;
+}
+
 ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(const std::vector<shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const std::list<ComputationNodeBasePtr>& allNodes /*must be in eval order*/)
 {
     // traverse the network in evaluation order and create a new list that replaces all recurrence by a SEQTraversalFlowControlNode
@@ -142,10 +149,17 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 #endif
         if (node->IsOutOfDateWrtInputs())
         {
+            // SEQ loops have no environment and report their nested nodes themselves
+            auto profiler = GetNodeProfiler(node);
+            auto begin = profiler ? NodeProfiler::Now() : NodeProfiler::Clock::time_point();
+
             node->BeginForwardProp();
             node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
             node->EndForwardProp();
 
+            if (profiler)
+                profiler->RecordNode(node, NodeProfilerPass::forward, begin, NodeProfiler::Now());
+
             node->BumpEvalTimeStamp();
         }
 
@@ -162,10 +176,16 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
     {
         auto& node = *pnode;
 
+        auto profiler = GetNodeProfiler(node);
+        auto begin = profiler ? NodeProfiler::Now() : NodeProfiler::Clock::time_point();
+
         node->BeginBackprop();
         node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
         node->EndBackprop();
 
+        if (profiler)
+            profiler->RecordNode(node, NodeProfilerPass::backward, begin, NodeProfiler::Now());
+
         // Extreme Tracing, part 2/4
         if (node->HasEnvironmentPtr() && node->Environment().IsLogLevelNodeTrace() && node->NeedsGradient())
             DumpNode<float>(node, /*dumpGradient=*/true) || DumpNode<double>(node, true);
@@ -245,13 +265,36 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
     // Note: Currently, this is limited to linear-time loops. But nothing stops the iteration below to, e.g., be a 2D iteration over an image
     // if we implement an according FrameRangeIteration.
     FrameRangeIteration range(GetMBLayout(), m_steppingDirection);
-    for (auto t = range.begin(); t != range.end(); t++)
+    auto profiler = GetNodeProfiler(m_nestedNodes[0]);
+    if (!profiler)
     {
-        for (auto& node : m_nestedNodes)
+        for (auto t = range.begin(); t != range.end(); t++)
         {
-            node->ForwardProp(t);
-            node->BumpEvalTimeStamp();
+            for (auto& node : m_nestedNodes)
+            {
+                node->ForwardProp(t);
+                node->BumpEvalTimeStamp();
+            }
+        }
+    }
+    else // same as above, but accumulating the time of each node over all time steps
+    {
+        let loopBegin = NodeProfiler::Now();
+        vector<double> seconds(m_nestedNodes.size(), 0);
+        size_t numSteps = 0;
+        for (auto t = range.begin(); t != range.end(); t++, numSteps++)
+        {
+            for (size_t i = 0; i < m_nestedNodes.size(); i++)
+            {
+                let begin = NodeProfiler::Now();
+                m_nestedNodes[i]->ForwardProp(t);
+                m_nestedNodes[i]->BumpEvalTimeStamp();
+                seconds[i] += std::chrono::duration<double>(NodeProfiler::Now() - begin).count();
+            }
         }
+        for (size_t i = 0; i < m_nestedNodes.size(); i++)
+            profiler->AccumulateNode(m_nestedNodes[i], NodeProfilerPass::forward, seconds[i], numSteps);
+        profiler->RecordTraceEvent(NodeName(), L"Loop", NodeProfilerPass::forward, loopBegin, NodeProfiler::Now());
     }
 
     // Extreme Tracing, part 3/4
@@ -284,16 +327,38 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
     const auto& recurrentNodes = m_nestedNodes; // BUGBUG: -ForForward?? Does this mean we can remove non-ForForward?
     auto pMBLayout = recurrentNodes[0]->GetMBLayout();
     FrameRangeIteration range(pMBLayout, m_steppingDirection);
-    for (auto t = range.rbegin(); t != range.rend(); t++) // note: reverse iteration
+    auto profiler = GetNodeProfiler(recurrentNodes[0]);
+    if (!profiler)
     {
-        for (auto nodeIter2 = recurrentNodes.rbegin(); nodeIter2 != recurrentNodes.rend(); ++nodeIter2)
+        for (auto t = range.rbegin(); t != range.rend(); t++) // note: reverse iteration
         {
-            auto& node2 = *nodeIter2;
-            node2->Backprop(t, true /*childrenInThisLoop*/, false /*childrenInOuterLoop*/);
-            // The above flags tell Backprop() to skip back-propagation from inside a node into
-            // a node that is outside the loop, which is done later in EndBackprop() in PAR mode.
+            for (auto nodeIter2 = recurrentNodes.rbegin(); nodeIter2 != recurrentNodes.rend(); ++nodeIter2)
+            {
+                auto& node2 = *nodeIter2;
+                node2->Backprop(t, true /*childrenInThisLoop*/, false /*childrenInOuterLoop*/);
+                // The above flags tell Backprop() to skip back-propagation from inside a node into
+                // a node that is outside the loop, which is done later in EndBackprop() in PAR mode.
+            }
         }
     }
+    else // same as above, but accumulating the time of each node over all time steps
+    {
+        let loopBegin = NodeProfiler::Now();
+        vector<double> seconds(recurrentNodes.size(), 0);
+        size_t numSteps = 0;
+        for (auto t = range.rbegin(); t != range.rend(); t++, numSteps++)
+        {
+            for (size_t i = recurrentNodes.size(); i-- > 0;)
+            {
+                let begin = NodeProfiler::Now();
+                recurrentNodes[i]->Backprop(t, true /*childrenInThisLoop*/, false /*childrenInOuterLoop*/);
+                seconds[i] += std::chrono::duration<double>(NodeProfiler::Now() - begin).count();
+            }
+        }
+        for (size_t i = 0; i < recurrentNodes.size(); i++)
+            profiler->AccumulateNode(recurrentNodes[i], NodeProfilerPass::backward, seconds[i], numSteps);
+        profiler->RecordTraceEvent(NodeName(), L"Loop", NodeProfilerPass::backward, loopBegin, NodeProfiler::Now());
+    }
 
     // Extreme Tracing, part 4
     for (auto& node : m_nestedNodes)
@@ -310,10 +375,16 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
 {
     // The following loop handles the case that a node inside the loop back-propagates a gradient into a node outside of the loop.
     // For efficiency, we perform this outside the loop in PAR mode. E.g., in one LSTM speech setup, we measured 12..14% overall speed-up.
+    // This includes members of other loops (e.g. the output of a lower layer consumed directly inside this one): the gradient into
+    // them does not take part in this loop's recurrence, and their own loop is only processed after this one is done.
+    auto profiler = GetNodeProfiler(m_nestedNodes[0]);
     for (auto nodeIter2 = m_nestedNodes.rbegin(); nodeIter2 != m_nestedNodes.rend(); ++nodeIter2)
     {
         auto& node2 = *nodeIter2;
+        auto begin = profiler ? NodeProfiler::Now() : NodeProfiler::Clock::time_point();
         node2->Backprop(FrameRange(m_nestedNodes[0]->GetMBLayout()), false /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+        if (profiler) // added to the node's backward time, but not counted as another call
+            profiler->AccumulateNode(node2, NodeProfilerPass::backward, std::chrono::duration<double>(NodeProfiler::Now() - begin).count(), 0);
     }
 
     // tell all nodes we are done for this iteraTion
@@ -1124,7 +1195,10 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
 
     // print the memory sharing structure
     if (TraceLevel() > 0)
-    PrintMemorySharingStructure(GetAllNodes());
+    {
+        PrintMemorySharingStructure(GetAllNodes());
+        m_matrixPool.PrintMemoryPlan();
+    }
 }
 
 void ComputationNetwork::ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, int>& parentCount)
@@ -51,8 +51,8 @@ void ComputationNode<ElemType>::Backprop(const FrameRange& fr, bool childrenInTh
     {
         ComputationNodePtr child = Input(i);
         if (child->m_needsGradient &&
-            ((childrenInThisLoop  && child->IsPartOfLoop() == IsPartOfLoop()) ||
-             (childrenInOuterLoop && child->IsPartOfLoop() != IsPartOfLoop()) ))
+            ((childrenInThisLoop  &&  child->IsPartOfSameLoop(*this)) ||
+             (childrenInOuterLoop && !child->IsPartOfSameLoop(*this)) ))
         {
             // fprintf(stderr, "Backprop: %ls %ls operation -> child %d %ls %ls\n", NodeName().c_str(), OperationName().c_str(), (int)i, child->NodeName().c_str(), child->OperationName().c_str());
             if (!m_needsGradient)
@@ -62,12 +62,12 @@ void ComputationNode<ElemType>::Backprop(const FrameRange& fr, bool childrenInTh
 #endif
             child->LazyZeroGradient(); // set gradient to 0 if this is the first time
 
-            // If we propagate from a loop to a node that is outside the loop, we are not efficient.
-            // This case is handled by SEQTraversalFlowControlNode::Backprop().
+            // If we propagate from a loop to a node that is outside the loop (which includes nodes of another loop), we are not efficient.
+            // This case is handled by SEQTraversalFlowControlNode::EndBackprop().
             // The check below is to verify that.
-            if (IsPartOfLoop() && !child->IsPartOfLoop() && !fr.IsAllFrames())
+            if (IsPartOfLoop() && !child->IsPartOfSameLoop(*this) && !fr.IsAllFrames())
             {
-                LogicError("Backprop: Inefficiency: %ls %ls operation in loop propagates gradient to non-loop %ls %ls\n",
+                LogicError("Backprop: Inefficiency: %ls %ls operation in loop propagates gradient to %ls %ls outside of that loop\n",
                            NodeName().c_str(), OperationName().c_str(), child->NodeName().c_str(), child->OperationName().c_str());
             }
 
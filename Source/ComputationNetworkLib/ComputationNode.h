@@ -46,7 +46,8 @@
 #define CNTK_MODEL_VERSION_14 14 // axis parameter in OptimizedRNNStackNode
 #define CNTK_MODEL_VERSION_15 15 // add new nodes: LambdaRankNode and NDCG1Eval
 #define CNTK_MODEL_VERSION_16 16 // save/load rng state for Dropout and RandomSample nodes.
-#define CURRENT_CNTK_MODEL_VERSION CNTK_MODEL_VERSION_16
+#define CNTK_MODEL_VERSION_17 17 // number of bits in QuantizedTimesNode
+#define CURRENT_CNTK_MODEL_VERSION CNTK_MODEL_VERSION_17
 
 // helper mode for debugging
 // If TRACK_GAP_NANS is defined then initialize layout gaps to NaN and do NaN checks. Also do detailed logging of node computations.
@@ -60,7 +61,9 @@ enum CopyNodeFlags // flags to be passed to the CopyTo() function
     copyNodeValue          = 1, // copy everything except for the input links
     copyNodeInputLinks     = 2, // copy over input links
     copyNodeAll            = 3, // copy everything
-    copyNodeAcrossNetworks = 4  // allow a cross network child copy
+    copyNodeAcrossNetworks = 4, // allow a cross network child copy
+    copyNodeShareValue     = 8, // together with copyNodeValue: share the value matrix instead of copying it (no gradient)
+    copyNodeWithoutValue   = 16 // together with copyNodeValue: copy everything but the value and gradient matrices, which the new node allocates itself
 };
 
 #pragma region base computation class
@@ -156,11 +159,13 @@ struct ComputationNetworkOwnedNodeState
     {
         PurgeStateForFormingRecurrentLoops();
         m_isPartOfLoop = false;
+        m_loopIndex = -1;
     }
 
     void CopyTo(ComputationNetworkOwnedNodeState& other) const
     {
         other.m_isPartOfLoop                  = m_isPartOfLoop;
+        other.m_loopIndex                     = m_loopIndex;
         other.m_needsGradient                 = m_needsGradient;
         other.m_valueSharable                 = m_valueSharable;
         other.m_traceNodeValueReal            = m_traceNodeValueReal;
@@ -171,6 +176,8 @@ struct ComputationNetworkOwnedNodeState
     }
 
     bool IsPartOfLoop() const { return m_isPartOfLoop; }
+    // true if both nodes are members of the same recurrent loop, or both are outside of any loop
+    bool IsPartOfSameLoop(const ComputationNetworkOwnedNodeState& other) const { return m_isPartOfLoop == other.m_isPartOfLoop && (!m_isPartOfLoop || m_loopIndex == other.m_loopIndex); }
 
     virtual void MarkValueNonSharable() { m_valueSharable = false; }
     virtual void MarkValueSharable() { m_valueSharable = true; }
@@ -194,6 +201,7 @@ protected:                // TODO: should be fully encapsulated here
                           // it will never be released to memory pool
 private:
     bool m_isPartOfLoop; // true if this loop is part of a recurrent loop
+    int m_loopIndex;     // if m_isPartOfLoop, index of the loop in m_allSEQNodes (unlike m_loopId, this survives FormRecurrentLoops())
 
 protected:
     // owned by FormRecurrentLoops() and stuff it calls, only used from inside there (FormRecurrentLoops() calls PurgeStateForFormingRecurrentLoops() at its end to make that super-clear)
@@ -1195,7 +1203,13 @@ public:
     virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
     {
         Base::CopyTo(nodeP, newName, flags);
-        if (flags & CopyNodeFlags::copyNodeValue)
+        if ((flags & CopyNodeFlags::copyNodeValue) && (flags & CopyNodeFlags::copyNodeShareValue))
+        {
+            auto node = DownCast(nodeP);
+            node->m_value = m_value;
+            node->m_gradient = nullptr;
+        }
+        else if ((flags & CopyNodeFlags::copyNodeValue) && !(flags & CopyNodeFlags::copyNodeWithoutValue))
         {
             auto node = DownCast(nodeP);
             if (m_value)
@@ -1755,7 +1769,7 @@ public:
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
     {
         if (IsValueSharable())
-            RequestMatrixFromPool(m_value, matrixPool);
+            RequestMatrixFromPool(m_value, matrixPool, GetSampleLayout().GetNumElements());
         else
             CreateMatrixIfNull(m_value);
     }
@@ -1780,7 +1794,7 @@ public:
     // request matrices that are needed for gradient computation
     virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
     {
-        RequestMatrixFromPool(m_gradient, matrixPool);
+        RequestMatrixFromPool(m_gradient, matrixPool, GetSampleLayout().GetNumElements());
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
@@ -1825,11 +1839,17 @@ protected:
             matrixPtr = make_shared<Matrix<ElemType>>(m_deviceId);
     }
 
-    void RequestMatrixFromPool(shared_ptr<Matrix<ElemType>>& matrixPtr, MatrixPool& matrixPool)
+    // 'size' is the number of elements per sample the matrix will hold, used by the pool for best fit, or 0 if unknown.
+    // A matrix that already exists but was not created by the pool is handed over to it, so that it can be released.
+    void RequestMatrixFromPool(shared_ptr<Matrix<ElemType>>& matrixPtr, MatrixPool& matrixPool, size_t size = 0)
     {
         if (matrixPtr == nullptr)
         {
-            matrixPtr = matrixPool.Request<ElemType>(m_deviceId);
+            matrixPtr = matrixPool.Request<ElemType>(m_deviceId, size);
+        }
+        else
+        {
+            matrixPool.Adopt<ElemType>(matrixPtr, size);
         }
     }
 
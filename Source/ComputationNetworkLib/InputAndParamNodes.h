@@ -335,6 +335,19 @@ public:
         Init(sampleLayout, m_isSparse, m_dynamicAxisNodeName, learningRateMultiplier);
     }
 
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<InputValueBase<ElemType>>(nodeP);
+            node->m_isSparse = m_isSparse;
+            node->m_dynamicAxisNodeName = m_dynamicAxisNodeName;
+            if (flags & CopyNodeFlags::copyNodeWithoutValue) // value not copied: give the new node one that matches the copied layout
+                node->Init(m_sampleLayout, m_isSparse, m_dynamicAxisNodeName, m_learningRateMultiplier);
+        }
+    }
+
     // InputValue must not resize its inputs because that might destroy it. It should already have the correct size.
     virtual void UpdateFunctionMBSize() override
     {
@@ -661,7 +661,7 @@ template class TransposeTimesNode<float>;
 template class TransposeTimesNode<double>;
 
 // Fixed-point matrix product. This scales inputs to 16bit signed integers by Symmetric quantizers, performs
-// integer multiplication using SSE/AVX2, and transforms the results back.
+// integer multiplication using SSE/AVX2 (BlockMultiplier), and transforms the results back.
 // Only dense untransposed matrix multiplication will be quantized. If at least one matrix is sparse then it will fall back to un-quantized default evaluation
 // Currently it works for CPU only. On GPU logicError will be thrown.
 // One way to include this node to the network is with the Edit command:
@@ -670,6 +670,7 @@ template class TransposeTimesNode<double>;
 // ...
 // bitShift(A|B) - bit shift parameters of quantizers for matrices A and B, see the quantizers for more details. Decreases the maximum range of quantziation by 2^bitShift to prevent integer overflow during BLAS routines.
 // bitShift=0 doesn't change the range; higher bitShift will decrease precision of quantization, but will make BLAS routines less prone to overflow.
+// bits - 16 (default) or 8. With 8 bits, each row of A and each column of B is scaled separately (see Int8QuantizedMultiplier) and the bit shifts are not used.
 // Other parameters - refer to the base multiplication class
 template <class ElemType>
 class QuantizedTimesNode : public TimesNodeBase<ElemType, false>
@@ -686,21 +687,38 @@ private:
     size_t m_bitShiftA; 
     size_t m_bitShiftB; 
 
+    // Number of bits of the quantized values, 16 or 8
+    size_t m_bits;
+
+    void CreateQuantizedMultiplier()
+    {
+        if (m_bits == 8)
+        {
+            this->m_pQuantizedMultiplier = make_shared<Int8QuantizedMultiplier<ElemType>>();
+        }
+        else if (m_bits == 16)
+        {
+            shared_ptr<SymmetricQuantizer<ElemType, short>> pQA(new SymmetricQuantizer<ElemType, short>(m_bitShiftA));
+            shared_ptr<SymmetricQuantizer<ElemType, short>> qQB(new SymmetricQuantizer<ElemType, short>(m_bitShiftB));
+            this->m_pQuantizedMultiplier = shared_ptr<QuantizedMultiplier<ElemType>>(new QuantizedMultiplier<ElemType>(pQA, qQB));
+        }
+        else
+            InvalidArgument("%ls: Quantized operation supports 16 or 8 bits, not %d.", NodeDescription().c_str(), (int)m_bits);
+    }
+
 public:
-    QuantizedTimesNode(DEVICEID_TYPE deviceId, const wstring& name, size_t bitShiftA = 1, size_t bitShiftB = 1, size_t outputRank = 1, int inferInputRankToMap = -1)
-        : Base(deviceId, name, outputRank, inferInputRankToMap), m_bitShiftA(bitShiftA), m_bitShiftB(bitShiftB)
+    QuantizedTimesNode(DEVICEID_TYPE deviceId, const wstring& name, size_t bitShiftA = 1, size_t bitShiftB = 1, size_t outputRank = 1, int inferInputRankToMap = -1, size_t bits = 16)
+        : Base(deviceId, name, outputRank, inferInputRankToMap), m_bitShiftA(bitShiftA), m_bitShiftB(bitShiftB), m_bits(bits)
     {
         // TODO support multiplication on GPUs as well.
         if (deviceId != CPUDEVICE)
             LogicError("Quantized operation is supposed to be used on CPU device only.");
 
-        shared_ptr<SymmetricQuantizer<ElemType, short>> pQA(new SymmetricQuantizer<ElemType, short>(m_bitShiftA));
-        shared_ptr<SymmetricQuantizer<ElemType, short>> qQB(new SymmetricQuantizer<ElemType, short>(m_bitShiftB));
-        this->m_pQuantizedMultiplier = shared_ptr<QuantizedMultiplier<ElemType>>(new QuantizedMultiplier<ElemType>(pQA, qQB));
+        CreateQuantizedMultiplier();
     }
 
     QuantizedTimesNode(const ScriptableObjects::IConfigRecordPtr configp)
-        : QuantizedTimesNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"bitShiftA"), configp->Get(L"bitShiftB"), configp->Get(L"outputRank"), configp->Get(L"inferInputRankToMap"))
+        : QuantizedTimesNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"bitShiftA"), configp->Get(L"bitShiftB"), configp->Get(L"outputRank"), configp->Get(L"inferInputRankToMap"), configp->Get(L"bits"))
     {
         AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
     }
@@ -713,6 +731,8 @@ public:
             auto node = dynamic_pointer_cast<QuantizedTimesNode<ElemType>>(nodeP);
             node->m_bitShiftA = m_bitShiftA;
             node->m_bitShiftB = m_bitShiftB;
+            node->m_bits = m_bits;
+            node->CreateQuantizedMultiplier();
         }
     }
 
@@ -721,6 +741,7 @@ public:
         Base::Save(fstream);
         fstream << m_bitShiftA;
         fstream << m_bitShiftB;
+        fstream << m_bits;
     }
 
     virtual void Load(File& fstream, size_t modelVersion) override
@@ -728,6 +749,11 @@ public:
         Base::Load(fstream, modelVersion);
         fstream >> m_bitShiftA;
         fstream >> m_bitShiftB;
+        if (modelVersion >= CNTK_MODEL_VERSION_17)
+            fstream >> m_bits;
+        else
+            m_bits = 16;
+        CreateQuantizedMultiplier();
     }
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
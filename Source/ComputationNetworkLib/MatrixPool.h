@@ -8,6 +8,8 @@
 #include <string>
 #include <stdexcept>
 #include <vector>
+#include <map>
+#include <memory>
 #include <algorithm>
 #include <stdlib.h>
 
@@ -19,17 +21,62 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 // MatrixPool -- class to support memory sharing
 // Despite the gather general name of this class, it is specifically designed to support the memory sharing of ComputationNodes.
+// ComputationNetwork::AllocateAllMatrices() simulates one forward and backward pass, requesting each matrix right before its
+// first use and releasing it after its last use. The pool then hands out released matrices by best fit:
+// each request passes the number of elements per sample it needs, and gets the smallest released matrix that was already
+// used for at least that size, or otherwise the largest one (which grows the least). This keeps small matrices from being
+// resized to large ones while large ones sit idle. The pool also tracks the simulated live size, for a memory-plan report.
 // Note: see #define SUPRESS_MEMSHARING below as for how to temporarily disable memory sharing altogether, for debugging
 class MatrixPool
 {
-    vector<shared_ptr<Matrix<float>>>  m_releasedFloatMatrices;
-    vector<shared_ptr<Matrix<double>>> m_releasedDoubleMatrices;
+    // released matrices, keyed by the largest size (elements per sample) each has been requested for so far
+    template <class ElemType>
+    using ReleasedMatrices = multimap<size_t, shared_ptr<Matrix<ElemType>>>;
+    ReleasedMatrices<float>  m_releasedFloatMatrices;
+    ReleasedMatrices<double> m_releasedDoubleMatrices;
 
     template <class ElemType>
-    vector<shared_ptr<Matrix<ElemType>>>& GetReleasedMatrices();
+    ReleasedMatrices<ElemType>& GetReleasedMatrices();
+
+    // bookkeeping for each matrix currently handed out by the pool
+    // The pool does not own these (only the released ones), so that a matrix is freed as soon as its node lets go of it.
+    struct MatrixUsage
+    {
+        size_t capacityBytes; // largest size it has been requested for
+        size_t liveBytes;     // size of the current request
+    };
+    map<weak_ptr<MatrixBase>, MatrixUsage, owner_less<weak_ptr<MatrixBase>>> m_liveMatrices;
+
+    // memory plan statistics, all in bytes per sample
+    size_t m_numMatrices = 0;    // distinct matrices handed out
+    size_t m_numRequests = 0;
+    size_t m_requestedBytes = 0; // sum over all requests, i.e. without any sharing
+    size_t m_allocatedBytes = 0; // sum of the capacities of all distinct matrices
+    size_t m_liveBytes = 0;
+    size_t m_peakLiveBytes = 0;
+
+    // hand out a matrix with the given capacity for a request of 'size' elements per sample
+    template <class ElemType>
+    void Track(const shared_ptr<Matrix<ElemType>>& matrixPtr, size_t capacity, size_t size)
+    {
+        const size_t bytes = size * sizeof(ElemType);
+        MatrixUsage usage{ capacity * sizeof(ElemType), bytes };
+        if (bytes > usage.capacityBytes)
+        {
+            m_allocatedBytes += bytes - usage.capacityBytes;
+            usage.capacityBytes = bytes;
+        }
+        m_liveMatrices[matrixPtr] = usage;
+        m_numRequests++;
+        m_requestedBytes += bytes;
+        m_liveBytes += bytes;
+        m_peakLiveBytes = max(m_peakLiveBytes, m_liveBytes);
+    }
 
 public:
     // release here means the matrix can be put back and shared by others
+    // Unlike the former debug-only check for double releases, releasing a matrix that is not currently handed out
+    // (use Adopt() for matrices created elsewhere) is a LogicError in all builds, since it would corrupt the bookkeeping.
     template <class ElemType>
     void Release(shared_ptr<Matrix<ElemType>> freeMatrix)
     {
@@ -38,39 +85,73 @@ public:
 //#define SUPRESS_MEMSHARING // #define this to disable memory sharing through this structure
         // TODO: Make this a runtime option.
 #ifndef SUPRESS_MEMSHARING
-        vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetReleasedMatrices<ElemType>();
-#ifdef _DEBUG
-        for (int i = 0; i < releasedMatrices.size(); i++)
-        {
-            if (releasedMatrices[i] == freeMatrix)
-                RuntimeError("MatrixPool::Release: freeMatrix is already in the released pool.");
-        }
-
-#endif
-        releasedMatrices.push_back(freeMatrix);
+        auto usage = m_liveMatrices.find(freeMatrix);
+        if (usage == m_liveMatrices.end())
+            LogicError("MatrixPool::Release: freeMatrix was not handed out by this pool, or has already been released.");
+        m_liveBytes -= usage->second.liveBytes;
+        GetReleasedMatrices<ElemType>().emplace(usage->second.capacityBytes / sizeof(ElemType), freeMatrix);
+        m_liveMatrices.erase(usage);
 #endif
     }
 
+    // 'size' is the number of elements per sample the matrix will hold, or 0 if unknown
     template <class ElemType>
-    shared_ptr<Matrix<ElemType>> Request(DEVICEID_TYPE deviceId)
+    shared_ptr<Matrix<ElemType>> Request(DEVICEID_TYPE deviceId, size_t size = 0)
     {
-        vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetReleasedMatrices<ElemType>();
+        ReleasedMatrices<ElemType>& releasedMatrices = GetReleasedMatrices<ElemType>();
         shared_ptr<Matrix<ElemType>> matrixPtr;
+        size_t capacity = 0;
         if (releasedMatrices.empty())
         {
             matrixPtr = make_shared<Matrix<ElemType>>(deviceId);
+            m_numMatrices++;
         }
         else
         {
-            matrixPtr = releasedMatrices.back();
-            releasedMatrices.pop_back();
+            // best fit: the smallest one that is large enough, else the largest one
+            auto best = releasedMatrices.lower_bound(size);
+            if (best == releasedMatrices.end())
+                best = prev(best);
+            capacity = best->first;
+            matrixPtr = best->second;
+            releasedMatrices.erase(best);
         }
 
         if (!matrixPtr) // this can't really happen
             LogicError("MatrixPool::Request: failed to get a valid matrix.");
 
+        Track(matrixPtr, capacity, size);
         return matrixPtr;
     }
+
+    // take over a matrix that was not created by the pool (e.g. a node creates its value in its constructor), so that
+    // it can be released to the pool like the requested ones; no-op for a matrix that is already handed out
+    template <class ElemType>
+    void Adopt(const shared_ptr<Matrix<ElemType>>& matrixPtr, size_t size = 0)
+    {
+        if (matrixPtr == nullptr)
+            LogicError("MatrixPool::Adopt: matrixPtr should not be null.");
+        if (m_liveMatrices.find(matrixPtr) != m_liveMatrices.end())
+            return;
+        ReleasedMatrices<ElemType>& releasedMatrices = GetReleasedMatrices<ElemType>();
+        if (find_if(releasedMatrices.begin(), releasedMatrices.end(), [&](const pair<const size_t, shared_ptr<Matrix<ElemType>>>& released) { return released.second == matrixPtr; }) != releasedMatrices.end())
+            LogicError("MatrixPool::Adopt: matrixPtr has already been released to this pool.");
+        m_numMatrices++;
+        Track(matrixPtr, 0, size);
+    }
+
+    size_t GetNumMatrices() const { return m_numMatrices; }
+    size_t GetRequestedBytes() const { return m_requestedBytes; }
+    size_t GetAllocatedBytes() const { return m_allocatedBytes; }
+    size_t GetPeakLiveBytes() const { return m_peakLiveBytes; }
+
+    // print the memory plan: how much the requests would take without sharing, what the pool allocates, and the
+    // largest amount simultaneously live (the lower bound any sharing scheme could reach)
+    void PrintMemoryPlan() const
+    {
+        fprintf(stderr, "\nMemory plan (per sample): %d matrix requests served by %d matrices. Without sharing: %.1f KB, allocated: %.1f KB, peak live: %.1f KB.\n",
+                (int) m_numRequests, (int) m_numMatrices, m_requestedBytes / 1024.0, m_allocatedBytes / 1024.0, m_peakLiveBytes / 1024.0);
+    }
 };
 
 }}}
@@ -0,0 +1,267 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "NodeProfiler.h"
+#include "LinearAlgebraNodes.h"
+#include "ConvolutionalNodes.h"
+#include "fileutil.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+NodeProfiler::NodeProfiler(const std::wstring& traceFilePath, size_t maxTraceEvents)
+    : m_traceFilePath(traceFilePath),
+      m_maxTraceEvents(maxTraceEvents),
+      m_traceStartTime(Now()),
+      m_numDroppedTraceEvents(0)
+{
+}
+
+// allocated size of the value and (if any) gradient buffers. Returns false if it was not able to dynamic-cast nodep to ComputationNode<ElemType>
+template <class ElemType>
+static bool GetBufferBytes(const ComputationNodeBasePtr& nodep, size_t& bytes)
+{
+    let node = dynamic_pointer_cast<ComputationNode<ElemType>>(nodep);
+    if (!node)
+        return false;
+    bytes = 0;
+    if (node->ValuePtr())
+        bytes += node->Value().BufferSize();
+    if (node->GradientPtr())
+        bytes += node->Gradient().BufferSize();
+    return true;
+}
+
+// This is a rough estimate: matrix products and convolutions are counted as multiply-adds,
+// and everything else as one operation per output element.
+/*static*/ double NodeProfiler::EstimateFLOPs(const ComputationNodeBasePtr& node, NodeProfilerPass pass)
+{
+    double outputSampleSize = (double)node->GetSampleLayout().GetNumElements();
+    double numOutputElements = outputSampleSize * (node->HasMBLayout() ? node->GetMBLayout()->GetNumCols() : 1);
+
+    const auto& operationName = node->OperationName();
+    bool isProduct = false;
+    double flops = numOutputElements;
+    if ((operationName == OperationNameOf(TimesNode) || operationName == OperationNameOf(TransposeTimesNode)) && node->GetNumInputs() == 2 && outputSampleSize > 0)
+    {
+        // [M x K] * [K x N]: K multiply-adds for each of the M x N output elements, where K^2 = (M*K * K*N) / (M*N)
+        // (N may be the sample size, the minibatch, or both)
+        double innerDim = sqrt((double)node->Input(0)->GetSampleLayout().GetNumElements() * node->Input(1)->GetSampleLayout().GetNumElements() / outputSampleSize);
+        flops = 2 * numOutputElements * innerDim;
+        isProduct = true;
+    }
+    else if (operationName == OperationNameOf(ConvolutionNode) && node->GetNumInputs() == 2)
+    {
+        // the kernel is [output channels x (kernel size * input channels)]: one multiply-add per kernel weight of the output channel
+        const auto& outputShape = node->GetSampleLayout();
+        double numOutputChannels = outputShape.GetRank() > 0 ? (double)outputShape[outputShape.GetRank() - 1] : 1;
+        flops = 2 * numOutputElements * node->Input(0)->GetSampleLayout().GetNumElements() / numOutputChannels;
+        isProduct = true;
+    }
+
+    // the backward pass of a product computes the gradients of both factors
+    if (pass == NodeProfilerPass::backward && isProduct)
+        flops *= 2;
+    return flops;
+}
+
+NodeProfiler::NodeStatistics& NodeProfiler::Account(const ComputationNodeBasePtr& node, NodeProfilerPass pass, double seconds, size_t numCalls)
+{
+    auto iter = m_nodeStatistics.find(node->NodeName());
+    if (iter == m_nodeStatistics.end())
+    {
+        NodeStatistics statistics = {};
+        statistics.m_operationName = node->OperationName();
+        iter = m_nodeStatistics.insert(make_pair(node->NodeName(), statistics)).first;
+    }
+
+    auto& statistics = iter->second;
+    let p = (size_t)pass;
+    statistics.m_numCalls[p] += numCalls;
+    statistics.m_seconds[p] += seconds;
+    if (numCalls > 0) // time spent outside of the node's regular calls (e.g. the PAR part of a loop's backprop) does not add FLOPs
+        statistics.m_flops[p] += EstimateFLOPs(node, pass);
+
+    size_t bytes = 0;
+    if (GetBufferBytes<float>(node, bytes) || GetBufferBytes<double>(node, bytes))
+        statistics.m_maxBytes = max(statistics.m_maxBytes, bytes);
+    return statistics;
+}
+
+void NodeProfiler::RecordNode(const ComputationNodeBasePtr& node, NodeProfilerPass pass, Clock::time_point begin, Clock::time_point end)
+{
+    Account(node, pass, std::chrono::duration<double>(end - begin).count(), 1);
+    RecordTraceEvent(node->NodeName(), node->OperationName(), pass, begin, end);
+}
+
+void NodeProfiler::AccumulateNode(const ComputationNodeBasePtr& node, NodeProfilerPass pass, double seconds, size_t numCalls)
+{
+    Account(node, pass, seconds, numCalls);
+}
+
+size_t NodeProfiler::GetTraceNameId(const std::wstring& name)
+{
+    auto iter = m_traceNameIds.find(name);
+    if (iter != m_traceNameIds.end())
+        return iter->second;
+    m_traceNames.push_back(name);
+    m_traceNameIds[name] = m_traceNames.size() - 1;
+    return m_traceNames.size() - 1;
+}
+
+void NodeProfiler::RecordTraceEvent(const std::wstring& name, const std::wstring& category, NodeProfilerPass pass, Clock::time_point begin, Clock::time_point end)
+{
+    if (m_traceFilePath.empty())
+        return;
+    if (m_traceEvents.size() >= m_maxTraceEvents)
+    {
+        m_numDroppedTraceEvents++;
+        return;
+    }
+
+    TraceEvent event;
+    event.m_nameId = GetTraceNameId(name);
+    event.m_categoryId = GetTraceNameId(category);
+    event.m_pass = pass;
+    event.m_beginInMicroseconds = std::chrono::duration<double, std::micro>(begin - m_traceStartTime).count();
+    event.m_durationInMicroseconds = std::chrono::duration<double, std::micro>(end - begin).count();
+    m_traceEvents.push_back(event);
+}
+
+void NodeProfiler::Report(const std::string& title, size_t maxNodesToPrint)
+{
+    struct Row
+    {
+        std::wstring m_name;
+        std::wstring m_operationName;
+        size_t m_numCalls;
+        double m_seconds[2];
+        double m_flops;
+        size_t m_bytes;
+        double TotalSeconds() const { return m_seconds[0] + m_seconds[1]; }
+    };
+
+    // aggregate by node and by operation type
+    std::vector<Row> nodeRows;
+    std::map<std::wstring, Row> operationRows;
+    double totalSeconds = 0;
+    for (const auto& iter : m_nodeStatistics)
+    {
+        const auto& statistics = iter.second;
+        // nodes that are not forward-propagated every minibatch (e.g. parameters) report their backward calls
+        size_t numCalls = statistics.m_numCalls[0] > 0 ? statistics.m_numCalls[0] : statistics.m_numCalls[1];
+        Row row = { iter.first, statistics.m_operationName, numCalls, { statistics.m_seconds[0], statistics.m_seconds[1] },
+                    statistics.m_flops[0] + statistics.m_flops[1], statistics.m_maxBytes };
+        nodeRows.push_back(row);
+        totalSeconds += row.TotalSeconds();
+
+        auto operationIter = operationRows.find(row.m_operationName);
+        if (operationIter == operationRows.end())
+        {
+            row.m_name = row.m_operationName;
+            operationRows[row.m_operationName] = row;
+        }
+        else
+        {
+            auto& operationRow = operationIter->second;
+            operationRow.m_numCalls += row.m_numCalls;
+            operationRow.m_seconds[0] += row.m_seconds[0];
+            operationRow.m_seconds[1] += row.m_seconds[1];
+            operationRow.m_flops += row.m_flops;
+            operationRow.m_bytes += row.m_bytes;
+        }
+    }
+
+    auto byTimeDescending = [](const Row& a, const Row& b) { return a.TotalSeconds() > b.TotalSeconds(); };
+    std::vector<Row> sortedOperationRows;
+    for (const auto& iter : operationRows)
+        sortedOperationRows.push_back(iter.second);
+    sort(sortedOperationRows.begin(), sortedOperationRows.end(), byTimeDescending);
+    sort(nodeRows.begin(), nodeRows.end(), byTimeDescending);
+
+    auto printRow = [totalSeconds](const Row& row, bool printOperation)
+    {
+        fprintf(stderr, "    %-40ls %-26ls %8d %12.3f %12.3f %6.2f%% %10.3f %9.2f %10.2f\n",
+                row.m_name.c_str(), printOperation ? row.m_operationName.c_str() : L"", (int)row.m_numCalls,
+                row.m_seconds[0] * 1000, row.m_seconds[1] * 1000, totalSeconds > 0 ? 100 * row.TotalSeconds() / totalSeconds : 0.0,
+                row.m_flops / 1e9, row.TotalSeconds() > 0 ? row.m_flops / row.TotalSeconds() / 1e9 : 0.0, row.m_bytes / 1e6);
+    };
+    auto printHeader = [](const char* what)
+    {
+        fprintf(stderr, "    %-40s %-26s %8s %12s %12s %7s %10s %9s %10s\n",
+                what, "", "Calls", "Forward ms", "Backward ms", "Share", "GFLOP", "GFLOP/s", "MB");
+    };
+
+    fprintf(stderr, "\nNode profile for %s: %.3f seconds in %d nodes\n", title.c_str(), totalSeconds, (int)nodeRows.size());
+    if (!nodeRows.empty())
+    {
+        printHeader("Operation");
+        for (const auto& row : sortedOperationRows)
+            printRow(row, false);
+        fprintf(stderr, "\n");
+        printHeader(nodeRows.size() > maxNodesToPrint ? "Node (top entries)" : "Node");
+        for (size_t i = 0; i < nodeRows.size() && i < maxNodesToPrint; i++)
+            printRow(nodeRows[i], true);
+    }
+    fprintf(stderr, "\n");
+
+    m_nodeStatistics.clear();
+
+    if (!m_traceFilePath.empty())
+    {
+        m_traceMarkers.push_back(make_pair(std::chrono::duration<double, std::micro>(Now() - m_traceStartTime).count(), title));
+        WriteTrace();
+        fprintf(stderr, "Node profile: wrote %d timeline events to %ls", (int)m_traceEvents.size(), m_traceFilePath.c_str());
+        if (m_numDroppedTraceEvents > 0)
+            fprintf(stderr, " (%d events were dropped after reaching the maximum)", (int)m_numDroppedTraceEvents);
+        fprintf(stderr, "\n");
+    }
+}
+
+static std::string JsonEscape(const std::string& s)
+{
+    std::string escaped;
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if ((unsigned char)c < 0x20)
+        {
+            char buf[8];
+            sprintf(buf, "\\u%04x", (unsigned int)(unsigned char)c);
+            escaped += buf;
+        }
+        else
+            escaped += c;
+    }
+    return escaped;
+}
+
+// writes the timeline in the Chrome trace event format (one row each for the forward and backward passes)
+void NodeProfiler::WriteTrace() const
+{
+    std::vector<std::string> names;
+    for (const auto& name : m_traceNames)
+        names.push_back(JsonEscape(msra::strfun::utf8(name)));
+
+    FILE* f = fopenOrDie(m_traceFilePath, L"w");
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"forward\"}},\n");
+    fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"backward\"}}");
+    for (const auto& marker : m_traceMarkers)
+        fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":0,\"tid\":0}", JsonEscape(marker.second).c_str(), marker.first);
+    for (const auto& event : m_traceEvents)
+        fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%d}",
+                names[event.m_nameId].c_str(), names[event.m_categoryId].c_str(), event.m_beginInMicroseconds, event.m_durationInMicroseconds, (int)event.m_pass);
+    fprintf(f, "\n]}\n");
+    fcloseOrDie(f);
+}
+
+}}}
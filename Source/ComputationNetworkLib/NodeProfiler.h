@@ -0,0 +1,105 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// ===========================================================================
+// NodeProfiler -- per-node accounting of wall time, memory and FLOPs of the forward and backward passes
+//
+// A network is profiled by setting ComputationEnvironment::nodeProfiler; the traversal flow-control nodes then
+// report every node they run. Per epoch, Report() prints a table aggregated by node and by operation type and
+// (optionally) writes the recorded timeline as a Chrome trace (load it in chrome://tracing).
+// When no profiler is set, the only overhead is a null-pointer test per node.
+//
+// Note: GPU kernels run asynchronously, so without CUDA_LAUNCH_BLOCKING=1 GPU times measure launch overhead only.
+// ===========================================================================
+
+enum class NodeProfilerPass
+{
+    forward = 0,
+    backward = 1
+};
+
+class NodeProfiler
+{
+public:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    struct NodeStatistics // [pass] indexed by NodeProfilerPass
+    {
+        std::wstring m_operationName;
+        size_t m_numCalls[2];
+        double m_seconds[2];
+        double m_flops[2];
+        size_t m_maxBytes; // largest value + gradient buffer size seen
+    };
+
+    // traceFilePath: where to write the Chrome trace, or empty to not record a timeline
+    // maxTraceEvents: timeline events beyond this number are dropped, to bound memory use
+    NodeProfiler(const std::wstring& traceFilePath = L"", size_t maxTraceEvents = 1000000);
+
+    static Clock::time_point Now() { return Clock::now(); }
+
+    // Accounts one execution of 'node' over the whole minibatch and adds it to the timeline.
+    void RecordNode(const ComputationNodeBasePtr& node, NodeProfilerPass pass, Clock::time_point begin, Clock::time_point end);
+
+    // Accounts 'numCalls' executions of 'node' that took 'seconds' in total, e.g. the time steps of a recurrent loop.
+    // The FLOPs are estimated for the whole minibatch, and only if numCalls > 0. Nothing is added to the timeline.
+    void AccumulateNode(const ComputationNodeBasePtr& node, NodeProfilerPass pass, double seconds, size_t numCalls);
+
+    // Adds an event to the timeline only, e.g. for a recurrent loop whose nodes are accounted with AccumulateNode().
+    void RecordTraceEvent(const std::wstring& name, const std::wstring& category, NodeProfilerPass pass, Clock::time_point begin, Clock::time_point end);
+
+    // Prints the aggregated tables to stderr and resets the aggregates; writes the timeline recorded so far to the trace file.
+    void Report(const std::string& title, size_t maxNodesToPrint = 20);
+
+    // what was accounted for the node of that name since the last Report(), or nullptr if nothing was
+    const NodeStatistics* GetNodeStatistics(const std::wstring& nodeName) const
+    {
+        auto iter = m_nodeStatistics.find(nodeName);
+        return iter != m_nodeStatistics.end() ? &iter->second : nullptr;
+    }
+
+    // estimated number of floating-point operations for a forward or backward pass of 'node' over the current minibatch
+    static double EstimateFLOPs(const ComputationNodeBasePtr& node, NodeProfilerPass pass);
+
+private:
+    struct TraceEvent
+    {
+        size_t m_nameId;     // index into m_traceNames
+        size_t m_categoryId; // index into m_traceNames
+        NodeProfilerPass m_pass;
+        double m_beginInMicroseconds;
+        double m_durationInMicroseconds;
+    };
+
+    NodeStatistics& Account(const ComputationNodeBasePtr& node, NodeProfilerPass pass, double seconds, size_t numCalls);
+    size_t GetTraceNameId(const std::wstring& name);
+    void WriteTrace() const;
+
+    std::map<std::wstring, NodeStatistics> m_nodeStatistics; // [node name]
+
+    std::wstring m_traceFilePath;
+    size_t m_maxTraceEvents;
+    Clock::time_point m_traceStartTime;
+    std::vector<TraceEvent> m_traceEvents;
+    std::vector<std::wstring> m_traceNames;
+    std::map<std::wstring, size_t> m_traceNameIds;
+    std::vector<std::pair<double, std::string>> m_traceMarkers; // [(timestamp, title)] of the reports
+    size_t m_numDroppedTraceEvents;
+};
+typedef std::shared_ptr<NodeProfiler> NodeProfilerPtr;
+
+}}}
@@ -433,6 +433,25 @@ void CNTKEvalExtended<ElemType>::ForwardPass(const ValueRefs<ElemType>& inputs,
     ForwardPassT(inputs, outputs, resetRNN);
 }
 
+template <typename ElemType>
+CNTKEvalExtended<ElemType>* CNTKEvalExtended<ElemType>::CreateSharedEvaluator() const
+{
+    if (this->m_net == nullptr)
+        RuntimeError("CreateSharedEvaluator() called before CreateNetwork()");
+
+    auto eval = new CNTKEvalExtended<ElemType>();
+    eval->m_config = this->m_config;
+    eval->m_net = this->m_net->CloneWithSharedParameters();
+    if (m_started)
+    {
+        std::vector<wstring> outputNodeNames;
+        for (const auto& node : m_outputNodes)
+            outputNodeNames.push_back(node->NodeName());
+        eval->StartForwardEvaluation(outputNodeNames);
+    }
+    return eval;
+}
+
 template <typename ElemType>
 void CNTKEvalExtended<ElemType>::Destroy()
 {
@@ -457,6 +476,24 @@ extern "C" EVAL_API void GetEvalExtendedD(IEvaluateModelExtended<double>** peval
     GetEvalExtended(peval);
 }
 
+template <typename ElemType>
+void EVAL_API GetSharedEvalExtended(IEvaluateModelExtended<ElemType>* eval, IEvaluateModelExtended<ElemType>** peval)
+{
+    auto cntkEval = dynamic_cast<CNTKEvalExtended<ElemType>*>(eval);
+    if (cntkEval == nullptr)
+        InvalidArgument("GetSharedEvalExtended: the evaluator was not created by GetEvalExtended().");
+    *peval = cntkEval->CreateSharedEvaluator();
+}
+
+extern "C" EVAL_API void GetSharedEvalExtendedF(IEvaluateModelExtended<float>* eval, IEvaluateModelExtended<float>** peval)
+{
+    GetSharedEvalExtended(eval, peval);
+}
+extern "C" EVAL_API void GetSharedEvalExtendedD(IEvaluateModelExtended<double>* eval, IEvaluateModelExtended<double>** peval)
+{
+    GetSharedEvalExtended(eval, peval);
+}
+
 template class CNTKEvalExtended<double>;
 template class CNTKEvalExtended<float>;
 } } }
@@ -107,6 +107,9 @@ public:
 
     virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output, bool resetRNN) override;
 
+    // see GetSharedEvalExtended()
+    CNTKEvalExtended<ElemType>* CreateSharedEvaluator() const;
+
     virtual void Destroy() override;
 
     virtual void CreateNetwork(const std::string& networkDescription) override
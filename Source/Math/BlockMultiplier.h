@@ -548,28 +548,25 @@ template<typename BlockHandlerT> class BlockMultiplier
 
         int m_numThreads;
 
-        BlockMultiplier(int numThreads = 1) 
+        BlockMultiplier(int numThreads = 1)
+            : m_pBlockHandlerBInfo(nullptr)
         {
             SetNumThreads(numThreads);
         }
 
+        // With OpenMP, the number of threads only applies to the parallel loops of MultiplyMatrices,
+        // the process-wide OpenMP setting is left alone.
         void SetNumThreads(int threads)
         {
             m_numThreads = threads;
 #ifdef STDTHREAD
             m_pPool.reset(new StdThreadPool<HandlerArgs<BlockHandlerT>>(threads));
-#else
-#ifdef OPENMPTHREAD
-            m_oldNumThreads = omp_get_num_threads();
-            omp_set_num_threads(threads);
-#endif
 #endif
         }
 
         ~BlockMultiplier()
         {
             BlockHandlerT::FreePreparedB(m_pBlockHandlerBInfo);
-            omp_set_num_threads(m_oldNumThreads);
         }
         static ScalarAT* CreateMatrixA(int m, int n, ScalarAT initVal = 0);
         static ScalarBT* CreateMatrixB(int m, int n, ScalarBT initVal = 0);
@@ -580,7 +577,6 @@ template<typename BlockHandlerT> class BlockMultiplier
         // For now we assume m, k and n are all multiples of kernelsize.
         void MultiplyMatrices(ScalarAT* A, int m, int k, ScalarBT* B, int n, int32_t* C, ScalarAT alpha = 1, ScalarBT beta = 0);
         static const int MAXRANGE = 1 << 13;
-        int m_oldNumThreads;
 };
 
 // Instantiate block multipliers
@@ -649,6 +645,7 @@ template<typename BlockHandlerT> typename BlockMultiplier<BlockHandlerT>::Scalar
         next = RewriteBInBlockOrder(oldB, next, k, n, blockSize, &offset);
     }
     assert(next - newB == k * n);
+    BlockHandlerT::FreePreparedB(m_pBlockHandlerBInfo);
     m_pBlockHandlerBInfo = BlockHandlerT::PrepareExtraB(newB, k, n);
 
     return newB;
@@ -935,16 +932,18 @@ template<typename BlockHandlerT> void BlockMultiplier<BlockHandlerT>::MultiplyMa
                 {
 
 #ifdef OPENMPTHREAD
-#pragma omp parallel for
+#pragma omp parallel for num_threads(m_numThreads)
 #endif
                     for (int startRow = 0; startRow < m; startRow += 4)
                     {
-                        ha.startRow = startRow;
+                        // Each iteration gets its own copy of the arguments, they differ in the start row.
+                        HandlerArgs<BlockHandlerT> rowArgs = ha;
+                        rowArgs.startRow = startRow;
 #ifdef STDTHREAD
-                        m_pPool->QueueAndWake(ha, currBlockInfo.fourFn);
+                        m_pPool->QueueAndWake(rowArgs, currBlockInfo.fourFn);
 #else
 #ifdef OPENMPTHREAD
-                        currBlockInfo.fourFn(ha);
+                        currBlockInfo.fourFn(rowArgs);
 #endif
 #endif
                     }
@@ -957,16 +956,17 @@ template<typename BlockHandlerT> void BlockMultiplier<BlockHandlerT>::MultiplyMa
                 else if (rowsPerBlock == 1)
                 {
 #ifdef OPENMPTHREAD
-#pragma omp parallel for
+#pragma omp parallel for num_threads(m_numThreads)
 #endif
                     for (int startRow = 0; startRow < m; ++startRow)
                     {
-                        ha.startRow = startRow;
+                        HandlerArgs<BlockHandlerT> rowArgs = ha;
+                        rowArgs.startRow = startRow;
 #ifdef STDTHREAD
-                        m_pPool->QueueAndWake(ha, currBlockInfo.oneFn);
+                        m_pPool->QueueAndWake(rowArgs, currBlockInfo.oneFn);
 #else
 #ifdef OPENMPTHREAD
-                        currBlockInfo.oneFn(ha);
+                        currBlockInfo.oneFn(rowArgs);
 #endif
 #endif
                     }
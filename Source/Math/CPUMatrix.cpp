@@ -11,6 +11,8 @@
 
 #include "CPUMatrix.h"
 #include "TensorOps.h"
+#include "TensorOpsSIMD.h"
+#include "CPURNN.h"
 #include <assert.h>
 #include <stdexcept>
 #include <omp.h>
@@ -21,6 +23,7 @@
 #include <thread>
 #include <iostream>
 #include <algorithm>
+#include <atomic>
 #ifdef _WIN32
 #define NOMINMAX
 #include "Windows.h"
@@ -4611,6 +4614,31 @@ void CPUMatrix<ElemType>::BatchNormalizationBackward(const CPUMatrix<ElemType>&
     RuntimeError("Batch normalization training on CPU is not yet implemented.");
 }
 
+template <class ElemType>
+void CPUMatrix<ElemType>::RNNForward(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& paramW, size_t xDim, size_t yDim, const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    // numLayers, hiddenSize are input parameters
+    if (!m_rnnExecutor)
+        m_rnnExecutor = std::make_shared<CPURNNExecutor<ElemType>>(xDim, yDim, rnnAttributes);
+    m_rnnExecutor->ForwardCore(paramW, inputX, *this, numSequencesForFrame, rnnAttributes, reserve, workspace);
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::RNNBackwardData(const CPUMatrix<ElemType>& outputDY, const CPUMatrix<ElemType>& paramW, CPUMatrix<ElemType>& outputDX, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    if (!m_rnnExecutor)
+        LogicError("RNNBackwardData called, but RNNWrapper object is not yet initialized");
+    m_rnnExecutor->BackwardDataCore(*this, outputDY, paramW, outputDX, rnnAttributes, reserve, workspace);
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::RNNBackwardWeights(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& outputY, CPUMatrix<ElemType>& dw, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    if (!m_rnnExecutor)
+        LogicError("RNNBackwardWeights called, but RNNWrapper object is not yet initialized");
+    m_rnnExecutor->BackwardWeightsCore(inputX, outputY, dw, rnnAttributes, reserve, workspace);
+}
+
 
 #pragma region Static BLAS Functions
 
@@ -6077,6 +6105,33 @@ int CPUMatrix<ElemType>::SetNumThreads(int numThreads)
     return numThreads;
 }
 
+// Minimum work per thread for the CPU tensor ops to go parallel, in units of one cheap element op (see TensorOpCost()).
+// The default is chosen so that a thread's share takes a few times longer than an OpenMP fork/join.
+static const size_t DefaultTensorOpMinWorkPerThread = 16384;
+static std::atomic<size_t> s_tensorOpMinWorkPerThread(DefaultTensorOpMinWorkPerThread);
+
+// if set, tensor reductions are split the same way regardless of the number of threads, so that results are reproducible
+static std::atomic<bool> s_deterministicTensorReductions(false);
+
+// note: this function does not depend on the <ElemType> parameter
+template <class ElemType>
+void CPUMatrix<ElemType>::SetTensorOpMinWorkPerThread(size_t minWorkPerThread)
+{
+    s_tensorOpMinWorkPerThread = minWorkPerThread != 0 ? minWorkPerThread : DefaultTensorOpMinWorkPerThread;
+}
+
+template <class ElemType>
+size_t CPUMatrix<ElemType>::GetTensorOpMinWorkPerThread()
+{
+    return s_tensorOpMinWorkPerThread;
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::SetDeterministicTensorReductions(bool deterministic)
+{
+    s_deterministicTensorReductions = deterministic;
+}
+
 // To ensure Intel MKL calls return the same results on all Intel or Intel compatible CPUs,
 // the function set CBWR compatible mode.
 template <class ElemType>
@@ -6098,6 +6153,67 @@ void CPUMatrix<ElemType>::SetCompatibleMode()
 // function to compute the value for a given output location (perform reduction if needed)
 // -----------------------------------------------------------------------
 
+// run body(k) for k = 0..K-1, spread over 'numThreads' threads if more than one
+template <typename FN>
+static inline void TensorOpParallelFor(size_t K, int numThreads, const FN& body)
+{
+    if (numThreads > 1)
+    {
+#pragma omp parallel for num_threads(numThreads)
+        for (int k = 0; k < (int) K; k++)
+            body(k);
+    }
+    else
+    {
+        for (size_t k = 0; k < K; k++)
+            body(k);
+    }
+}
+
+// Reductions are computed pairwise: a range is split in halves until it is at most this many elements long,
+// which keeps the rounding error at O(log n) instead of O(n) for long sums.
+// Note that this is also done on a single thread, so sums no longer come out bit-identical to the former strictly
+// left-to-right fold: the double aggregate differs in its last bits, which rarely changes the rounded ElemType result.
+static const size_t TensorOpPairwiseReductionBlockSize = 128;
+
+// Number of partial results a single-output reduction is split into in deterministic mode, independently of the
+// number of threads, so that the summation order (and thus the result) only depends on the shape.
+static const size_t TensorOpDeterministicReductionBlocks = 64;
+
+// upper bound for the number of partial results of a split reduction, which are kept on the stack
+static const size_t TensorOpMaxReductionBlocks = 256;
+
+// The per-element lambda of a tensor op, together with a vectorized kernel (TensorOpsSIMD.h) for the same op along
+// the innermost reducing dimension, or nullptr if there is none.
+template <typename OPFN>
+struct TensorOpFn
+{
+    OPFN fn;
+    SIMDElementwiseKernel reductionKernel;
+
+    template <class ElemType, size_t N>
+    inline ElemType operator()(const array<ElemType*, N>& pointers) const
+    {
+        return fn(pointers);
+    }
+};
+
+// compute the elementwise op for n consecutive elements of the innermost reducing dimension into 'values'
+template <class ElemType, size_t N>
+static inline void TensorOpWithReductionKernel(SIMDElementwiseKernel, size_t, const array<ElemType*, N>&, ElemType*)
+{
+    LogicError("TensorOpWithReductionKernel: Vectorized kernels exist for float only.");
+}
+
+template <size_t N>
+static inline void TensorOpWithReductionKernel(SIMDElementwiseKernel kernel, size_t n, const array<float*, N>& pointers, float* values)
+{
+    array<const float*, N - 1> inputs;
+    for (size_t i = 0; i < N - 1; i++)
+        inputs[i] = pointers[i];
+    kernel(n, 0, inputs.data(), 1, values);
+}
+
 // perform loop over reduction index m
 // This function is declared inside a wrapper struct to allow partial specialization (m = -1).
 template <class ElemType, typename OPFN, typename ReductionOp, size_t N, int m>
@@ -6106,23 +6222,98 @@ struct TensorOpReduction
     // reduction case (non-reduction case is specialized)
     static inline ElemType Loop(array<ElemType*, N> pointers, const OPFN& opfn, const ReductionOp& reductionOp,
                                 const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+    {
+        // Actually it would be nicer to return double but we keep ElementType so that test don't return different numbers than previous implementation.
+        return static_cast<ElemType>(Range(pointers, reducingOpDims[(size_t) m], opfn, reductionOp, reducingOpDims, reducingStrides));
+    }
+
+    // reduce the first n indices of dimension m
+    static inline double Range(array<ElemType*, N> pointers, size_t n, const OPFN& opfn, const ReductionOp& reductionOp,
+                               const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
     {
         array<ptrdiff_t, N - 1> strides;   // N-1 because last one is the result pointer, which is unused in reduction
         for (size_t i = 0; i < N - 1; i++) // N = a small constant, this will be unrolled
             strides[i] = reducingStrides[i][(size_t) m];
 
-        double aggregate = TensorOpReduction<ElemType, OPFN, ReductionOp, N, m - 1>::Loop(pointers, opfn, reductionOp, reducingOpDims, reducingStrides);
-        for (size_t dim = reducingOpDims[(size_t)m] - 1; dim-- > 0;)
+        if (n > TensorOpPairwiseReductionBlockSize)
         {
-            // advance the pointers
+            // split in halves
+            const size_t half = n / 2;
+            const double first = Range(pointers, half, opfn, reductionOp, reducingOpDims, reducingStrides);
             for (size_t i = 0; i < N - 1; i++)
-                pointers[i] += strides[i]; // note: last pointer (result) is unused and untouched here
+                pointers[i] += (ptrdiff_t) half * strides[i]; // note: last pointer (result) is unused and untouched here
+            return reductionOp(first, Range(pointers, n - half, opfn, reductionOp, reducingOpDims, reducingStrides));
+        }
 
-            // need to descend into one loop deeper
-            aggregate = reductionOp(aggregate, TensorOpReduction<ElemType, OPFN, ReductionOp, N, m - 1>::Loop(pointers, opfn, reductionOp, reducingOpDims, reducingStrides));
+        // innermost reducing dimension contiguous or broadcasting in all inputs: compute the elementwise op for the whole
+        // block with the vectorized kernel, then reduce the values in the same order as below
+        if (m == 0 && opfn.reductionKernel)
+        {
+            ElemType values[TensorOpPairwiseReductionBlockSize];
+            TensorOpWithReductionKernel(opfn.reductionKernel, n, pointers, values);
+            return Accumulate(n, reductionOp, [&](size_t j)
+            {
+                return (double) values[j];
+            });
         }
-        // Actually it would be nicer to return double but we keep ElementType so that test don't return different numbers than previous implementation.
-        return static_cast<double>(aggregate);
+
+        // need to descend into one loop deeper
+        return Accumulate(n, reductionOp, [&](size_t j)
+        {
+            array<ElemType*, N> p = pointers;
+            for (size_t i = 0; i < N - 1; i++)
+                p[i] += (ptrdiff_t) j * strides[i];
+            return (double) TensorOpReduction<ElemType, OPFN, ReductionOp, N, m - 1>::Loop(p, opfn, reductionOp, reducingOpDims, reducingStrides);
+        });
+    }
+
+    // reduce sub(0..n-1)
+    template <typename SUBFN>
+    static inline double Accumulate(size_t n, const ReductionOp& reductionOp, const SUBFN& sub)
+    {
+        if (n < 4)
+        {
+            double aggregate = sub(0);
+            for (size_t j = 1; j < n; j++)
+                aggregate = reductionOp(aggregate, sub(j));
+            return aggregate;
+        }
+        // interleave four independent accumulators, so that the loop is not serialized on a single dependency chain
+        double aggregate0 = sub(0), aggregate1 = sub(1), aggregate2 = sub(2), aggregate3 = sub(3);
+        size_t j = 4;
+        for (; j + 4 <= n; j += 4)
+        {
+            aggregate0 = reductionOp(aggregate0, sub(j));
+            aggregate1 = reductionOp(aggregate1, sub(j + 1));
+            aggregate2 = reductionOp(aggregate2, sub(j + 2));
+            aggregate3 = reductionOp(aggregate3, sub(j + 3));
+        }
+        for (; j < n; j++)
+            aggregate0 = reductionOp(aggregate0, sub(j));
+        return reductionOp(reductionOp(aggregate0, aggregate1), reductionOp(aggregate2, aggregate3));
+    }
+
+    // reduce for one output element on multiple threads, by splitting the outermost reducing dimension m into blocks
+    // The partial results are combined pairwise in a fixed order.
+    static ElemType BlockedLoop(const array<ElemType*, N>& pointers, const OPFN& opfn, const ReductionOp& reductionOp,
+                                const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides, int numThreads)
+    {
+        const size_t dim = reducingOpDims[(size_t) m];
+        const size_t numBlocks = min(dim, min(TensorOpMaxReductionBlocks, s_deterministicTensorReductions ? TensorOpDeterministicReductionBlocks : (size_t) numThreads));
+        double partials[TensorOpMaxReductionBlocks]; // this is called for every output element, so don't allocate
+        TensorOpParallelFor(numBlocks, numThreads, [&](size_t block)
+        {
+            const size_t begin = dim * block / numBlocks;
+            const size_t end = dim * (block + 1) / numBlocks;
+            array<ElemType*, N> blockPointers = pointers;
+            for (size_t i = 0; i < N - 1; i++)
+                blockPointers[i] += (ptrdiff_t) begin * reducingStrides[i][(size_t) m];
+            partials[block] = Range(blockPointers, end - begin, opfn, reductionOp, reducingOpDims, reducingStrides);
+        });
+        for (size_t stride = 1; stride < numBlocks; stride *= 2)
+            for (size_t block = 0; block + stride < numBlocks; block += 2 * stride)
+                partials[block] = reductionOp(partials[block], partials[block + stride]);
+        return static_cast<ElemType>(partials[0]);
     }
 };
 
@@ -6136,6 +6327,12 @@ struct TensorOpReduction<ElemType, OPFN, ReductionOp, N, -1>
     {
         return opfn(pointers); // finally we are doing some work!!!
     }
+
+    static ElemType BlockedLoop(const array<ElemType*, N>& pointers, const OPFN& opfn, const ReductionOp& reductionOp,
+                                const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides, int /*numThreads*/)
+    {
+        return Loop(pointers, opfn, reductionOp, reducingOpDims, reducingStrides);
+    }
 };
 
 // -----------------------------------------------------------------------
@@ -6143,12 +6340,13 @@ struct TensorOpReduction<ElemType, OPFN, ReductionOp, N, -1>
 // -----------------------------------------------------------------------
 
 // perform loop over regular index k and reducing index m for N operands (counting the output)
+// 'numThreads' is passed down to the innermost vectorizable loop, which parallelizes over it if > 1 (see TensorOpWithRegularLoop()).
 template <class ElemType, typename OPFN, typename ReductionOp, size_t N, bool vectorizable, int m, int k>
 struct TensorOpIteration
 {
     static inline void Loop(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn, const ReductionOp& reductionOp,
                             const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
-                            const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+                            const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides, int numThreads)
     {
         // non-scalar case: still nested result loops left
         array<ptrdiff_t, N> strides;
@@ -6157,7 +6355,7 @@ struct TensorOpIteration
         for (size_t dim = regularOpDims[(size_t) k]; dim-- > 0;)
         {
             // need to descend into one loop deeper
-            TensorOpIteration<ElemType, OPFN, ReductionOp, N, vectorizable, m, k - 1>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            TensorOpIteration<ElemType, OPFN, ReductionOp, N, vectorizable, m, k - 1>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides, numThreads);
             // advance the pointers
             for (size_t i = 0; i < N; i++)
                 pointers[i] += strides[i];
@@ -6172,7 +6370,7 @@ struct TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/,
 {
     static inline void Loop(ElemType beta, array<ElemType*, 3> pointers, ElemType alpha, const OPFN& opfn, const ReductionOp& reductionOp,
                             const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 3>& regularStrides,
-                            const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 3>& reducingStrides)
+                            const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 3>& reducingStrides, int numThreads)
     {
         ElemType* pa = pointers[0];
         ElemType* pb = pointers[1];
@@ -6180,20 +6378,22 @@ struct TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/,
         size_t K = regularOpDims[0];
         // special-case beta and alpha to allow the compiler to short-circuit it
         if (beta != 0)
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            TensorOpParallelFor(K, numThreads, [&](size_t k)
+            {
+                TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides, 1);
+            });
         else if (alpha != 1)
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            TensorOpParallelFor(K, numThreads, [&](size_t k)
+            {
+                TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides, 1);
+            });
         else
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, 1, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            TensorOpParallelFor(K, numThreads, [&](size_t k)
+            {
+                TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, 1, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides, 1);
+            });
         // TODO: According to Amit, the VS compiler is not able to vectorize into lambdas. Solution: change the lambda to take an N, or to implement the loop inside (with 1 element by default).
         // TODO: The signedness of k (required for omp) causes an extra sign-extend.
-        // TODO: OMP adds LOTS of overhead. Do we need a guard, a min size when to use it?
     }
 };
 // and unary
@@ -6202,24 +6402,27 @@ struct TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/,
 {
     static inline void Loop(ElemType beta, array<ElemType*, 2> pointers, ElemType alpha, const OPFN& opfn, const ReductionOp& reductionOp,
                             const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
-                            const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides)
+                            const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides, int numThreads)
     {
         ElemType* pa = pointers[0];
         ElemType* pb = pointers[1];
         size_t K = regularOpDims[0];
         // special-case beta and alpha to allow the compiler to short-circuit it
         if (beta != 0)
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            TensorOpParallelFor(K, numThreads, [&](size_t k)
+            {
+                TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides, 1);
+            });
         else if (alpha != 1)
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            TensorOpParallelFor(K, numThreads, [&](size_t k)
+            {
+                TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides, 1);
+            });
         else
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, 1, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            TensorOpParallelFor(K, numThreads, [&](size_t k)
+            {
+                TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, 1, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides, 1);
+            });
     }
 };
 
@@ -6228,10 +6431,14 @@ struct TensorOpIteration<ElemType, OPFN, ReductionOp, N, vectorizable, m, -1>
 {
     static inline void Loop(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn, const ReductionOp& reductionOp,
                             const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, N>&,
-                            const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+                            const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides, int numThreads)
     {
         // we are at element level for the result: perform the op (there may still be reduction)
-        ElemType val = TensorOpReduction<ElemType, OPFN, ReductionOp, N, m>::Loop(pointers, opfn, reductionOp, reducingOpDims, reducingStrides);
+        // Long reductions are split into blocks if we may use multiple threads, and always in deterministic mode, so that
+        // the result does not depend on the number of threads.
+        ElemType val = numThreads > 1 || (m >= 0 && s_deterministicTensorReductions)
+                           ? TensorOpReduction<ElemType, OPFN, ReductionOp, N, m>::BlockedLoop(pointers, opfn, reductionOp, reducingOpDims, reducingStrides, numThreads)
+                           : TensorOpReduction<ElemType, OPFN, ReductionOp, N, m>::Loop(pointers, opfn, reductionOp, reducingOpDims, reducingStrides);
         // scale
         val *= alpha;
         // combine with previous value in target matrix, then write it out
@@ -6244,23 +6451,167 @@ struct TensorOpIteration<ElemType, OPFN, ReductionOp, N, vectorizable, m, -1>
     }
 };
 
+// perform the loop over the outermost regular index k as a single parallel region
+// Each thread gets a contiguous block of that dimension and runs all inner loops serially.
+template <class ElemType, typename OPFN, typename ReductionOp, size_t N, bool vectorizable, int m, int k>
+struct TensorOpOutermostParallelIteration
+{
+    static void Loop(ElemType beta, const array<ElemType*, N>& pointers, ElemType alpha, const OPFN& opfn, const ReductionOp& reductionOp,
+                     const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                     const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides, int numThreads)
+    {
+        array<ptrdiff_t, N> strides;
+        for (size_t i = 0; i < N; i++) // N = a small constant, this will be unrolled
+            strides[i] = regularStrides[i][(size_t) k];
+        const int K = (int) regularOpDims[(size_t) k];
+#pragma omp parallel for num_threads(numThreads) schedule(static)
+        for (int dim = 0; dim < K; dim++)
+        {
+            array<ElemType*, N> blockPointers;
+            for (size_t i = 0; i < N; i++)
+                blockPointers[i] = pointers[i] + (ptrdiff_t) dim * strides[i];
+            TensorOpIteration<ElemType, OPFN, ReductionOp, N, vectorizable, m, k - 1>::Loop(beta, blockPointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides, 1 /*serial*/);
+        }
+    }
+};
+
+// scalar result: there is no outer loop to parallelize
+template <class ElemType, typename OPFN, typename ReductionOp, size_t N, bool vectorizable, int m>
+struct TensorOpOutermostParallelIteration<ElemType, OPFN, ReductionOp, N, vectorizable, m, -1>
+{
+    static void Loop(ElemType beta, const array<ElemType*, N>& pointers, ElemType alpha, const OPFN& opfn, const ReductionOp& reductionOp,
+                     const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                     const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides, int /*numThreads*/)
+    {
+        TensorOpIteration<ElemType, OPFN, ReductionOp, N, vectorizable, m, -1>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides, 1);
+    }
+};
+
+// -----------------------------------------------------------------------
+// cost model for spreading a tensor op over threads
+// -----------------------------------------------------------------------
+
+// rough cost of computing one element with 'op', relative to a simple arithmetic op
+static size_t TensorOpCost(ElementWiseOperator op)
+{
+    switch (op)
+    {
+    case ElementWiseOperator::opSigmoid:
+    case ElementWiseOperator::opTanh:
+    case ElementWiseOperator::opExp:
+    case ElementWiseOperator::opLog:
+    case ElementWiseOperator::opCosine:
+    case ElementWiseOperator::opSin:
+    case ElementWiseOperator::opLogSum:
+    case ElementWiseOperator::opElementwiseProductWithCosDerivative:
+    case ElementWiseOperator::opElementwiseProductWithSinDerivative:
+    case ElementWiseOperator::opElementwiseProductWithLogSumDerivative:
+    case ElementWiseOperator::opElementwiseProductWithExpOfDiff:
+        return 8; // transcendental functions
+    case ElementWiseOperator::opReciprocal:
+    case ElementWiseOperator::opSqrt:
+    case ElementWiseOperator::opElementwiseQuotient:
+    case ElementWiseOperator::opElementwiseProductWithReciprocalDerivative:
+    case ElementWiseOperator::opElementwiseProductWithSqrtDerivative:
+        return 2; // divisions
+    default:
+        return 1;
+    }
+}
+
+// number of threads worth using for an op with the given amount of work (element count times TensorOpCost()); 1 means serial
+static int TensorOpNumThreads(double work)
+{
+#ifdef _OPENMP
+    if (!omp_in_parallel()) // if we are already inside a parallel region, nesting would only add overhead
+    {
+        const double numThreads = floor(work / (double) s_tensorOpMinWorkPerThread);
+        return (int) max(1.0, min(numThreads, (double) omp_get_max_threads()));
+    }
+#endif
+    return 1;
+}
+
+// how a tensor op is spread over threads
+enum class TensorOpParallelism
+{
+    Serial,    // too little work to amortize an OpenMP fork/join
+    Outermost, // one parallel region over the outermost regular dimension, in contiguous blocks
+    Innermost, // one parallel loop over the innermost dimension per row; only for the vectorizable case
+    Reduction, // few outputs with long reductions: each output's reduction is split over the threads
+};
+
+// Pick the parallelization for a tensor op. May lower 'numThreads' to the number of blocks available.
+// Splitting the outermost dimension costs a single fork/join and keeps each thread on contiguous memory, so it is
+// preferred if it has enough iterations. Otherwise, splitting long contiguous innermost rows still keeps all threads busy.
+static TensorOpParallelism ChooseTensorOpParallelism(int& numThreads, const SmallVector<size_t>& regularOpDims, bool canSplitInnermost, bool isReduction)
+{
+    if (numThreads <= 1)
+        return TensorOpParallelism::Serial;
+    size_t numOutputs = 1;
+    for (size_t dim : regularOpDims)
+        numOutputs *= dim;
+    if (isReduction && numOutputs < (size_t) numThreads)
+        return TensorOpParallelism::Reduction;
+    if (regularOpDims.empty())
+        return TensorOpParallelism::Serial;
+    const size_t outermostDim = regularOpDims.back();
+    // a single dimension that is contiguous: the innermost loop is specialized for it
+    if (canSplitInnermost && regularOpDims.size() == 1)
+        return TensorOpParallelism::Innermost;
+    if (outermostDim >= (size_t) numThreads)
+        return TensorOpParallelism::Outermost;
+    if (canSplitInnermost && regularOpDims[0] >= (size_t) numThreads)
+        return TensorOpParallelism::Innermost;
+    if (outermostDim > 1)
+    {
+        numThreads = (int) outermostDim;
+        return TensorOpParallelism::Outermost;
+    }
+    return TensorOpParallelism::Serial;
+}
+
 // -----------------------------------------------------------------------
 // map runtime parameters N to template parameters
 // -----------------------------------------------------------------------
 
+// tensor operation with k+1 dimensions (-1 means scalar)
+template <class ElemType, typename OPFN, typename ReductionOp, size_t N, bool vectorizable, int m, int k>
+static void TensorOpWithParallelism(ElemType beta, const array<ElemType*, N>& pointers, ElemType alpha, const OPFN& opfn, ReductionOp reductionOp,
+                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides, size_t opCost)
+{
+    double work = (double) opCost;
+    for (size_t dim : regularOpDims)
+        work *= dim;
+    for (size_t dim : reducingOpDims)
+        work *= dim;
+    int numThreads = TensorOpNumThreads(work);
+    switch (ChooseTensorOpParallelism(numThreads, regularOpDims, vectorizable && m < 0 && N <= 3 /*specialized innermost loops exist*/, m >= 0))
+    {
+    case TensorOpParallelism::Outermost:
+        return TensorOpOutermostParallelIteration<ElemType, OPFN, ReductionOp, N, vectorizable, m, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides, numThreads);
+    case TensorOpParallelism::Innermost:
+    case TensorOpParallelism::Reduction:
+        return TensorOpIteration<ElemType, OPFN, ReductionOp, N, vectorizable, m, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides, numThreads);
+    default:
+        return TensorOpIteration<ElemType, OPFN, ReductionOp, N, vectorizable, m, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides, 1);
+    }
+}
+
 // tensor operation with k+1 dimensions (-1 means scalar)
 template <class ElemType, typename OPFN, typename ReductionOp, size_t N, int k>
 static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& pointers, ElemType alpha, const OPFN& opfn, ReductionOp reductionOp,
                                     const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
-                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides, size_t opCost)
 {
     size_t dims = reducingOpDims.size();
     switch (dims)
     {
     case 2:
-        return TensorOpIteration<ElemType, OPFN, ReductionOp, N, false /*vectorizable*/, 1, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithParallelism<ElemType, OPFN, ReductionOp, N, false /*vectorizable*/, 1, k>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides, opCost);
     case 1:
-        return TensorOpIteration<ElemType, OPFN, ReductionOp, N, false /*vectorizable*/, 0, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithParallelism<ElemType, OPFN, ReductionOp, N, false /*vectorizable*/, 0, k>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides, opCost);
     case 0:
     {
         // if all leading dimensions are 1, we can let the compiler do some unrolling
@@ -6268,22 +6619,46 @@ static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& po
         for (size_t i = 0; i < N; i++)
             leadingAllOne &= k >= 0 && regularStrides[i][0] == 1;
         if (leadingAllOne) // special version that uses a hard-coded increment of 1 for all leading dimensions
-            return TensorOpIteration<ElemType, OPFN, ReductionOp, N, true /*vectorizable*/, -1, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            return TensorOpWithParallelism<ElemType, OPFN, ReductionOp, N, true /*vectorizable*/, -1, k>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides, opCost);
         else
-            return TensorOpIteration<ElemType, OPFN, ReductionOp, N, false /*vectorizable*/, -1, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            return TensorOpWithParallelism<ElemType, OPFN, ReductionOp, N, false /*vectorizable*/, -1, k>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides, opCost);
     }
     default:
         LogicError("TensorOp: %d non-flattened reduction dimensions are not supported.", (int) dims);
     }
 }
 
+// Get the vectorized kernel for the elementwise op of a reduction, if the innermost reducing dimension is contiguous or
+// broadcasting (stride 0) in all inputs. Returns nullptr otherwise, or if there is no kernel for this op/type/CPU.
+template <class ElemType, size_t N>
+static SIMDElementwiseKernel GetSIMDReductionKernel(const array<ElemType*, N>&, ElementWiseOperator, const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, N>&)
+{
+    return nullptr; // kernels exist for float only
+}
+
+template <size_t N>
+static SIMDElementwiseKernel GetSIMDReductionKernel(const array<float*, N>&, ElementWiseOperator op, const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+{
+    if (reducingOpDims.empty())
+        return nullptr;
+    unsigned int broadcastMask = 0;
+    for (size_t i = 0; i < N - 1; i++)
+    {
+        if (reducingStrides[i][0] == 0)
+            broadcastMask |= 1u << i;
+        else if (reducingStrides[i][0] != 1)
+            return nullptr;
+    }
+    return GetSIMDElementwiseKernel(op, N - 1, broadcastMask);
+}
+
 // tensor operation, generalized in number of arguments, operation already provided as a lambda
 // This function now expands into different k.
 template <class ElemType, typename OPFN, typename ReductionOp, size_t N>
 static void TensorOpWithFnAndReduction(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn, const ReductionOp& reductionOp,
     const array<size_t, N>& offsets,
     const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
-    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides, size_t opCost)
 {
     for (size_t i = 0; i < N; i++) // N = a small constant, this will be unrolled
         pointers[i] += offsets[i];
@@ -6291,15 +6666,15 @@ static void TensorOpWithFnAndReduction(ElemType beta, array<ElemType*, N> pointe
     switch (dims)
     {
     case 4:
-        return TensorOpWithRegularLoop<ElemType, OPFN, ReductionOp, N, 3>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithRegularLoop<ElemType, OPFN, ReductionOp, N, 3>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides, opCost);
     case 3:
-        return TensorOpWithRegularLoop<ElemType, OPFN, ReductionOp, N, 2>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithRegularLoop<ElemType, OPFN, ReductionOp, N, 2>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides, opCost);
     case 2:
-        return TensorOpWithRegularLoop<ElemType, OPFN, ReductionOp, N, 1>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithRegularLoop<ElemType, OPFN, ReductionOp, N, 1>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides, opCost);
     case 1:
-        return TensorOpWithRegularLoop<ElemType, OPFN, ReductionOp, N, 0>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithRegularLoop<ElemType, OPFN, ReductionOp, N, 0>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides, opCost);
     case 0:
-        return TensorOpWithRegularLoop<ElemType, OPFN, ReductionOp, N, -1>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithRegularLoop<ElemType, OPFN, ReductionOp, N, -1>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides, opCost);
     default:
         LogicError("TensorOp: %d non-flattened input dimensions are not supported.", (int)dims);
     }
@@ -6308,11 +6683,18 @@ static void TensorOpWithFnAndReduction(ElemType beta, array<ElemType*, N> pointe
 // tensor operation, generalized in number of arguments, operation already provided as a lambda
 // This function now expands into different reductionOps
 template <class ElemType, typename OPFN, size_t N>
-static void TensorOpWithFn(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn, ElementWiseOperator reductionOp,
+static void TensorOpWithFn(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn, ElementWiseOperator op, ElementWiseOperator reductionOp,
     const array<size_t, N>& offsets,
     const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
     const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
 {
+    // per-element cost estimate, for deciding whether to go parallel
+    size_t opCost = TensorOpCost(op);
+    if (!reducingOpDims.empty())
+        opCost += TensorOpCost(reductionOp);
+
+    const TensorOpFn<OPFN> fn = { opfn, GetSIMDReductionKernel(pointers, op, reducingOpDims, reducingStrides) };
+
 // BUGBUG: Using always 'double' as type of aggregator even for ElemType==float. Reason: otherwise some e2e test would fail as historically we 
 // used double for aggregator of sum. But:
 // * for min and max reductions this is meaningless.
@@ -6321,11 +6703,11 @@ static void TensorOpWithFn(ElemType beta, array<ElemType*, N> pointers, ElemType
 // TODO: apdapt e2e tests to run with aggregator of type ElemType.
 #define CaseTensorOpWithFnAndReduction(oper)                                                  \
     case ElementWiseOperator::op##oper:                                                       \
-    return TensorOpWithFnAndReduction(beta, pointers, alpha, opfn, [](double a, double b)     \
+    return TensorOpWithFnAndReduction(beta, pointers, alpha, fn, [](double a, double b)       \
                                     {                                                         \
                                     return Op##oper(a, b);                                    \
                                     },                                                        \
-                                    offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
+                                    offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides, opCost)
 
     switch (reductionOp)
     {
@@ -6338,6 +6720,77 @@ static void TensorOpWithFn(ElemType beta, array<ElemType*, N> pointers, ElemType
     }
 }
 
+// -----------------------------------------------------------------------
+// hand-vectorized elementwise ops (TensorOpsSIMD.h)
+// -----------------------------------------------------------------------
+
+// rows longer than this get split into several work items, so that single large vectors still use all threads
+static const size_t SIMDRowChunkSize = 16384;
+
+// Run a non-reducing elementwise op through an explicitly vectorized kernel.
+// The kernel processes one contiguous row of the output along the innermost dimension, in which the inputs must be
+// contiguous or broadcasting (stride 0). All outer dimensions are iterated here.
+// Returns false if there is no kernel for this op/type/CPU or the layout does not qualify; the caller then uses the generic path.
+template <class ElemType, size_t N>
+static bool TensorOpWithSIMDKernel(ElemType, const array<ElemType*, N>&, ElemType, ElementWiseOperator, const array<size_t, N>&,
+                                   const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, N>&, const SmallVector<size_t>&)
+{
+    return false; // kernels exist for float only
+}
+
+template <size_t N>
+static bool TensorOpWithSIMDKernel(float beta, const array<float*, N>& pointers, float alpha, ElementWiseOperator op, const array<size_t, N>& offsets,
+                                   const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                                   const SmallVector<size_t>& reducingOpDims)
+{
+    if (!reducingOpDims.empty() || regularOpDims.empty() || regularStrides[N - 1][0] != 1)
+        return false;
+    unsigned int broadcastMask = 0;
+    for (size_t i = 0; i < N - 1; i++)
+    {
+        if (regularStrides[i][0] == 0)
+            broadcastMask |= 1u << i;
+        else if (regularStrides[i][0] != 1)
+            return false;
+    }
+    const SIMDElementwiseKernel kernel = GetSIMDElementwiseKernel(op, N - 1, broadcastMask);
+    if (!kernel)
+        return false;
+
+    const size_t rowLength = regularOpDims[0];
+    size_t numRows = 1;
+    for (size_t k = 1; k < regularOpDims.size(); k++)
+        numRows *= regularOpDims[k];
+    const size_t numChunks = (rowLength + SIMDRowChunkSize - 1) / SIMDRowChunkSize;
+    const size_t numWorkItems = numRows * numChunks;
+
+    // the vectorized kernels are a few times cheaper per element than the generic loops, which the cost model is calibrated for
+    const int numThreads = TensorOpNumThreads((double) numRows * rowLength * TensorOpCost(op) / 4);
+    TensorOpParallelFor(numWorkItems, numThreads, [&](size_t item)
+    {
+        // locate the row by decomposing its index over the outer dimensions
+        size_t row = item / numChunks;
+        const size_t begin = (item % numChunks) * SIMDRowChunkSize;
+        array<const float*, N - 1> inputs;
+        float* output = pointers[N - 1] + offsets[N - 1];
+        for (size_t i = 0; i < N - 1; i++)
+            inputs[i] = pointers[i] + offsets[i];
+        for (size_t k = 1; k < regularOpDims.size(); k++)
+        {
+            const size_t index = row % regularOpDims[k];
+            row /= regularOpDims[k];
+            for (size_t i = 0; i < N - 1; i++)
+                inputs[i] += (ptrdiff_t) index * regularStrides[i][k];
+            output += (ptrdiff_t) index * regularStrides[N - 1][k];
+        }
+        for (size_t i = 0; i < N - 1; i++)
+            if (!(broadcastMask & (1u << i)))
+                inputs[i] += begin;
+        kernel(min(SIMDRowChunkSize, rowLength - begin), beta, inputs.data(), alpha, output + begin);
+    });
+    return true;
+}
+
 // -----------------------------------------------------------------------
 // entry points from Matrix.cpp; also map op to a lambda
 // -----------------------------------------------------------------------
@@ -6363,9 +6816,12 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               {                                                        \
                                   return Op##oper((*(pp[0])));                         \
                               },                                                       \
-                              reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
+                              op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
     array<ElemType*, 2> pointers = {a.Data(), Data()};
+    if (TensorOpWithSIMDKernel(beta, pointers, alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims))
+        return;
+
     switch (op)
     {
         ForAllUnaryOps(CaseUnaryTensorOp);
@@ -6391,9 +6847,12 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               {                                                        \
                                   return Op##oper((*(pp[0])), (*(pp[1])));             \
                               },                                                       \
-                              reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
+                              op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
     array<ElemType*, 3> pointers = {a.Data(), b.Data(), Data()};
+    if (TensorOpWithSIMDKernel(beta, pointers, alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims))
+        return;
+
     switch (op)
     {
         ForAllBinaryOps(CaseBinaryTensorOp);
@@ -6419,9 +6878,12 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               {                                                        \
                                   return Op##oper((*(pp[0])), (*(pp[1])), (*(pp[2]))); \
                               },                                                       \
-                              reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
+                              op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
     array<ElemType*, 4> pointers = {a.Data(), b.Data(), c.Data(), Data()};
+    if (TensorOpWithSIMDKernel(beta, pointers, alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims))
+        return;
+
     switch (op)
     {
         ForAllTernaryOps(CaseTernaryTensorOp);
@@ -0,0 +1,576 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "CPURNN.h"
+#include "TensorOps.h"
+#include "TensorOpsSIMD.h"
+#include <omp.h>
+#include <algorithm>
+#include <cstring>
+
+#ifdef USE_MKL
+// requires MKL 10.0 and above
+#include <mkl.h>
+#else
+#ifdef _MSC_VER
+// Visual Studio doesn't define standard complex types properly
+#define HAVE_LAPACK_CONFIG_H
+#define LAPACK_COMPLEX_STRUCTURE
+#endif
+#include <cblas.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// helpers
+// -----------------------------------------------------------------------
+
+// column-major C = alpha * op(A) * op(B) + beta * C, on raw pointers so that the hidden state of one direction can be
+// addressed inside the output of a bidirectional layer (leading dimension 2 * hiddenSize)
+static void Gemm(bool transA, bool transB, size_t m, size_t n, size_t k, float alpha, const float* a, size_t lda, const float* b, size_t ldb, float beta, float* c, size_t ldc)
+{
+    cblas_sgemm(CblasColMajor, transA ? CblasTrans : CblasNoTrans, transB ? CblasTrans : CblasNoTrans, (int) m, (int) n, (int) k, alpha, a, (int) lda, b, (int) ldb, beta, c, (int) ldc);
+}
+
+static void Gemm(bool transA, bool transB, size_t m, size_t n, size_t k, double alpha, const double* a, size_t lda, const double* b, size_t ldb, double beta, double* c, size_t ldc)
+{
+    cblas_dgemm(CblasColMajor, transA ? CblasTrans : CblasNoTrans, transB ? CblasTrans : CblasNoTrans, (int) m, (int) n, (int) k, alpha, a, (int) lda, b, (int) ldb, beta, c, (int) ldc);
+}
+
+// y += A * x
+static void GemvAdd(size_t m, size_t n, const float* a, const float* x, float* y)
+{
+    cblas_sgemv(CblasColMajor, CblasNoTrans, (int) m, (int) n, 1.0f, a, (int) m, x, 1, 1.0f, y, 1);
+}
+
+static void GemvAdd(size_t m, size_t n, const double* a, const double* x, double* y)
+{
+    cblas_dgemv(CblasColMajor, CblasNoTrans, (int) m, (int) n, 1.0, a, (int) m, x, 1, 1.0, y, 1);
+}
+
+// Gate nonlinearities over a contiguous range, out[i] = f(in[i]); in and out may be the same.
+template <class ElemType>
+struct ScalarGateFunctions
+{
+    void ApplySigmoid(size_t n, const ElemType* in, ElemType* out) const
+    {
+        for (size_t i = 0; i < n; i++)
+            out[i] = Sigmoid(in[i]);
+    }
+    void ApplyTanh(size_t n, const ElemType* in, ElemType* out) const
+    {
+        for (size_t i = 0; i < n; i++)
+            out[i] = tanh_(in[i]);
+    }
+    void ApplyLinearRectifier(size_t n, const ElemType* in, ElemType* out) const
+    {
+        for (size_t i = 0; i < n; i++)
+            out[i] = in[i] > 0 ? in[i] : 0;
+    }
+};
+
+template <class ElemType>
+struct GateFunctions : public ScalarGateFunctions<ElemType>
+{
+};
+
+// float uses the vectorized kernels of TensorOpsSIMD.h if the CPU supports them.
+template <>
+struct GateFunctions<float>
+{
+    GateFunctions()
+        : m_sigmoid(GetSIMDElementwiseKernel(ElementWiseOperator::opSigmoid, 1, 0)),
+          m_tanh(GetSIMDElementwiseKernel(ElementWiseOperator::opTanh, 1, 0)),
+          m_linearRectifier(GetSIMDElementwiseKernel(ElementWiseOperator::opLinearRectifier, 1, 0))
+    {
+    }
+    void ApplySigmoid(size_t n, const float* in, float* out) const
+    {
+        if (m_sigmoid)
+            m_sigmoid(n, 0, &in, 1, out);
+        else
+            m_scalar.ApplySigmoid(n, in, out);
+    }
+    void ApplyTanh(size_t n, const float* in, float* out) const
+    {
+        if (m_tanh)
+            m_tanh(n, 0, &in, 1, out);
+        else
+            m_scalar.ApplyTanh(n, in, out);
+    }
+    void ApplyLinearRectifier(size_t n, const float* in, float* out) const
+    {
+        if (m_linearRectifier)
+            m_linearRectifier(n, 0, &in, 1, out);
+        else
+            m_scalar.ApplyLinearRectifier(n, in, out);
+    }
+
+private:
+    SIMDElementwiseKernel m_sigmoid, m_tanh, m_linearRectifier;
+    ScalarGateFunctions<float> m_scalar;
+};
+
+// number of threads for the per-sample gate computations of one time step
+// The gates are dominated by transcendental functions, weighted like those of the CPU tensor ops (see CPUMatrix::TensorOp()).
+template <class ElemType>
+static int NumCellThreads(size_t numElements)
+{
+    if (omp_in_parallel())
+        return 1;
+    size_t numThreads = numElements * 8 / CPUMatrix<ElemType>::GetTensorOpMinWorkPerThread();
+    return (int) max((size_t) 1, min(numThreads, (size_t) omp_get_max_threads()));
+}
+
+// -----------------------------------------------------------------------
+// CPURNNExecutor
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+CPURNNExecutor<ElemType>::CPURNNExecutor(size_t xDim, size_t yDim, const RnnAttributes& rnnAttributes)
+    : m_rnnAttributes(rnnAttributes),
+      m_xDim(xDim), m_yDim(yDim), m_hiddenSize(rnnAttributes.m_hiddenSize),
+      m_numDirections(rnnAttributes.m_bidirectional ? 2 : 1),
+      m_numColumns(0),
+      m_BackwardDataCalledYet(false)
+{
+    if      (m_rnnAttributes.m_recurrentOp == wstring(L"lstm"))    m_cellType = CellType::lstm,    m_numGates = 4;
+    else if (m_rnnAttributes.m_recurrentOp == wstring(L"gru"))     m_cellType = CellType::gru,     m_numGates = 3;
+    else if (m_rnnAttributes.m_recurrentOp == wstring(L"rnnReLU")) m_cellType = CellType::rnnReLU, m_numGates = 1;
+    else if (m_rnnAttributes.m_recurrentOp == wstring(L"rnnTanh")) m_cellType = CellType::rnnTanh, m_numGates = 1;
+    else InvalidArgument("Unknown cell type '%ls'. Supported values are 'lstm', 'gru', 'rnnReLU', 'rnnTanh'.", m_rnnAttributes.m_recurrentOp.c_str());
+
+    if (m_yDim != m_numDirections * m_hiddenSize)
+        InvalidArgument("CPU RNN: Output leading dimension must be twice hidden size for bidirectional networks");
+
+    // parameter layout, see CPURNN.h
+    const size_t gateDim = GateDim();
+    size_t weightsOffset = 0;
+    for (size_t layer = 0; layer < m_rnnAttributes.m_numLayers; layer++)
+    {
+        for (size_t direction = 0; direction < m_numDirections; direction++)
+        {
+            LayerInfo info;
+            info.layer = layer;
+            info.direction = direction;
+            info.inputDim = layer == 0 ? m_xDim : m_yDim;
+            info.weightsOffset = weightsOffset;
+            weightsOffset += (info.inputDim + m_hiddenSize) * gateDim;
+            m_layers.push_back(info);
+        }
+    }
+    for (size_t i = 0; i < m_layers.size(); i++)
+        m_layers[i].biasOffset = weightsOffset + i * 2 * gateDim;
+    m_numParameters = weightsOffset + m_layers.size() * 2 * gateDim;
+}
+
+template <class ElemType>
+void CPURNNExecutor<ElemType>::CheckCompatible(const RnnAttributes& rnnAttributes) const
+{
+    if (!(m_rnnAttributes == rnnAttributes))
+        LogicError("RNN Layout has changed during processing");
+}
+
+template <class ElemType>
+size_t CPURNNExecutor<ElemType>::NumColumnsWithHistory(size_t t, size_t direction) const
+{
+    // Sequences are sorted by decreasing length, so the sequences of a time step are a prefix of those of the time step before.
+    if (direction == 0)
+        return t > 0 ? NumColumns(t) : 0;
+    else
+        return t + 1 < m_numSequencesForFrame.size() ? NumColumns(t + 1) : 0;
+}
+
+template <class ElemType>
+ElemType* CPURNNExecutor<ElemType>::Gates(CPUMatrix<ElemType>& reserve, size_t layerIndex) const
+{
+    return reserve.Data() + layerIndex * (GateDim() + StateDim()) * m_numColumns;
+}
+
+template <class ElemType>
+ElemType* CPURNNExecutor<ElemType>::State(CPUMatrix<ElemType>& reserve, size_t layerIndex) const
+{
+    return Gates(reserve, layerIndex) + GateDim() * m_numColumns;
+}
+
+template <class ElemType>
+ElemType* CPURNNExecutor<ElemType>::LayerOutput(CPUMatrix<ElemType>& reserve, const CPUMatrix<ElemType>& outputY, size_t layer) const
+{
+    if (layer + 1 == m_rnnAttributes.m_numLayers)
+        return outputY.Data();
+    return Gates(reserve, m_layers.size()) + layer * m_yDim * m_numColumns;
+}
+
+template <class ElemType>
+size_t CPURNNExecutor<ElemType>::GateGradientsSize() const
+{
+    const size_t numGateGradients = m_cellType == CellType::gru ? 2 : 1;
+    return m_layers.size() * numGateGradients * GateDim() * m_numColumns;
+}
+
+template <class ElemType>
+ElemType* CPURNNExecutor<ElemType>::GateGradients(CPUMatrix<ElemType>& workspace, size_t layerIndex) const
+{
+    return workspace.Data() + layerIndex * (GateGradientsSize() / m_layers.size());
+}
+
+template <class ElemType>
+ElemType* CPURNNExecutor<ElemType>::RecurrentGateGradients(CPUMatrix<ElemType>& workspace, size_t layerIndex) const
+{
+    // For GRU, the recurrent projection of the candidate is scaled by the reset gate, so its gradient differs from that of the input projection.
+    ElemType* dGates = GateGradients(workspace, layerIndex);
+    return m_cellType == CellType::gru ? dGates + GateDim() * m_numColumns : dGates;
+}
+
+template <class ElemType>
+void CPURNNExecutor<ElemType>::ForwardCore(
+    const CPUMatrix<ElemType>& weightsW,
+    const CPUMatrix<ElemType>& inputX, CPUMatrix<ElemType>& outputY,
+    const vector<size_t>& numSequencesForFrame,
+    const RnnAttributes& rnnAttributes,
+    CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    CheckCompatible(rnnAttributes);
+    if (weightsW.GetNumElements() != m_numParameters)
+        InvalidArgument("RNN needs %ld parameters, but %ld were allocated", (long) m_numParameters, (long) weightsW.GetNumElements());
+
+    m_numSequencesForFrame = numSequencesForFrame;
+    m_firstColumn.resize(m_numSequencesForFrame.size());
+    m_numColumns = 0;
+    for (size_t t = 0; t < m_numSequencesForFrame.size(); t++)
+    {
+        if (t > 0 && NumColumns(t) > NumColumns(t - 1))
+            LogicError("CPU RNN: Sequences must be sorted by decreasing length.");
+        m_firstColumn[t] = m_numColumns;
+        m_numColumns += NumColumns(t);
+    }
+    if (inputX.GetNumElements() != m_xDim * m_numColumns || outputY.GetNumElements() != m_yDim * m_numColumns)
+        LogicError("CPU RNN: Input and output must have %d and %d rows for each of the %d samples.", (int) m_xDim, (int) m_yDim, (int) m_numColumns);
+
+    // Only needed in training, can't be touched between passes.
+    const size_t numLayers = m_rnnAttributes.m_numLayers;
+    reserve.Resize(m_layers.size() * (GateDim() + StateDim()) * m_numColumns + (numLayers - 1) * m_yDim * m_numColumns, 1);
+    // GRU keeps the recurrent projections of a time step apart from the input projections
+    const size_t maxColumns = m_numSequencesForFrame.empty() ? 0 : NumColumns(0);
+    if (m_cellType == CellType::gru)
+        workspace.Resize(GateDim() * maxColumns, 1);
+
+    for (const auto& info : m_layers)
+    {
+        const ElemType* input = info.layer == 0 ? inputX.Data() : LayerOutput(reserve, outputY, info.layer - 1);
+        size_t layerIndex = &info - m_layers.data();
+        ForwardLayer(info, weightsW.Data(), input, LayerOutput(reserve, outputY, info.layer), Gates(reserve, layerIndex), State(reserve, layerIndex), workspace.Data());
+    }
+    m_BackwardDataCalledYet = false;
+}
+
+template <class ElemType>
+void CPURNNExecutor<ElemType>::ForwardLayer(const LayerInfo& info, const ElemType* w, const ElemType* input, ElemType* output, ElemType* gates, ElemType* state, ElemType* scratch)
+{
+    const size_t H = m_hiddenSize;
+    const size_t G = GateDim();
+    const ElemType* W = w + info.weightsOffset;
+    const ElemType* R = W + info.inputDim * G;
+    const ElemType* bW = w + info.biasOffset;
+    const ElemType* bR = bW + G;
+    const bool isGRU = m_cellType == CellType::gru;
+
+    // input projections and biases of all time steps at once
+    // (the recurrent bias of the GRU candidate is scaled by the reset gate, and added per time step)
+    vector<ElemType> bias(G);
+    for (size_t g = 0; g < G; g++)
+        bias[g] = bW[g] + (isGRU && g >= 2 * H ? 0 : bR[g]);
+#pragma omp parallel for
+    for (long j = 0; j < (long) m_numColumns; j++)
+        memcpy(gates + j * G, bias.data(), G * sizeof(ElemType));
+    Gemm(true, false, G, m_numColumns, info.inputDim, 1, W, info.inputDim, input, info.inputDim, 1, gates, G);
+
+    // the recurrence: output h of direction d is at rows [d * H, (d + 1) * H) of the layer output
+    const GateFunctions<ElemType> f;
+    ElemType* h = output + info.direction * H;
+    const size_t T = m_numSequencesForFrame.size();
+    for (size_t s = 0; s < T; s++)
+    {
+        const size_t t = info.direction == 0 ? s : T - 1 - s;
+        const size_t n = NumColumns(t);
+        const size_t nPrev = NumColumnsWithHistory(t, info.direction);
+        const size_t col0 = FirstColumn(t);
+        const size_t colPrev = nPrev > 0 ? FirstColumn(info.direction == 0 ? t - 1 : t + 1) : 0;
+        ElemType* stepGates = gates + col0 * G;
+        const ElemType* hPrev = h + colPrev * m_yDim;
+        if (nPrev > 0)
+        {
+            if (isGRU)
+                Gemm(true, false, G, nPrev, H, 1, R, H, hPrev, m_yDim, 0, scratch, G);
+            else
+                Gemm(true, false, G, nPrev, H, 1, R, H, hPrev, m_yDim, 1, stepGates, G);
+        }
+
+        // gate nonlinearities and new state, one sample at a time while its gates are in cache
+#pragma omp parallel for num_threads(NumCellThreads<ElemType>(n * G))
+        for (long j = 0; j < (long) n; j++)
+        {
+            const bool hasHistory = (size_t) j < nPrev;
+            ElemType* a = stepGates + j * G;
+            ElemType* ht = h + (col0 + j) * m_yDim;
+            switch (m_cellType)
+            {
+            case CellType::lstm:
+            {
+                f.ApplySigmoid(2 * H, a, a);         // i, f
+                f.ApplyTanh(H, a + 2 * H, a + 2 * H); // c'
+                f.ApplySigmoid(H, a + 3 * H, a + 3 * H); // o
+                ElemType* c = state + (col0 + j) * H;
+                const ElemType* cPrev = state + (colPrev + j) * H;
+                for (size_t k = 0; k < H; k++)
+                    c[k] = (hasHistory ? a[H + k] * cPrev[k] : 0) + a[k] * a[2 * H + k];
+                f.ApplyTanh(H, c, ht);
+                for (size_t k = 0; k < H; k++)
+                    ht[k] *= a[3 * H + k];
+                break;
+            }
+            case CellType::gru:
+            {
+                ElemType* rh = state + (col0 + j) * H; // recurrent projection of the candidate, before the reset gate
+                const ElemType* rec = scratch + j * G;
+                if (hasHistory)
+                {
+                    for (size_t k = 0; k < 2 * H; k++)
+                        a[k] += rec[k];
+                    for (size_t k = 0; k < H; k++)
+                        rh[k] = rec[2 * H + k] + bR[2 * H + k];
+                }
+                else
+                {
+                    for (size_t k = 0; k < H; k++)
+                        rh[k] = bR[2 * H + k];
+                }
+                f.ApplySigmoid(2 * H, a, a); // r, u
+                for (size_t k = 0; k < H; k++)
+                    a[2 * H + k] += a[k] * rh[k];
+                f.ApplyTanh(H, a + 2 * H, a + 2 * H); // c'
+                const ElemType* hp = hPrev + j * m_yDim;
+                for (size_t k = 0; k < H; k++)
+                    ht[k] = (1 - a[H + k]) * a[2 * H + k] + (hasHistory ? a[H + k] * hp[k] : 0);
+                break;
+            }
+            case CellType::rnnReLU:
+                f.ApplyLinearRectifier(H, a, a);
+                memcpy(ht, a, H * sizeof(ElemType));
+                break;
+            case CellType::rnnTanh:
+                f.ApplyTanh(H, a, a);
+                memcpy(ht, a, H * sizeof(ElemType));
+                break;
+            }
+        }
+    }
+}
+
+template <class ElemType>
+void CPURNNExecutor<ElemType>::BackwardDataCore(
+    const CPUMatrix<ElemType>& outputY, const CPUMatrix<ElemType>& outputDY, const CPUMatrix<ElemType>& weightsW, CPUMatrix<ElemType>& dx,
+    const RnnAttributes& rnnAttributes,
+    CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    CheckCompatible(rnnAttributes);
+
+    if (!m_BackwardDataCalledYet)
+    {
+        const size_t numLayers = m_rnnAttributes.m_numLayers;
+        const size_t N = m_numColumns;
+        const size_t maxColumns = m_numSequencesForFrame.empty() ? 0 : NumColumns(0);
+
+        // workspace: gate gradients (kept for BackwardWeightsCore()), two buffers for the output gradients of the
+        // hidden layers, and scratch for the recurrent gradients (reused by BackwardWeightsCore())
+        const size_t gateGradientsSize = GateGradientsSize();
+        const size_t layerGradientsSize = numLayers > 1 ? 2 * m_yDim * N : 0;
+        const size_t scratchSize = max(2 * m_hiddenSize * maxColumns, (m_hiddenSize + 1) * N);
+        workspace.Resize(gateGradientsSize + layerGradientsSize + scratchSize, 1);
+        ElemType* layerGradients[2] = { workspace.Data() + gateGradientsSize, workspace.Data() + gateGradientsSize + m_yDim * N };
+        ElemType* dh = workspace.Data() + gateGradientsSize + layerGradientsSize;
+        ElemType* dc = dh + m_hiddenSize * maxColumns;
+
+        if (dx.GetNumElements() != m_xDim * N)
+            LogicError("CPU RNN: Input gradient must have %d rows for each of the %d samples.", (int) m_xDim, (int) N);
+
+        for (size_t layer = numLayers; layer-- > 0;)
+        {
+            const ElemType* output = LayerOutput(reserve, outputY, layer);
+            const ElemType* dOutput = layer + 1 == numLayers ? outputDY.Data() : layerGradients[layer % 2];
+            ElemType* dInput = layer == 0 ? dx.Data() : layerGradients[(layer - 1) % 2];
+            for (size_t direction = 0; direction < m_numDirections; direction++)
+            {
+                const size_t layerIndex = layer * m_numDirections + direction;
+                const LayerInfo& info = m_layers[layerIndex];
+                ElemType* dGates = GateGradients(workspace, layerIndex);
+                BackwardLayer(info, weightsW.Data(), output, dOutput, Gates(reserve, layerIndex), State(reserve, layerIndex),
+                              dGates, RecurrentGateGradients(workspace, layerIndex), dh, dc);
+
+                // gradient of the input projections of all time steps at once
+                Gemm(false, false, info.inputDim, N, GateDim(), 1, weightsW.Data() + info.weightsOffset, info.inputDim, dGates, GateDim(), direction == 0 ? 0 : 1, dInput, info.inputDim);
+            }
+        }
+    }
+    m_BackwardDataCalledYet = true;
+}
+
+template <class ElemType>
+void CPURNNExecutor<ElemType>::BackwardLayer(const LayerInfo& info, const ElemType* w, const ElemType* output, const ElemType* dOutput, const ElemType* gates, const ElemType* state,
+                                             ElemType* dGates, ElemType* dRecurrentGates, ElemType* dh, ElemType* dc)
+{
+    const size_t H = m_hiddenSize;
+    const size_t G = GateDim();
+    const ElemType* R = w + info.weightsOffset + info.inputDim * G;
+    const bool isGRU = m_cellType == CellType::gru;
+    const GateFunctions<ElemType> f;
+    const ElemType* h = output + info.direction * H;
+    const ElemType* dy = dOutput + info.direction * H;
+
+    // back through time: time steps in the reverse order of ForwardLayer()
+    // dh and dc hold the gradients that flow into the state of the time step from the one processed before.
+    const size_t T = m_numSequencesForFrame.size();
+    for (size_t s = T; s-- > 0;)
+    {
+        const size_t t = info.direction == 0 ? s : T - 1 - s;
+        const size_t n = NumColumns(t);
+        const size_t nPrev = NumColumnsWithHistory(t, info.direction);
+        const size_t nNext = s + 1 < T ? NumColumnsWithHistory(info.direction == 0 ? t + 1 : t - 1, info.direction) : 0;
+        const size_t col0 = FirstColumn(t);
+        const size_t colPrev = nPrev > 0 ? FirstColumn(info.direction == 0 ? t - 1 : t + 1) : 0;
+
+#pragma omp parallel for num_threads(NumCellThreads<ElemType>(n * G))
+        for (long j = 0; j < (long) n; j++)
+        {
+            const bool hasHistory = (size_t) j < nPrev;
+            const bool hasFuture = (size_t) j < nNext;
+            const ElemType* a = gates + (col0 + j) * G;
+            const ElemType* dyt = dy + (col0 + j) * m_yDim;
+            ElemType* dg = dGates + (col0 + j) * G;
+            ElemType* dht = dh + j * H;
+            switch (m_cellType)
+            {
+            case CellType::lstm:
+            {
+                const ElemType* c = state + (col0 + j) * H;
+                const ElemType* cPrev = state + (colPrev + j) * H;
+                ElemType* dct = dc + j * H;
+                ElemType* tanhC = dg + 3 * H; // temporarily, overwritten with the gradient of o below
+                f.ApplyTanh(H, c, tanhC);
+                for (size_t k = 0; k < H; k++)
+                {
+                    const ElemType i = a[k], fg = a[H + k], cc = a[2 * H + k], o = a[3 * H + k], tc = tanhC[k];
+                    const ElemType dhk = dyt[k] + (hasFuture ? dht[k] : 0);
+                    const ElemType dck = (hasFuture ? dct[k] : 0) + dhk * o * (1 - tc * tc);
+                    dg[k]         = dck * cc * i * (1 - i);
+                    dg[H + k]     = hasHistory ? dck * cPrev[k] * fg * (1 - fg) : 0;
+                    dg[2 * H + k] = dck * i * (1 - cc * cc);
+                    dg[3 * H + k] = dhk * tc * o * (1 - o);
+                    if (hasHistory)
+                        dct[k] = dck * fg;
+                }
+                break;
+            }
+            case CellType::gru:
+            {
+                const ElemType* rh = state + (col0 + j) * H;
+                const ElemType* hp = h + (colPrev + j) * m_yDim;
+                ElemType* drg = dRecurrentGates + (col0 + j) * G;
+                for (size_t k = 0; k < H; k++)
+                {
+                    const ElemType r = a[k], u = a[H + k], cc = a[2 * H + k];
+                    const ElemType hpk = hasHistory ? hp[k] : 0;
+                    const ElemType dhk = dyt[k] + (hasFuture ? dht[k] : 0);
+                    const ElemType dck = dhk * (1 - u) * (1 - cc * cc);
+                    const ElemType drk = dck * rh[k] * r * (1 - r);
+                    const ElemType duk = dhk * (hpk - cc) * u * (1 - u);
+                    dg[k] = drg[k] = drk;
+                    dg[H + k] = drg[H + k] = duk;
+                    dg[2 * H + k] = dck;
+                    drg[2 * H + k] = dck * r;
+                    if (hasHistory)
+                        dht[k] = dhk * u; // direct path; the one through the gates is added below
+                }
+                break;
+            }
+            case CellType::rnnReLU:
+                for (size_t k = 0; k < H; k++)
+                    dg[k] = a[k] > 0 ? dyt[k] + (hasFuture ? dht[k] : 0) : 0;
+                break;
+            case CellType::rnnTanh:
+                for (size_t k = 0; k < H; k++)
+                    dg[k] = (dyt[k] + (hasFuture ? dht[k] : 0)) * (1 - a[k] * a[k]);
+                break;
+            }
+        }
+
+        // gradient flowing into the hidden state of the previous time step through the recurrent projection
+        if (nPrev > 0)
+            Gemm(false, false, H, nPrev, G, 1, R, H, dRecurrentGates + col0 * G, G, isGRU ? 1 : 0, dh, H);
+    }
+}
+
+template <class ElemType>
+void CPURNNExecutor<ElemType>::BackwardWeightsCore(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& outputY, CPUMatrix<ElemType>& dw,
+    const RnnAttributes& rnnAttributes,
+    CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    CheckCompatible(rnnAttributes);
+    if (!m_BackwardDataCalledYet)
+        LogicError("out of order calling you have been very bad");
+    if (dw.GetNumElements() != m_numParameters)
+        InvalidArgument("RNN needs %ld parameters, but %ld were allocated", (long) m_numParameters, (long) dw.GetNumElements());
+
+    // scratch after the gate and layer gradients, see BackwardDataCore()
+    const size_t H = m_hiddenSize;
+    const size_t G = GateDim();
+    const size_t N = m_numColumns;
+    const size_t numLayers = m_rnnAttributes.m_numLayers;
+    ElemType* hPrev = workspace.Data() + GateGradientsSize() + (numLayers > 1 ? 2 * m_yDim * N : 0);
+    ElemType* ones = hPrev + H * N;
+    fill(ones, ones + N, (ElemType) 1);
+
+    // Like cuDNN, the weight gradients are accumulated into dw.
+    for (size_t layerIndex = 0; layerIndex < m_layers.size(); layerIndex++)
+    {
+        const LayerInfo& info = m_layers[layerIndex];
+        const ElemType* input = info.layer == 0 ? inputX.Data() : LayerOutput(reserve, outputY, info.layer - 1);
+        const ElemType* h = LayerOutput(reserve, outputY, info.layer) + info.direction * H;
+        const ElemType* dGates = GateGradients(workspace, layerIndex);
+        const ElemType* dRecurrentGates = RecurrentGateGradients(workspace, layerIndex);
+        ElemType* dW = dw.Data() + info.weightsOffset;
+        ElemType* dR = dW + info.inputDim * G;
+        ElemType* dbW = dw.Data() + info.biasOffset;
+        ElemType* dbR = dbW + G;
+
+        // the hidden state each sample saw from its previous time step (zero at the start of the sequence)
+#pragma omp parallel for
+        for (long t = 0; t < (long) m_numSequencesForFrame.size(); t++)
+        {
+            const size_t nPrev = NumColumnsWithHistory(t, info.direction);
+            const size_t colPrev = nPrev > 0 ? FirstColumn(info.direction == 0 ? t - 1 : t + 1) : 0;
+            for (size_t j = 0; j < NumColumns(t); j++)
+            {
+                ElemType* dst = hPrev + (FirstColumn(t) + j) * H;
+                if (j < nPrev)
+                    memcpy(dst, h + (colPrev + j) * m_yDim, H * sizeof(ElemType));
+                else
+                    memset(dst, 0, H * sizeof(ElemType));
+            }
+        }
+
+        Gemm(false, true, info.inputDim, G, N, 1, input, info.inputDim, dGates, G, 1, dW, info.inputDim);
+        Gemm(false, true, H, G, N, 1, hPrev, H, dRecurrentGates, G, 1, dR, H);
+        GemvAdd(G, N, dGates, ones, dbW);
+        GemvAdd(G, N, dRecurrentGates, ones, dbR);
+    }
+}
+
+template class CPURNNExecutor<float>;
+template class CPURNNExecutor<double>;
+
+}}}
@@ -0,0 +1,98 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include "CPUMatrix.h"
+#include "RNNCommon.h"
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// CPURNNExecutor is the CPU counterpart of CuDnnRNNExecutor (CuDnnRNN.h): it evaluates the RNN stack of an
+// OptimizedRNNStackNode (LSTM, GRU, ReLU/tanh RNN, optionally bidirectional and multi-layer) and its gradients.
+// Like the cuDNN version it is attached to the output CPUMatrix, and all calls to the RNN go through that object.
+//
+// The parameters use the packed layout of cuDNN, so a model trained on either device runs on the other:
+//  - first the weight matrices of each layer and direction (layer-major), each one being
+//    W (inputDim x numGates*hiddenSize) followed by R (hiddenSize x numGates*hiddenSize), column-major,
+//  - then the biases in the same order, each being bW (numGates*hiddenSize) followed by bR (numGates*hiddenSize).
+// The gates are ordered i, f, c, o for LSTM and r, u, c for GRU.
+//
+// Data is expected in the packing produced by OptimizedRNNStackNode: one column per sample, time-step major, with
+// the sequences of each time step sorted by decreasing length (numSequencesForFrame[t] columns for time step t).
+//
+// For each layer and direction, the input projections of all time steps are computed with one GEMM; the time steps
+// then only need the recurrent GEMM and the gate nonlinearities, which are applied in a single pass per sample
+// using the vectorized kernels of TensorOpsSIMD.h where available.
+template <class ElemType>
+class CPURNNExecutor
+{
+public:
+    CPURNNExecutor(size_t xDim, size_t yDim, const RnnAttributes& rnnAttributes);
+
+    void ForwardCore(const CPUMatrix<ElemType>& weightsW, const CPUMatrix<ElemType>& inputX, CPUMatrix<ElemType>& outputY, const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace);
+    void BackwardWeightsCore(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& outputY, CPUMatrix<ElemType>& dw, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace);
+    void BackwardDataCore(const CPUMatrix<ElemType>& outputY, const CPUMatrix<ElemType>& outputDY, const CPUMatrix<ElemType>& w, CPUMatrix<ElemType>& dx, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace);
+
+private:
+    enum class CellType
+    {
+        lstm,
+        gru,
+        rnnReLU,
+        rnnTanh
+    };
+
+    // one direction of one layer
+    struct LayerInfo
+    {
+        size_t layer;
+        size_t direction;
+        size_t inputDim;
+        size_t weightsOffset;   // W, then R
+        size_t biasOffset;      // bW, then bR
+    };
+
+    // The reserve holds, for each layer and direction, the gate activations (numGates*hiddenSize per sample) and
+    // the cell state (LSTM) or recurrent candidate projection (GRU), followed by the outputs of all but the last layer.
+    // The workspace holds the gradients of the gate pre-activations for the weight gradients (numGates*hiddenSize per
+    // sample, twice for GRU, where the recurrent and input projections of the candidate differ).
+    size_t GateDim() const { return m_numGates * m_hiddenSize; }
+    size_t StateDim() const { return m_cellType == CellType::lstm || m_cellType == CellType::gru ? m_hiddenSize : 0; }
+    ElemType* Gates(CPUMatrix<ElemType>& reserve, size_t layerIndex) const;
+    ElemType* State(CPUMatrix<ElemType>& reserve, size_t layerIndex) const;
+    ElemType* LayerOutput(CPUMatrix<ElemType>& reserve, const CPUMatrix<ElemType>& outputY, size_t layer) const;
+    size_t GateGradientsSize() const;
+    ElemType* GateGradients(CPUMatrix<ElemType>& workspace, size_t layerIndex) const;
+    ElemType* RecurrentGateGradients(CPUMatrix<ElemType>& workspace, size_t layerIndex) const;
+
+    void ForwardLayer(const LayerInfo& info, const ElemType* w, const ElemType* input, ElemType* output, ElemType* gates, ElemType* state, ElemType* scratch);
+    void BackwardLayer(const LayerInfo& info, const ElemType* w, const ElemType* output, const ElemType* dOutput, const ElemType* gates, const ElemType* state,
+                       ElemType* dGates, ElemType* dRecurrentGates, ElemType* dh, ElemType* dc);
+
+    // first column and number of columns of time step t, and number of those that continue a sequence from the previous step in the direction
+    size_t FirstColumn(size_t t) const { return m_firstColumn[t]; }
+    size_t NumColumns(size_t t) const { return m_numSequencesForFrame[t]; }
+    size_t NumColumnsWithHistory(size_t t, size_t direction) const;
+
+    void CheckCompatible(const RnnAttributes& rnnAttributes) const;
+
+    RnnAttributes m_rnnAttributes;
+    CellType m_cellType;
+    size_t m_numGates;
+    size_t m_xDim, m_yDim, m_hiddenSize;
+    size_t m_numDirections;
+    vector<LayerInfo> m_layers;
+    size_t m_numParameters;
+
+    // packing of the current minibatch, from ForwardCore()
+    vector<size_t> m_numSequencesForFrame;
+    vector<size_t> m_firstColumn;
+    size_t m_numColumns;
+
+    bool m_BackwardDataCalledYet;
+};
+
+}}}
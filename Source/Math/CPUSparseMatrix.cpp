@@ -17,6 +17,7 @@
 #include <random>
 #include <chrono>
 #include <iostream>
+#include <algorithm>
 #ifdef LEAKDETECT
 #include <vld.h>
 #endif
@@ -262,7 +263,8 @@ void CPUSparseMatrix<ElemType>::SetValue(const CPUSparseMatrix<ElemType>& v)
         }
         else
         {
-            memcpy(GetBlockIds(), v.GetBlockIds(), v.GetBlockSize());
+            SetBlockSize(v.GetBlockSize());
+            memcpy(GetBlockIds(), v.GetBlockIds(), v.GetBlockSize() * sizeof(size_t));
         }
     }
     if (v.m_sliceViewOffset > 0)
@@ -933,8 +935,24 @@ void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPU
         MultiplyDenseAndSparse<ElemType, false /* dense times sparse */, false /* transposeA */, false /*transposeB*/>::MultiplyAndWeightedAdd(alpha, a /*sparse*/, b /* dense */, beta, c /* matrix beeing updated */);
 }
 
+// y += alpha * x, where x may be strided (a row of a column-major matrix)
+static void Axpy(int n, float alpha, const float* x, int incx, float* y)
+{
+    cblas_saxpy(n, alpha, x, incx, y, 1);
+}
+
+static void Axpy(int n, double alpha, const double* x, int incx, double* y)
+{
+    cblas_daxpy(n, alpha, x, incx, y, 1);
+}
+
 // c = alpha * lhs * rhs
 // dense * sparse -> sparse
+// This is the gradient of the weights of a layer with sparse input, e.g. an embedding, and c is in block-column format:
+// only the columns of c that can be nonzero are stored, i.e. the rows of rhs that occur in the minibatch if transposeB,
+// else the nonempty columns of rhs. Each such column is a sum of terms alpha * value * op(lhs)(:, k), one per nonzero
+// rhs(k, j) or rhs(j, k). The terms are grouped by output column by a (stable) sort, which yields the block ids in
+// increasing order and lets the columns be accumulated in parallel, without a lookup over the whole vocabulary.
 template <class ElemType>
 void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<ElemType>& lhs, const bool transposeA,
                                                const CPUSparseMatrix<ElemType>& rhs, const bool transposeB, CPUSparseMatrix<ElemType>& c)
@@ -961,69 +979,68 @@ void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<E
 
     c.Reset();
 
-    if (!transposeA && !transposeB)
-    {
+    if (rhs.GetFormat() != matrixFormatSparseCSC)
         NOT_IMPLEMENTED;
-    }
-    else if (!transposeA && transposeB)
-    {
-        if (rhs.GetFormat() != matrixFormatSparseCSC)
-            NOT_IMPLEMENTED;
-
-        // allocate enough memory
-        c.SetFormat(matrixFormatSparseBlockCol);
-        c.RequireSizeAndAllocate(m, n, m * min(n, rhs.NzCount()), true, false);
-
-        map<size_t, size_t> w2Id;
-        for (size_t j = 0; j < rhs.GetNumCols(); j++)
-        { // j ranges over batches
-            size_t start = rhs.SecondaryIndexLocation()[j];
-            size_t end = rhs.SecondaryIndexLocation()[j + 1];
 
-            for (size_t p = start; p < end; p++)
-            {
-                size_t i = rhs.MajorIndexLocation()[p]; // i ranges over words
-                ElemType val = rhs.Buffer()[p];  // 1 for(i, j)
-
-                bool first = true;
-                if (w2Id.find(i) == w2Id.end())
-                {
-                    size_t id = w2Id.size();
-                    w2Id[i] = id;
-                    c.GetBlockIds()[c.GetBlockSize()] = i;
-                    c.SetBlockSize(c.GetBlockSize() + 1);
-                }
-                else
-                {
-                    first = false;
-                }
-                size_t pos = w2Id[i] * lhs.GetNumRows();
-                for (size_t h = 0; h < lhs.GetNumRows(); h++)
-                { // h range over hidden layer
-                    if (first == true)
-                    {
-                        c.Buffer()[pos] = alpha * lhs(h, j) * val;
-                    }
-                    else
-                    {
-                        c.Buffer()[pos] += alpha * lhs(h, j) * val;
-                    }
-                    pos++;
-                }
-            }
-        }
-        if (c.GetBlockSize() * m > c.GetSizeAllocated())
+    // gather the terms: output column, index of the column of op(lhs), value of rhs
+    struct Term
+    {
+        size_t column;
+        size_t lhsIndex;
+        ElemType value;
+    };
+    const CPUSPARSE_INDEX_TYPE* columnStarts = rhs.SecondaryIndexLocation(); // offsets into the full buffer
+    const CPUSPARSE_INDEX_TYPE* rowIndices = rhs.MajorIndexLocation();       // these two start at the first nonzero of the (slice) view
+    const ElemType* values = rhs.Data();
+    const long numRhsCols = (long) rhs.GetNumCols();
+    const size_t nz = columnStarts[numRhsCols] - columnStarts[0]; // (not NzCount(), which ignores the offset of a slice view)
+    vector<Term> terms(nz);
+#pragma omp parallel for
+    for (long j = 0; j < numRhsCols; j++)
+    {
+        for (size_t p = columnStarts[j] - columnStarts[0]; p < columnStarts[j + 1] - columnStarts[0]; p++)
         {
-            LogicError("Sparse matrix is unexpectedly out of range.");
+            if (transposeB)
+                terms[p] = { (size_t) rowIndices[p], (size_t) j, values[p] };
+            else
+                terms[p] = { (size_t) j, (size_t) rowIndices[p], values[p] };
         }
     }
-    else if (transposeA && !transposeB)
+    // Without transposeB, the terms of a column are already consecutive. Otherwise, the order within a column stays that of the minibatch.
+    if (transposeB)
+        stable_sort(terms.begin(), terms.end(), [](const Term& a, const Term& b) { return a.column < b.column; });
+
+    vector<size_t> blockStarts;
+    for (size_t q = 0; q < nz; q++)
     {
-        NOT_IMPLEMENTED;
+        if (q == 0 || terms[q].column != terms[q - 1].column)
+            blockStarts.push_back(q);
     }
-    else
+    const long numBlocks = (long) blockStarts.size();
+    blockStarts.push_back(nz);
+
+    c.SetFormat(matrixFormatSparseBlockCol);
+    c.RequireSizeAndAllocate(m, n, m * numBlocks, true, false);
+    c.SetBlockSize(numBlocks);
+
+    // column lhsIndex of op(lhs) is contiguous, or, if transposeA, row lhsIndex of lhs with a stride of its number of rows
+    const ElemType* lhsData = lhs.Data();
+    const size_t lhsRows = lhs.GetNumRows();
+    const int lhsStride = transposeA ? (int) lhsRows : 1;
+    ElemType* blockValues = c.Buffer();
+    size_t* blockIds = c.GetBlockIds();
+    // Blocks differ in their number of terms (frequent words), hence the dynamic schedule.
+#pragma omp parallel for schedule(dynamic, 16)
+    for (long b = 0; b < numBlocks; b++)
     {
-        NOT_IMPLEMENTED;
+        blockIds[b] = terms[blockStarts[b]].column;
+        ElemType* column = blockValues + b * m;
+        memset(column, 0, sizeof(ElemType) * m);
+        for (size_t q = blockStarts[b]; q < blockStarts[b + 1]; q++)
+        {
+            const ElemType* lhsColumn = transposeA ? lhsData + terms[q].lhsIndex : lhsData + terms[q].lhsIndex * lhsRows;
+            Axpy((int) m, alpha * terms[q].value, lhsColumn, lhsStride, column);
+        }
     }
 }
 
@@ -1209,6 +1226,187 @@ ElemType CPUSparseMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& c, const bool n
         return 1;
 }
 
+// m + m^2 + ... + m^k: the total weight with which a momentum-smoothed value enters the model over k steps without gradient
+static double MomentumWeightOverSteps(double momentum, size_t k)
+{
+    if (momentum == 1)
+        return (double) k;
+    return momentum * (1 - pow(momentum, (double) k)) / (1 - momentum);
+}
+
+// Momentum SGD (and NAG) with the same smoothed-gradient convention as the dense NormalGrad(), i.e. c holds the
+// learning-rate-scaled velocity v. A step without gradient does v = momentum * v and w -= v (NAG: w -= momentum * v),
+// so the k steps a column missed move it by (m + ... + m^k) * v (NAG: times m) and leave m^k * v.
+// Skipped steps use the current momentum; this is exact as long as the momentum did not change meanwhile.
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::LazyNormalGrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum, const bool useNesterovMomentum,
+                                               std::vector<size_t>& lastUpdates, size_t currentStep) const
+{
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        RuntimeError("CPUSparseMatrix::LazyNormalGrad() only supports the block column format.");
+    if (c.IsEmpty())
+    {
+        c.RequireSize(GetNumRows(), GetNumCols());
+        c.SetValue(0.0);
+    }
+    if (c.GetNumRows() != GetNumRows() || c.GetNumCols() != GetNumCols() || functionValues.GetNumRows() != GetNumRows() || functionValues.GetNumCols() != GetNumCols() || lastUpdates.size() != GetNumCols())
+        InvalidArgument("CPUSparseMatrix::LazyNormalGrad(): Dimension mismatch.");
+
+    const size_t numRows = GetNumRows();
+    const ElemType nesterovFactor = useNesterovMomentum ? momentum : 1;
+    const ElemType scaledLearnRate = (1 - momentum) * learnRatePerSample;
+#pragma omp parallel for
+    for (long j = 0; j < (long) GetBlockSize(); j++)
+    {
+        size_t col = GetBlockIds()[j] - GetBlockIdShift();
+        size_t skipped = currentStep - lastUpdates[col];
+        const ElemType* grad = Buffer() + j * numRows;
+        ElemType* velocity = c.Data() + col * numRows;
+        ElemType* val = functionValues.Data() + col * numRows;
+        ElemType skippedWeight = (ElemType) (nesterovFactor * MomentumWeightOverSteps(momentum, skipped));
+        ElemType skippedDecay = (ElemType) pow((double) momentum, (double) skipped);
+        for (size_t i = 0; i < numRows; i++)
+        {
+            ElemType v = velocity[i];
+            if (skipped > 0)
+            {
+                val[i] -= skippedWeight * v;
+                v *= skippedDecay;
+            }
+            ElemType g = scaledLearnRate * grad[i];
+            v = momentum * v + g;
+            val[i] -= useNesterovMomentum ? momentum * v + g : v;
+            velocity[i] = v;
+        }
+        lastUpdates[col] = currentStep + 1;
+    }
+}
+
+// FSAdaGrad (see CPUMatrix::FSAdagrad()); c holds the smoothed squared gradients followed by the smoothed gradients.
+// A step without gradient scales the former by adaWeight and applies the latter like LazyNormalGrad() does.
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::LazyFSAdagrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul,
+                                              std::vector<size_t>& lastUpdates, size_t currentStep) const
+{
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        RuntimeError("CPUSparseMatrix::LazyFSAdagrad() only supports the block column format.");
+    size_t numColsNeeded = 2 * GetNumCols();
+    if (c.IsEmpty() || (c.GetNumCols() < numColsNeeded))
+    {
+        c.RequireSize(GetNumRows(), numColsNeeded);
+        c.SetValue(0.0);
+    }
+    if (c.GetNumRows() != GetNumRows() || c.GetNumCols() != numColsNeeded || functionValues.GetNumRows() != GetNumRows() || functionValues.GetNumCols() != GetNumCols() || lastUpdates.size() != GetNumCols())
+        InvalidArgument("CPUSparseMatrix::LazyFSAdagrad(): Dimension mismatch.");
+
+    const size_t numRows = GetNumRows();
+    const size_t n = GetNumElements();
+#pragma omp parallel for
+    for (long j = 0; j < (long) GetBlockSize(); j++)
+    {
+        size_t col = GetBlockIds()[j] - GetBlockIdShift();
+        size_t skipped = currentStep - lastUpdates[col];
+        const ElemType* grad = Buffer() + j * numRows;
+        ElemType* smoothAda = c.Data() + col * numRows;
+        ElemType* smoothMom = c.Data() + n + col * numRows;
+        ElemType* val = functionValues.Data() + col * numRows;
+        ElemType skippedAdaDecay = (ElemType) pow((double) adaWeight, (double) skipped);
+        ElemType skippedWeight = momentum > 0.0f ? (ElemType) (learnRatePerSample * MomentumWeightOverSteps(momentum, skipped)) : 0;
+        ElemType skippedDecay = (ElemType) pow((double) momentum, (double) skipped);
+        for (size_t i = 0; i < numRows; i++)
+        {
+            if (skipped > 0)
+            {
+                smoothAda[i] *= skippedAdaDecay;
+                if (momentum > 0.0f)
+                {
+                    val[i] -= skippedWeight * smoothMom[i];
+                    smoothMom[i] *= skippedDecay;
+                }
+            }
+
+            ElemType g = grad[i];
+            ElemType adaSqr = adaWeight * smoothAda[i] + (1.0f - adaWeight) * g * g;
+            smoothAda[i] = adaSqr;
+            if (adaSqr != 0.0f)
+            {
+                ElemType ada = sqrt(adaSqr);
+                ElemType w = adaMul * ((ElemType) 1.0 / ada);
+
+                if (w > 10.0f)
+                    w = 10.0f;
+                g *= w;
+            }
+
+            if (momentum > 0.0f)
+            {
+                g = momentum * smoothMom[i] + (1.0f - momentum) * g;
+                smoothMom[i] = g;
+            }
+
+            val[i] -= learnRatePerSample * g;
+        }
+        lastUpdates[col] = currentStep + 1;
+    }
+}
+
+// RmsProp (see CPUMatrix::RmsProp()); c holds the smoothed squared gradients, the signs of the previous gradients and
+// the step sizes. A step without gradient scales the first by RMS_GAMMA, clears the sign and shrinks the step size
+// towards RMS_WGT_MIN (RMS_WGT_DEC <= 1 is assumed). As in RmsProp(), the gradients (this) are scaled in place.
+// There is no average multiplier: the dense one averages over all elements, which would defeat the lazy update.
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::LazyRmsProp(CPUMatrix<ElemType>& c, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN,
+                                            std::vector<size_t>& lastUpdates, size_t currentStep)
+{
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        RuntimeError("CPUSparseMatrix::LazyRmsProp() only supports the block column format.");
+    if (c.IsEmpty() || c.GetNumCols() < GetNumCols() * 3)
+    {
+        c.RequireSize(GetNumRows(), GetNumCols() * 3);
+        c.SetValue(0.0);
+    }
+    if (c.GetNumRows() != GetNumRows() || c.GetNumCols() != GetNumCols() * 3 || lastUpdates.size() != GetNumCols())
+        InvalidArgument("CPUSparseMatrix::LazyRmsProp(): Dimension mismatch.");
+
+    const ElemType floor = 1e-6f;
+    const ElemType ONE_MINUS_GAMMA = ElemType(1.0) - RMS_GAMMA;
+    const size_t numRows = GetNumRows();
+    const size_t n = GetNumElements();
+#pragma omp parallel for
+    for (long j = 0; j < (long) GetBlockSize(); j++)
+    {
+        size_t col = GetBlockIds()[j] - GetBlockIdShift();
+        size_t skipped = currentStep - lastUpdates[col];
+        ElemType* curr_grad = Buffer() + j * numRows;
+        ElemType* avars = c.Data() + col * numRows;
+        ElemType* signs = c.Data() + n + col * numRows;
+        ElemType* steps = c.Data() + 2 * n + col * numRows;
+        ElemType skippedGammaDecay = (ElemType) pow((double) RMS_GAMMA, (double) skipped);
+        ElemType skippedStepDecay = (ElemType) pow((double) RMS_WGT_DEC, (double) skipped);
+        for (size_t i = 0; i < numRows; i++)
+        {
+            if (skipped > 0)
+            {
+                avars[i] *= skippedGammaDecay;
+                steps[i] = std::max(steps[i] * skippedStepDecay, RMS_WGT_MIN);
+                signs[i] = 0;
+            }
+
+            avars[i] = RMS_GAMMA * avars[i] + ONE_MINUS_GAMMA * (curr_grad[i] * curr_grad[i]);
+            const int grad_sign = (ElemType(0) < curr_grad[i]) - (curr_grad[i] < ElemType(0));
+
+            if (signs[i] * grad_sign > 0)
+                steps[i] = std::min(steps[i] * RMS_WGT_INC, RMS_WGT_MAX);
+            else
+                steps[i] = std::max(steps[i] * RMS_WGT_DEC, RMS_WGT_MIN);
+
+            curr_grad[i] *= steps[i] / sqrt(avars[i] + floor);
+            signs[i] = (ElemType) grad_sign;
+        }
+        lastUpdates[col] = currentStep + 1;
+    }
+}
+
 template <class ElemType>
 CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::InplaceTruncateTop(const ElemType threshold)
 {
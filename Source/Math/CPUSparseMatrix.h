@@ -211,6 +211,17 @@ public:
     void NormalGrad(CPUMatrix<ElemType>& c, const ElemType momentum);
     ElemType Adagrad(CPUMatrix<ElemType>& c, const bool needAveMultiplier);
 
+    // Lazy updates for block-column gradients (e.g. those of embeddings): only the columns present in the gradient (this)
+    // are touched. lastUpdates[j] is the number of steps column j is up to date with; the steps it missed since then
+    // (in which its gradient was zero) are applied before the update of the current step, currentStep.
+    // LazyRmsProp() has no average multiplier: the dense one averages over all elements, including the columns not touched here.
+    void LazyNormalGrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum, const bool useNesterovMomentum,
+                        std::vector<size_t>& lastUpdates, size_t currentStep) const;
+    void LazyFSAdagrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul,
+                       std::vector<size_t>& lastUpdates, size_t currentStep) const;
+    void LazyRmsProp(CPUMatrix<ElemType>& c, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN,
+                     std::vector<size_t>& lastUpdates, size_t currentStep);
+
 public:
     CPUSparseMatrix<ElemType>& InplaceTruncateTop(const ElemType threshold);
     CPUSparseMatrix<ElemType>& InplaceTruncateBottom(const ElemType threshold);
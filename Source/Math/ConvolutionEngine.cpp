@@ -848,6 +848,442 @@ public:
     }
 };
 
+// Transform matrices of the Winograd minimal filtering algorithm F(m x m, 3 x 3):
+// Y = AT * [(G * g * GT) .* (BT * d * B)] * A,
+// where g is a 3x3 kernel, d is an (m+2)x(m+2) input tile and Y is the m x m output tile.
+template <class ElemType, size_t m>
+struct WinogradMatrices;
+
+template <class ElemType>
+struct WinogradMatrices<ElemType, 2>
+{
+    static ElemType BT(size_t i, size_t j)
+    {
+        static const ElemType bt[4][4] = {
+            { 1,  0, -1,  0 },
+            { 0,  1,  1,  0 },
+            { 0, -1,  1,  0 },
+            { 0,  1,  0, -1 } };
+        return bt[i][j];
+    }
+    static ElemType G(size_t i, size_t j)
+    {
+        static const ElemType g[4][3] = {
+            { 1,     0,    0   },
+            { 0.5,   0.5,  0.5 },
+            { 0.5,  -0.5,  0.5 },
+            { 0,     0,    1   } };
+        return g[i][j];
+    }
+    static ElemType AT(size_t i, size_t j)
+    {
+        static const ElemType at[2][4] = {
+            { 1, 1,  1,  0 },
+            { 0, 1, -1, -1 } };
+        return at[i][j];
+    }
+};
+
+template <class ElemType>
+struct WinogradMatrices<ElemType, 4>
+{
+    static ElemType BT(size_t i, size_t j)
+    {
+        static const ElemType bt[6][6] = {
+            { 4,  0, -5,  0, 1, 0 },
+            { 0, -4, -4,  1, 1, 0 },
+            { 0,  4, -4, -1, 1, 0 },
+            { 0, -2, -1,  2, 1, 0 },
+            { 0,  2, -1, -2, 1, 0 },
+            { 0,  4,  0, -5, 0, 1 } };
+        return bt[i][j];
+    }
+    static ElemType G(size_t i, size_t j)
+    {
+        static const ElemType g[6][3] = {
+            {  1.0 / 4,   0,          0       },
+            { -1.0 / 6,  -1.0 / 6,   -1.0 / 6 },
+            { -1.0 / 6,   1.0 / 6,   -1.0 / 6 },
+            {  1.0 / 24,  1.0 / 12,   1.0 / 6 },
+            {  1.0 / 24, -1.0 / 12,   1.0 / 6 },
+            {  0,         0,          1       } };
+        return g[i][j];
+    }
+    static ElemType AT(size_t i, size_t j)
+    {
+        static const ElemType at[4][6] = {
+            { 1, 1,  1, 1,  1, 0 },
+            { 0, 1, -1, 2, -2, 0 },
+            { 0, 1,  1, 4,  4, 0 },
+            { 0, 1, -1, 8, -8, 1 } };
+        return at[i][j];
+    }
+};
+
+//------------------------------------------------------------------
+// Direct convolution engine implementation.
+// This engine supports 2D convolutions with full sharing (and kernel depth equal
+// to the number of input channels) on CPU and computes them without unrolling the input.
+// 3x3 stride-1 convolutions use the Winograd minimal filtering algorithms F(2x2,3x3) and F(4x4,3x3)
+// (Fast Algorithms for Convolutional Neural Networks; Lavin, Gray), which need 2.25x and 4x fewer
+// multiplications than GEMM engine. The workspace holds transformed kernels and a block of transformed tiles.
+// Everything else uses a direct convolution blocked over output maps and output rows.
+// Uses GEMM engine for backpropagation and for sparse inputs, and reference engine for pooling.
+//------------------------------------------------------------------
+template <class ElemType>
+class DirectConvolutionEngine : public GemmConvolutionEngine<ElemType>
+{
+public:
+    using Base = GemmConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+
+public:
+    DirectConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind)
+    {
+        m_supported = IsSupported(deviceId, geometry);
+        if (!m_supported)
+            return;
+
+        const auto& inT = geometry->InputShape();
+        const auto& kernT = geometry->KernelShape();
+        m_inW = inT[0];
+        m_inH = inT[1];
+        m_inC = inT[2];
+        m_kW = kernT[0];
+        m_kH = kernT[1];
+        m_outW = geometry->OutputShape()[0];
+        m_outH = geometry->OutputShape()[1];
+        m_mapCount = geometry->GetMapCount(2);
+        m_strideW = geometry->GetStride(0);
+        m_strideH = geometry->GetStride(1);
+        // The first output cell is centered at MpRowCol[0], kernel cell 0 is (kW - 1) / 2 to the left of it.
+        int col = geometry->MpRowCol()[0];
+        m_padW = (int)(m_kW - 1) / 2 - col % (int)m_inW;
+        m_padH = (int)(m_kH - 1) / 2 - col / (int)m_inW % (int)m_inH;
+
+        m_winogradTileSize = 0;
+        if (IsWinogradSupported(geometry))
+            m_winogradTileSize = m_outW >= 8 && m_outH >= 8 ? 4 : 2;
+    }
+
+protected:
+    using Base::m_geometry;
+    using Base::m_deviceId;
+    using Base::m_imageLayout;
+    using Base::m_maxTempMemSizeInSamples;
+
+    void EnsureCompatible() override
+    {
+        Base::EnsureCompatible();
+        if (!m_supported)
+            LogicError("Direct convolution engine supports only 2D convolutions with full sharing. Geometry: %s", ((string)*m_geometry).c_str());
+    }
+
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) override
+    {
+        if (in.GetMatrixType() != MatrixType::DENSE || kernel.GetMatrixType() != MatrixType::DENSE)
+        {
+            Base::ForwardCore(in, kernel, out, workspace);
+            return;
+        }
+        out.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+        if (m_winogradTileSize == 4)
+            WinogradForward<4>(in, kernel, out, workspace);
+        else if (m_winogradTileSize == 2)
+            WinogradForward<2>(in, kernel, out, workspace);
+        else
+            DirectForward(in.Data(), kernel.Data(), out.Data(), in.GetNumCols());
+    }
+
+public:
+    static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry)
+    {
+        if (!Base::IsSupported(deviceId, geometry))
+            return false;
+        const auto& inT = geometry->InputShape();
+        const auto& kernT = geometry->KernelShape();
+        if (inT.GetRank() != 3 || kernT[2] != inT[2] || geometry->MpRowCol().empty())
+            return false;
+        if (geometry->GetMapCount(0) != 1 || geometry->GetMapCount(1) != 1 || geometry->OutputShape()[2] != geometry->GetMapCount(2))
+            return false;
+        // The kernel must cover all input channels exactly (no padding in channel dimension).
+        return geometry->MpRowCol()[0] / (int)(inT[0] * inT[1]) == (int)(kernT[2] - 1) / 2;
+    }
+
+    static bool IsWinogradSupported(ConvolveGeometryPtr geometry)
+    {
+        const auto& kernT = geometry->KernelShape();
+        return kernT[0] == 3 && kernT[1] == 3 && geometry->GetStride(0) == 1 && geometry->GetStride(1) == 1 &&
+               kernT[2] >= WinogradMinChannels && geometry->GetMapCount(2) >= WinogradMinChannels;
+    }
+
+    // Returns true if this engine is expected to be faster than GEMM engine, that is, if it can use Winograd
+    // convolution on large enough feature maps. On small maps, partial tiles and transforms eat up the savings.
+    // Direct convolution does fewer memory passes than unrolling + GEMM but cannot compete with a tuned BLAS,
+    // so it is used only when explicitly requested.
+    static bool IsPreferred(ConvolveGeometryPtr geometry)
+    {
+        const auto& outT = geometry->OutputShape();
+        return IsWinogradSupported(geometry) && outT[0] >= WinogradMinPreferredSize && outT[1] >= WinogradMinPreferredSize;
+    }
+
+private:
+    // Winograd transforms do not pay off for very shallow convolutions.
+    static const size_t WinogradMinChannels = 8;
+    // Minimum output width and height for Winograd to beat GEMM engine.
+    static const size_t WinogradMinPreferredSize = 16;
+    // Tiles are processed in blocks whose transformed inputs and outputs take about this many elements,
+    // but no less than WinogradMinTileBlock tiles at a time, to keep the GEMMs efficient.
+    static const size_t WinogradWorkspaceSize = 4 * 1024 * 1024;
+    static const size_t WinogradMinTileBlock = 64;
+    // Number of output maps computed together by direct convolution (to reuse each input row).
+    static const size_t DirectMapBlock = 4;
+
+    // Direct convolution. For each sample and block of output maps, output rows are accumulated
+    // one at a time from the input rows under the kernel, so the rows being updated stay in L1
+    // and the innermost loop runs over contiguous output cells.
+    void DirectForward(const ElemType* in, const ElemType* kernel, ElemType* out, size_t batchSize)
+    {
+        size_t inSize = m_inW * m_inH * m_inC;
+        size_t outMapSize = m_outW * m_outH;
+        size_t kernelSize = m_kW * m_kH * m_inC;
+        size_t mapBlocks = (m_mapCount + DirectMapBlock - 1) / DirectMapBlock;
+
+#pragma omp parallel for
+        for (long item = 0; item < (long)(batchSize * mapBlocks); item++)
+        {
+            size_t n = item / mapBlocks;
+            size_t k0 = item % mapBlocks * DirectMapBlock;
+            size_t kCount = min(DirectMapBlock, m_mapCount - k0);
+            const ElemType* src = in + n * inSize;
+            ElemType* dst = out + (n * m_mapCount + k0) * outMapSize;
+            for (size_t y = 0; y < m_outH; y++)
+            {
+                ElemType* dstRow[DirectMapBlock];
+                for (size_t kk = 0; kk < kCount; kk++)
+                {
+                    dstRow[kk] = dst + kk * outMapSize + y * m_outW;
+                    fill(dstRow[kk], dstRow[kk] + m_outW, (ElemType)0);
+                }
+                for (size_t c = 0; c < m_inC; c++)
+                {
+                    for (size_t j = 0; j < m_kH; j++)
+                    {
+                        int yIn = (int)(y * m_strideH + j) - m_padH;
+                        if (yIn < 0 || yIn >= (int)m_inH)
+                            continue;
+                        const ElemType* srcRow = src + (c * m_inH + yIn) * m_inW;
+                        for (size_t i = 0; i < m_kW; i++)
+                        {
+                            // Output cells x for which the input cell x * stride + xOff is inside the input.
+                            int xOff = (int)i - m_padW;
+                            int sW = (int)m_strideW;
+                            int xBegin = xOff < 0 ? (-xOff + sW - 1) / sW : 0;
+                            int xEnd = (int)m_inW - 1 - xOff < 0 ? 0 : min((int)m_outW, ((int)m_inW - 1 - xOff) / sW + 1);
+                            const ElemType* s = srcRow + xOff;
+                            size_t w = (c * m_kH + j) * m_kW + i;
+                            if (kCount == DirectMapBlock)
+                            {
+                                ElemType w0 = kernel[(k0 + 0) * kernelSize + w];
+                                ElemType w1 = kernel[(k0 + 1) * kernelSize + w];
+                                ElemType w2 = kernel[(k0 + 2) * kernelSize + w];
+                                ElemType w3 = kernel[(k0 + 3) * kernelSize + w];
+                                ElemType* d0 = dstRow[0];
+                                ElemType* d1 = dstRow[1];
+                                ElemType* d2 = dstRow[2];
+                                ElemType* d3 = dstRow[3];
+                                for (int x = xBegin; x < xEnd; x++)
+                                {
+                                    ElemType v = s[x * sW];
+                                    d0[x] += w0 * v;
+                                    d1[x] += w1 * v;
+                                    d2[x] += w2 * v;
+                                    d3[x] += w3 * v;
+                                }
+                            }
+                            else
+                            {
+                                for (size_t kk = 0; kk < kCount; kk++)
+                                {
+                                    ElemType wk = kernel[(k0 + kk) * kernelSize + w];
+                                    ElemType* d = dstRow[kk];
+                                    for (int x = xBegin; x < xEnd; x++)
+                                        d[x] += wk * s[x * sW];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Winograd convolution. With xi being a position in the (m+2)x(m+2) transformed tile:
+    // 1. Kernels are transformed into U[xi]: [C x K].
+    // 2. For each block of T tiles (over the whole minibatch), input tiles are transformed into V[xi]: [C x T].
+    // 3. Elementwise (in xi) products summed over channels are (m+2)^2 independent GEMMs:
+    //    M[xi] = U[xi]^T * V[xi]: [K x T].
+    // 4. M is transformed back into m x m output tiles.
+    template <size_t m>
+    void WinogradForward(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace)
+    {
+        typedef WinogradMatrices<ElemType, m> WM;
+        const size_t alpha = m + 2;
+        const size_t tileSize = alpha * alpha;
+        size_t batchSize = in.GetNumCols();
+        size_t inSize = m_inW * m_inH * m_inC;
+        size_t outMapSize = m_outW * m_outH;
+        size_t kernelSize = 9 * m_inC;
+        size_t tilesW = (m_outW + m - 1) / m;
+        size_t tilesPerSample = tilesW * ((m_outH + m - 1) / m);
+        size_t tileCount = tilesPerSample * batchSize;
+        size_t tileBlock = max(WinogradMinTileBlock, WinogradWorkspaceSize / (tileSize * (m_inC + m_mapCount)));
+        if (m_maxTempMemSizeInSamples != 0)
+            tileBlock = min(tileBlock, m_maxTempMemSizeInSamples * tilesPerSample);
+        tileBlock = min(tileBlock, tileCount);
+
+        // Reserve space for:
+        // 1. Transformed kernels U.
+        // 2. Transformed input tiles V.
+        // 3. Transformed output tiles M.
+        size_t uSize = tileSize * m_inC * m_mapCount;
+        size_t vSize = tileSize * m_inC * tileBlock;
+        size_t mSize = tileSize * m_mapCount * tileBlock;
+        workspace.Resize(1, uSize + vSize + mSize);
+        ElemType* u = workspace.Data();
+        ElemType* v = u + uSize;
+        ElemType* mm = v + vSize;
+        const ElemType* src = in.Data();
+        const ElemType* kern = kernel.Data();
+        ElemType* dst = out.Data();
+
+        // 1. U = G * g * GT.
+#pragma omp parallel for
+        for (long kc = 0; kc < (long)(m_mapCount * m_inC); kc++)
+        {
+            size_t k = kc / m_inC;
+            size_t c = kc % m_inC;
+            const ElemType* g = kern + k * kernelSize + c * 9;
+            ElemType gg[alpha][3];
+            for (size_t a = 0; a < alpha; a++)
+                for (size_t i = 0; i < 3; i++)
+                    gg[a][i] = WM::G(a, 0) * g[i] + WM::G(a, 1) * g[3 + i] + WM::G(a, 2) * g[6 + i];
+            for (size_t a = 0; a < alpha; a++)
+                for (size_t b = 0; b < alpha; b++)
+                    u[(a * alpha + b) * m_inC * m_mapCount + k * m_inC + c] = gg[a][0] * WM::G(b, 0) + gg[a][1] * WM::G(b, 1) + gg[a][2] * WM::G(b, 2);
+        }
+
+        for (size_t start = 0; start < tileCount; start += tileBlock)
+        {
+            size_t curTileCount = min(tileBlock, tileCount - start);
+
+            // 2. V = BT * d * B.
+#pragma omp parallel for
+            for (long t = 0; t < (long)curTileCount; t++)
+            {
+                size_t n = (start + t) / tilesPerSample;
+                size_t tile = (start + t) % tilesPerSample;
+                int x0 = (int)(tile % tilesW * m) - m_padW;
+                int y0 = (int)(tile / tilesW * m) - m_padH;
+                for (size_t c = 0; c < m_inC; c++)
+                {
+                    const ElemType* srcMap = src + n * inSize + c * m_inW * m_inH;
+                    ElemType d[alpha][alpha];
+                    for (size_t r = 0; r < alpha; r++)
+                    {
+                        int y = y0 + (int)r;
+                        for (size_t s = 0; s < alpha; s++)
+                        {
+                            int x = x0 + (int)s;
+                            d[r][s] = (y < 0 || y >= (int)m_inH || x < 0 || x >= (int)m_inW) ? 0 : srcMap[y * m_inW + x];
+                        }
+                    }
+                    ElemType bd[alpha][alpha];
+                    for (size_t a = 0; a < alpha; a++)
+                    {
+                        for (size_t s = 0; s < alpha; s++)
+                        {
+                            ElemType sum = 0;
+                            for (size_t r = 0; r < alpha; r++)
+                                sum += WM::BT(a, r) * d[r][s];
+                            bd[a][s] = sum;
+                        }
+                    }
+                    for (size_t a = 0; a < alpha; a++)
+                    {
+                        for (size_t b = 0; b < alpha; b++)
+                        {
+                            ElemType sum = 0;
+                            for (size_t s = 0; s < alpha; s++)
+                                sum += bd[a][s] * WM::BT(b, s);
+                            v[((a * alpha + b) * tileBlock + t) * m_inC + c] = sum;
+                        }
+                    }
+                }
+            }
+
+            // 3. M[xi] = U[xi]^T * V[xi].
+            for (size_t xi = 0; xi < tileSize; xi++)
+            {
+                auto uxi = workspace.ColumnSlice(xi * m_inC * m_mapCount, m_inC * m_mapCount);
+                uxi.Reshape(m_inC, m_mapCount);
+                auto vxi = workspace.ColumnSlice(uSize + xi * m_inC * tileBlock, m_inC * curTileCount);
+                vxi.Reshape(m_inC, curTileCount);
+                auto mxi = workspace.ColumnSlice(uSize + vSize + xi * m_mapCount * tileBlock, m_mapCount * curTileCount);
+                mxi.Reshape(m_mapCount, curTileCount);
+                Mat::Multiply(uxi, true, vxi, false, mxi);
+            }
+
+            // 4. Y = AT * M * A.
+#pragma omp parallel for
+            for (long t = 0; t < (long)curTileCount; t++)
+            {
+                size_t n = (start + t) / tilesPerSample;
+                size_t tile = (start + t) % tilesPerSample;
+                size_t x0 = tile % tilesW * m;
+                size_t y0 = tile / tilesW * m;
+                for (size_t k = 0; k < m_mapCount; k++)
+                {
+                    ElemType* dstMap = dst + (n * m_mapCount + k) * outMapSize;
+                    ElemType am[m][alpha];
+                    for (size_t p = 0; p < m; p++)
+                    {
+                        for (size_t b = 0; b < alpha; b++)
+                        {
+                            ElemType sum = 0;
+                            for (size_t a = 0; a < alpha; a++)
+                                sum += WM::AT(p, a) * mm[((a * alpha + b) * tileBlock + t) * m_mapCount + k];
+                            am[p][b] = sum;
+                        }
+                    }
+                    for (size_t p = 0; p < m && y0 + p < m_outH; p++)
+                    {
+                        for (size_t q = 0; q < m && x0 + q < m_outW; q++)
+                        {
+                            ElemType sum = 0;
+                            for (size_t b = 0; b < alpha; b++)
+                                sum += am[p][b] * WM::AT(q, b);
+                            dstMap[(y0 + p) * m_outW + x0 + q] = sum;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    bool m_supported;
+    size_t m_inW, m_inH, m_inC;
+    size_t m_outW, m_outH, m_mapCount;
+    size_t m_kW, m_kH;
+    size_t m_strideW, m_strideH;
+    int m_padW, m_padH;
+    // Output tile size m of Winograd F(m x m, 3 x 3), or 0 to use direct convolution.
+    size_t m_winogradTileSize;
+};
+
 template <class ElemType>
 std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId,
                                                                                  ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind,
@@ -883,6 +1319,17 @@ std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create
         return CuDnnConvolutionEngineFactory<ElemType>::Create(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, forceDeterministicAlgorithms);
     }
 
+    // Among CPU engines, prefer Winograd convolution over unrolling + GEMM where it is faster.
+    if (isEnabled(ConvolutionEngineKind::Direct) && poolKind == PoolKind::None &&
+        DirectConvolutionEngine<ElemType>::IsSupported(deviceId, geometry) &&
+        (!isEnabled(ConvolutionEngineKind::Gemm) || DirectConvolutionEngine<ElemType>::IsPreferred(geometry)))
+    {
+        if (GetMathLibTraceLevel() > 0)
+            fprintf(stderr, "%lsusing direct convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+
+        return std::make_unique<DirectConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind);
+    }
+
     if (isEnabled(ConvolutionEngineKind::Gemm) && GemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
     {
         if (GetMathLibTraceLevel() > 0)
@@ -1612,6 +1612,61 @@ ElemType Matrix<ElemType>::RmsProp(Matrix<ElemType>& gradients,
     // Note: Since both 'this' and gradients are changed, we must call SetDataLocation() on 'this' as well.
 }
 
+template <class ElemType>
+void Matrix<ElemType>::LazyNormalGrad(Matrix<ElemType>& gradients,
+                                      Matrix<ElemType>& functionValues,
+                                      const ElemType learnRatePerSample,
+                                      const ElemType momentum,
+                                      const bool useNesterovMomentum,
+                                      std::vector<size_t>& lastUpdates, size_t currentStep)
+{
+    DecideAndMoveToRightDevice(*this, gradients, functionValues);
+
+    DISPATCH_MATRIX_ON_FLAG(&gradients, nullptr,
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; },
+        { gradients.m_CPUSparseMatrix->LazyNormalGrad(*m_CPUMatrix, *functionValues.m_CPUMatrix, learnRatePerSample, momentum, useNesterovMomentum, lastUpdates, currentStep); },
+        { NOT_IMPLEMENTED; });
+}
+
+template <class ElemType>
+void Matrix<ElemType>::LazyFSAdagradUpdate(size_t mbSize,
+                                           Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, double& smoothedCount,
+                                           const double learnRatePerSample, const double targetAdagradAvDenom,
+                                           const double meanMomentum, const double varMomentum,
+                                           std::vector<size_t>& lastUpdates, size_t currentStep)
+{
+    DecideAndMoveToRightDevice(*this, gradients, functionValues);
+
+    // the sample count is global, as in FSAdagradUpdate()
+    smoothedCount = varMomentum * smoothedCount + (1.0 - varMomentum) * mbSize;
+    let targetAdagradAvDenom_x_sqrtAdagradSqrFrames = (ElemType)(targetAdagradAvDenom * sqrt(smoothedCount));
+    DISPATCH_MATRIX_ON_FLAG(&gradients, nullptr,
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; },
+        { gradients.m_CPUSparseMatrix->LazyFSAdagrad(*m_CPUMatrix, *functionValues.m_CPUMatrix, (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum, targetAdagradAvDenom_x_sqrtAdagradSqrFrames, lastUpdates, currentStep); },
+        { NOT_IMPLEMENTED; });
+}
+
+// both 'this' and gradients will be changed
+template <class ElemType>
+void Matrix<ElemType>::LazyRmsProp(Matrix<ElemType>& gradients,
+                                   ElemType RMS_GAMMA,
+                                   ElemType RMS_WGT_INC,
+                                   ElemType RMS_WGT_MAX,
+                                   ElemType RMS_WGT_DEC,
+                                   ElemType RMS_WGT_MIN,
+                                   std::vector<size_t>& lastUpdates, size_t currentStep)
+{
+    DecideAndMoveToRightDevice(*this, gradients);
+
+    DISPATCH_MATRIX_ON_FLAG(&gradients, nullptr,
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; },
+        { gradients.m_CPUSparseMatrix->LazyRmsProp(*m_CPUMatrix, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, lastUpdates, currentStep); },
+        { NOT_IMPLEMENTED; });
+}
+
 template <class ElemType>
 void Matrix<ElemType>::Reshape(const size_t numRows, const size_t numCols)
 {
@@ -4425,7 +4480,7 @@ void Matrix<ElemType>::RNNForward(const Matrix<ElemType> &inputX, const Matrix<E
 
     DISPATCH_MATRIX_ON_FLAG(this,
                             this,
-                            NOT_IMPLEMENTED,
+                            m_CPUMatrix->RNNForward(*(inputX.m_CPUMatrix), *(paramW.m_CPUMatrix), xDim, yDim, numSequencesForFrame, rnnAttributes, *(reserve.m_CPUMatrix), *(workspace.m_CPUMatrix)),
                             m_GPUMatrix->RNNForward(*(inputX.m_GPUMatrix), *(paramW.m_GPUMatrix), xDim, yDim, numSequencesForFrame, rnnAttributes, *(reserve.m_GPUMatrix), *(workspace.m_GPUMatrix)),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
@@ -4440,7 +4495,7 @@ void Matrix<ElemType>::RNNBackwardData(const Matrix<ElemType>& outputDY, const M
     workspace._transferToDevice(GetDeviceId());
     DISPATCH_MATRIX_ON_FLAG(this,
                             this,
-                            NOT_IMPLEMENTED,
+                            m_CPUMatrix->RNNBackwardData(*(outputDY.m_CPUMatrix), *(paramW.m_CPUMatrix), *(outputDX.m_CPUMatrix), rnnAttributes, *(reserve.m_CPUMatrix), *(workspace.m_CPUMatrix)),
                             m_GPUMatrix->RNNBackwardData(*(outputDY.m_GPUMatrix), *(paramW.m_GPUMatrix), *(outputDX.m_GPUMatrix), rnnAttributes, *(reserve.m_GPUMatrix), *(workspace.m_GPUMatrix)),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
@@ -4455,7 +4510,7 @@ void Matrix<ElemType>::RNNBackwardWeights(const Matrix<ElemType>& inputX, const
     workspace._transferToDevice(GetDeviceId());
     DISPATCH_MATRIX_ON_FLAG(this,
                             this,
-                            NOT_IMPLEMENTED,
+                            m_CPUMatrix->RNNBackwardWeights(*(inputX.m_CPUMatrix), *(outputY.m_CPUMatrix), *(dw.m_CPUMatrix), rnnAttributes, *(reserve.m_CPUMatrix), *(workspace.m_CPUMatrix)),
                             m_GPUMatrix->RNNBackwardWeights(*(inputX.m_GPUMatrix), *(outputY.m_GPUMatrix), *(dw.m_GPUMatrix), rnnAttributes, *(reserve.m_GPUMatrix), *(workspace.m_GPUMatrix)),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
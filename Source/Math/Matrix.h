@@ -207,6 +207,19 @@ public:
                          const double meanMomentum, const double varMomentum);
     ElemType RmsProp(Matrix<ElemType>& gradients, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
 
+    // Lazy variants of the above for block-column sparse gradients on the CPU, which only touch the columns present in the gradients.
+    // lastUpdates (one entry per column) records how many steps each column is up to date with; see CPUSparseMatrix::LazyNormalGrad().
+    void LazyNormalGrad(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum, const bool useNAG,
+                        std::vector<size_t>& lastUpdates, size_t currentStep);
+    void LazyFSAdagradUpdate(size_t mbSize,
+                             Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, double& smoothedCount,
+                             const double learnRatePerSample, const double targetAdagradAvDenom,
+                             const double meanMomentum, const double varMomentum,
+                             std::vector<size_t>& lastUpdates, size_t currentStep);
+    // (without the average multiplier, which needs all elements; use RmsProp() on the dense gradients for that)
+    void LazyRmsProp(Matrix<ElemType>& gradients, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN,
+                     std::vector<size_t>& lastUpdates, size_t currentStep);
+
     void Resize(const size_t numRows, const size_t numCols, const size_t numNZElemToReserve = 10000, bool growOnly = true); // by default we only reallocate if need to grow
     void Resize(const Matrix<ElemType>& other) // TODO: Should this carry over numNZElemToReserve for sparse matrices?
     {
@@ -0,0 +1,233 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Quantized matrix products (QuantizedOperations.h): the 16-bit product on the BlockMultiplier and the 8-bit product
+// with per-row/per-column scales. The AVX2 kernel of the latter is in QuantizedOperationsAVX2.cpp.
+//
+
+#include "stdafx.h"
+#include "QuantizedOperations.h"
+#include "TensorOpsSIMD.h"
+#include <omp.h>
+#if !defined(__aarch64__)
+#include "BlockMultiplier.h"
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// QuantizedMultiplier
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+QuantizedMultiplier<ElemType>::QuantizedMultiplier(shared_ptr<QuantizerBase<ElemType, short>> pQuantizerA, bool isAConstant, shared_ptr<QuantizerBase<ElemType, short>> pQuantizerB, bool isBConstant)
+    : QuantizedMultiplier(isAConstant, isBConstant)
+{
+    m_pQuantizerA = pQuantizerA;
+    m_pQuantizerB = pQuantizerB;
+#if !defined(__aarch64__)
+    m_pBlockMultiplier = make_shared<BlockMultiplierType>();
+#endif
+}
+
+template <class ElemType>
+QuantizedMultiplier<ElemType>::QuantizedMultiplier(bool isAConstant, bool isBConstant)
+    : m_isAConstant(isAConstant), m_isBConstant(isBConstant), m_firstPass(true), m_pPreparedA(nullptr)
+{
+    if (isAConstant && isBConstant)
+        LogicError("Quantized multiplication is applied to two constant matrices -- it is highly inefficient. Better approach is to replace the operation with the resulting matrix.");
+}
+
+template <class ElemType>
+QuantizedMultiplier<ElemType>::~QuantizedMultiplier()
+{
+#if !defined(__aarch64__)
+    if (m_pPreparedA)
+        BlockMultiplierType::FreeMatrix(m_pPreparedA);
+#endif
+}
+
+template <class ElemType>
+void QuantizedMultiplier<ElemType>::Multiply(int m, int n, int k, ElemType* A, ElemType* B, ElemType* C)
+{
+    // Quantize
+    bool quantizeA = !m_isAConstant || m_firstPass;
+    if (quantizeA)
+    {
+        m_pMatA.resize(m*k);
+        ArrayRef<short> refMatA(m_pMatA.data(), m_pMatA.size());
+        m_pQuantizerA->Quantize(ArrayRef<ElemType>(A, m_pMatA.size()), refMatA);
+    }
+
+    if (!m_isBConstant || m_firstPass)
+    {
+        m_pMatB.resize(n*k);
+        ArrayRef<short> refMatB(m_pMatB.data(), m_pMatB.size());
+        m_pQuantizerB->Quantize(ArrayRef<ElemType>(B, m_pMatB.size()), refMatB);
+    }
+
+    m_firstPass = false;
+
+    // Do multiply
+    // The block multiplier accumulates into the product, which therefore has to start out zeroed.
+    m_product.assign((size_t)m * n, 0);
+#if !defined(__aarch64__)
+    if (quantizeA || !m_pPreparedA)
+    {
+        if (m_pPreparedA)
+            BlockMultiplierType::FreeMatrix(m_pPreparedA);
+        m_pPreparedA = m_pBlockMultiplier->PrepareB(m_pMatA.data(), k, m);
+    }
+
+    m_pBlockMultiplier->SetNumThreads(omp_get_max_threads());
+    m_pBlockMultiplier->MultiplyMatrices(m_pMatB.data(), n, k, m_pPreparedA, m, m_product.data());
+#else
+    // No SSE on ARM64, see BlockHandlerSSE.cpp.
+    for (size_t i = 0; i < m; i++)
+        for (size_t j = 0; j < n; j++)
+        {
+            int dotProduct=0;
+            for (size_t l = 0; l < k; l++)
+            {
+                // CNTK is using column-major storage
+                dotProduct += m_pMatA[i + l*m] * m_pMatB[l + k*j];
+            }
+            m_product[i + j*m] = dotProduct;
+        }
+#endif
+
+    // De-quantize
+    int mn = m*n;
+    for (int i = 0; i < mn; i++)
+        C[i] = (ElemType)m_product[i];
+    m_pQuantizerB->Dequantize(C, C, mn);
+    m_pQuantizerA->Dequantize(C, C, mn);
+}
+
+// -----------------------------------------------------------------------
+// Int8QuantizedMultiplier
+// -----------------------------------------------------------------------
+
+static const float Int8Range = 127;
+
+// Quantizes the rows of the column-major A[m,k] into q, with rows stored contiguously and padded to paddedK.
+template <class ElemType>
+static void QuantizeRows(const ElemType* A, int m, int k, int paddedK, vector<int8_t>& q, vector<float>& scales)
+{
+    q.assign((size_t)m * paddedK, 0);
+    scales.resize(m);
+
+    // Rows are processed in blocks, so that reading a column of the block reads whole cache lines.
+    const int rowsPerBlock = 16;
+#pragma omp parallel for
+    for (int firstRow = 0; firstRow < m; firstRow += rowsPerBlock)
+    {
+        int numRows = min(rowsPerBlock, m - firstRow);
+        ElemType absMax[rowsPerBlock] = {};
+        for (int l = 0; l < k; l++)
+        {
+            const ElemType* column = A + firstRow + (size_t)l * m;
+            for (int r = 0; r < numRows; r++)
+                absMax[r] = max(absMax[r], (ElemType)fabs(column[r]));
+        }
+
+        ElemType quantizeFactor[rowsPerBlock];
+        for (int r = 0; r < numRows; r++)
+        {
+            scales[firstRow + r] = (float)(absMax[r] / Int8Range);
+            quantizeFactor[r] = absMax[r] > 0 ? Int8Range / absMax[r] : 0;
+        }
+
+        for (int l = 0; l < k; l++)
+        {
+            const ElemType* column = A + firstRow + (size_t)l * m;
+            for (int r = 0; r < numRows; r++)
+                q[(size_t)(firstRow + r) * paddedK + l] = (int8_t)round(column[r] * quantizeFactor[r]);
+        }
+    }
+}
+
+// Quantizes the columns of the column-major B[k,n] into q, with columns padded to paddedK.
+template <class ElemType>
+static void QuantizeColumns(const ElemType* B, int k, int n, int paddedK, vector<int8_t>& q, vector<float>& scales)
+{
+    q.assign((size_t)n * paddedK, 0);
+    scales.resize(n);
+
+#pragma omp parallel for
+    for (int j = 0; j < n; j++)
+    {
+        const ElemType* column = B + (size_t)j * k;
+        ElemType absMax = 0;
+        for (int l = 0; l < k; l++)
+            absMax = max(absMax, (ElemType)fabs(column[l]));
+
+        scales[j] = (float)(absMax / Int8Range);
+        ElemType quantizeFactor = absMax > 0 ? Int8Range / absMax : 0;
+        int8_t* quantized = q.data() + (size_t)j * paddedK;
+        for (int l = 0; l < k; l++)
+            quantized[l] = (int8_t)round(column[l] * quantizeFactor);
+    }
+}
+
+template <class ElemType>
+Int8QuantizedMultiplier<ElemType>::Int8QuantizedMultiplier(bool isAConstant, bool isBConstant)
+    : QuantizedMultiplier<ElemType>(isAConstant, isBConstant), m_paddedK(0)
+{
+}
+
+template <class ElemType>
+void Int8QuantizedMultiplier<ElemType>::Multiply(int m, int n, int k, ElemType* A, ElemType* B, ElemType* C)
+{
+    m_paddedK = (k + Int8DotProductsPadding - 1) / Int8DotProductsPadding * Int8DotProductsPadding;
+
+    if (!this->m_isAConstant || this->m_firstPass)
+        QuantizeRows(A, m, k, m_paddedK, m_matA, m_scalesA);
+
+    if (!this->m_isBConstant || this->m_firstPass)
+        QuantizeColumns(B, k, n, m_paddedK, m_matB, m_scalesB);
+
+    this->m_firstPass = false;
+
+    m_product.resize((size_t)m * n);
+    if (GetCPUInstructionSet() != CPUInstructionSet::None)
+        Int8DotProductsAVX2(m, n, m_paddedK, m_matA.data(), m_matB.data(), m_product.data());
+    else
+        Int8DotProducts(m, n, m_paddedK, m_matA.data(), m_matB.data(), m_product.data());
+
+    // De-quantize
+#pragma omp parallel for
+    for (int j = 0; j < n; j++)
+    {
+        for (int i = 0; i < m; i++)
+        {
+            size_t index = i + (size_t)j * m;
+            C[index] = (ElemType)(m_product[index] * m_scalesA[i] * m_scalesB[j]);
+        }
+    }
+}
+
+void Int8DotProducts(int m, int n, int k, const int8_t* a, const int8_t* b, int32_t* c)
+{
+#pragma omp parallel for
+    for (int i = 0; i < m; i++)
+    {
+        const int8_t* rowA = a + (size_t)i * k;
+        for (int j = 0; j < n; j++)
+        {
+            const int8_t* rowB = b + (size_t)j * k;
+            int32_t dotProduct = 0;
+            for (int l = 0; l < k; l++)
+                dotProduct += rowA[l] * rowB[l];
+            c[i + (size_t)j * m] = dotProduct;
+        }
+    }
+}
+
+template class QuantizedMultiplier<float>;
+template class QuantizedMultiplier<double>;
+template class Int8QuantizedMultiplier<float>;
+template class Int8QuantizedMultiplier<double>;
+
+}}}
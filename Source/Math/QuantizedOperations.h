@@ -4,22 +4,42 @@
 //
 #pragma once
 #include "Quantizers.h"
+#include "CommonMatrix.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+template <typename BlockHandlerT> class BlockMultiplier;
+class BlockHandlerSSE;
+class BlockHandlerAVX;
 
 // Quantized product of two dense matrices A and B, where each matrix has its own quantizer.
 // This class handles quantization of both matrices, product and de-quantization of the result.
-// Other implementations should inherit from this class or extract common methods to the base class and inherit from the base.
+// The integer product is computed by the BlockMultiplier (SSE, or AVX2 in builds with SUPPORT_AVX2). A constant matrix (i.e. weights)
+// is only quantized on the first pass, and if it is A, it is also only rewritten once into the block order of the multiplier.
+// Other implementations should inherit from this class and override Multiply().
 template <class ElemType>
-class QuantizedMultiplier
+class MATH_API QuantizedMultiplier
 {
-    // Quantizers for matrices A and B
-    shared_ptr<QuantizerBase<ElemType, short>> m_pQuantizerA;
-    shared_ptr<QuantizerBase<ElemType, short>> m_pQuantizerB;
+public:
+    QuantizedMultiplier(shared_ptr<QuantizerBase<ElemType, short>> pQuantizerA, bool isAConstant, shared_ptr<QuantizerBase<ElemType, short>> pQuantizerB, bool isBConstant);
+    QuantizedMultiplier(shared_ptr<QuantizerBase<ElemType, short>> pQuantizerA, shared_ptr<QuantizerBase<ElemType, short>> pQuantizerB) :
+        QuantizedMultiplier(pQuantizerA, false, pQuantizerB, false)
+    {
+    };
+    virtual ~QuantizedMultiplier();
 
-    // Placeholders for quantized matrices A and B
-    vector<short> m_pMatA, m_pMatB;
+    // A[m,k]*B[k,n] = C[m,n]
+    virtual void Multiply(int m, int n, int k, ElemType* A, ElemType* B, ElemType* C);
+
+    void SetIsAConstant(bool v) { m_isAConstant = v; }
+    void SetIsBConstant(bool v) { m_isBConstant = v; }
+
+protected:
+    // For implementations that quantize the matrices on their own.
+    QuantizedMultiplier(bool isAConstant, bool isBConstant);
 
     // Whether matrices A and B are constant (i.e. weights)
     // If the matrix is constant, the size of the underlying container for quatized values will be preserved for
@@ -29,61 +49,57 @@ class QuantizedMultiplier
 
     bool m_firstPass;
 
-public: 
-    QuantizedMultiplier(shared_ptr<QuantizerBase<ElemType, short>> pQuantizerA, bool isAConstant, shared_ptr<QuantizerBase<ElemType, short>> pQuantizerB, bool isBConstant) :
-        m_pQuantizerA(pQuantizerA), m_pQuantizerB(pQuantizerB), m_isAConstant(isAConstant), m_isBConstant(isBConstant), m_firstPass(true)
-    {
-        if (isAConstant && isBConstant)
-            LogicError("Quantized multiplication is applied to two constant matrices -- it is highly inefficient. Better approach is to replace the operation with the resulting matrix.");
-    };
-    QuantizedMultiplier(shared_ptr<QuantizerBase<ElemType, short>> pQuantizerA, shared_ptr<QuantizerBase<ElemType, short>> pQuantizerB) :
-        QuantizedMultiplier(pQuantizerA, false, pQuantizerB, false)
-    {
-    };
+private:
+#ifdef SUPPORT_AVX2
+    typedef BlockMultiplier<BlockHandlerAVX> BlockMultiplierType;
+#else
+    typedef BlockMultiplier<BlockHandlerSSE> BlockMultiplierType;
+#endif
+
+    // Quantizers for matrices A and B
+    shared_ptr<QuantizerBase<ElemType, short>> m_pQuantizerA;
+    shared_ptr<QuantizerBase<ElemType, short>> m_pQuantizerB;
+
+    // Placeholders for quantized matrices A and B
+    vector<short> m_pMatA, m_pMatB;
+
+    // The block multiplier computes C' = B' * A', where B' and A' are the memory of B and A read as row-major,
+    // i.e. the transposes of B and A; C' is then the column-major C. A' is rewritten in block order (m_pPreparedA).
+    shared_ptr<BlockMultiplierType> m_pBlockMultiplier;
+    short* m_pPreparedA;
+
+    // Integer product, column-major C[m,n]
+    vector<int32_t> m_product;
+};
+
+// 8-bit quantized product of two dense matrices A and B.
+// Each row of A and each column of B is quantized to [-127, 127] with its own scale (its absolute maximum / 127),
+// i.e. C[i,j] = scaleA[i] * scaleB[j] * sum_l qA[i,l] * qB[l,j]. Since the scales follow the data, there is no bit shift to tune,
+// and the 32-bit sums do not overflow for any practical k.
+// The dot products use AVX2 byte multiply-adds (vpmaddubsw/vpmaddwd, the two-instruction form of VNNI's vpdpbusd) if the CPU
+// supports them (see TensorOpsSIMD.h), and scalar code otherwise.
+template <class ElemType>
+class MATH_API Int8QuantizedMultiplier : public QuantizedMultiplier<ElemType>
+{
+public:
+    Int8QuantizedMultiplier(bool isAConstant = false, bool isBConstant = false);
 
     // A[m,k]*B[k,n] = C[m,n]
-    void Multiply(int m, int n, int k, ElemType* A, ElemType* B, ElemType* C)
-    {
-        // Quantize
-        if (!m_isAConstant || m_firstPass)
-        {
-            m_pMatA.resize(m*k);
-            ArrayRef<short> refMatA(m_pMatA.data(), m_pMatA.size());
-            m_pQuantizerA->Quantize(ArrayRef<ElemType>(A, m_pMatA.size()), refMatA);
-        }
-        
-        if (!m_isBConstant || m_firstPass)
-        {
-            m_pMatB.resize(n*k);
-            ArrayRef<short> refMatB(m_pMatB.data(), m_pMatB.size());
-            m_pQuantizerB->Quantize(ArrayRef<ElemType>(B, m_pMatB.size()), refMatB);
-        }
-
-        m_firstPass = false;
-
-        // Do multiply
-        // Naive inefficient product, just for demonstation
-        // TODO: replace with an efficient version, e.g. IPG, block multiplier, Eigen, gemmlowp, etc.
-        for (size_t i = 0; i < m; i++)
-            for (size_t j = 0; j < n; j++)
-            {
-                int dotProduct=0;
-                for (size_t l = 0; l < k; l++)
-                {
-                    // CNTK is using column-major storage
-                    dotProduct += m_pMatA[i + l*m] * m_pMatB[l + k*j];
-                }
-                C[i + j*m] = (ElemType)dotProduct;
-            }
-
-        // De-quantize
-        int mn = m*n;
-        m_pQuantizerB->Dequantize(C, C, mn);
-        m_pQuantizerA->Dequantize(C, C, mn);
-    }
+    virtual void Multiply(int m, int n, int k, ElemType* A, ElemType* B, ElemType* C) override;
 
-    void SetIsAConstant(bool v) { m_isAConstant = v; }
-    void SetIsBConstant(bool v) { m_isBConstant = v; }
+private:
+    // Rows of A and columns of B, each padded with zeros to m_paddedK values
+    vector<int8_t> m_matA, m_matB;
+    vector<float> m_scalesA, m_scalesB;
+    vector<int32_t> m_product;
+    int m_paddedK;
 };
 
-}}}
\ No newline at end of file
+// Dot products of the rows of a and b, stored contiguously and padded to k, a multiple of Int8DotProductsPadding:
+//     c[i + j * m] = sum_l a[i * k + l] * b[j * k + l]    for i < m, j < n
+// Values must be in [-127, 127]. Implemented in QuantizedOperations.cpp (scalar) and QuantizedOperationsAVX2.cpp.
+static const int Int8DotProductsPadding = 32;
+void Int8DotProducts(int m, int n, int k, const int8_t* a, const int8_t* b, int32_t* c);
+void Int8DotProductsAVX2(int m, int n, int k, const int8_t* a, const int8_t* b, int32_t* c);
+
+}}}
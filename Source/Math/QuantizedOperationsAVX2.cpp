@@ -0,0 +1,111 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// AVX2 kernel of the 8-bit quantized product (Int8QuantizedMultiplier in QuantizedOperations.h).
+// This file is compiled with AVX2 code generation enabled (see Makefile). Its kernel is only ever
+// called after GetSupportedCPUInstructionSet() has confirmed that the CPU supports it.
+//
+
+#include "stdafx.h"
+#include "QuantizedOperations.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+
+#include <immintrin.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+namespace {
+
+// Adds the products of the 32 signed bytes of a and b, summed in groups of four, to the 8 lanes of sum.
+// vpmaddubsw multiplies unsigned by signed bytes, so the sign of a is moved to b. Since the values are in [-127, 127],
+// the pairwise sums of vpmaddubsw are at most 2 * 127 * 127 and do not saturate.
+inline __m256i MultiplyAdd(__m256i sum, __m256i a, __m256i b, __m256i ones)
+{
+    __m256i pairs = _mm256_maddubs_epi16(_mm256_sign_epi8(a, a), _mm256_sign_epi8(b, a));
+    return _mm256_add_epi32(sum, _mm256_madd_epi16(pairs, ones));
+}
+
+inline int32_t HorizontalSum(__m256i v)
+{
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+
+}
+
+void Int8DotProductsAVX2(int m, int n, int k, const int8_t* a, const int8_t* b, int32_t* c)
+{
+    assert(k % Int8DotProductsPadding == 0);
+    const __m256i ones = _mm256_set1_epi16(1);
+
+    // Four rows of a at a time (which stay in L1 while all rows of b stream by), each loaded row of b is used four times.
+    const int rowsPerBlock = 4;
+    int numBlocks = (m + rowsPerBlock - 1) / rowsPerBlock;
+#pragma omp parallel for
+    for (int block = 0; block < numBlocks; block++)
+    {
+        int firstRow = block * rowsPerBlock;
+        const int8_t* rowA0 = a + (size_t)firstRow * k;
+        if (firstRow + rowsPerBlock <= m)
+        {
+            const int8_t* rowA1 = rowA0 + k;
+            const int8_t* rowA2 = rowA1 + k;
+            const int8_t* rowA3 = rowA2 + k;
+            for (int j = 0; j < n; j++)
+            {
+                const int8_t* rowB = b + (size_t)j * k;
+                __m256i sum0 = _mm256_setzero_si256();
+                __m256i sum1 = _mm256_setzero_si256();
+                __m256i sum2 = _mm256_setzero_si256();
+                __m256i sum3 = _mm256_setzero_si256();
+                for (int l = 0; l < k; l += 32)
+                {
+                    __m256i vb = _mm256_loadu_si256((const __m256i*)(rowB + l));
+                    sum0 = MultiplyAdd(sum0, _mm256_loadu_si256((const __m256i*)(rowA0 + l)), vb, ones);
+                    sum1 = MultiplyAdd(sum1, _mm256_loadu_si256((const __m256i*)(rowA1 + l)), vb, ones);
+                    sum2 = MultiplyAdd(sum2, _mm256_loadu_si256((const __m256i*)(rowA2 + l)), vb, ones);
+                    sum3 = MultiplyAdd(sum3, _mm256_loadu_si256((const __m256i*)(rowA3 + l)), vb, ones);
+                }
+                int32_t* column = c + firstRow + (size_t)j * m;
+                column[0] = HorizontalSum(sum0);
+                column[1] = HorizontalSum(sum1);
+                column[2] = HorizontalSum(sum2);
+                column[3] = HorizontalSum(sum3);
+            }
+        }
+        else // last, partial block
+        {
+            for (int i = firstRow; i < m; i++)
+            {
+                const int8_t* rowA = a + (size_t)i * k;
+                for (int j = 0; j < n; j++)
+                {
+                    const int8_t* rowB = b + (size_t)j * k;
+                    __m256i sum = _mm256_setzero_si256();
+                    for (int l = 0; l < k; l += 32)
+                        sum = MultiplyAdd(sum, _mm256_loadu_si256((const __m256i*)(rowA + l)), _mm256_loadu_si256((const __m256i*)(rowB + l)), ones);
+                    c[i + (size_t)j * m] = HorizontalSum(sum);
+                }
+            }
+        }
+    }
+}
+
+}}}
+
+#else // no AVX2 on this architecture
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+void Int8DotProductsAVX2(int m, int n, int k, const int8_t* a, const int8_t* b, int32_t* c)
+{
+    Int8DotProducts(m, n, k, a, b, c);
+}
+
+}}}
+
+#endif
@@ -0,0 +1,94 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// AVX2 + FMA instantiation of the vectorized elementwise tensor kernels (TensorOpsSIMDKernels.h).
+// This file is compiled with AVX2/FMA code generation enabled (see Makefile). Its kernels are only ever
+// called after GetSupportedCPUInstructionSet() has confirmed that the CPU supports them.
+//
+
+#include "stdafx.h"
+#include "TensorOpsSIMD.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+
+#include <immintrin.h>
+#include "TensorOpsSIMDKernels.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+namespace {
+
+struct AVX2Traits
+{
+    typedef __m256 Reg;
+    typedef __m256 Mask;
+    static const size_t width = 8;
+
+    static inline Reg Load(const float* p) { return _mm256_loadu_ps(p); }
+    static inline void Store(float* p, Reg a) { _mm256_storeu_ps(p, a); }
+    static inline Reg Set1(float f) { return _mm256_set1_ps(f); }
+
+    static inline Reg Add(Reg a, Reg b) { return _mm256_add_ps(a, b); }
+    static inline Reg Sub(Reg a, Reg b) { return _mm256_sub_ps(a, b); }
+    static inline Reg Mul(Reg a, Reg b) { return _mm256_mul_ps(a, b); }
+    static inline Reg Div(Reg a, Reg b) { return _mm256_div_ps(a, b); }
+    static inline Reg Min(Reg a, Reg b) { return _mm256_min_ps(a, b); }
+    static inline Reg Max(Reg a, Reg b) { return _mm256_max_ps(a, b); }
+    static inline Reg Fmadd(Reg a, Reg b, Reg c) { return _mm256_fmadd_ps(a, b, c); }
+    static inline Reg Fnmadd(Reg a, Reg b, Reg c) { return _mm256_fnmadd_ps(a, b, c); }
+    static inline Reg Sqrt(Reg a) { return _mm256_sqrt_ps(a); }
+    static inline Reg Floor(Reg a) { return _mm256_floor_ps(a); }
+    static inline Reg And(Reg a, Reg b) { return _mm256_and_ps(a, b); }
+    static inline Reg Or(Reg a, Reg b) { return _mm256_or_ps(a, b); }
+    static inline Reg Abs(Reg a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static inline Reg Negate(Reg a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+
+    static inline Mask CmpLT(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static inline Mask CmpLE(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static inline Mask CmpGT(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static inline Mask CmpGE(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static inline Mask CmpEQ(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    static inline Mask CmpNE(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ); }
+    static inline Mask MaskAnd(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+    static inline Mask MaskOr(Mask a, Mask b) { return _mm256_or_ps(a, b); }
+    static inline Mask MaskXor(Mask a, Mask b) { return _mm256_xor_ps(a, b); }
+    static inline Reg Select(Mask m, Reg t, Reg f) { return _mm256_blendv_ps(f, t, m); }
+
+    // 2^n by constructing the exponent field directly
+    static inline Reg Pow2n(Reg n)
+    {
+        __m256i e = _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(0x7f));
+        return _mm256_castsi256_ps(_mm256_slli_epi32(e, 23));
+    }
+
+    static inline Reg Frexp(Reg x, Reg& e)
+    {
+        __m256i bits = _mm256_castps_si256(x);
+        e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(0x7e)));
+        bits = _mm256_and_si256(bits, _mm256_set1_epi32(~0x7f800000));
+        return _mm256_or_ps(_mm256_castsi256_ps(bits), _mm256_set1_ps(0.5f));
+    }
+};
+
+}
+
+SIMDElementwiseKernel GetAVX2ElementwiseKernel(ElementWiseOperator op, size_t numInputs, unsigned int broadcastMask)
+{
+    return SIMD::GetElementwiseKernel<AVX2Traits>(op, numInputs, broadcastMask);
+}
+
+}}}
+
+#else // no AVX2 on this architecture
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+SIMDElementwiseKernel GetAVX2ElementwiseKernel(ElementWiseOperator, size_t, unsigned int)
+{
+    return nullptr;
+}
+
+}}}
+
+#endif
@@ -0,0 +1,95 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// AVX-512 instantiation of the vectorized elementwise tensor kernels (TensorOpsSIMDKernels.h).
+// This file is compiled with AVX-512F code generation enabled (see Makefile). Its kernels are only ever
+// called after GetSupportedCPUInstructionSet() has confirmed that the CPU supports them.
+//
+
+#include "stdafx.h"
+#include "TensorOpsSIMD.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+
+#include <immintrin.h>
+#include "TensorOpsSIMDKernels.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+namespace {
+
+struct AVX512Traits
+{
+    typedef __m512 Reg;
+    typedef __mmask16 Mask;
+    static const size_t width = 16;
+
+    static inline Reg Load(const float* p) { return _mm512_loadu_ps(p); }
+    static inline void Store(float* p, Reg a) { _mm512_storeu_ps(p, a); }
+    static inline Reg Set1(float f) { return _mm512_set1_ps(f); }
+
+    static inline Reg Add(Reg a, Reg b) { return _mm512_add_ps(a, b); }
+    static inline Reg Sub(Reg a, Reg b) { return _mm512_sub_ps(a, b); }
+    static inline Reg Mul(Reg a, Reg b) { return _mm512_mul_ps(a, b); }
+    static inline Reg Div(Reg a, Reg b) { return _mm512_div_ps(a, b); }
+    static inline Reg Min(Reg a, Reg b) { return _mm512_min_ps(a, b); }
+    static inline Reg Max(Reg a, Reg b) { return _mm512_max_ps(a, b); }
+    static inline Reg Fmadd(Reg a, Reg b, Reg c) { return _mm512_fmadd_ps(a, b, c); }
+    static inline Reg Fnmadd(Reg a, Reg b, Reg c) { return _mm512_fnmadd_ps(a, b, c); }
+    static inline Reg Sqrt(Reg a) { return _mm512_sqrt_ps(a); }
+    static inline Reg Floor(Reg a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+    // AVX-512F has no float bitwise ops (those are AVX-512DQ), so go through the integer domain
+    static inline Reg And(Reg a, Reg b) { return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a), _mm512_castps_si512(b))); }
+    static inline Reg Or(Reg a, Reg b) { return _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(a), _mm512_castps_si512(b))); }
+    static inline Reg Abs(Reg a) { return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x7fffffff))); }
+    static inline Reg Negate(Reg a) { return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x80000000))); }
+
+    static inline Mask CmpLT(Reg a, Reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static inline Mask CmpLE(Reg a, Reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+    static inline Mask CmpGT(Reg a, Reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static inline Mask CmpGE(Reg a, Reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+    static inline Mask CmpEQ(Reg a, Reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+    static inline Mask CmpNE(Reg a, Reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_NEQ_UQ); }
+    static inline Mask MaskAnd(Mask a, Mask b) { return (Mask) (a & b); }
+    static inline Mask MaskOr(Mask a, Mask b) { return (Mask) (a | b); }
+    static inline Mask MaskXor(Mask a, Mask b) { return (Mask) (a ^ b); }
+    static inline Reg Select(Mask m, Reg t, Reg f) { return _mm512_mask_blend_ps(m, f, t); }
+
+    // 2^n by constructing the exponent field directly
+    static inline Reg Pow2n(Reg n)
+    {
+        __m512i e = _mm512_add_epi32(_mm512_cvtps_epi32(n), _mm512_set1_epi32(0x7f));
+        return _mm512_castsi512_ps(_mm512_slli_epi32(e, 23));
+    }
+
+    static inline Reg Frexp(Reg x, Reg& e)
+    {
+        __m512i bits = _mm512_castps_si512(x);
+        e = _mm512_cvtepi32_ps(_mm512_sub_epi32(_mm512_srli_epi32(bits, 23), _mm512_set1_epi32(0x7e)));
+        bits = _mm512_and_si512(bits, _mm512_set1_epi32(~0x7f800000));
+        return _mm512_castsi512_ps(_mm512_or_si512(bits, _mm512_castps_si512(_mm512_set1_ps(0.5f))));
+    }
+};
+
+}
+
+SIMDElementwiseKernel GetAVX512ElementwiseKernel(ElementWiseOperator op, size_t numInputs, unsigned int broadcastMask)
+{
+    return SIMD::GetElementwiseKernel<AVX512Traits>(op, numInputs, broadcastMask);
+}
+
+}}}
+
+#else // no AVX-512 on this architecture
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+SIMDElementwiseKernel GetAVX512ElementwiseKernel(ElementWiseOperator, size_t, unsigned int)
+{
+    return nullptr;
+}
+
+}}}
+
+#endif
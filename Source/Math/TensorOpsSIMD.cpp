@@ -0,0 +1,86 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Runtime CPU feature detection and kernel dispatch for the vectorized elementwise tensor kernels.
+// The kernels themselves live in TensorOpsAVX2.cpp and TensorOpsAVX512.cpp, which are the only files
+// compiled with the respective instruction sets enabled.
+//
+
+#include "stdafx.h"
+#include "TensorOpsSIMD.h"
+#include <atomic>
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static CPUInstructionSet DetectCPUInstructionSet()
+{
+#if defined(_M_X64) || defined(__x86_64__)
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return CPUInstructionSet::None;
+    __cpuid(info, 1);
+    const bool fma = (info[2] & (1 << 12)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave)
+        return CPUInstructionSet::None;
+    // the OS must save the YMM (and for AVX-512 the ZMM/opmask) state on context switches
+    const unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    const bool avx2 = (info[1] & (1 << 5)) != 0 && fma && (xcr0 & 0x06) == 0x06;
+    const bool avx512f = (info[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6;
+#else
+    // note: these also check that the OS has enabled the extended register state
+    __builtin_cpu_init();
+    const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    const bool avx512f = __builtin_cpu_supports("avx512f");
+#endif
+    if (avx512f && avx2)
+        return CPUInstructionSet::AVX512;
+    if (avx2)
+        return CPUInstructionSet::AVX2;
+#endif
+    return CPUInstructionSet::None;
+}
+
+CPUInstructionSet GetSupportedCPUInstructionSet()
+{
+    static const CPUInstructionSet supported = DetectCPUInstructionSet();
+    return supported;
+}
+
+static std::atomic<int> s_cpuInstructionSet((int) GetSupportedCPUInstructionSet());
+
+CPUInstructionSet GetCPUInstructionSet()
+{
+    return (CPUInstructionSet) s_cpuInstructionSet.load();
+}
+
+CPUInstructionSet SetCPUInstructionSet(CPUInstructionSet instructionSet)
+{
+    if ((int) instructionSet > (int) GetSupportedCPUInstructionSet())
+        instructionSet = GetSupportedCPUInstructionSet();
+    s_cpuInstructionSet = (int) instructionSet;
+    return instructionSet;
+}
+
+SIMDElementwiseKernel GetSIMDElementwiseKernel(ElementWiseOperator op, size_t numInputs, unsigned int broadcastMask)
+{
+    switch (GetCPUInstructionSet())
+    {
+    case CPUInstructionSet::AVX512:
+        return GetAVX512ElementwiseKernel(op, numInputs, broadcastMask);
+    case CPUInstructionSet::AVX2:
+        return GetAVX2ElementwiseKernel(op, numInputs, broadcastMask);
+    default:
+        return nullptr;
+    }
+}
+
+}}}
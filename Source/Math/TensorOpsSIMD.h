@@ -0,0 +1,52 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Explicitly vectorized CPU kernels for the elementwise TensorView operations (TensorOps.h).
+//
+// The generic CPU tensor path (CPUMatrix::TensorOp()) calls a lambda per element and relies on the compiler
+// to auto-vectorize it, which in practice does not happen. This provides hand-vectorized AVX2/AVX-512 versions
+// of the ForAllUnaryOps/ForAllBinaryOps/ForAllTernaryOps families for one innermost row of a tensor op.
+// The instruction set is selected at runtime from the CPU's capabilities, so one binary runs everywhere.
+//
+
+#pragma once
+
+#include "CommonMatrix.h"
+#include <cstddef>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// instruction-set extensions the CPU tensor kernels can be dispatched to, in increasing order
+enum class CPUInstructionSet : int
+{
+    None = 0,   // no hand-vectorized kernels; use the generic lambda-based loops
+    AVX2 = 1,   // AVX2 + FMA, 8 floats per register
+    AVX512 = 2, // AVX-512F, 16 floats per register
+};
+
+// highest instruction set that this build has kernels for and that the CPU we are running on supports
+MATH_API CPUInstructionSet GetSupportedCPUInstructionSet();
+
+// instruction set currently used by the CPU tensor kernels (by default the supported one)
+MATH_API CPUInstructionSet GetCPUInstructionSet();
+
+// restrict the CPU tensor kernels to a lower instruction set, e.g. to compare against the scalar path
+// Requests above the supported instruction set are clamped. Returns the instruction set actually selected.
+MATH_API CPUInstructionSet SetCPUInstructionSet(CPUInstructionSet instructionSet);
+
+// A vectorized kernel computes one contiguous output row
+//   c[i] = beta * c[i] + alpha * op(inputs[0][i * s0], inputs[1][i * s1], ...)  for i in [0, n)
+// where each input stride sj is either 1 (contiguous) or 0 (broadcast), as baked into the kernel.
+// If beta == 0, c is not read.
+typedef void (*SIMDElementwiseKernel)(size_t n, float beta, const float* const* inputs, float alpha, float* c);
+
+// Bit j of 'broadcastMask' is set if input j has stride 0 along the row.
+// Returns nullptr if there is no vectorized kernel for this op (e.g. sin/cos) or no usable instruction set.
+MATH_API SIMDElementwiseKernel GetSIMDElementwiseKernel(ElementWiseOperator op, size_t numInputs, unsigned int broadcastMask);
+
+// per-instruction-set kernel tables, implemented in TensorOpsAVX2.cpp and TensorOpsAVX512.cpp
+SIMDElementwiseKernel GetAVX2ElementwiseKernel(ElementWiseOperator op, size_t numInputs, unsigned int broadcastMask);
+SIMDElementwiseKernel GetAVX512ElementwiseKernel(ElementWiseOperator op, size_t numInputs, unsigned int broadcastMask);
+
+}}}
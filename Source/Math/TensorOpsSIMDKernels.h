@@ -0,0 +1,421 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Instruction-set independent implementation of the vectorized elementwise kernels declared in TensorOpsSIMD.h.
+//
+// This file is included by TensorOpsAVX2.cpp and TensorOpsAVX512.cpp only. Each of them compiles it with its own
+// target flags and its own vector traits class V (declared in an anonymous namespace), which provides
+//  - Reg/Mask types, 'width' (floats per register)
+//  - Load/Store/Set1, Add/Sub/Mul/Div/Fmadd/Fnmadd, Sqrt/Floor/Abs/Negate, bitwise And/Or
+//  - ordered comparisons CmpLT/LE/GT/GE/EQ and unordered CmpNE yielding a Mask, MaskAnd/MaskOr/MaskXor, Select
+//  - Pow2n(n) = 2^n for integral n, and Frexp(x, e) (mantissa in [0.5, 1) and exponent, like frexpf())
+// Everything below is templated on V and has internal linkage, so code compiled for different instruction sets
+// can never be merged by the linker.
+//
+
+#pragma once
+
+#include "TensorOpsSIMD.h"
+#include "CommonMatrix.h"
+#include <math.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace SIMD {
+
+// -----------------------------------------------------------------------
+// vectorized math functions
+// Cephes single-precision polynomials (the same ones as used by sse_mathfun), accurate to a few ulp.
+// -----------------------------------------------------------------------
+
+template <class V>
+static inline typename V::Reg Exp(typename V::Reg x)
+{
+    // clamp to a range beyond which the result is +inf or 0 anyway (operand order lets NaNs pass through)
+    x = V::Min(V::Set1(89.0f), x);
+    x = V::Max(V::Set1(-110.0f), x);
+    // exp(x) = 2^n * exp(g), n = round(x / log(2)), with log(2) split in two for extra precision
+    auto n = V::Floor(V::Fmadd(x, V::Set1(1.44269504088896341f), V::Set1(0.5f)));
+    // 2^n is applied in two factors where it is out of the range of normalized floats, so that the result overflows
+    // to +inf or is rounded to a denormal or 0, like expf()
+    auto big = V::CmpGT(n, V::Set1(100.0f));
+    auto tiny = V::CmpLT(n, V::Set1(-100.0f));
+    auto s = V::Select(big, V::Set1(40.0f), V::Select(tiny, V::Set1(-40.0f), V::Set1(0.0f)));
+    auto scale = V::Select(big, V::Set1(1099511627776.0f /*2^40*/), V::Select(tiny, V::Set1(9.094947017729282e-13f /*2^-40*/), V::Set1(1.0f)));
+    x = V::Fnmadd(n, V::Set1(0.693359375f), x);
+    x = V::Fnmadd(n, V::Set1(-2.12194440e-4f), x);
+    auto y = V::Set1(1.9875691500E-4f);
+    y = V::Fmadd(y, x, V::Set1(1.3981999507E-3f));
+    y = V::Fmadd(y, x, V::Set1(8.3334519073E-3f));
+    y = V::Fmadd(y, x, V::Set1(4.1665795894E-2f));
+    y = V::Fmadd(y, x, V::Set1(1.6666665459E-1f));
+    y = V::Fmadd(y, x, V::Set1(5.0000001201E-1f));
+    y = V::Fmadd(y, V::Mul(x, x), V::Add(x, V::Set1(1.0f)));
+    return V::Mul(V::Mul(y, V::Pow2n(V::Sub(n, s))), scale);
+}
+
+// natural logarithm for normalized x > 0 (callers take care of x <= 0)
+template <class V>
+static inline typename V::Reg Log(typename V::Reg x)
+{
+    const auto x0 = x;
+    typename V::Reg e;
+    x = V::Frexp(x, e); // x in [0.5, 1)
+    // if x < sqrt(1/2) use 2x - 1 and decrement e, otherwise x - 1
+    auto small = V::CmpLT(x, V::Set1(0.707106781186547524f));
+    e = V::Sub(e, V::Select(small, V::Set1(1.0f), V::Set1(0.0f)));
+    x = V::Add(V::Sub(x, V::Set1(1.0f)), V::Select(small, x, V::Set1(0.0f)));
+    auto z = V::Mul(x, x);
+    auto y = V::Set1(7.0376836292E-2f);
+    y = V::Fmadd(y, x, V::Set1(-1.1514610310E-1f));
+    y = V::Fmadd(y, x, V::Set1(1.1676998740E-1f));
+    y = V::Fmadd(y, x, V::Set1(-1.2420140846E-1f));
+    y = V::Fmadd(y, x, V::Set1(1.4249322787E-1f));
+    y = V::Fmadd(y, x, V::Set1(-1.6668057665E-1f));
+    y = V::Fmadd(y, x, V::Set1(2.0000714765E-1f));
+    y = V::Fmadd(y, x, V::Set1(-2.4999993993E-1f));
+    y = V::Fmadd(y, x, V::Set1(3.3333331174E-1f));
+    y = V::Mul(V::Mul(y, x), z);
+    y = V::Fmadd(e, V::Set1(-2.12194440e-4f), y);
+    y = V::Fnmadd(z, V::Set1(0.5f), y);
+    x = V::Add(x, y);
+    x = V::Fmadd(e, V::Set1(0.693359375f), x);
+    // NaN and +inf map to themselves
+    return V::Select(V::MaskOr(V::CmpNE(x0, x0), V::CmpEQ(x0, V::Set1(HUGE_VALF))), x0, x);
+}
+
+template <class V>
+static inline typename V::Reg Tanh(typename V::Reg x)
+{
+    auto ax = V::Abs(x);
+    // small arguments: odd polynomial, avoids the cancellation in 1 - 2/(e^2x + 1)
+    auto z = V::Mul(x, x);
+    auto p = V::Set1(-5.70498872745E-3f);
+    p = V::Fmadd(p, z, V::Set1(2.06390887954E-2f));
+    p = V::Fmadd(p, z, V::Set1(-5.37397155531E-2f));
+    p = V::Fmadd(p, z, V::Set1(1.33314422036E-1f));
+    p = V::Fmadd(p, z, V::Set1(-3.33332819422E-1f));
+    auto small = V::Fmadd(V::Mul(p, z), x, x);
+    // large arguments: 1 - 2/(e^2|x| + 1), with the sign of x
+    auto large = V::Sub(V::Set1(1.0f), V::Div(V::Set1(2.0f), V::Add(Exp<V>(V::Add(ax, ax)), V::Set1(1.0f))));
+    large = V::Or(large, V::And(x, V::Set1(-0.0f)));
+    return V::Select(V::CmpLT(ax, V::Set1(0.625f)), small, large);
+}
+
+// same formula as Sigmoid() in TensorOps.h
+template <class V>
+static inline typename V::Reg Sigmoid(typename V::Reg x)
+{
+    return V::Div(V::Set1(1.0f), V::Add(Exp<V>(V::Negate(x)), V::Set1(1.0f)));
+}
+
+template <class V>
+static inline typename V::Reg FromMask(typename V::Mask m)
+{
+    return V::Select(m, V::Set1(1.0f), V::Set1(0.0f));
+}
+
+// -----------------------------------------------------------------------
+// elementwise operations
+// One struct per ElementWiseOperator, mirroring the scalar definitions in TensorOps.h.
+// -----------------------------------------------------------------------
+
+#pragma push_macro("DefUnaryOp")
+#define DefUnaryOp(op, expr)                        \
+    template <class V>                              \
+    struct Op##op                                   \
+    {                                               \
+        typedef typename V::Reg Reg;                \
+        static const size_t arity = 1;              \
+        static inline Reg Apply(Reg a) { return expr; } \
+    }
+
+DefUnaryOp(Copy, a);
+DefUnaryOp(Negate, V::Negate(a));
+DefUnaryOp(Not, FromMask<V>(V::CmpEQ(a, V::Set1(0.0f))));
+DefUnaryOp(Abs, V::Abs(a));
+DefUnaryOp(Floor, V::Floor(a));
+DefUnaryOp(Reciprocal, V::Select(V::CmpEQ(a, V::Set1(0.0f)), V::Set1(0.0f), V::Div(V::Set1(1.0f), a)));
+DefUnaryOp(Sigmoid, Sigmoid<V>(a));
+DefUnaryOp(Tanh, Tanh<V>(a));
+DefUnaryOp(Sqr, V::Mul(a, a));
+DefUnaryOp(Sqrt, V::Sqrt(V::Select(V::CmpGT(a, V::Set1(0.0f)), a, V::Set1(0.0f))));
+DefUnaryOp(Exp, Exp<V>(a));
+DefUnaryOp(Log, V::Select(V::CmpLT(a, V::Set1(EPS_IN_LOG)), V::Set1(LOG_OF_EPS_IN_LOG), Log<V>(a)));
+DefUnaryOp(LinearRectifier, V::Select(V::CmpGT(a, V::Set1(0.0f)), a, V::Set1(0.0f)));
+#pragma pop_macro("DefUnaryOp")
+
+#pragma push_macro("DefBinaryOp")
+#define DefBinaryOp(op, expr)                              \
+    template <class V>                                     \
+    struct Op##op                                          \
+    {                                                      \
+        typedef typename V::Reg Reg;                       \
+        static const size_t arity = 2;                     \
+        static inline Reg Apply(Reg a, Reg b) { return expr; } \
+    }
+
+DefBinaryOp(CopyIf, V::Select(V::CmpNE(a, V::Set1(0.0f)), b, V::Set1(0.0f)));
+DefBinaryOp(CopyIfNot, V::Select(V::CmpEQ(a, V::Set1(0.0f)), b, V::Set1(0.0f)));
+DefBinaryOp(Sum, V::Add(a, b));
+DefBinaryOp(Difference, V::Sub(a, b));
+DefBinaryOp(ElementwiseProduct, V::Mul(a, b));
+DefBinaryOp(ElementwiseQuotient, V::Div(a, V::Select(V::CmpLT(V::Abs(b), V::Set1(EPS_IN_INVERSE)),
+                                                      V::Select(V::CmpGT(b, V::Set1(0.0f)), V::Set1(EPS_IN_INVERSE), V::Set1(-EPS_IN_INVERSE)), b)));
+DefBinaryOp(Max, V::Select(V::CmpGT(a, b), a, b));
+DefBinaryOp(Min, V::Select(V::CmpLT(a, b), a, b));
+DefBinaryOp(Equal, FromMask<V>(V::CmpEQ(a, b)));
+DefBinaryOp(NotEqual, FromMask<V>(V::CmpNE(a, b)));
+DefBinaryOp(Greater, FromMask<V>(V::CmpGT(a, b)));
+DefBinaryOp(Less, FromMask<V>(V::CmpLT(a, b)));
+DefBinaryOp(GreaterEqual, FromMask<V>(V::CmpGE(a, b)));
+DefBinaryOp(LessEqual, FromMask<V>(V::CmpLE(a, b)));
+DefBinaryOp(And, FromMask<V>(V::MaskAnd(V::CmpNE(a, V::Set1(0.0f)), V::CmpNE(b, V::Set1(0.0f)))));
+DefBinaryOp(Or, FromMask<V>(V::MaskOr(V::CmpNE(a, V::Set1(0.0f)), V::CmpNE(b, V::Set1(0.0f)))));
+DefBinaryOp(Xor, FromMask<V>(V::MaskXor(V::CmpNE(a, V::Set1(0.0f)), V::CmpNE(b, V::Set1(0.0f)))));
+DefBinaryOp(MaskNegative, V::Select(V::CmpGE(b, V::Set1(0.0f)), a, V::Set1(0.0f)));
+DefBinaryOp(ElementwiseProductWithSigmoidDerivativeFromOutput, V::Mul(a, V::Mul(b, V::Sub(V::Set1(1.0f), b))));
+DefBinaryOp(ElementwiseProductWithTanhDerivativeFromOutput, V::Mul(a, V::Sub(V::Set1(1.0f), V::Mul(b, b))));
+DefBinaryOp(ElementwiseProductWithLinearRectifierDerivativeFromOutput, V::Select(V::CmpGT(b, V::Set1(0.0f)), a, V::Set1(0.0f)));
+DefBinaryOp(ElementwiseProductWithLogDerivativeFromOutput, V::Mul(a, Exp<V>(V::Negate(b))));
+DefBinaryOp(ElementwiseProductWithAbsDerivative, V::Mul(a, V::Select(V::CmpGT(b, V::Set1(0.0f)), V::Set1(1.0f),
+                                                                     V::Select(V::CmpLT(b, V::Set1(0.0f)), V::Set1(-1.0f), b))));
+DefBinaryOp(ElementwiseProductWithReciprocalDerivative, V::Mul(a, V::Negate(V::Mul(b, b))));
+DefBinaryOp(ElementwiseProductWithSqrtDerivative, V::Div(a, V::Mul(V::Set1(2.0f), b)));
+DefBinaryOp(SqrOfDifference, V::Mul(V::Sub(a, b), V::Sub(a, b)));
+#pragma pop_macro("DefBinaryOp")
+
+// LogAdd() from TensorOps.h
+template <class V>
+struct OpLogSum
+{
+    typedef typename V::Reg Reg;
+    static const size_t arity = 2;
+    static inline Reg Apply(Reg a, Reg b)
+    {
+        auto swap = V::CmpLT(a, b);
+        auto x = V::Select(swap, b, a); // larger
+        auto y = V::Select(swap, a, b); // smaller
+        auto diff = V::Sub(y, x);
+        auto farApart = V::Select(V::CmpLT(x, V::Set1((float) LSMALL)), V::Set1((float) LZERO), x);
+        auto close = V::Add(x, Log<V>(V::Add(V::Set1(1.0f), Exp<V>(diff))));
+        return V::Select(V::CmpLT(diff, V::Set1((float) MINLOGEXP)), farApart, close);
+    }
+};
+
+#pragma push_macro("DefTernaryOp")
+#define DefTernaryOp(op, expr)                                    \
+    template <class V>                                            \
+    struct Op##op                                                 \
+    {                                                             \
+        typedef typename V::Reg Reg;                              \
+        static const size_t arity = 3;                            \
+        static inline Reg Apply(Reg a, Reg b, Reg c) { return expr; } \
+    }
+
+DefTernaryOp(Cond, V::Select(V::CmpNE(a, V::Set1(0.0f)), b, c));
+DefTernaryOp(CopyIfEqual, V::Select(V::CmpEQ(a, b), c, V::Set1(0.0f)));
+DefTernaryOp(Clip, V::Select(V::CmpLT(c, a), a, V::Select(V::CmpGT(c, b), b, c)));
+DefTernaryOp(ElementwiseProductWithLogSumDerivative, V::Mul(a, Sigmoid<V>(V::Sub(c, b))));
+DefTernaryOp(ElementwiseProductWithExpOfDiff, V::Mul(a, Exp<V>(V::Sub(b, c))));
+#pragma pop_macro("DefTernaryOp")
+
+// -----------------------------------------------------------------------
+// row loop
+// -----------------------------------------------------------------------
+
+template <class V, bool broadcast>
+static inline typename V::Reg LoadInput(const float* p, size_t i)
+{
+    return broadcast ? V::Set1(*p) : V::Load(p + i);
+}
+
+// apply OP at position i of the row; bit j of 'mask' selects broadcasting for input j
+template <class V, class OP, unsigned int mask, size_t arity = OP::arity>
+struct ApplyAt;
+
+template <class V, class OP, unsigned int mask>
+struct ApplyAt<V, OP, mask, 1>
+{
+    static inline typename V::Reg Compute(const float* const* in, size_t i)
+    {
+        return OP::Apply(LoadInput<V, (mask & 1) != 0>(in[0], i));
+    }
+};
+
+template <class V, class OP, unsigned int mask>
+struct ApplyAt<V, OP, mask, 2>
+{
+    static inline typename V::Reg Compute(const float* const* in, size_t i)
+    {
+        return OP::Apply(LoadInput<V, (mask & 1) != 0>(in[0], i), LoadInput<V, (mask & 2) != 0>(in[1], i));
+    }
+};
+
+template <class V, class OP, unsigned int mask>
+struct ApplyAt<V, OP, mask, 3>
+{
+    static inline typename V::Reg Compute(const float* const* in, size_t i)
+    {
+        return OP::Apply(LoadInput<V, (mask & 1) != 0>(in[0], i), LoadInput<V, (mask & 2) != 0>(in[1], i), LoadInput<V, (mask & 4) != 0>(in[2], i));
+    }
+};
+
+// c = beta * c + alpha * val, with the alpha and beta terms compiled out for the common cases
+// Uses the same operation order as the scalar path (TensorOpIteration), so results of simple ops are bit-identical.
+template <class V, bool useAlpha, bool useBeta>
+static inline typename V::Reg Combine(typename V::Reg val, typename V::Reg alpha, typename V::Reg beta, const float* c)
+{
+    if (useAlpha)
+        val = V::Mul(val, alpha);
+    if (useBeta)
+        val = V::Add(val, V::Mul(beta, V::Load(c)));
+    return val;
+}
+
+template <class V, class OP, unsigned int mask, bool useAlpha, bool useBeta>
+static void RowLoop(size_t n, float beta, const float* const* inputs, float alpha, float* c)
+{
+    const auto vAlpha = V::Set1(alpha);
+    const auto vBeta = V::Set1(beta);
+    size_t i = 0;
+    for (; i + V::width <= n; i += V::width)
+        V::Store(c + i, Combine<V, useAlpha, useBeta>(ApplyAt<V, OP, mask>::Compute(inputs, i), vAlpha, vBeta, c + i));
+    if (i == n)
+        return;
+
+    // remainder: run the same vector code on a zero-padded copy, so that every element sees identical arithmetic
+    const size_t rest = n - i;
+    float tailIn[3][V::width];
+    const float* tailInputs[3];
+    for (size_t j = 0; j < OP::arity; j++)
+    {
+        if (mask & (1u << j))
+            tailInputs[j] = inputs[j];
+        else
+        {
+            for (size_t k = 0; k < V::width; k++)
+                tailIn[j][k] = k < rest ? inputs[j][i + k] : 0.0f;
+            tailInputs[j] = tailIn[j];
+        }
+    }
+    float tailOut[V::width];
+    for (size_t k = 0; k < V::width; k++)
+        tailOut[k] = useBeta && k < rest ? c[i + k] : 0.0f;
+    V::Store(tailOut, Combine<V, useAlpha, useBeta>(ApplyAt<V, OP, mask>::Compute(tailInputs, 0), vAlpha, vBeta, tailOut));
+    for (size_t k = 0; k < rest; k++)
+        c[i + k] = tailOut[k];
+}
+
+// the kernel entry point: pick the loop variant for alpha/beta once per row
+template <class V, class OP, unsigned int mask>
+static void ElementwiseKernel(size_t n, float beta, const float* const* inputs, float alpha, float* c)
+{
+    if (beta != 0)
+        RowLoop<V, OP, mask, true, true>(n, beta, inputs, alpha, c);
+    else if (alpha != 1)
+        RowLoop<V, OP, mask, true, false>(n, beta, inputs, alpha, c);
+    else
+        RowLoop<V, OP, mask, false, false>(n, beta, inputs, alpha, c);
+}
+
+// -----------------------------------------------------------------------
+// kernel lookup: map (op, broadcast mask) to a kernel instantiation
+// -----------------------------------------------------------------------
+
+// only instantiate kernels for masks that refer to existing inputs
+template <class V, class OP, unsigned int mask, bool valid = (mask < (1u << OP::arity))>
+struct KernelFor
+{
+    static SIMDElementwiseKernel Get() { return &ElementwiseKernel<V, OP, mask>; }
+};
+
+template <class V, class OP, unsigned int mask>
+struct KernelFor<V, OP, mask, false>
+{
+    static SIMDElementwiseKernel Get() { return nullptr; }
+};
+
+template <class V, template <class> class OP>
+static SIMDElementwiseKernel SelectKernel(size_t numInputs, unsigned int broadcastMask)
+{
+    typedef OP<V> Op;
+    if (numInputs != Op::arity)
+        return nullptr;
+    switch (broadcastMask)
+    {
+    case 0: return KernelFor<V, Op, 0>::Get();
+    case 1: return KernelFor<V, Op, 1>::Get();
+    case 2: return KernelFor<V, Op, 2>::Get();
+    case 3: return KernelFor<V, Op, 3>::Get();
+    case 4: return KernelFor<V, Op, 4>::Get();
+    case 5: return KernelFor<V, Op, 5>::Get();
+    case 6: return KernelFor<V, Op, 6>::Get();
+    case 7: return KernelFor<V, Op, 7>::Get();
+    default: return nullptr;
+    }
+}
+
+// Note: Cosine, Sin and their derivatives have no vectorized version and fall back to the generic path.
+template <class V>
+static SIMDElementwiseKernel GetElementwiseKernel(ElementWiseOperator op, size_t numInputs, unsigned int broadcastMask)
+{
+#define CaseSIMDKernel(oper) \
+    case ElementWiseOperator::op##oper: return SelectKernel<V, Op##oper>(numInputs, broadcastMask)
+
+    switch (op)
+    {
+        // unary
+        CaseSIMDKernel(Copy);
+        CaseSIMDKernel(Negate);
+        CaseSIMDKernel(Not);
+        CaseSIMDKernel(Abs);
+        CaseSIMDKernel(Floor);
+        CaseSIMDKernel(Reciprocal);
+        CaseSIMDKernel(Sigmoid);
+        CaseSIMDKernel(Tanh);
+        CaseSIMDKernel(Sqr);
+        CaseSIMDKernel(Sqrt);
+        CaseSIMDKernel(Exp);
+        CaseSIMDKernel(Log);
+        CaseSIMDKernel(LinearRectifier);
+        // binary
+        CaseSIMDKernel(CopyIf);
+        CaseSIMDKernel(CopyIfNot);
+        CaseSIMDKernel(Sum);
+        CaseSIMDKernel(Difference);
+        CaseSIMDKernel(ElementwiseProduct);
+        CaseSIMDKernel(ElementwiseQuotient);
+        CaseSIMDKernel(LogSum);
+        CaseSIMDKernel(Max);
+        CaseSIMDKernel(Min);
+        CaseSIMDKernel(Equal);
+        CaseSIMDKernel(NotEqual);
+        CaseSIMDKernel(Greater);
+        CaseSIMDKernel(Less);
+        CaseSIMDKernel(GreaterEqual);
+        CaseSIMDKernel(LessEqual);
+        CaseSIMDKernel(And);
+        CaseSIMDKernel(Or);
+        CaseSIMDKernel(Xor);
+        CaseSIMDKernel(MaskNegative);
+        CaseSIMDKernel(ElementwiseProductWithSigmoidDerivativeFromOutput);
+        CaseSIMDKernel(ElementwiseProductWithTanhDerivativeFromOutput);
+        CaseSIMDKernel(ElementwiseProductWithLinearRectifierDerivativeFromOutput);
+        CaseSIMDKernel(ElementwiseProductWithLogDerivativeFromOutput);
+        CaseSIMDKernel(ElementwiseProductWithAbsDerivative);
+        CaseSIMDKernel(ElementwiseProductWithReciprocalDerivative);
+        CaseSIMDKernel(ElementwiseProductWithSqrtDerivative);
+        CaseSIMDKernel(SqrOfDifference);
+        // ternary
+        CaseSIMDKernel(Cond);
+        CaseSIMDKernel(CopyIfEqual);
+        CaseSIMDKernel(Clip);
+        CaseSIMDKernel(ElementwiseProductWithLogSumDerivative);
+        CaseSIMDKernel(ElementwiseProductWithExpOfDiff);
+    default:
+        return nullptr;
+    }
+#undef CaseSIMDKernel
+}
+
+}}}}
@@ -0,0 +1,292 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include <string.h>
+#include "BinaryDeserializer.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+// Dense sequence data pointing into the mapped file.
+struct MappedDenseSequenceData : DenseSequenceData
+{
+    const void* GetDataBuffer() override
+    {
+        return m_data;
+    }
+
+    const void* m_data;
+};
+
+// Sparse sequence data with values and indices pointing into the mapped file.
+// Only the per-sample nnz counts are copied, as the SparseSequenceData interface requires a vector.
+struct MappedSparseSequenceData : SparseSequenceData
+{
+    const void* GetDataBuffer() override
+    {
+        return m_data;
+    }
+
+    const void* m_data;
+};
+
+class BinaryDeserializer::BinaryDataChunk : public Chunk, public std::enable_shared_from_this<Chunk>
+{
+public:
+    BinaryDataChunk(const BinaryDeserializer& parent, ChunkIdType chunkId) :
+        m_parent(parent),
+        m_file(parent.m_file),
+        m_header(parent.m_chunks[parent.m_chunkIds[chunkId]]),
+        m_includedSequences(parent.m_includedSequences[chunkId])
+    {
+    }
+
+    void GetSequence(size_t sequenceId, std::vector<SequenceDataPtr>& result) override
+    {
+        size_t sequenceIndex = m_header.m_firstSequence + (m_includedSequences.empty() ? sequenceId : m_includedSequences[sequenceId]);
+        assert(sequenceIndex < m_header.m_firstSequence + m_header.m_numberOfSequences);
+
+        const auto& streams = m_parent.m_streams;
+        const BinarySequenceStreamEntry* entries = m_parent.m_entries + sequenceIndex * streams.size();
+        result.reserve(result.size() + streams.size());
+        for (size_t j = 0; j < streams.size(); ++j)
+        {
+            const auto& entry = entries[j];
+            SequenceDataPtr data;
+            if (streams[j]->m_storageType == StorageType::dense)
+            {
+                auto dense = make_shared<MappedDenseSequenceData>();
+                dense->m_data = m_file->Data() + entry.m_valuesOffset;
+                data = dense;
+            }
+            else
+            {
+                auto sparse = make_shared<MappedSparseSequenceData>();
+                sparse->m_data = m_file->Data() + entry.m_valuesOffset;
+                sparse->m_indices = (IndexType*)(m_file->Data() + entry.m_indicesOffset);
+                const IndexType* nnzCounts = (const IndexType*)(m_file->Data() + entry.m_nnzCountsOffset);
+                sparse->m_nnzCounts.assign(nnzCounts, nnzCounts + entry.m_numberOfSamples);
+                sparse->m_totalNnzCount = entry.m_totalNnzCount;
+                data = sparse;
+            }
+
+            data->m_id = sequenceId;
+            data->m_numberOfSamples = entry.m_numberOfSamples;
+            data->m_elementType = streams[j]->m_elementType;
+            data->m_sampleLayout = streams[j]->m_sampleLayout;
+            data->m_chunk = shared_from_this();
+            result.push_back(data);
+        }
+    }
+
+private:
+    const BinaryDeserializer& m_parent;
+    MemoryMappedFilePtr m_file;
+    const BinaryChunkHeader& m_header;
+    const std::vector<uint32_t>& m_includedSequences;
+};
+
+BinaryDeserializer::BinaryDeserializer(CorpusDescriptorPtr corpus, const wstring& filename, ElementType elementType, bool isPrimary) :
+    m_file(make_shared<MemoryMappedFile>(filename)),
+    m_isPrimary(isPrimary)
+{
+    if (m_file->Size() < sizeof(BinaryFileHeader) + sizeof(BinaryFileTrailer))
+        RuntimeError("Binary file '%ls' is too small to be a valid CNTK binary format file.", filename.c_str());
+
+    const auto& header = *MappedArray<BinaryFileHeader>(0, 1);
+    const auto& trailer = *MappedArray<BinaryFileTrailer>(m_file->Size() - sizeof(BinaryFileTrailer), 1);
+    if (memcmp(header.m_magic, BinaryFormatMagic, sizeof(header.m_magic)) != 0 ||
+        memcmp(trailer.m_magic, BinaryFormatMagic, sizeof(trailer.m_magic)) != 0)
+        RuntimeError("File '%ls' is not a CNTK binary format file or is truncated.", filename.c_str());
+    if (header.m_version != BinaryFormatVersion)
+        RuntimeError("Binary file '%ls' has an unsupported version %u (expected %u).", filename.c_str(), header.m_version, BinaryFormatVersion);
+    if (header.m_indexTypeSize != sizeof(IndexType))
+        RuntimeError("Binary file '%ls' was written with %u-byte sparse indices, expected %u.", filename.c_str(), header.m_indexTypeSize, (unsigned int)sizeof(IndexType));
+
+    size_t elementSize = elementType == ElementType::tfloat ? sizeof(float) : sizeof(double);
+    if (header.m_elementSize != elementSize)
+        RuntimeError("Binary file '%ls' contains %u-byte values, which does not match the configured precision.", filename.c_str(), header.m_elementSize);
+
+    // footer
+    m_numStreams = trailer.m_numStreams;
+    m_numChunks = trailer.m_numChunks;
+    size_t numSequences = trailer.m_numSequences;
+    uint64_t offset = trailer.m_footerOffset;
+    const BinaryStreamHeader* streamHeaders = MappedArray<BinaryStreamHeader>(offset, m_numStreams);
+    offset += sizeof(BinaryStreamHeader) * m_numStreams;
+    m_chunks = MappedArray<BinaryChunkHeader>(offset, m_numChunks);
+    offset += sizeof(BinaryChunkHeader) * m_numChunks;
+    m_sequences = MappedArray<BinarySequenceHeader>(offset, numSequences);
+    offset += sizeof(BinarySequenceHeader) * numSequences;
+    m_entries = MappedArray<BinarySequenceStreamEntry>(offset, numSequences * m_numStreams);
+    offset += sizeof(BinarySequenceStreamEntry) * numSequences * m_numStreams;
+
+    for (size_t j = 0; j < m_numStreams; ++j)
+    {
+        const auto& streamHeader = streamHeaders[j];
+        const char* name = MappedArray<char>(offset, streamHeader.m_nameLength);
+        offset += streamHeader.m_nameLength + streamHeader.m_aliasLength;
+
+        if (streamHeader.m_storageType != (uint32_t)StorageType::dense && streamHeader.m_storageType != (uint32_t)StorageType::sparse_csc)
+            RuntimeError("Binary file '%ls' is corrupt: stream %d has an unknown storage type %u.", filename.c_str(), (int)j, streamHeader.m_storageType);
+        if (streamHeader.m_sampleDimension == 0 ||
+            (streamHeader.m_storageType == (uint32_t)StorageType::dense && streamHeader.m_sampleDimension > m_file->Size()))
+            RuntimeError("Binary file '%ls' is corrupt: stream %d has an invalid sample dimension.", filename.c_str(), (int)j);
+
+        auto stream = make_shared<StreamDescription>();
+        stream->m_id = j;
+        stream->m_name = msra::strfun::utf16(string(name, streamHeader.m_nameLength));
+        stream->m_storageType = (StorageType)streamHeader.m_storageType;
+        stream->m_elementType = elementType;
+        stream->m_sampleLayout = make_shared<TensorShape>((size_t)streamHeader.m_sampleDimension);
+        m_streams.push_back(stream);
+    }
+
+    // The data of each sequence is handed out as pointers into the mapping, so check all locations up front.
+    for (size_t i = 0; i < numSequences; ++i)
+    {
+        for (size_t j = 0; j < m_numStreams; ++j)
+        {
+            const auto& entry = m_entries[i * m_numStreams + j];
+            if (m_streams[j]->m_storageType == StorageType::dense)
+                CheckMappedRange(entry.m_valuesOffset, entry.m_numberOfSamples, streamHeaders[j].m_sampleDimension * elementSize);
+            else
+            {
+                CheckMappedRange(entry.m_valuesOffset, entry.m_totalNnzCount, elementSize);
+                CheckMappedRange(entry.m_indicesOffset, entry.m_totalNnzCount, sizeof(IndexType));
+                CheckMappedRange(entry.m_nnzCountsOffset, entry.m_numberOfSamples, sizeof(IndexType));
+            }
+        }
+    }
+
+    // apply the corpus descriptor
+    for (uint32_t chunk = 0; chunk < m_numChunks; ++chunk)
+    {
+        const auto& chunkHeader = m_chunks[chunk];
+        if (chunkHeader.m_firstSequence > numSequences || chunkHeader.m_numberOfSequences > numSequences - chunkHeader.m_firstSequence)
+            RuntimeError("Binary file '%ls' has an inconsistent index.", filename.c_str());
+        CheckMappedRange(chunkHeader.m_offset, chunkHeader.m_byteSize, 1);
+
+        vector<uint32_t> included;
+        for (uint32_t i = 0; i < chunkHeader.m_numberOfSequences; ++i)
+        {
+            if (corpus->IsIncluded(std::to_string(m_sequences[chunkHeader.m_firstSequence + i].m_key)))
+                included.push_back(i);
+        }
+        if (included.empty())
+            continue;
+
+        if (CHUNKID_MAX <= m_chunkIds.size())
+            RuntimeError("Maximum number of chunks exceeded");
+        ChunkIdType chunkId = (ChunkIdType)m_chunkIds.size();
+        m_chunkIds.push_back(chunk);
+        if (included.size() == chunkHeader.m_numberOfSequences)
+            included.clear(); // all sequences
+        m_includedSequences.push_back(move(included));
+
+        if (!m_isPrimary)
+        {
+            size_t numIncluded = m_includedSequences.back().empty() ? chunkHeader.m_numberOfSequences : m_includedSequences.back().size();
+            for (size_t i = 0; i < numIncluded; ++i)
+            {
+                auto description = DescribeSequence(chunkId, i);
+                m_keyToSequenceInChunk.insert(make_pair((size_t)description.m_key.m_sequence, make_pair(chunkId, i)));
+            }
+        }
+    }
+}
+
+template <class T>
+const T* BinaryDeserializer::MappedArray(uint64_t offset, uint64_t count) const
+{
+    CheckMappedRange(offset, count, sizeof(T));
+    return (const T*)(m_file->Data() + offset);
+}
+
+void BinaryDeserializer::CheckMappedRange(uint64_t offset, uint64_t count, uint64_t itemSize) const
+{
+    if (offset > m_file->Size() || (count > 0 && count > (m_file->Size() - offset) / itemSize))
+        RuntimeError("Binary file '%ls' is corrupt: data at offset %llu exceeds the end of the file.", m_file->Path().c_str(), (unsigned long long)offset);
+}
+
+SequenceDescription BinaryDeserializer::DescribeSequence(ChunkIdType chunkId, size_t sequenceInChunk) const
+{
+    const auto& chunkHeader = m_chunks[m_chunkIds[chunkId]];
+    const auto& included = m_includedSequences[chunkId];
+    const auto& sequence = m_sequences[chunkHeader.m_firstSequence + (included.empty() ? sequenceInChunk : included[sequenceInChunk])];
+
+    SequenceDescription description;
+    description.m_id = sequenceInChunk;
+    description.m_numberOfSamples = sequence.m_numberOfSamples;
+    description.m_chunkId = chunkId;
+    description.m_key.m_sequence = sequence.m_key;
+    description.m_key.m_sample = 0;
+    return description;
+}
+
+ChunkDescriptions BinaryDeserializer::GetChunkDescriptions()
+{
+    ChunkDescriptions result;
+    result.reserve(m_chunkIds.size());
+    for (ChunkIdType chunkId = 0; chunkId < m_chunkIds.size(); ++chunkId)
+    {
+        const auto& chunkHeader = m_chunks[m_chunkIds[chunkId]];
+        const auto& included = m_includedSequences[chunkId];
+        size_t numberOfSamples = 0;
+        if (included.empty())
+            numberOfSamples = chunkHeader.m_numberOfSamples;
+        else
+        {
+            for (auto i : included)
+                numberOfSamples += m_sequences[chunkHeader.m_firstSequence + i].m_numberOfSamples;
+        }
+
+        result.push_back(shared_ptr<ChunkDescription>(
+            new ChunkDescription {
+                chunkId,
+                numberOfSamples,
+                included.empty() ? chunkHeader.m_numberOfSequences : included.size(),
+                chunkHeader.m_byteSize
+        }));
+    }
+
+    return result;
+}
+
+void BinaryDeserializer::GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result)
+{
+    const auto& included = m_includedSequences[chunkId];
+    size_t numSequences = included.empty() ? m_chunks[m_chunkIds[chunkId]].m_numberOfSequences : included.size();
+    result.reserve(numSequences);
+    for (size_t i = 0; i < numSequences; ++i)
+        result.push_back(DescribeSequence(chunkId, i));
+}
+
+ChunkPtr BinaryDeserializer::GetChunk(ChunkIdType chunkId)
+{
+    const auto& chunkHeader = m_chunks[m_chunkIds[chunkId]];
+    // the whole chunk is about to be read, let the OS start paging it in
+    m_file->Prefetch(chunkHeader.m_offset, chunkHeader.m_byteSize);
+    return make_shared<BinaryDataChunk>(*this, chunkId);
+}
+
+bool BinaryDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
+{
+    if (m_isPrimary)
+        LogicError("Matching by sequence key is not supported for primary deserilalizer.");
+
+    auto sequenceLocation = m_keyToSequenceInChunk.find(key.m_sequence);
+    if (sequenceLocation == m_keyToSequenceInChunk.end())
+    {
+        return false;
+    }
+
+    result = DescribeSequence(sequenceLocation->second.first, sequenceLocation->second.second);
+    return true;
+}
+
+}}}
@@ -0,0 +1,72 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <map>
+#include "DataDeserializerBase.h"
+#include "CorpusDescriptor.h"
+#include "MemoryMappedFile.h"
+#include "BinaryFormat.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Deserializer for the binary companion format of the CNTK text format (see BinaryFormat.h).
+// The file is memory mapped and the sequence data handed to the packer points directly into
+// the mapping: no parsing and no copying of values or sparse indices takes place.
+// A chunk keeps the mapping alive for as long as any of its sequences is referenced.
+class BinaryDeserializer : public DataDeserializerBase
+{
+public:
+    BinaryDeserializer(CorpusDescriptorPtr corpus, const std::wstring& filename, ElementType elementType, bool isPrimary);
+
+    // Retrieves a chunk of data.
+    ChunkPtr GetChunk(ChunkIdType chunkId) override;
+
+    // Get information about chunks.
+    ChunkDescriptions GetChunkDescriptions() override;
+
+    // Get information about particular chunk.
+    void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result) override;
+
+    bool GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result) override;
+
+private:
+    class BinaryDataChunk;
+
+    // Returns a typed pointer into the mapped file after checking that the range lies within the file.
+    template <class T>
+    const T* MappedArray(uint64_t offset, uint64_t count) const;
+
+    // Raises a RuntimeError unless 'count' items of 'itemSize' bytes starting at 'offset' lie within the file.
+    void CheckMappedRange(uint64_t offset, uint64_t count, uint64_t itemSize) const;
+
+    SequenceDescription DescribeSequence(ChunkIdType chunkId, size_t sequenceInChunk) const;
+
+    MemoryMappedFilePtr m_file;
+    size_t m_numStreams;
+
+    // The tables of the footer, pointing into the mapped file.
+    const BinaryChunkHeader* m_chunks;
+    size_t m_numChunks;
+    const BinarySequenceHeader* m_sequences;
+    const BinarySequenceStreamEntry* m_entries; // [sequence * m_numStreams + stream]
+
+    // The chunks with at least one sequence included by the corpus descriptor: exposed chunk id -> chunk in the file.
+    std::vector<uint32_t> m_chunkIds;
+
+    // Per exposed chunk, the included sequences (offsets from the first sequence of the chunk),
+    // or empty if all sequences of the chunk are included.
+    std::vector<std::vector<uint32_t>> m_includedSequences;
+
+    // Only for secondary deserializers: sequence key -> (chunk id, sequence in chunk).
+    std::map<size_t, std::pair<ChunkIdType, size_t>> m_keyToSequenceInChunk;
+
+    bool m_isPrimary;
+
+    DISABLE_COPY_AND_MOVE(BinaryDeserializer);
+};
+
+}}}
@@ -0,0 +1,90 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// On-disk layout of the binary companion format of the CNTK text format.
+//
+// The file is produced once from a text file by the TextToBinaryConverter and is then
+// memory mapped by the BinaryDeserializer, which hands out pointers into the mapping.
+// All data is stored in the native (little-endian) byte order:
+//
+//   [BinaryFileHeader]
+//   [chunk 0] ... [chunk N-1]
+//   [footer: BinaryStreamHeader x numStreams,
+//            BinaryChunkHeader x numChunks,
+//            BinarySequenceHeader x numSequences,
+//            BinarySequenceStreamEntry x (numSequences * numStreams),
+//            stream names and aliases (UTF-8, not terminated)]
+//   [BinaryFileTrailer]
+//
+// A chunk is column-oriented: for each stream it holds the data of all its sequences back to back,
+//   dense:  values     ElemType[numSamples * sampleDimension]
+//   sparse: nnz counts IndexType[numSamples], indices IndexType[nnz], values ElemType[nnz]
+// Every block starts at a multiple of BinaryFormatAlignment bytes from the beginning of the file.
+
+static const char BinaryFormatMagic[8] = { 'C', 'N', 'T', 'K', 'B', 'I', 'N', '1' };
+static const uint32_t BinaryFormatVersion = 1;
+static const size_t BinaryFormatAlignment = 16;
+
+struct BinaryFileHeader
+{
+    char m_magic[8];
+    uint32_t m_version;
+    uint32_t m_elementSize;      // sizeof(ElemType) of all values: 4 (float) or 8 (double)
+    uint32_t m_indexTypeSize;    // sizeof(IndexType) of the sparse indices and nnz counts
+    uint32_t m_reserved;
+};
+
+struct BinaryFileTrailer
+{
+    uint64_t m_footerOffset;
+    uint64_t m_footerSize;
+    uint32_t m_numStreams;
+    uint32_t m_numChunks;
+    uint64_t m_numSequences;
+    char m_magic[8];
+};
+
+struct BinaryStreamHeader
+{
+    uint32_t m_storageType;      // StorageType::dense or StorageType::sparse_csc
+    uint32_t m_nameLength;       // in bytes
+    uint32_t m_aliasLength;      // in bytes
+    uint32_t m_reserved;
+    uint64_t m_sampleDimension;
+};
+
+struct BinaryChunkHeader
+{
+    uint64_t m_offset;           // file offset of the first block of the chunk
+    uint64_t m_byteSize;
+    uint64_t m_numberOfSamples;  // sum of the sequence lengths
+    uint64_t m_firstSequence;    // index of the first sequence of the chunk in the sequence table
+    uint64_t m_numberOfSequences;
+};
+
+struct BinarySequenceHeader
+{
+    uint64_t m_key;              // sequence key (the sequence id in the text file)
+    uint32_t m_numberOfSamples;  // largest number of samples among all streams
+    uint32_t m_reserved;
+};
+
+// Location of the data of one stream of a sequence inside its chunk.
+struct BinarySequenceStreamEntry
+{
+    uint64_t m_valuesOffset;     // file offset of the first value
+    uint64_t m_indicesOffset;    // sparse only: file offset of the first index
+    uint64_t m_nnzCountsOffset;  // sparse only: file offset of the nnz count of the first sample
+    uint32_t m_numberOfSamples;
+    uint32_t m_totalNnzCount;    // sparse only
+};
+
+}}}
@@ -34,14 +34,19 @@ CNTKTextFormatReader::CNTKTextFormatReader(const ConfigParameters& config)
             m_deserializer = make_shared<TextParser<double>>(corpus, configHelper, true);
 
         if (configHelper.ShouldKeepDataInMemory())
-            m_deserializer = make_shared<ChunkCache>(m_deserializer);
+        {
+            m_chunkCache = make_shared<ChunkCache>(m_deserializer, configHelper.GetChunkCacheSize());
+            m_deserializer = m_chunkCache;
+        }
 
         size_t window = configHelper.GetRandomizationWindow();
         if (window > 0)
         {
             // Verbosity is a general config parameter, not specific to the text format reader.
             int verbosity = config(L"verbosity", 0);
-            m_sequenceEnumerator = make_shared<BlockRandomizer>(verbosity, window, m_deserializer, true);
+            m_sequenceEnumerator = make_shared<BlockRandomizer>(verbosity, window, m_deserializer, true,
+                BlockRandomizer::DecimationMode::chunk, false, false,
+                configHelper.GetReadAheadChunks(), configHelper.GetReadAheadMaxBytes(), configHelper.GetNumReadAheadThreads());
         }
         else
         {
@@ -67,4 +72,14 @@ CNTKTextFormatReader::CNTKTextFormatReader(const ConfigParameters& config)
     }
 }
 
+void CNTKTextFormatReader::StartEpoch(const EpochConfiguration& config, const std::map<std::wstring, int>& inputDescriptions)
+{
+    if (m_chunkCache)
+    {
+        m_chunkCache->PrintStatistics();
+    }
+
+    ReaderBase::StartEpoch(config, inputDescriptions);
+}
+
 } } }
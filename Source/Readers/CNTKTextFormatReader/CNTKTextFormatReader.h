@@ -7,6 +7,7 @@
 
 #include "TextParser.h"
 #include "ReaderBase.h"
+#include "ChunkCache.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -18,6 +19,13 @@ class CNTKTextFormatReader : public ReaderBase
 {
 public:
     CNTKTextFormatReader(const ConfigParameters& parameters);
+
+    // Starts a new epoch, reporting the chunk cache statistics of the previous one.
+    void StartEpoch(const EpochConfiguration& config, const std::map<std::wstring, int>& inputDescriptions) override;
+
+private:
+    // Keeps chunks in memory if requested in the config.
+    std::shared_ptr<ChunkCache> m_chunkCache;
 };
 
 }}}
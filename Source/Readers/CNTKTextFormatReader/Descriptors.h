@@ -41,7 +41,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     // some user-specified size.
     struct ChunkDescriptor : ChunkDescription
     {
-        ChunkDescriptor() : ChunkDescription({}), m_byteSize(0) {}
+        ChunkDescriptor() : ChunkDescription({}) {}
         // TODO: if we don't want to keep the whole index
         // (metadata for all sequences in memory), we should not
         // leave this empty when building a chunk index, and only
@@ -49,7 +49,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         // (the indexer will have to do a second pass for this chunk).
         std::vector<SequenceDescriptor> m_sequences;
 
-        size_t m_byteSize; // size in bytes
+        // size_t m_byteSize -- size in bytes (of the text)
     };
 
     typedef shared_ptr<ChunkDescriptor> ChunkDescriptorPtr;
@@ -10,8 +10,11 @@
 #include "DataReader.h"
 #include "ReaderShim.h"
 #include "CNTKTextFormatReader.h"
+#include "BinaryDeserializer.h"
+#include "TextToBinaryConverter.h"
 #include "HeapMemoryProvider.h"
 #include "StringUtil.h"
+#include "fileutil.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -33,7 +36,7 @@ extern "C" DATAREADER_API void GetReaderD(IDataReader** preader)
 }
 
 // TODO: Not safe from the ABI perspective. Will be uglified to make the interface ABI.
-// A factory method for creating text deserializers.
+// A factory method for creating text and binary deserializers.
 extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializer, const std::wstring& type, const ConfigParameters& deserializerConfig, CorpusDescriptorPtr corpus, bool isPrimary)
 {
     string precision = deserializerConfig.Find("precision", "float");
@@ -50,6 +53,29 @@ extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializ
         else // double
             *deserializer = new TextParser<double>(corpus, TextConfigHelper(deserializerConfig), isPrimary);
     }
+    else if (type == L"CNTKBinaryFormatDeserializer")
+    {
+        wstring binaryFile = msra::strfun::utf16(deserializerConfig(L"file"));
+
+        // If the text file is given, the binary file is (re)created from it whenever it is missing or outdated.
+        // The conversion uses the same "input" section and chunk size as the text deserializer would.
+        if (deserializerConfig.ExistsCurrent(L"textFile"))
+        {
+            wstring textFile = msra::strfun::utf16(deserializerConfig(L"textFile"));
+            if (!msra::files::fuptodate(binaryFile, textFile))
+            {
+                ConfigParameters textConfig(deserializerConfig);
+                textConfig.erase("file");
+                textConfig.Insert("file", msra::strfun::utf8(textFile));
+                if (precision == "float")
+                    TextToBinaryConverter<float>::Convert(TextConfigHelper(textConfig), binaryFile);
+                else
+                    TextToBinaryConverter<double>::Convert(TextConfigHelper(textConfig), binaryFile);
+            }
+        }
+
+        *deserializer = new BinaryDeserializer(corpus, binaryFile, precision == "float" ? ElementType::tfloat : ElementType::tdouble, isPrimary);
+    }
     else
         InvalidArgument("Unknown deserializer type '%ls'", type.c_str());
 
@@ -6,13 +6,69 @@
 #include "stdafx.h"
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <future>
+#include <thread>
 #include "Indexer.h"
 #include "TextReaderConstants.h"
+#include "MemoryMappedFile.h"
+#include "fileutil.h"
 
 using std::string;
+using std::wstring;
+using std::vector;
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Layout of the index cache file: the header followed by IndexedSequence x numberOfSequences.
+static const char IndexCacheMagic[8] = { 'C', 'T', 'F', 'I', 'N', 'D', 'E', 'X' };
+static const uint32_t IndexCacheVersion = 1;
+
+struct IndexCacheHeader
+{
+    char m_magic[8];
+    uint32_t m_version;
+    uint32_t m_hasSequenceIds;     // the outcome of the indexing (sequence ids or line numbers as keys)
+    uint64_t m_fileSize;           // size and modification time of the indexed file
+    int64_t m_modificationTime;
+    uint64_t m_configurationHash;
+    uint64_t m_numberOfSequences;
+};
+
+// Hash (FNV-1a) of everything that changes the content of the index, but not its chunking.
+static uint64_t GetConfigurationHash(bool hasSequenceIds)
+{
+    const uint64_t values[] = { IndexCacheVersion, hasSequenceIds, (uint64_t)ROW_DELIMITER, (uint64_t)NAME_PREFIX };
+    uint64_t hash = 14695981039346656037ULL;
+    for (uint64_t value : values)
+    {
+        for (size_t i = 0; i < sizeof(value); ++i)
+        {
+            hash ^= (value >> (8 * i)) & 0xFF;
+            hash *= 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+static void GetFileStatus(FILE* file, uint64_t& size, int64_t& modificationTime)
+{
+#ifdef _WIN32
+    struct _stat64 status;
+    int rc = _fstat64(_fileno(file), &status);
+#else
+    struct stat status;
+    int rc = fstat(fileno(file), &status);
+#endif
+    if (rc != 0)
+        RuntimeError("Could not determine the size and the modification time of the input file: %s", strerror(errno));
+    size = status.st_size;
+    modificationTime = status.st_mtime;
+}
+
 Indexer::Indexer(FILE* file, bool isPrimary, bool skipSequenceIds, size_t chunkSize) :
     m_file(file),
     m_fileOffsetStart(0),
@@ -158,6 +214,340 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
     AddSequenceIfIncluded(corpus, currentKey, sd);
 }
 
+void Indexer::Build(CorpusDescriptorPtr corpus, const wstring& filename, size_t numberOfThreads,
+                    const wstring& cacheFile, size_t minimumRangeSize)
+{
+    if (!m_index.IsEmpty())
+    {
+        return;
+    }
+
+    uint64_t fileSize;
+    int64_t modificationTime;
+    GetFileStatus(m_file, fileSize, modificationTime);
+    uint64_t configurationHash = GetConfigurationHash(m_hasSequenceIds);
+
+    if (!cacheFile.empty() && TryLoadCache(corpus, cacheFile, fileSize, modificationTime, configurationHash))
+    {
+        return;
+    }
+
+    if (numberOfThreads == 0)
+    {
+        numberOfThreads = std::thread::hardware_concurrency();
+    }
+    numberOfThreads = std::max<size_t>(1, std::min<size_t>(numberOfThreads, fileSize / std::max<size_t>(minimumRangeSize, 1)));
+
+    if (numberOfThreads == 1 && cacheFile.empty())
+    {
+        Build(corpus);
+        return;
+    }
+
+    if (fileSize == 0)
+    {
+        RuntimeError("Input file is empty");
+    }
+
+    m_index.Reserve(fileSize);
+
+    // The cache is first written to a temporary file, which is renamed once complete. The name is unique per process,
+    // since several workers may index the same file at the same time.
+    // Failing to write the cache is not an error, the index is simply rebuilt next time.
+    wstring temporaryFile = cacheFile + L".tmp" + std::to_wstring(GetCurrentProcessId());
+    std::unique_ptr<FILE, int (*)(FILE*)> cache(nullptr, &fclose);
+    bool cacheWritten = false;
+    IndexCacheHeader header = {};
+    if (!cacheFile.empty())
+    {
+        FILE* f = nullptr;
+        if (_wfopen_s(&f, temporaryFile.c_str(), L"wb") == 0 && f != nullptr)
+        {
+            cache.reset(f);
+            memcpy(header.m_magic, IndexCacheMagic, sizeof(header.m_magic));
+            header.m_version = IndexCacheVersion;
+            header.m_fileSize = fileSize;
+            header.m_modificationTime = modificationTime;
+            header.m_configurationHash = configurationHash;
+            cacheWritten = fwrite(&header, sizeof(header), 1, f) == 1;
+        }
+    }
+
+    BuildInParallel(filename, numberOfThreads, [&](const IndexedSequence& sequence)
+    {
+        AddSequenceIfIncluded(corpus, sequence);
+        header.m_numberOfSequences++;
+        if (cacheWritten)
+        {
+            cacheWritten = fwrite(&sequence, sizeof(sequence), 1, cache.get()) == 1;
+        }
+    });
+
+    if (cacheFile.empty())
+    {
+        return;
+    }
+
+    if (cacheWritten)
+    {
+        header.m_hasSequenceIds = m_hasSequenceIds;
+        cacheWritten = fseek(cache.get(), 0, SEEK_SET) == 0 &&
+                       fwrite(&header, sizeof(header), 1, cache.get()) == 1;
+    }
+    if (cache && fclose(cache.release()) != 0)
+    {
+        cacheWritten = false;
+    }
+
+    // The index in memory is used either way, a cache that cannot be replaced (e.g. since another worker
+    // has just written or is reading it) is left as it is.
+    bool cacheExists = false;
+    try
+    {
+        if (cacheWritten)
+        {
+            renameOrDie(temporaryFile, cacheFile);
+            return;
+        }
+    }
+    catch (const std::exception&)
+    {
+        cacheExists = fexists(cacheFile);
+    }
+
+    if (!cacheExists)
+        fprintf(stderr, "WARNING: Could not write the index cache '%ls', the index will be rebuilt next time.\n", cacheFile.c_str());
+    if (fexists(temporaryFile))
+        _wunlink(temporaryFile.c_str());
+}
+
+bool Indexer::TryLoadCache(CorpusDescriptorPtr corpus, const wstring& cacheFile, uint64_t fileSize,
+                           int64_t modificationTime, uint64_t configurationHash)
+{
+    FILE* f = nullptr;
+    if (_wfopen_s(&f, cacheFile.c_str(), L"rb") != 0 || f == nullptr)
+    {
+        return false;
+    }
+
+    std::unique_ptr<FILE, int (*)(FILE*)> cache(f, &fclose);
+    IndexCacheHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+        memcmp(header.m_magic, IndexCacheMagic, sizeof(header.m_magic)) != 0 ||
+        header.m_version != IndexCacheVersion ||
+        header.m_fileSize != fileSize ||
+        header.m_modificationTime != modificationTime ||
+        header.m_configurationHash != configurationHash ||
+        filesize(f) != sizeof(header) + header.m_numberOfSequences * sizeof(IndexedSequence))
+    {
+        fprintf(stderr, "Index cache '%ls' does not match the input file, rebuilding it.\n", cacheFile.c_str());
+        return false;
+    }
+
+    m_index.Reserve(fileSize);
+    m_hasSequenceIds = header.m_hasSequenceIds != 0;
+
+    vector<IndexedSequence> sequences(std::min<uint64_t>(header.m_numberOfSequences, 64 * 1024));
+    for (uint64_t remaining = header.m_numberOfSequences; remaining > 0;)
+    {
+        size_t count = (size_t)std::min<uint64_t>(remaining, sequences.size());
+        if (fread(sequences.data(), sizeof(IndexedSequence), count, f) != count)
+        {
+            RuntimeError("Could not read the index cache '%ls'.", cacheFile.c_str());
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            AddSequenceIfIncluded(corpus, sequences[i]);
+        }
+        remaining -= count;
+    }
+
+    return true;
+}
+
+template <class F>
+void Indexer::BuildInParallel(const wstring& filename, size_t numberOfRanges, F add)
+{
+    MemoryMappedFile input(filename);
+    const char* data = input.Data();
+    int64_t size = (int64_t)input.Size();
+    input.Advise(0, input.Size(), MemoryMappedFile::AccessPattern::sequential);
+
+    // The same decisions as in the sequential Build().
+    int64_t start = 0;
+    if (size > 3 && data[0] == '\xEF' && data[1] == '\xBB' && data[2] == '\xBF')
+    {
+        start = 3;
+    }
+
+    if (!m_hasSequenceIds || data[start] == NAME_PREFIX)
+    {
+        m_hasSequenceIds = false;
+    }
+
+    // Split the input into ranges, each beginning right after a line break.
+    vector<int64_t> boundaries(numberOfRanges + 1);
+    boundaries[0] = start;
+    boundaries[numberOfRanges] = size;
+    for (size_t i = 1; i < numberOfRanges; ++i)
+    {
+        int64_t position = start + (size - start) * (int64_t)i / (int64_t)numberOfRanges;
+        if (position <= boundaries[i - 1])
+        {
+            boundaries[i] = boundaries[i - 1];
+            continue;
+        }
+
+        const char* newline = (const char*)memchr(data + position - 1, ROW_DELIMITER, size - position + 1);
+        boundaries[i] = newline ? (newline - data) + 1 : size;
+    }
+
+    vector<RangeIndex> ranges(numberOfRanges);
+    {
+        vector<std::future<void>> tasks;
+        for (size_t i = 1; i < numberOfRanges; ++i)
+        {
+            tasks.push_back(std::async(std::launch::async, [&, i]()
+            {
+                IndexRange(data, boundaries[i], boundaries[i + 1], m_hasSequenceIds, ranges[i]);
+            }));
+        }
+
+        IndexRange(data, boundaries[0], boundaries[1], m_hasSequenceIds, ranges[0]);
+        for (auto& task : tasks)
+        {
+            task.get();
+        }
+    }
+
+    // Stitch the ranges together: in the line mode, keys are global line numbers,
+    // otherwise a sequence may continue over the boundary of a range.
+    uint64_t lineOffset = 0;
+    IndexedSequence pending = {};
+    bool hasPending = false;
+    for (size_t i = 0; i < numberOfRanges; ++i)
+    {
+        auto& range = ranges[i];
+        if (!m_hasSequenceIds)
+        {
+            for (auto& sequence : range.m_sequences)
+            {
+                sequence.m_key += lineOffset;
+                add(sequence);
+            }
+            lineOffset += range.m_numberOfLines;
+        }
+        else
+        {
+            if (range.m_leadingLines > 0)
+            {
+                if (!hasPending)
+                {
+                    RuntimeError("Expected a sequence id at the offset %" PRIi64 ", none was found.", boundaries[i]);
+                }
+                pending.m_byteSize += range.m_leadingBytes;
+                pending.m_numberOfSamples += range.m_leadingLines;
+            }
+
+            for (const auto& sequence : range.m_sequences)
+            {
+                if (hasPending && sequence.m_key == pending.m_key)
+                {
+                    pending.m_byteSize += sequence.m_byteSize;
+                    pending.m_numberOfSamples += sequence.m_numberOfSamples;
+                    continue;
+                }
+
+                if (hasPending)
+                {
+                    add(pending);
+                }
+                pending = sequence;
+                hasPending = true;
+            }
+        }
+
+        vector<IndexedSequence>().swap(range.m_sequences);
+    }
+
+    if (hasPending)
+    {
+        add(pending);
+    }
+}
+
+/*static*/ void Indexer::IndexRange(const char* data, int64_t begin, int64_t end, bool hasSequenceIds, RangeIndex& result)
+{
+    IndexedSequence current = {};
+    bool hasCurrent = false;
+    for (int64_t lineStart = begin; lineStart < end;)
+    {
+        const char* newline = (const char*)memchr(data + lineStart, ROW_DELIMITER, end - lineStart);
+        int64_t lineEnd = newline ? (newline - data) + 1 : end;
+
+        if (!hasSequenceIds)
+        {
+            result.m_sequences.push_back({ result.m_numberOfLines, lineStart, (uint64_t)(lineEnd - lineStart), 1 });
+        }
+        else
+        {
+            const char* pos = data + lineStart;
+            size_t id = 0;
+            while (pos != data + lineEnd && *pos >= '0' && *pos <= '9')
+            {
+                id = id * 10 + (*pos - '0');
+                ++pos;
+            }
+
+            // As in TryGetSequenceId, digits running into the end of the file are not an id.
+            bool found = pos != data + lineStart && pos != data + lineEnd;
+            if (found && (!hasCurrent || id != current.m_key))
+            {
+                if (hasCurrent)
+                {
+                    current.m_byteSize = lineStart - current.m_fileOffsetBytes;
+                    result.m_sequences.push_back(current);
+                }
+                else
+                {
+                    result.m_leadingBytes = lineStart - begin;
+                }
+
+                current = { id, lineStart, 0, 0 };
+                hasCurrent = true;
+            }
+
+            if (hasCurrent)
+                current.m_numberOfSamples++;
+            else
+                result.m_leadingLines++;
+        }
+
+        result.m_numberOfLines++;
+        lineStart = lineEnd;
+    }
+
+    if (hasCurrent)
+    {
+        current.m_byteSize = end - current.m_fileOffsetBytes;
+        result.m_sequences.push_back(current);
+    }
+    else if (hasSequenceIds)
+    {
+        result.m_leadingBytes = end - begin;
+    }
+}
+
+void Indexer::AddSequenceIfIncluded(CorpusDescriptorPtr corpus, const IndexedSequence& sequence)
+{
+    SequenceDescriptor sd = {};
+    sd.m_fileOffsetBytes = sequence.m_fileOffsetBytes;
+    sd.m_byteSize = (size_t)sequence.m_byteSize;
+    sd.m_numberOfSamples = (uint32_t)sequence.m_numberOfSamples;
+    AddSequenceIfIncluded(corpus, (size_t)sequence.m_key, sd);
+}
+
 void Indexer::AddSequenceIfIncluded(CorpusDescriptorPtr corpus, size_t sequenceId, SequenceDescriptor& sd)
 {
     auto key = std::to_string(sequenceId);
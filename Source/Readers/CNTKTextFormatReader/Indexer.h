@@ -6,6 +6,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <string>
 #include <vector>
 #include "Descriptors.h"
 #include "CorpusDescriptor.h"
@@ -26,6 +27,17 @@ public:
     // sequences.
     void Build(CorpusDescriptorPtr corpus);
 
+    // Same as above, but with two ways of avoiding the sequential pass over a large input:
+    //  - if 'cacheFile' is not empty, the index is loaded from it when it matches the size and
+    //    the modification time of the input file, otherwise it is written there once built;
+    //  - the file 'filename' (the one opened as 'file') is split into up to 'numberOfThreads'
+    //    byte ranges of at least 'minimumRangeSize' bytes that are indexed concurrently
+    //    (0 threads stands for the number of hardware threads).
+    // The cache does not depend on the corpus descriptor nor on the chunk size, both are applied
+    // when the index is loaded.
+    void Build(CorpusDescriptorPtr corpus, const std::wstring& filename, size_t numberOfThreads,
+               const std::wstring& cacheFile, size_t minimumRangeSize = 64 * 1024 * 1024);
+
     // Returns input data index (chunk and sequence metadata)
     const Index& GetIndex() const { return m_index; }
 
@@ -35,6 +47,39 @@ public:
     bool HasSequenceIds() const { return m_hasSequenceIds; }
 
 private:
+    // A sequence as found in the input, before it is filtered by the corpus descriptor.
+    // This is also the record format of the index cache file.
+    struct IndexedSequence
+    {
+        uint64_t m_key;
+        int64_t m_fileOffsetBytes;
+        uint64_t m_byteSize;
+        uint64_t m_numberOfSamples;
+    };
+
+    // The sequences found in one byte range of the input file.
+    struct RangeIndex
+    {
+        std::vector<IndexedSequence> m_sequences;
+        // Lines at the beginning of the range without a sequence id:
+        // they continue the last sequence of the previous range.
+        uint64_t m_leadingLines = 0;
+        uint64_t m_leadingBytes = 0;
+        uint64_t m_numberOfLines = 0;
+    };
+
+    // Indexes the lines in [begin, end) of the mapped input, 'begin' must be the start of a line.
+    static void IndexRange(const char* data, int64_t begin, int64_t end, bool hasSequenceIds, RangeIndex& result);
+
+    // Indexes the input split into the given number of ranges in parallel,
+    // calling 'add' for each sequence in the order of the file.
+    template <class F>
+    void BuildInParallel(const std::wstring& filename, size_t numberOfRanges, F add);
+
+    // Returns false, if the cache file does not exist or does not match the input file.
+    bool TryLoadCache(CorpusDescriptorPtr corpus, const std::wstring& cacheFile, uint64_t fileSize,
+                      int64_t modificationTime, uint64_t configurationHash);
+
     FILE* m_file;
 
     int64_t m_fileOffsetStart;
@@ -55,6 +100,7 @@ private:
 
     // Same function as above but with check that the sequence is included in the corpus descriptor.
     void AddSequenceIfIncluded(CorpusDescriptorPtr corpus, size_t sequenceId, SequenceDescriptor& sd);
+    void AddSequenceIfIncluded(CorpusDescriptorPtr corpus, const IndexedSequence& sequence);
 
     // fills up the buffer with data from file, all previously buffered data
     // will be overwritten.
@@ -148,6 +148,13 @@ TextConfigHelper::TextConfigHelper(const ConfigParameters& config)
     m_traceLevel = config(L"traceLevel", 1);
     m_chunkSizeBytes = config(L"chunkSizeInBytes", 32 * 1024 * 1024); // 32 MB by default
     m_keepDataInMemory = config(L"keepDataInMemory", false);
+    m_chunkCacheSizeBytes = config(L"chunkCacheSizeInBytes", 0);
+    m_cacheIndex = config(L"cacheIndex", false);
+    m_numIndexingThreads = config(L"numIndexingThreads", 0);
+    m_numParsingThreads = config(L"numParsingThreads", 1);
+    m_readAheadChunks = config(L"readAheadChunks", 1);
+    m_readAheadMaxBytes = config(L"readAheadMaxBytes", 0);
+    m_numReadAheadThreads = config(L"numReadAheadThreads", 1);
     m_frameMode = config(L"frameMode", false);
 }
 
@@ -37,6 +37,20 @@ public:
 
     bool ShouldKeepDataInMemory() const { return m_keepDataInMemory; }
 
+    size_t GetChunkCacheSize() const { return m_chunkCacheSizeBytes; }
+
+    bool ShouldCacheIndex() const { return m_cacheIndex; }
+
+    size_t GetNumIndexingThreads() const { return m_numIndexingThreads; }
+
+    size_t GetNumParsingThreads() const { return m_numParsingThreads; }
+
+    size_t GetReadAheadChunks() const { return m_readAheadChunks; }
+
+    size_t GetReadAheadMaxBytes() const { return m_readAheadMaxBytes; }
+
+    size_t GetNumReadAheadThreads() const { return m_numReadAheadThreads; }
+
     bool IsInFrameMode() const { return m_frameMode; }
 
     ElementType GetElementType() const { return m_elementType; }
@@ -53,6 +67,13 @@ private:
     unsigned int m_traceLevel;
     size_t m_chunkSizeBytes; // chunks size in bytes
     bool m_keepDataInMemory; // if true the whole dataset is kept in memory
+    size_t m_chunkCacheSizeBytes; // if not 0, only the most recently used chunks up to this size are kept in memory
+    bool m_cacheIndex; // if true the index is stored next to the input file and reused while the file is unchanged
+    size_t m_numIndexingThreads; // 0 stands for the number of hardware threads
+    size_t m_numParsingThreads; // 1 by default, 0 stands for the number of hardware threads
+    size_t m_readAheadChunks; // number of chunks the randomizer loads ahead of time
+    size_t m_readAheadMaxBytes; // if not 0, the maximum total size of the chunks loaded ahead of time
+    size_t m_numReadAheadThreads; // number of chunks loaded concurrently
     bool m_frameMode; // if true, the maximum expected sequence length in the dataset is one sample.
 };
 
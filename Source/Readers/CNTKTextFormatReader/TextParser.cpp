@@ -7,9 +7,12 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <cfloat>
+#include <future>
+#include <thread>
 #include "Indexer.h"
 #include "TextParser.h"
 #include "TextReaderConstants.h"
+#include "TextScanner.h"
 
 #define isSign(c) ((c == '-' || c == '+'))
 #define isE(c) ((c == 'e' || c == 'E'))
@@ -33,6 +36,63 @@ enum State
     Exponent
 };
 
+// Powers of ten that are exactly representable as doubles.
+static const double s_exactPowersOfTen[] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Computes mantissa * 10^exponent with a single rounding (Clinger's fast path), which
+// is possible when both operands are exact doubles. Returns false otherwise.
+static bool TryMakeReal(uint64_t mantissa, int exponent, double& value)
+{
+    if (mantissa > (1ULL << 53) || exponent < -22 || exponent > 22)
+    {
+        return false;
+    }
+
+    value = (exponent < 0) ? mantissa / s_exactPowersOfTen[-exponent] : mantissa * s_exactPowersOfTen[exponent];
+    return true;
+}
+
+static bool TryMakeReal(uint64_t mantissa, int exponent, float& value)
+{
+    double result;
+    if (!TryMakeReal(mantissa, exponent, result))
+    {
+        return false;
+    }
+
+    // Rounding the (correctly rounded) double to float is exact unless the double
+    // landed exactly half-way between two floats, or is outside of the normal float range.
+    uint64_t bits;
+    memcpy(&bits, &result, sizeof(bits));
+    const uint64_t halfway = 1ULL << (DBL_MANT_DIG - FLT_MANT_DIG - 1);
+    if (result != 0 && ((bits & (2 * halfway - 1)) == halfway || result < FLT_MIN || result > FLT_MAX))
+    {
+        return false;
+    }
+
+    value = static_cast<float>(result);
+    return true;
+}
+
+// Slow path, the string is parsed by the C runtime (in the "C" locale, the only one used by CNTK).
+static void ParseReal(const char* string, double& value)
+{
+    value = strtod(string, nullptr);
+}
+
+static void ParseReal(const char* string, float& value)
+{
+    value = strtof(string, nullptr);
+}
+
+// Auto-configured parsing (see SetNumParsingThreads) uses additional threads only
+// if each of them gets at least this much of the chunk to parse.
+static const size_t MinParsingBytesPerThread = 1024 * 1024;
+
 template <class ElemType>
 class TextParser<ElemType>::TextDataChunk : public Chunk, public std::enable_shared_from_this<Chunk>
 {
@@ -68,6 +128,9 @@ TextParser(corpus, helper.GetFilePath(), helper.GetStreams(), isPrimary)
     SetMaxAllowedErrors(helper.GetMaxAllowedErrors());
     SetChunkSize(helper.GetChunkSize());
     SetSkipSequenceIds(helper.ShouldSkipSequenceIds());
+    SetCacheIndex(helper.ShouldCacheIndex());
+    SetNumIndexingThreads(helper.GetNumIndexingThreads());
+    SetNumParsingThreads(helper.GetNumParsingThreads());
 
     Initialize();
 }
@@ -90,9 +153,13 @@ TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring&
     m_hadWarnings(false),
     m_numAllowedErrors(0),
     m_skipSequenceIds(false),
+    m_cacheIndex(false),
+    m_numIndexingThreads(0),
+    m_numParsingThreads(1),
     m_numRetries(5),
     m_corpus(corpus),
-    m_isPrimary(isPrimary)
+    m_isPrimary(isPrimary),
+    m_owner(nullptr)
 {
     assert(streams.size() > 0);
 
@@ -120,6 +187,37 @@ TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring&
     m_scratch = unique_ptr<char[]>(new char[m_maxAliasLength + 1]);
 }
 
+// Internal, a worker parser that parses sequences from memory on behalf of the owner (see LoadChunk).
+template <class ElemType>
+TextParser<ElemType>::TextParser(TextParser* owner) :
+    m_filename(owner->m_filename),
+    m_file(nullptr),
+    m_streamInfos(owner->m_streamInfos),
+    m_maxAliasLength(owner->m_maxAliasLength),
+    m_aliasToIdMap(owner->m_aliasToIdMap),
+    m_indexer(nullptr),
+    m_fileOffsetStart(0),
+    m_fileOffsetEnd(0),
+    m_bufferStart(nullptr),
+    m_bufferEnd(nullptr),
+    m_pos(nullptr),
+    m_scratch(new char[owner->m_maxAliasLength + 1]),
+    m_chunkSizeBytes(owner->m_chunkSizeBytes),
+    m_traceLevel(owner->m_traceLevel),
+    m_hadWarnings(false),
+    m_numAllowedErrors(0),
+    m_skipSequenceIds(owner->m_skipSequenceIds),
+    m_cacheIndex(false),
+    m_numIndexingThreads(0),
+    m_numParsingThreads(1),
+    m_numRetries(0),
+    m_corpus(owner->m_corpus),
+    m_isPrimary(owner->m_isPrimary),
+    m_owner(owner)
+{
+    m_streams = owner->m_streams;
+}
+
 template <class ElemType>
 TextParser<ElemType>::~TextParser()
 {
@@ -170,7 +268,7 @@ void TextParser<ElemType>::Initialize()
 
         m_indexer = make_unique<Indexer>(m_file, m_isPrimary, m_skipSequenceIds, m_chunkSizeBytes);
 
-        m_indexer->Build(m_corpus);
+        m_indexer->Build(m_corpus, m_filename, m_numIndexingThreads, m_cacheIndex ? m_filename + L".idx" : L"");
     });
 
     assert(m_indexer != nullptr);
@@ -200,7 +298,8 @@ ChunkDescriptions TextParser<ElemType>::GetChunkDescriptions()
             new ChunkDescription {
                 chunk.m_id,
                 chunk.m_numberOfSamples,
-                chunk.m_numberOfSequences
+                chunk.m_numberOfSequences,
+                chunk.m_byteSize // the size of the text, parsed values take about as much memory
         }));
     }
 
@@ -249,6 +348,7 @@ ChunkPtr TextParser<ElemType>::GetChunk(ChunkIdType chunkId)
     const auto& chunkDescriptor = m_indexer->GetIndex().m_chunks[chunkId];
     auto textChunk = make_shared<TextDataChunk>(chunkDescriptor, this);
 
+    lock_guard<mutex> lock(m_getChunkMutex);
     attempt(m_numRetries, [this, &textChunk, &chunkDescriptor]()
     {
         if (ferror(m_file) != 0)
@@ -265,16 +365,98 @@ ChunkPtr TextParser<ElemType>::GetChunk(ChunkIdType chunkId)
 template <class ElemType>
 void TextParser<ElemType>::LoadChunk(TextChunkPtr& chunk, const ChunkDescriptor& descriptor)
 {
-    chunk->m_sequenceMap.resize(descriptor.m_sequences.size());
-    for (const auto& sequenceDescriptor : descriptor.m_sequences)
+    const auto& sequences = descriptor.m_sequences;
+    chunk->m_sequenceMap.resize(sequences.size());
+
+    size_t numThreads = m_numParsingThreads;
+    if (numThreads == 0)
+    {
+        numThreads = min<size_t>(thread::hardware_concurrency(), descriptor.m_byteSize / MinParsingBytesPerThread);
+    }
+    numThreads = min(numThreads, sequences.size());
+
+    if (numThreads <= 1)
     {
-        chunk->m_sequenceMap[sequenceDescriptor.m_id] = LoadSequence(sequenceDescriptor);
+        for (const auto& sequenceDescriptor : sequences)
+        {
+            chunk->m_sequenceMap[sequenceDescriptor.m_id] = LoadSequence(sequenceDescriptor);
+        }
+        return;
+    }
+
+    // Read the whole chunk (sequences are stored in the order of the file) and
+    // let the workers parse consecutive groups of sequences from memory.
+    int64_t begin = sequences.front().m_fileOffsetBytes;
+    int64_t end = sequences.back().m_fileOffsetBytes + sequences.back().m_byteSize;
+    vector<char> data(end - begin);
+    if (_fseeki64(m_file, begin, SEEK_SET) != 0)
+    {
+        PrintWarningNotification();
+        RuntimeError("Error seeking to position %" PRId64 " in the input file (%ls).", begin, m_filename.c_str());
+    }
+    freadOrDie(data.data(), 1, data.size(), m_file);
+
+    // the read buffer is now empty, positioned at the end of the chunk.
+    m_fileOffsetStart = end;
+    m_fileOffsetEnd = end;
+    m_bufferStart = m_buffer.get();
+    m_bufferEnd = m_bufferStart;
+    m_pos = m_bufferStart;
+
+    while (m_workers.size() < numThreads)
+    {
+        m_workers.push_back(unique_ptr<TextParser>(new TextParser(this)));
+    }
+
+    vector<future<void>> tasks;
+    size_t sequencesPerThread = (sequences.size() + numThreads - 1) / numThreads;
+    for (size_t i = 0; i < numThreads; ++i)
+    {
+        TextParser* worker = m_workers[i].get();
+        worker->m_traceLevel = m_traceLevel;
+        worker->m_fileOffsetStart = begin;
+        worker->m_fileOffsetEnd = end;
+        worker->m_bufferStart = data.data();
+        worker->m_bufferEnd = data.data() + data.size();
+        worker->m_pos = worker->m_bufferStart;
+
+        size_t first = i * sequencesPerThread;
+        size_t last = min(first + sequencesPerThread, sequences.size());
+        tasks.push_back(async(launch::async, [&chunk, &sequences, worker, first, last]()
+        {
+            for (size_t j = first; j < last; ++j)
+            {
+                chunk->m_sequenceMap[sequences[j].m_id] = worker->LoadSequence(sequences[j]);
+            }
+        }));
+    }
+
+    for (auto& task : tasks)
+    {
+        task.wait();
+    }
+    for (size_t i = 0; i < numThreads; ++i)
+    {
+        m_hadWarnings |= m_workers[i]->m_hadWarnings;
+    }
+    for (auto& task : tasks)
+    {
+        task.get(); // rethrows the exception of a worker, if any
     }
 }
 
 template <class ElemType>
 void TextParser<ElemType>::IncrementNumberOfErrorsOrDie()
 {
+    if (m_owner != nullptr)
+    {
+        // workers share the budget of allowed errors of their owner.
+        lock_guard<mutex> lock(m_owner->m_numAllowedErrorsMutex);
+        m_owner->m_hadWarnings |= m_hadWarnings;
+        m_owner->IncrementNumberOfErrorsOrDie();
+        return;
+    }
+
     if (m_numAllowedErrors == 0)
     {
         PrintWarningNotification();
@@ -288,6 +470,12 @@ void TextParser<ElemType>::IncrementNumberOfErrorsOrDie()
 template <class ElemType>
 bool TextParser<ElemType>::TryRefillBuffer()
 {
+    if (m_file == nullptr)
+    {
+        // a worker has all its input in memory.
+        return false;
+    }
+
     size_t bytesRead = fread(m_buffer.get(), 1, BUFFER_SIZE, m_file);
 
     if (bytesRead == (size_t)-1)
@@ -352,7 +540,7 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
         }
         else
         {
-            sequence.push_back(make_unique<SparseInputStreamBuffer>());
+            sequence.push_back(make_unique<SparseInputStreamBuffer>(sequenceDsc.m_numberOfSamples));
         }
     }
 
@@ -881,32 +1069,30 @@ bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, st
 template <class ElemType>
 void TextParser<ElemType>::SkipToNextValue(size_t& bytesToRead)
 {
-    while (bytesToRead && CanRead())
-    {
-        char c = *m_pos;
-        // skip everything until we hit either a value delimiter, an input marker or the end of row.
-        if (isValueDelimiter(c) || c == NAME_PREFIX || c == ROW_DELIMITER)
-        {
-            return;
-        }
-        ++m_pos;
-        --bytesToRead;
-    }
+    // skip everything until we hit either a value delimiter, an input marker or the end of row.
+    SkipToFirstOf(SPACE_CHAR, TAB_CHAR, NAME_PREFIX, ROW_DELIMITER, bytesToRead);
 }
 
 template <class ElemType>
 void TextParser<ElemType>::SkipToNextInput(size_t& bytesToRead)
+{
+    // skip everything until we hit either an input marker or the end of row.
+    SkipToFirstOf(NAME_PREFIX, ROW_DELIMITER, NAME_PREFIX, ROW_DELIMITER, bytesToRead);
+}
+
+template <class ElemType>
+void TextParser<ElemType>::SkipToFirstOf(char c0, char c1, char c2, char c3, size_t& bytesToRead)
 {
     while (bytesToRead && CanRead())
     {
-        char c = *m_pos;
-        // skip everything until we hit either an input marker or the end of row.
-        if (c == NAME_PREFIX || c == ROW_DELIMITER)
+        const char* end = m_pos + min<size_t>(bytesToRead, m_bufferEnd - m_pos);
+        const char* found = FindFirstOf(m_pos, end, c0, c1, c2, c3);
+        bytesToRead -= found - m_pos;
+        m_pos = found;
+        if (found != end)
         {
             return;
         }
-        ++m_pos;
-        --bytesToRead;
     }
 }
 
@@ -955,7 +1141,9 @@ bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
 
 
 
-// TODO: better precision (at the moment we're at parity with UCIFast)?
+// Parses the number into a decimal mantissa (up to 19 significant digits) and exponent,
+// which are converted to the nearest floating point value (see TryMakeReal), falling back
+// to the C runtime for numbers that cannot be converted exactly this way.
 // Assumes that bytesToRead is greater than the number of characters 
 // in the string representation of the floating point number
 // (i.e., the string is followed by one of the delimiters)
@@ -966,8 +1154,68 @@ template <class ElemType>
 bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRead)
 {
     State state = State::Init;
-    double coefficient = .0, number = .0, divider = .0;
-    bool negative = false;
+    uint64_t mantissa = 0;
+    int exponent = 0;          // decimal exponent implied by the position of the period and dropped digits
+    int explicitExponent = 0;  // the value following the letter 'e'
+    bool negative = false, negativeExponent = false, truncated = false;
+
+    // The characters of the number, for the slow path; an unusually long one continues on the heap.
+    char text[64];
+    size_t length = 0;
+    string longText;
+    auto addChar = [&](char c)
+    {
+        if (length < sizeof(text))
+        {
+            text[length] = c;
+        }
+        else
+        {
+            if (length == sizeof(text))
+            {
+                longText.assign(text, length);
+            }
+            longText.push_back(c);
+        }
+        ++length;
+    };
+
+    auto addDigit = [&](char c, bool fractional)
+    {
+        if (mantissa < 1000000000000000000ULL)
+        {
+            mantissa = mantissa * 10 + (c - '0');
+            exponent -= fractional;
+        }
+        else
+        {
+            // precision beyond 19 digits only matters for rounding, leave it to the slow path.
+            truncated |= (c != '0');
+            exponent += !fractional;
+        }
+    };
+
+    auto makeValue = [&]()
+    {
+        int totalExponent = exponent + (negativeExponent ? -explicitExponent : explicitExponent);
+        if (truncated || !TryMakeReal(mantissa, totalExponent, value))
+        {
+            if (length < sizeof(text))
+            {
+                text[length] = '\0';
+                ParseReal(text, value);
+            }
+            else
+            {
+                ParseReal(longText.c_str(), value);
+            }
+            return;
+        }
+        if (negative)
+        {
+            value = -value;
+        }
+    };
 
     while (bytesToRead && CanRead())
     {
@@ -980,7 +1228,7 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
             if (IsDigit(c))
             {
                 state = IntegralPart;
-                number = (c - '0');
+                addDigit(c, false);
             }
             else if (isSign(c))
             {
@@ -1004,7 +1252,7 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
             if (IsDigit(c))
             {
                 state = IntegralPart;
-                number = (c - '0');
+                addDigit(c, false);
             }
             else
             {
@@ -1021,7 +1269,7 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
         case IntegralPart:
             if (IsDigit(c))
             {
-                number = number * 10 + (c - '0');
+                addDigit(c, false);
             }
             else if (c == '.')
             {
@@ -1030,12 +1278,10 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
             else if (isE(c))
             {
                 state = TheLetterE;
-                coefficient = (negative) ? -number : number;
-                number = 0;
             }
             else
             {
-                value = static_cast<ElemType>((negative) ? -number : number);
+                makeValue();
                 return true;
             }
             break;
@@ -1043,37 +1289,27 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
             if (IsDigit(c))
             {
                 state = FractionalPart;
-                coefficient = number;
-                number = (c - '0');
-                divider = 10;
+                addDigit(c, true);
             }
             else
             {
-                value = static_cast<ElemType>((negative) ? -number : number);
+                makeValue();
                 return true;
             }
             break;
         case FractionalPart:
             if (IsDigit(c))
             {
-                // TODO: ignore if number of precision digits > FLT_[MANT_]DIG/DBL_[MANT_]DIG
                 // no state change
-                number = number * 10 + (c - '0');
-                divider *= 10;
+                addDigit(c, true);
             }
             else if (isE(c))
             {
                 state = TheLetterE;
-                coefficient += (number / divider);
-                if (negative)
-                {
-                    coefficient = -coefficient;
-                }
             }
             else
             {
-                coefficient += (number / divider);
-                value = static_cast<ElemType>((negative) ? -coefficient : coefficient);
+                makeValue();
                 return true;
             }
             break;
@@ -1082,13 +1318,12 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
             if (IsDigit(c))
             {
                 state = Exponent;
-                negative = false;
-                number = (c - '0');
+                explicitExponent = (c - '0');
             }
             else if (isSign(c))
             {
                 state = ExponentSign;
-                negative = (c == '-');
+                negativeExponent = (c == '-');
             }
             else
             {
@@ -1107,7 +1342,7 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
             if (IsDigit(c))
             {
                 state = Exponent;
-                number = (c - '0');
+                explicitExponent = (c - '0');
             }
             else
             {
@@ -1124,14 +1359,12 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
         case Exponent:
             if (IsDigit(c))
             {
-                // no state change
-                number = number * 10 + (c - '0');
+                // no state change, saturate far beyond the range of double
+                explicitExponent = min(explicitExponent * 10 + (c - '0'), 100000);
             }
             else
             {
-                // TODO: check the exponent value (see FLT_[MAX/MIN]_10_EXP).
-                double exponent = (negative) ? -number : number;
-                value = static_cast<ElemType>(coefficient * pow(10.0, exponent));
+                makeValue();
                 return true;
             }
             break;
@@ -1145,6 +1378,7 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
             return false;
         }
 
+        addChar(c);
         ++m_pos;
         --bytesToRead;
     }
@@ -1183,6 +1417,24 @@ void TextParser<ElemType>::SetChunkSize(size_t size)
     m_chunkSizeBytes = size;
 }
 
+template <class ElemType>
+void TextParser<ElemType>::SetCacheIndex(bool cache)
+{
+    m_cacheIndex = cache;
+}
+
+template <class ElemType>
+void TextParser<ElemType>::SetNumIndexingThreads(size_t numThreads)
+{
+    m_numIndexingThreads = numThreads;
+}
+
+template <class ElemType>
+void TextParser<ElemType>::SetNumParsingThreads(size_t numThreads)
+{
+    m_numParsingThreads = numThreads;
+}
+
 template <class ElemType>
 void TextParser<ElemType>::SetNumRetries(unsigned int numRetries)
 {
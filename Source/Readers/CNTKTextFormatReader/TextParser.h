@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <mutex>
 #include "DataDeserializerBase.h"
 #include "Descriptors.h"
 #include "TextConfigHelper.h"
@@ -38,6 +39,9 @@ public:
 private:
     TextParser(CorpusDescriptorPtr corpus, const std::wstring& filename, const vector<StreamDescriptor>& streams, bool isPrimary);
 
+    // Creates a worker that parses sequences of a chunk held in memory by the owner.
+    explicit TextParser(TextParser* owner);
+
     // Builds an index of the input data.
     void Initialize();
 
@@ -62,9 +66,11 @@ private:
     // of NNZ counts (one for each sample).
     struct SparseInputStreamBuffer : SparseSequenceData
     {
-        SparseInputStreamBuffer()
+        // capacity = expected number of samples
+        SparseInputStreamBuffer(size_t capacity)
         {
             m_totalNnzCount = 0;
+            m_nnzCounts.reserve(capacity);
         }
 
         const void* GetDataBuffer() override
@@ -120,6 +126,9 @@ private:
     bool m_hadWarnings;
     unsigned int m_numAllowedErrors;
     bool m_skipSequenceIds;
+    bool m_cacheIndex; // if true the index is kept in the file m_filename + ".idx"
+    size_t m_numIndexingThreads;
+    size_t m_numParsingThreads;
     unsigned int m_numRetries; // specifies the number of times an unsuccessful
     // file operation should be repeated (default value is 5).
 
@@ -129,6 +138,19 @@ private:
     // Corpus descriptor.
     CorpusDescriptorPtr m_corpus;
 
+    // For a worker, the parser that owns it, otherwise null.
+    TextParser* m_owner;
+
+    // Workers share the number of allowed errors of their owner.
+    std::mutex m_numAllowedErrorsMutex;
+
+    // Workers used to parse the sequences of a chunk in parallel.
+    std::vector<std::unique_ptr<TextParser>> m_workers;
+
+    // Serializes GetChunk calls (e.g. from several read ahead threads of the randomizer):
+    // they share the file, the read buffer and the workers. Each chunk is still parsed in parallel.
+    std::mutex m_getChunkMutex;
+
     // throws runtime exception when number of parsing errors is
     // greater than the specified threshold
     void IncrementNumberOfErrorsOrDie();
@@ -141,6 +163,7 @@ private:
 
     void SkipToNextValue(size_t& bytesToRead);
     void SkipToNextInput(size_t& bytesToRead);
+    void SkipToFirstOf(char c0, char c1, char c2, char c3, size_t& bytesToRead);
 
     bool TryRefillBuffer();
 
@@ -193,6 +216,14 @@ private:
 
     void SetChunkSize(size_t size);
 
+    void SetCacheIndex(bool cache);
+
+    void SetNumIndexingThreads(size_t numThreads);
+
+    // Sets the number of threads that parse the sequences of a chunk,
+    // 0 stands for as many as there are hardware threads and megabytes in the chunk.
+    void SetNumParsingThreads(size_t numThreads);
+
     void SetNumRetries(unsigned int numRetries);
 
     friend class CNTKTextFormatReaderTestRunner<ElemType>;
@@ -0,0 +1,63 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define TEXT_SCANNER_USE_SSE2
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Returns a pointer to the first character in [begin, end) that is equal to
+// one of c0..c3 (repeat a character to look for fewer), or 'end' if there is none.
+// With SSE2, the input is compared 16 characters at a time.
+// The parser uses it to skip ignored inputs, comments and malformed values. The main scan of a row
+// reads names and numbers character by character anyway, and the runs between its delimiters are
+// too short for a vector compare to pay off.
+inline const char* FindFirstOf(const char* begin, const char* end, char c0, char c1, char c2, char c3)
+{
+#ifdef TEXT_SCANNER_USE_SSE2
+    const __m128i v0 = _mm_set1_epi8(c0);
+    const __m128i v1 = _mm_set1_epi8(c1);
+    const __m128i v2 = _mm_set1_epi8(c2);
+    const __m128i v3 = _mm_set1_epi8(c3);
+    while (end - begin >= 16)
+    {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        __m128i match = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(block, v0), _mm_cmpeq_epi8(block, v1)),
+            _mm_or_si128(_mm_cmpeq_epi8(block, v2), _mm_cmpeq_epi8(block, v3)));
+        int mask = _mm_movemask_epi8(match);
+        if (mask != 0)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return begin + index;
+#else
+            return begin + __builtin_ctz(mask);
+#endif
+        }
+        begin += 16;
+    }
+#endif
+
+    for (; begin != end; ++begin)
+    {
+        char c = *begin;
+        if (c == c0 || c == c1 || c == c2 || c == c3)
+        {
+            return begin;
+        }
+    }
+    return end;
+}
+
+}}}
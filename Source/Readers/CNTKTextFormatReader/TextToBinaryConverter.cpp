@@ -0,0 +1,236 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <string.h>
+#include "TextToBinaryConverter.h"
+#include "BinaryFormat.h"
+#include "TextParser.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+// Writes to a file while keeping track of the current offset and padding blocks to the format alignment.
+class BinaryFileWriter
+{
+public:
+    BinaryFileWriter(const wstring& path) : m_file(fopenOrDie(path, L"wb")), m_offset(0)
+    {
+    }
+
+    ~BinaryFileWriter()
+    {
+        if (m_file)
+            fclose(m_file);
+    }
+
+    void Write(const void* data, size_t size)
+    {
+        if (size == 0)
+            return;
+        fwriteOrDie(data, 1, size, m_file);
+        m_offset += size;
+    }
+
+    void Align()
+    {
+        static const char zeros[BinaryFormatAlignment] = {};
+        size_t remainder = m_offset % BinaryFormatAlignment;
+        if (remainder != 0)
+            Write(zeros, BinaryFormatAlignment - remainder);
+    }
+
+    void Close()
+    {
+        fcloseOrDie(m_file);
+        m_file = nullptr;
+    }
+
+    uint64_t Offset() const { return m_offset; }
+
+private:
+    FILE* m_file;
+    uint64_t m_offset;
+
+    DISABLE_COPY_AND_MOVE(BinaryFileWriter);
+};
+
+template <class ElemType>
+/*static*/ void TextToBinaryConverter<ElemType>::Convert(const TextConfigHelper& config, const wstring& binaryFile)
+{
+    const auto& streams = config.GetStreams();
+
+    // The binary file contains all sequences, a corpus descriptor is applied when reading it.
+    TextParser<ElemType> parser(make_shared<CorpusDescriptor>(true), config, /*isPrimary=*/true);
+
+    fprintf(stderr, "Converting '%ls' into the binary format '%ls'.\n", config.GetFilePath().c_str(), binaryFile.c_str());
+
+    // The file is first written to a temporary file, which is renamed once complete. The name is unique per process,
+    // since several workers may convert the same file at the same time.
+    wstring temporaryFile = binaryFile + L".tmp" + std::to_wstring(GetCurrentProcessId());
+    BinaryFileWriter writer(temporaryFile);
+
+    BinaryFileHeader header = {};
+    memcpy(header.m_magic, BinaryFormatMagic, sizeof(header.m_magic));
+    header.m_version = BinaryFormatVersion;
+    header.m_elementSize = sizeof(ElemType);
+    header.m_indexTypeSize = sizeof(IndexType);
+    writer.Write(&header, sizeof(header));
+    writer.Align();
+
+    vector<BinaryChunkHeader> chunkHeaders;
+    vector<BinarySequenceHeader> sequenceHeaders;
+    vector<BinarySequenceStreamEntry> entries; // [sequence * numStreams + stream]
+
+    vector<SequenceDescription> sequences;
+    vector<SequenceDataPtr> sequenceData;
+    vector<vector<SequenceDataPtr>> chunkData; // [stream][sequence in chunk]
+    for (const auto& chunkDescription : parser.GetChunkDescriptions())
+    {
+        sequences.clear();
+        parser.GetSequencesForChunk(chunkDescription->m_id, sequences);
+        auto chunk = parser.GetChunk(chunkDescription->m_id);
+
+        chunkData.assign(streams.size(), vector<SequenceDataPtr>());
+        BinaryChunkHeader chunkHeader = {};
+        chunkHeader.m_offset = writer.Offset();
+        chunkHeader.m_firstSequence = sequenceHeaders.size();
+        chunkHeader.m_numberOfSequences = sequences.size();
+
+        size_t firstEntry = entries.size();
+        for (const auto& sequence : sequences)
+        {
+            sequenceData.clear();
+            chunk->GetSequence(sequence.m_id, sequenceData);
+            assert(sequenceData.size() == streams.size());
+            for (size_t j = 0; j < streams.size(); ++j)
+                chunkData[j].push_back(sequenceData[j]);
+
+            BinarySequenceHeader sequenceHeader = {};
+            sequenceHeader.m_key = sequence.m_key.m_sequence;
+            sequenceHeader.m_numberOfSamples = sequence.m_numberOfSamples;
+            sequenceHeaders.push_back(sequenceHeader);
+            chunkHeader.m_numberOfSamples += sequence.m_numberOfSamples;
+        }
+        entries.resize(entries.size() + sequences.size() * streams.size());
+
+        // column-oriented: one block (dense) or three blocks (sparse) per stream
+        for (size_t j = 0; j < streams.size(); ++j)
+        {
+            const auto& stream = streams[j];
+            auto entry = [&](size_t i) -> BinarySequenceStreamEntry& { return entries[firstEntry + i * streams.size() + j]; };
+            if (stream.m_storageType == StorageType::dense)
+            {
+                for (size_t i = 0; i < chunkData[j].size(); ++i)
+                {
+                    const auto& data = chunkData[j][i];
+                    entry(i).m_valuesOffset = writer.Offset();
+                    entry(i).m_numberOfSamples = data->m_numberOfSamples;
+                    writer.Write(data->GetDataBuffer(), sizeof(ElemType) * stream.m_sampleDimension * data->m_numberOfSamples);
+                }
+                writer.Align();
+            }
+            else
+            {
+                for (size_t i = 0; i < chunkData[j].size(); ++i)
+                {
+                    auto data = static_cast<SparseSequenceData*>(chunkData[j][i].get());
+                    entry(i).m_nnzCountsOffset = writer.Offset();
+                    entry(i).m_numberOfSamples = data->m_numberOfSamples;
+                    entry(i).m_totalNnzCount = data->m_totalNnzCount;
+                    writer.Write(data->m_nnzCounts.data(), sizeof(IndexType) * data->m_nnzCounts.size());
+                }
+                writer.Align();
+                for (size_t i = 0; i < chunkData[j].size(); ++i)
+                {
+                    auto data = static_cast<SparseSequenceData*>(chunkData[j][i].get());
+                    entry(i).m_indicesOffset = writer.Offset();
+                    writer.Write(data->m_indices, sizeof(IndexType) * data->m_totalNnzCount);
+                }
+                writer.Align();
+                for (size_t i = 0; i < chunkData[j].size(); ++i)
+                {
+                    auto data = static_cast<SparseSequenceData*>(chunkData[j][i].get());
+                    entry(i).m_valuesOffset = writer.Offset();
+                    writer.Write(data->GetDataBuffer(), sizeof(ElemType) * data->m_totalNnzCount);
+                }
+                writer.Align();
+            }
+        }
+
+        chunkHeader.m_byteSize = writer.Offset() - chunkHeader.m_offset;
+        chunkHeaders.push_back(chunkHeader);
+    }
+
+    // footer
+    BinaryFileTrailer trailer = {};
+    trailer.m_footerOffset = writer.Offset();
+    trailer.m_numStreams = (uint32_t)streams.size();
+    trailer.m_numChunks = (uint32_t)chunkHeaders.size();
+    trailer.m_numSequences = sequenceHeaders.size();
+    memcpy(trailer.m_magic, BinaryFormatMagic, sizeof(trailer.m_magic));
+
+    vector<string> names, aliases;
+    for (const auto& stream : streams)
+    {
+        names.push_back(msra::strfun::utf8(stream.m_name));
+        aliases.push_back(stream.m_alias);
+
+        BinaryStreamHeader streamHeader = {};
+        streamHeader.m_storageType = (uint32_t)stream.m_storageType;
+        streamHeader.m_nameLength = (uint32_t)names.back().size();
+        streamHeader.m_aliasLength = (uint32_t)aliases.back().size();
+        streamHeader.m_sampleDimension = stream.m_sampleDimension;
+        writer.Write(&streamHeader, sizeof(streamHeader));
+    }
+    writer.Write(chunkHeaders.data(), sizeof(BinaryChunkHeader) * chunkHeaders.size());
+    writer.Write(sequenceHeaders.data(), sizeof(BinarySequenceHeader) * sequenceHeaders.size());
+    writer.Write(entries.data(), sizeof(BinarySequenceStreamEntry) * entries.size());
+    for (size_t j = 0; j < streams.size(); ++j)
+    {
+        writer.Write(names[j].data(), names[j].size());
+        writer.Write(aliases[j].data(), aliases[j].size());
+    }
+    writer.Align();
+    trailer.m_footerSize = writer.Offset() - trailer.m_footerOffset;
+    writer.Write(&trailer, sizeof(trailer));
+    writer.Close();
+
+    // The first worker to finish provides the file; the others keep it rather than replacing it while it may be in use.
+    // A failure to replace it also means that another worker has done so.
+    bool replaced = false;
+    try
+    {
+        if (!msra::files::fuptodate(binaryFile, config.GetFilePath()))
+        {
+            renameOrDie(temporaryFile, binaryFile);
+            replaced = true;
+        }
+    }
+    catch (const std::exception&)
+    {
+        if (!fexists(binaryFile))
+            throw;
+    }
+
+    if (!replaced)
+    {
+        _wunlink(temporaryFile.c_str());
+        fprintf(stderr, "'%ls' was converted by another process meanwhile.\n", binaryFile.c_str());
+        return;
+    }
+
+    fprintf(stderr, "Converted %" PRIu64 " sequences in %" PRIu64 " chunks (%" PRIu64 " bytes).\n",
+            (uint64_t)sequenceHeaders.size(), (uint64_t)chunkHeaders.size(), writer.Offset());
+}
+
+template class TextToBinaryConverter<float>;
+template class TextToBinaryConverter<double>;
+
+}}}
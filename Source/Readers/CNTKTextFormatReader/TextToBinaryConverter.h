@@ -0,0 +1,25 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "TextConfigHelper.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Converts a file in the CNTK text format into the memory-mappable binary format described in BinaryFormat.h.
+// The text file is parsed once, chunk by chunk, with the regular TextParser; the chunking of the
+// text file (chunkSizeInBytes) is preserved in the binary file.
+template <class ElemType>
+class TextToBinaryConverter
+{
+public:
+    // Converts all sequences of the file specified in 'config' into 'binaryFile'. The output is first
+    // written to a temporary file, which is renamed once complete, so that an interrupted conversion
+    // never leaves a truncated binary file behind.
+    static void Convert(const TextConfigHelper& config, const std::wstring& binaryFile);
+};
+
+}}}
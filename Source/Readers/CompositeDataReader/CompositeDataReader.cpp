@@ -18,6 +18,8 @@
 #include "FramePacker.h"
 #include "SequencePacker.h"
 #include "TruncatedBpttPacker.h"
+#include "LengthBucketer.h"
+#include "ReaderStageTimes.h"
 #include "CorpusDescriptor.h"
 #include "ConfigUtil.h"
 #include "StringUtil.h"
@@ -36,6 +38,7 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
 
     // We currently by default using numeric keys for ctf and image deserializers.
     bool useNumericSequenceKeys = ContainsDeserializer(config, L"CNTKTextFormatDeserializer") ||
+        ContainsDeserializer(config, L"CNTKBinaryFormatDeserializer") ||
         ContainsDeserializer(config, L"ImageDeserializer");
 
     useNumericSequenceKeys = config(L"useNumericSequenceKeys", useNumericSequenceKeys);
@@ -91,6 +94,13 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
         deserializer = std::make_shared<Bundler>(config, deserializer, m_deserializers, cleanse);
     }
 
+    // Optionally accounting the time spent in the different stages of the pipeline (used by the reader benchmark).
+    if (config(L"profileStages", false))
+    {
+        m_stageTimes = std::make_shared<ReaderStageTimes>();
+        deserializer = std::make_shared<TimedDeserializer>(deserializer, m_stageTimes);
+    }
+
     int verbosity = config(L"verbosity", 0);
 
     // Pick up the randomizer, always picking up no randomization for the write mode.
@@ -113,17 +123,44 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
 
         // By default using STL random number generator.
         bool useLegacyRandomization = config(L"useLegacyRandomization", false);
-        m_sequenceEnumerator = std::make_shared<BlockRandomizer>(verbosity, randomizationWindow, deserializer, true /* should Prefetch */, BlockRandomizer::DecimationMode::chunk, useLegacyRandomization, multiThreadedDeserialization);
+
+        // By default reading a single chunk ahead with a single thread.
+        // On file systems with high latency it makes sense to read more chunks ahead
+        // (and to load them concurrently if the deserializers support it).
+        size_t readAheadChunks = config(L"readAheadChunks", 1);
+        size_t readAheadMaxBytes = config(L"readAheadMaxBytes", 0);
+        size_t numReadAheadThreads = config(L"numReadAheadThreads", 1);
+        m_sequenceEnumerator = std::make_shared<BlockRandomizer>(verbosity, randomizationWindow, deserializer, true /* should Prefetch */, BlockRandomizer::DecimationMode::chunk, useLegacyRandomization, multiThreadedDeserialization,
+            readAheadChunks, readAheadMaxBytes, numReadAheadThreads);
     }
     else
     {
         m_sequenceEnumerator = std::make_shared<NoRandomizer>(deserializer, multiThreadedDeserialization);
     }
 
+    if (m_stageTimes)
+    {
+        m_sequenceEnumerator = std::make_shared<TimedSequenceEnumerator>(m_sequenceEnumerator, ReaderStage::randomize, m_stageTimes);
+    }
+
     // In case when there are transforms, applying them to the data.
-    m_sequenceEnumerator = m_transforms.empty()
-        ? m_sequenceEnumerator
-        : std::make_shared<TransformController>(m_transforms, m_sequenceEnumerator);
+    if (!m_transforms.empty())
+    {
+        m_sequenceEnumerator = std::make_shared<TransformController>(m_transforms, m_sequenceEnumerator);
+        if (m_stageTimes)
+        {
+            m_sequenceEnumerator = std::make_shared<TimedSequenceEnumerator>(m_sequenceEnumerator, ReaderStage::transform, m_stageTimes);
+        }
+    }
+
+    // Optionally grouping sequences of similar length into the same minibatch to reduce padding.
+    // Only makes sense when whole sequences are packed.
+    bool bucketing = !isActionWrite && m_packingMode == PackingMode::sequence && config(L"bucketing", false);
+    if (bucketing)
+    {
+        size_t bucketPoolSize = config(L"bucketPoolSize", 100);
+        m_sequenceEnumerator = std::make_shared<LengthBucketer>(m_sequenceEnumerator, bucketPoolSize);
+    }
 
     // TODO: Creating output stream descriptions - this should come from the network so that we can check 
     // that input matches what the network expects (including tensor shape, etc.).
@@ -149,7 +186,9 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
     case PackingMode::sequence:
         m_packer = std::make_shared<SequencePacker>(
             m_sequenceEnumerator,
-            m_streams);
+            m_streams,
+            2 /* numberOfBuffers */,
+            config(L"reportPaddingEfficiency", bucketing));
         break;
     case PackingMode::truncated:
     {
@@ -161,6 +200,11 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
     default:
         LogicError("Unsupported type of packer '%d'.", (int)m_packingMode);
     }
+
+    if (m_stageTimes)
+    {
+        m_packer = std::make_shared<TimedPacker>(m_packer, m_stageTimes);
+    }
 }
 
 std::vector<StreamDescriptionPtr> CompositeDataReader::GetStreamDescriptions()
@@ -36,6 +36,9 @@ typedef std::shared_ptr<StreamDescription> StreamDescriptionPtr;
 struct EpochConfiguration;
 struct Minibatch;
 
+class ReaderStageTimes;
+typedef std::shared_ptr<ReaderStageTimes> ReaderStageTimesPtr;
+
 // The whole CompositeDataReader is meant as a stopgap to allow deserializers/transformers composition until SGD talkes 
 // directly to the new Reader API. The example of the cntk configuration that this reader supports can be found at
 //     Tests/EndToEndTests/Speech/HtkDeserializers/LSTM/FullUtterance/cntk.cntk
@@ -63,6 +66,12 @@ public:
     // Starts a new epoch with the provided configuration
     void StartEpoch(const EpochConfiguration& config, const std::map<std::wstring, int>& inputDescriptions) override;
 
+    // Time spent in the stages of the pipeline, nullptr unless profileStages is set in the config.
+    ReaderStageTimesPtr GetStageTimes() const
+    {
+        return m_stageTimes;
+    }
+
 private:
     void CreateDeserializers(const ConfigParameters& readerConfig);
     void CreateTransforms(const ConfigParameters& deserializerConfig);
@@ -99,6 +108,9 @@ private:
 
     // Truncation length for BPTT mode.
     size_t m_truncationLength;
+
+    // Time spent in the stages of the pipeline.
+    ReaderStageTimesPtr m_stageTimes;
 };
 
 }}}
@@ -7,13 +7,52 @@
 
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <functional>
 #include "DataDeserializer.h"
 #include "../HTKMLFReader/htkfeatio.h"
 #include "UtteranceDescription.h"
+#include "MemoryMappedFile.h"
 #include "ssematrix.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Frames of an utterance, viewed as a vector of column vectors (one per frame).
+// Does not have any memory associated, points either into the frames matrix of the chunk
+// or into the memory mapped archive file.
+class UtteranceFrames
+{
+public:
+    UtteranceFrames(const float* data, size_t dimension, size_t numberOfFrames, size_t frameStride)
+        : m_data(data), m_dimension(dimension), m_numberOfFrames(numberOfFrames), m_frameStride(frameStride)
+    {
+    }
+
+    size_t size() const
+    {
+        return m_numberOfFrames;
+    }
+
+    const_array_ref<float> operator[](size_t j) const
+    {
+        return const_array_ref<float>(m_data + j * m_frameStride, m_dimension);
+    }
+
+    // Whether the frames are stored without padding between them, i.e. can be exposed as dense sequence data as is.
+    bool IsContiguous() const
+    {
+        return m_frameStride == m_dimension;
+    }
+
+private:
+    const float* m_data;
+    size_t m_dimension;
+    size_t m_numberOfFrames;
+    size_t m_frameStride;
+};
+
+// Returns a (shared) memory mapping of the given archive file.
+typedef std::function<MemoryMappedFilePtr(const std::wstring&)> MapFileFunction;
+
 // Class represents a description of an HTK chunk.
 // It is only used internally by the HTK deserializer.
 // Can exist without associated data and provides methods for requiring/releasing chunk data.
@@ -26,6 +65,21 @@ class HTKChunkDescription
     // Stores all frames of the chunk consecutively (mutable since this is a cache).
     mutable msra::dbn::matrix m_frames;
 
+    // Location of the frames of an utterance inside a memory mapped archive file.
+    struct MappedUtterance
+    {
+        MemoryMappedFilePtr m_file;
+        size_t m_offset;
+        size_t m_size;
+    };
+
+    // Alternatively to m_frames, the frames of all utterances can be used in place from the memory mapped
+    // archive files (if they are stored there as plain floats). Indexed by utterance.
+    mutable std::vector<MappedUtterance> m_mappedUtterances;
+
+    // Feature dimension of the data in memory.
+    mutable size_t m_dimension = 0;
+
     // First frames of all utterances. m_firstFrames[utteranceIndex] == index of the first frame of the utterance.
     // Size of m_firstFrames should be equal to the number of utterances.
     std::vector<size_t> m_firstFrames;
@@ -103,22 +157,37 @@ public:
     }
 
     // Returns all frames of a given utterance.
-    msra::dbn::matrixstripe GetUtteranceFrames(size_t index) const
+    UtteranceFrames GetUtteranceFrames(size_t index) const
     {
         if (!IsInRam())
         {
             LogicError("GetUtteranceFrames was called when data have not yet been paged in.");
         }
 
-        const size_t ts = m_firstFrames[index];
         const size_t n = m_utterances[index].GetNumberOfFrames();
-        return msra::dbn::matrixstripe(m_frames, ts, n);
+        if (!m_mappedUtterances.empty())
+        {
+            const auto& mapped = m_mappedUtterances[index];
+            return UtteranceFrames((const float*)(mapped.m_file->Data() + mapped.m_offset), m_dimension, n, m_dimension);
+        }
+
+        const size_t ts = m_firstFrames[index];
+        return UtteranceFrames(&m_frames(0, ts), m_dimension, n, m_frames.getcolstride());
+    }
+
+    // Returns the mapped file the frames of the given utterance point into, nullptr if the chunk is not memory mapped.
+    // Sequences pointing into the mapping have to keep a reference to it.
+    MemoryMappedFilePtr GetMappedFile(size_t index) const
+    {
+        return m_mappedUtterances.empty() ? nullptr : m_mappedUtterances[index].m_file;
     }
 
     // Pages-in the data for this chunk.
     // this function supports retrying since we read from the unreliable network, i.e. do not return in a broken state
     // We pass in the feature info variables to check that that data being read has expected properties.
-    void RequireData(const string& featureKind, size_t featureDimension, unsigned int samplePeriod, int verbosity = 0) const
+    // If mapFile is given, the frames are used in place from the memory mapped archive files when they are stored
+    // there as plain floats, otherwise (or if some utterance of the chunk is not) they are read into memory.
+    void RequireData(const string& featureKind, size_t featureDimension, unsigned int samplePeriod, int verbosity = 0, const MapFileFunction& mapFile = nullptr) const
     {
         if (GetNumberOfUtterances() == 0)
         {
@@ -135,13 +204,27 @@ public:
             // feature reader (we reinstantiate it for each block, i.e. we reopen the file actually)
             // if this is the first feature read ever, we explicitly open the first file to get the information such as feature dimension
             msra::asr::htkfeatreader reader;
+            m_dimension = featureDimension;
+
+            if (mapFile && MapData(reader, featureKind, featureDimension, samplePeriod, mapFile))
+            {
+                if (verbosity)
+                {
+                    fprintf(stderr, "HTKChunkDescription::RequireData: mapped physical chunk %u (%" PRIu64 " utterances, %" PRIu64 " frames, %" PRIu64 " bytes)\n",
+                            m_chunkId,
+                            m_utterances.size(),
+                            m_totalFrames,
+                            sizeof(float) * featureDimension * m_totalFrames);
+                }
+                return;
+            }
 
             // read all utterances; if they are in the same archive, htkfeatreader will be efficient in not closing the file
             m_frames.resize(featureDimension, m_totalFrames);
             foreach_index(i, m_utterances)
             {
                 // read features for this file
-                auto framesWrapper = GetUtteranceFrames(i);
+                auto framesWrapper = msra::dbn::matrixstripe(m_frames, m_firstFrames[i], m_utterances[i].GetNumberOfFrames());
                 reader.read(m_utterances[i].GetPath(), featureKind, samplePeriod, framesWrapper);
             }
 
@@ -158,6 +241,7 @@ public:
         {
             // Releasing all data
             m_frames.resize(0, 0);
+            m_mappedUtterances.clear();
             throw;
         }
     }
@@ -181,18 +265,74 @@ public:
                     m_chunkId,
                     m_utterances.size(),
                     m_totalFrames,
-                    sizeof(float) * m_frames.rows() * m_frames.cols());
+                    sizeof(float) * m_dimension * m_totalFrames);
         }
 
+        // The pages of the mapped frames are dropped from the working set, sequences that still
+        // point into the mapping (keeping a reference to the file) page them in again when accessed.
+        ForEachMappedRange([](const MemoryMappedFilePtr& file, size_t offset, size_t size) { file->Release(offset, size); });
+
         // release frames
         m_frames.resize(0, 0);
+        m_mappedUtterances.clear();
     }
 
     private:
         // test if data is in memory at the moment
         bool IsInRam() const
         {
-            return !m_frames.empty();
+            return !m_frames.empty() || !m_mappedUtterances.empty();
+        }
+
+        // Maps the frames of all utterances of the chunk in place, returns false (without mapping anything)
+        // if the frames of some utterance cannot be used as they are stored in the archive.
+        bool MapData(msra::asr::htkfeatreader& reader, const string& featureKind, size_t featureDimension, unsigned int samplePeriod, const MapFileFunction& mapFile) const
+        {
+            std::vector<MappedUtterance> mapped;
+            mapped.reserve(m_utterances.size());
+            std::wstring path;
+            uint64_t offset;
+            for (const auto& utterance : m_utterances)
+            {
+                if (!reader.getrawlocation(utterance.GetPath(), featureKind, samplePeriod, featureDimension, utterance.GetNumberOfFrames(), path, offset))
+                {
+                    return false;
+                }
+
+                // Utterances of a chunk are usually stored in the same archive, reuse its mapping.
+                MemoryMappedFilePtr file = (!mapped.empty() && mapped.back().m_file->Path() == path) ? mapped.back().m_file : mapFile(path);
+                size_t size = sizeof(float) * featureDimension * utterance.GetNumberOfFrames();
+                if (offset > file->Size() || size > file->Size() - offset)
+                {
+                    RuntimeError("HTKChunkDescription::RequireData: frames of an utterance exceed the end of the archive '%ls'.", path.c_str());
+                }
+
+                mapped.push_back(MappedUtterance { file, (size_t)offset, size });
+            }
+
+            m_mappedUtterances = std::move(mapped);
+
+            // The chunks are required in the randomized order, let the OS read ahead what is going to be used next.
+            ForEachMappedRange([](const MemoryMappedFilePtr& file, size_t offset, size_t size) { file->Prefetch(offset, size); });
+            return true;
+        }
+
+        // Calls the function for the mapped byte ranges of the chunk, merging the ranges of consecutive utterances.
+        template <class F>
+        void ForEachMappedRange(F f) const
+        {
+            size_t i = 0;
+            while (i < m_mappedUtterances.size())
+            {
+                const auto& first = m_mappedUtterances[i];
+                size_t end = first.m_offset + first.m_size;
+                for (++i; i < m_mappedUtterances.size() && m_mappedUtterances[i].m_file == first.m_file && m_mappedUtterances[i].m_offset == end; ++i)
+                {
+                    end += m_mappedUtterances[i].m_size;
+                }
+
+                f(first.m_file, first.m_offset, end - first.m_offset);
+            }
         }
 };
 
@@ -48,6 +48,7 @@ HTKDataDeserializer::HTKDataDeserializer(
     std::wstring precision = cfg(L"precision", L"float");
 
     m_expandToPrimary = cfg(L"expandToUtterance", false);
+    m_memoryMap = cfg(L"memoryMap", true);
     if (m_expandToPrimary && m_primary)
     {
         InvalidArgument("Cannot expand utterances of the primary stream %ls, please change your configuration.", inputName.c_str());
@@ -93,6 +94,7 @@ HTKDataDeserializer::HTKDataDeserializer(
     m_dimension = m_dimension * (1 + context.first + context.second);
 
     m_expandToPrimary = feature(L"expandToUtterance", false);
+    m_memoryMap = feature(L"memoryMap", true);
     if (m_expandToPrimary && m_primary)
     {
         InvalidArgument("Cannot expand utterances of the primary stream %ls, please change your configuration.", featureName.c_str());
@@ -299,31 +301,18 @@ void HTKDataDeserializer::GetSequencesForChunk(ChunkIdType chunkId, vector<Seque
     }
 }
 
-// A wrapper around a matrix that views it as a vector of column vectors.
-// Does not have any memory associated.
-class MatrixAsVectorOfVectors
+MemoryMappedFilePtr HTKDataDeserializer::MapFile(const wstring& path)
 {
-public:
-    MatrixAsVectorOfVectors(msra::dbn::matrixbase& m)
-        : m_matrix(m)
-    {
-    }
-
-    size_t size() const
+    lock_guard<mutex> lock(m_mappedFilesLock);
+    auto& entry = m_mappedFiles[path];
+    auto file = entry.lock();
+    if (!file)
     {
-        return m_matrix.cols();
+        file = make_shared<MemoryMappedFile>(path);
+        entry = file;
     }
-
-    const_array_ref<float> operator[](size_t j) const
-    {
-        return array_ref<float>(&m_matrix(0, j), m_matrix.rows());
-    }
-
-private:
-    DISABLE_COPY_AND_MOVE(MatrixAsVectorOfVectors);
-    msra::dbn::matrixbase& m_matrix;
-};
-
+    return file;
+}
 
 // Represents a chunk data in memory. Given up to the randomizer.
 // It is up to the randomizer to decide when to release a particular chunk.
@@ -336,9 +325,15 @@ public:
 
         // possibly distributed read
         // making several attempts
+        MapFileFunction mapFile;
+        if (m_parent->m_memoryMap)
+        {
+            mapFile = [this](const wstring& path) { return m_parent->MapFile(path); };
+        }
+
         msra::util::attempt(5, [&]()
         {
-            chunkDescription.RequireData(m_parent->m_featureKind, m_parent->m_ioFeatureDimension, m_parent->m_samplePeriod, m_parent->m_verbosity);
+            chunkDescription.RequireData(m_parent->m_featureKind, m_parent->m_ioFeatureDimension, m_parent->m_samplePeriod, m_parent->m_verbosity, mapFile);
         });
     }
 
@@ -453,6 +448,29 @@ private:
     std::vector<double> m_buffer;
 };
 
+// This class stores sequence data for HTK floats that point into a memory mapped archive file.
+struct HTKMappedSequenceData : DenseSequenceData
+{
+    HTKMappedSequenceData(const float* data, size_t numberOfSamples, MemoryMappedFilePtr file) : m_data(data), m_file(file)
+    {
+        m_numberOfSamples = (uint32_t)numberOfSamples;
+        if (m_numberOfSamples != numberOfSamples)
+        {
+            RuntimeError("Maximum number of samples per sequence exceeded.");
+        }
+    }
+
+    const void* GetDataBuffer() override
+    {
+        return m_data;
+    }
+
+private:
+    const float* m_data;
+    // Keeps the mapping alive, the chunk can be released before the sequence.
+    MemoryMappedFilePtr m_file;
+};
+
 // Copies a source into a destination with the specified destination offset.
 static void CopyToOffset(const const_array_ref<float>& source, array_ref<float>& destination, size_t offset)
 {
@@ -463,7 +481,7 @@ static void CopyToOffset(const const_array_ref<float>& source, array_ref<float>&
 // TODO: Move augmentation to the separate class outside of deserializer.
 // TODO: Check the CNTK Book why different left and right extents are not supported.
 // Augments a frame with a given index with frames to the left and right of it.
-static void AugmentNeighbors(const MatrixAsVectorOfVectors& utterance,
+static void AugmentNeighbors(const UtteranceFrames& utterance,
                              size_t frameIndex,
                              const size_t leftExtent,
                              const size_t rightExtent,
@@ -493,10 +511,19 @@ void HTKDataDeserializer::GetSequenceById(ChunkIdType chunkId, size_t id, vector
     const auto& chunkDescription = m_chunks[chunkId];
     size_t utteranceIndex = m_frameMode ? chunkDescription.GetUtteranceForChunkFrameIndex(id) : id;
     const UtteranceDescription* utterance = chunkDescription.GetUtterance(utteranceIndex);
-    auto utteranceFrames = chunkDescription.GetUtteranceFrames(utteranceIndex);
+    auto utteranceFramesWrapper = chunkDescription.GetUtteranceFrames(utteranceIndex);
+
+    // Without augmentation, the frames of a memory mapped chunk are used in place.
+    auto mappedFile = chunkDescription.GetMappedFile(utteranceIndex);
+    if (mappedFile && m_elementType == ElementType::tfloat && !m_expandToPrimary &&
+        m_augmentationWindow.first == 0 && m_augmentationWindow.second == 0 && utteranceFramesWrapper.IsContiguous())
+    {
+        size_t frameIndex = m_frameMode ? id - chunkDescription.GetStartFrameIndexInsideChunk(utteranceIndex) : 0;
+        size_t numberOfFrames = m_frameMode ? 1 : utterance->GetNumberOfFrames();
+        r.push_back(make_shared<HTKMappedSequenceData>(utteranceFramesWrapper[frameIndex].begin(), numberOfFrames, mappedFile));
+        return;
+    }
 
-    // wrapper that allows m[j].size() and m[j][i] as required by augmentneighbors()
-    MatrixAsVectorOfVectors utteranceFramesWrapper(utteranceFrames);
     size_t utteranceLength = m_frameMode ? 1  : (m_expandToPrimary ? utterance->GetExpansionLength() : utterance->GetNumberOfFrames());
     FeatureMatrix features(m_dimension, utteranceLength);
 
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <mutex>
 #include "DataDeserializerBase.h"
 #include "Config.h"
 #include "CorpusDescriptor.h"
@@ -50,6 +51,9 @@ private:
     // Gets sequence by its chunk id and id inside the chunk.
     void GetSequenceById(ChunkIdType chunkId, size_t id, std::vector<SequenceDataPtr>&);
 
+    // Returns a memory mapping of the archive file, shared between all chunks that use it.
+    MemoryMappedFilePtr MapFile(const std::wstring& path);
+
     // Dimension of features.
     size_t m_dimension;
 
@@ -85,6 +89,13 @@ private:
     size_t m_ioFeatureDimension = 0;
     std::string m_featureKind;
 
+    // Flag that indicates whether the archive files should be memory mapped instead of reading chunks into memory.
+    bool m_memoryMap;
+
+    // Currently mapped archive files. The mappings are owned by the chunks and sequences that use them.
+    std::map<std::wstring, std::weak_ptr<MemoryMappedFile>> m_mappedFiles;
+    std::mutex m_mappedFilesLock;
+
     // A flag that indicates whether the utterance should be extended to match the lenght of the utterance from the primary deserializer.
     // TODO: This should be moved to the packers when deserializers work in sequence mode only.
     bool m_expandToPrimary;
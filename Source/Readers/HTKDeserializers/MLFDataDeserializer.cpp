@@ -10,9 +10,6 @@
 #include "MLFDataDeserializer.h"
 #include "ConfigHelper.h"
 #include "SequenceData.h"
-#include "../HTKMLFReader/htkfeatio.h"
-#include "../HTKMLFReader/msra_mgram.h"
-#include "latticearchive.h"
 #include "StringUtil.h"
 
 
@@ -30,13 +27,24 @@ static double s_oneDouble = 1.0;
 class MLFDataDeserializer::MLFChunk : public Chunk
 {
     MLFDataDeserializer* m_parent;
+
 public:
     MLFChunk(MLFDataDeserializer* parent) : m_parent(parent)
-    {}
+    {
+    }
 
     virtual void GetSequence(size_t sequenceId, vector<SequenceDataPtr>& result) override
     {
-        m_parent->GetSequenceById(sequenceId, result);
+        if (m_parent->m_frameMode)
+        {
+            size_t label = m_parent->GetClassIdOfFrame(sequenceId);
+            assert(label < m_parent->m_categories.size());
+            result.push_back(m_parent->m_categories[label]);
+        }
+        else
+        {
+            m_parent->GetSequenceById(sequenceId, result);
+        }
     }
 };
 
@@ -75,7 +83,8 @@ MLFDataDeserializer::MLFDataDeserializer(CorpusDescriptorPtr corpus, const Confi
     size_t dimension = config.GetLabelDimension();
 
     wstring labelMappingFile = streamConfig(L"labelMappingFile", L"");
-    InitializeChunkDescriptions(corpus, config, labelMappingFile, dimension);
+    bool cacheLabels = streamConfig(L"cacheLabels", false);
+    InitializeChunkDescriptions(corpus, config, labelMappingFile, dimension, cacheLabels);
     InitializeStream(inputName, dimension);
 }
 
@@ -101,96 +110,92 @@ MLFDataDeserializer::MLFDataDeserializer(CorpusDescriptorPtr corpus, const Confi
     m_elementType = AreEqualIgnoreCase(precision, L"float") ? ElementType::tfloat : ElementType::tdouble;
 
     wstring labelMappingFile = labelConfig(L"labelMappingFile", L"");
-    InitializeChunkDescriptions(corpus, config, labelMappingFile, dimension);
+    bool cacheLabels = labelConfig(L"cacheLabels", false);
+    InitializeChunkDescriptions(corpus, config, labelMappingFile, dimension, cacheLabels);
     InitializeStream(name, dimension);
 }
 
 // Currently we create a single chunk only.
-void MLFDataDeserializer::InitializeChunkDescriptions(CorpusDescriptorPtr corpus, const ConfigHelper& config, const wstring& stateListPath, size_t dimension)
+// With cacheLabels, the labels are stored in a binary archive next to the first MLF file,
+// which is used instead of parsing the MLF files as long as they do not change.
+void MLFDataDeserializer::InitializeChunkDescriptions(CorpusDescriptorPtr corpus, const ConfigHelper& config, const wstring& stateListPath, size_t dimension, bool cacheLabels)
 {
-    // TODO: Similarly to the old reader, currently we assume all Mlfs will have same root name (key)
-    // restrict MLF reader to these files--will make stuff much faster without having to use shortened input files
-
-    // TODO: currently we do not use symbol and word tables.
-    const msra::lm::CSymbolSet* wordTable = nullptr;
-    unordered_map<const char*, int>* symbolTable = nullptr;
     vector<wstring> mlfPaths = config.GetMlfPaths();
+    if (cacheLabels)
+    {
+        vector<wstring> sources = mlfPaths;
+        if (!stateListPath.empty())
+        {
+            sources.push_back(stateListPath);
+        }
 
-    // TODO: Currently we still use the old IO module. This will be refactored later.
-    const double htkTimeToFrame = 100000.0; // default is 10ms
-    msra::asr::htkmlfreader<msra::asr::htkmlfentry, msra::lattices::lattice::htkmlfwordsequence> labels(mlfPaths, set<wstring>(), stateListPath, wordTable, symbolTable, htkTimeToFrame);
-
-    // Make sure 'msra::asr::htkmlfreader' type has a move constructor
-    static_assert(
-        is_move_constructible<
-        msra::asr::htkmlfreader<msra::asr::htkmlfentry,
-        msra::lattices::lattice::htkmlfwordsequence >> ::value,
-        "Type 'msra::asr::htkmlfreader' should be move constructible!");
+        // The archive contains all utterances, independent of the corpus.
+        wstring archivePath = mlfPaths.front() + L".labelcache";
+        m_labels = MLFLabelArchive::Load(archivePath, sources);
+        if (!m_labels)
+        {
+            m_labels = MLFLabelArchive::Parse(mlfPaths, stateListPath);
+            if (!m_labels->Write(archivePath, sources))
+            {
+                fprintf(stderr, "WARNING: Could not write the label archive '%ls', the MLF files will be parsed again next time.\n", archivePath.c_str());
+            }
+        }
+    }
+    else
+    {
+        m_labels = MLFLabelArchive::Parse(mlfPaths, stateListPath, [&corpus](const string& key) { return corpus->IsIncluded(key); });
+    }
 
-    MLFUtterance description;
     size_t numClasses = 0;
     size_t totalFrames = 0;
+    const MLFLabelArchive::Run* runs = m_labels->GetRuns();
 
     // TODO resize m_keyToSequence with number of IDs from string registry
-    for (const auto& l : labels)
+    for (size_t i = 0; i < m_labels->GetNumberOfUtterances(); ++i)
     {
-        auto key = msra::strfun::utf8(l.first);
+        const auto& utterance = m_labels->GetUtterance(i);
+        auto key = m_labels->GetKey(utterance);
         if (!corpus->IsIncluded(key))
             continue;
 
         size_t id = corpus->KeyToId(key);
-        description.m_key.m_sequence = id;
-
-        const auto& utterance = l.second;
-        description.m_sequenceStart = m_classIds.size();
-        uint32_t numberOfFrames = 0;
-
-        foreach_index(i, utterance)
+        if (m_frameMode)
         {
-            const auto& timespan = utterance[i];
-            if ((i == 0 && timespan.firstframe != 0) ||
-                (i > 0 && utterance[i - 1].firstframe + utterance[i - 1].numframes != timespan.firstframe))
-            {
-                RuntimeError("Labels are not in the consecutive order MLF in label set: %ls", l.first.c_str());
-            }
-
-            if (timespan.classid >= dimension)
-            {
-                RuntimeError("Class id %d exceeds the model output dimension %d.", (int)timespan.classid, (int)dimension);
-            }
-
-            if (timespan.classid != static_cast<msra::dbn::CLASSIDTYPE>(timespan.classid))
-            {
-                RuntimeError("CLASSIDTYPE has too few bits");
-            }
+            m_utteranceFirstRunEnd.push_back(m_runEnds.size());
+        }
 
-            if (SEQUENCELEN_MAX < timespan.firstframe + timespan.numframes)
+        for (size_t run = utterance.m_firstRun, frames = 0; frames < utterance.m_numberOfFrames; ++run)
+        {
+            if (runs[run].m_classId >= dimension)
             {
-                RuntimeError("Maximum number of sample per sequence exceeded.");
+                RuntimeError("Class id %d exceeds the model output dimension %d.", (int)runs[run].m_classId, (int)dimension);
             }
 
-            numClasses = max(numClasses, (size_t)(1u + timespan.classid));
-
-            for (size_t t = timespan.firstframe; t < timespan.firstframe + timespan.numframes; t++)
+            numClasses = max(numClasses, (size_t)(1u + runs[run].m_classId));
+            frames += runs[run].m_numberOfFrames;
+            if (m_frameMode)
             {
-                m_classIds.push_back(timespan.classid);
-                numberOfFrames++;
+                m_runEnds.push_back(static_cast<uint32_t>(frames));
             }
         }
 
-        description.m_numberOfSamples = numberOfFrames;
         m_utteranceIndex.push_back(totalFrames);
-        totalFrames += numberOfFrames;
+        m_utteranceFirstRun.push_back(utterance.m_firstRun);
+        totalFrames += utterance.m_numberOfFrames;
 
-        if (m_keyToSequence.size() <= description.m_key.m_sequence)
+        if (m_keyToSequence.size() <= id)
         {
-            m_keyToSequence.resize(description.m_key.m_sequence + 1, SIZE_MAX);
+            m_keyToSequence.resize(id + 1, SIZE_MAX);
         }
-        assert(m_keyToSequence[description.m_key.m_sequence] == SIZE_MAX);
-        m_keyToSequence[description.m_key.m_sequence] = m_utteranceIndex.size() - 1;
+        assert(m_keyToSequence[id] == SIZE_MAX);
+        m_keyToSequence[id] = m_utteranceIndex.size() - 1;
         m_numberOfSequences++;
     }
     m_utteranceIndex.push_back(totalFrames);
+    if (m_frameMode)
+    {
+        m_utteranceFirstRunEnd.push_back(m_runEnds.size());
+    }
 
     m_totalNumberOfFrames = totalFrames;
 
@@ -294,38 +299,73 @@ struct MLFSequenceData : SparseSequenceData
     }
 };
 
-void MLFDataDeserializer::GetSequenceById(size_t sequenceId, vector<SequenceDataPtr>& result)
+size_t MLFDataDeserializer::GetClassIdOfFrame(size_t frameIndex) const
 {
-    if (m_frameMode)
+    assert(m_frameMode && frameIndex < m_totalNumberOfFrames);
+
+    // The utterance is the last one that starts at or before the frame.
+    size_t utterance = 0, last = m_numberOfSequences; // m_utteranceIndex[utterance] <= frameIndex < m_utteranceIndex[last]
+    while (last - utterance > 1)
     {
-        size_t label = m_classIds[sequenceId];
-        assert(label < m_categories.size());
-        result.push_back(m_categories[label]);
+        size_t middle = (utterance + last) / 2;
+        if (m_utteranceIndex[middle] <= frameIndex)
+        {
+            utterance = middle;
+        }
+        else
+        {
+            last = middle;
+        }
     }
-    else
+
+    // The run is the first one of the utterance that ends after the frame.
+    size_t frame = frameIndex - m_utteranceIndex[utterance];
+    size_t firstRunEnd = m_utteranceFirstRunEnd[utterance];
+    size_t begin = firstRunEnd, end = m_utteranceFirstRunEnd[utterance + 1];
+    while (begin < end)
     {
-        // Packing labels for the utterance into sparse sequence.
-        size_t startFrameIndex = m_utteranceIndex[sequenceId];
-        size_t numberOfSamples = m_utteranceIndex[sequenceId + 1] - startFrameIndex;
-        SparseSequenceDataPtr s;
-        if (m_elementType == ElementType::tfloat)
+        size_t middle = (begin + end) / 2;
+        if (m_runEnds[middle] <= frame)
         {
-            s = make_shared<MLFSequenceData<float>>(numberOfSamples);
+            begin = middle + 1;
         }
         else
         {
-            assert(m_elementType == ElementType::tdouble);
-            s = make_shared<MLFSequenceData<double>>(numberOfSamples);
+            end = middle;
         }
+    }
+
+    return m_labels->GetRuns()[m_utteranceFirstRun[utterance] + (begin - firstRunEnd)].m_classId;
+}
+
+void MLFDataDeserializer::GetSequenceById(size_t sequenceId, vector<SequenceDataPtr>& result)
+{
+    assert(!m_frameMode); // frames are served by the chunk
 
-        for (size_t i = 0; i < numberOfSamples; i++)
+    // Packing labels for the utterance into sparse sequence.
+    size_t startFrameIndex = m_utteranceIndex[sequenceId];
+    size_t numberOfSamples = m_utteranceIndex[sequenceId + 1] - startFrameIndex;
+    SparseSequenceDataPtr s;
+    if (m_elementType == ElementType::tfloat)
+    {
+        s = make_shared<MLFSequenceData<float>>(numberOfSamples);
+    }
+    else
+    {
+        assert(m_elementType == ElementType::tdouble);
+        s = make_shared<MLFSequenceData<double>>(numberOfSamples);
+    }
+
+    // Expanding the label runs of the utterance.
+    const MLFLabelArchive::Run* run = m_labels->GetRuns() + m_utteranceFirstRun[sequenceId];
+    for (size_t i = 0; i < numberOfSamples; ++run)
+    {
+        for (size_t end = min(numberOfSamples, i + run->m_numberOfFrames); i < end; ++i)
         {
-            size_t frameIndex = startFrameIndex + i;
-            size_t label = m_classIds[frameIndex];
-            s->m_indices[i] = static_cast<IndexType>(label);
+            s->m_indices[i] = static_cast<IndexType>(run->m_classId);
         }
-        result.push_back(s);
     }
+    result.push_back(s);
 }
 
 bool MLFDataDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
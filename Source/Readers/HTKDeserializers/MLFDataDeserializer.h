@@ -9,6 +9,7 @@
 #include "HTKDataDeserializer.h"
 #include "../HTKMLFReader/biggrowablevectors.h"
 #include "CorpusDescriptor.h"
+#include "MLFLabelArchive.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -41,7 +42,7 @@ private:
     class MLFChunk;
     DISABLE_COPY_AND_MOVE(MLFDataDeserializer);
 
-    void InitializeChunkDescriptions(CorpusDescriptorPtr corpus, const ConfigHelper& config, const std::wstring& stateListPath, size_t dimension);
+    void InitializeChunkDescriptions(CorpusDescriptorPtr corpus, const ConfigHelper& config, const std::wstring& stateListPath, size_t dimension, bool cacheLabels);
     void InitializeStream(const std::wstring& name, size_t dimension);
 
     void GetSequenceById(size_t sequenceId, std::vector<SequenceDataPtr>& result);
@@ -54,12 +55,24 @@ private:
     // Number of sequences
     size_t m_numberOfSequences = 0;
 
-    // Array of all labels.
-    msra::dbn::biggrowablevector<msra::dbn::CLASSIDTYPE> m_classIds;
+    // Class id of a frame in frame mode, found by a binary search for its utterance and then for its label run.
+    size_t GetClassIdOfFrame(size_t frameIndex) const;
 
-    // Index of utterances in the m_classIds.
+    // Run-length encoded labels of all utterances (possibly memory mapped).
+    MLFLabelArchivePtr m_labels;
+
+    // Index of utterances in frames (the first frame of each utterance, plus the total number of frames at the end).
     msra::dbn::biggrowablevector<size_t> m_utteranceIndex;
 
+    // First label run of each utterance in m_labels.
+    msra::dbn::biggrowablevector<size_t> m_utteranceFirstRun;
+
+    // In frame mode, the end of each label run of the utterances, in frames from the start of its utterance.
+    // The runs of utterance i are m_runEnds[m_utteranceFirstRunEnd[i]] up to (excluding) m_runEnds[m_utteranceFirstRunEnd[i + 1]].
+    // This takes memory per run rather than per frame, and leaves the labels themselves in the (possibly mapped) archive.
+    msra::dbn::biggrowablevector<uint32_t> m_runEnds;
+    msra::dbn::biggrowablevector<size_t> m_utteranceFirstRunEnd;
+
     // Type of the data this serializer provides.
     ElementType m_elementType;
 
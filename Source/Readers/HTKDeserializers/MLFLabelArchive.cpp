@@ -0,0 +1,329 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "MLFLabelArchive.h"
+#include "DataDeserializer.h"
+#include "../HTKMLFReader/htkfeatio.h"
+#include "../HTKMLFReader/msra_mgram.h"
+#include "latticearchive.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+// Layout of the archive: the header, SourceEntry x m_numberOfSources, Utterance x m_numberOfUtterances,
+// Run x m_numberOfRuns and the key table (m_keysSize bytes).
+static const char ArchiveMagic[8] = { 'M', 'L', 'F', 'L', 'A', 'B', 'E', 'L' };
+static const uint32_t ArchiveVersion = 1;
+
+struct ArchiveHeader
+{
+    char m_magic[8];
+    uint32_t m_version;
+    uint32_t m_numberOfSources;
+    uint64_t m_numberOfUtterances;
+    uint64_t m_numberOfRuns;
+    uint64_t m_keysSize;
+};
+
+// Describes a source file the archive was built from.
+struct SourceEntry
+{
+    uint64_t m_size;
+    int64_t m_modificationTime;
+    uint64_t m_checksum;
+};
+
+// FNV-1a over 64-bit words (and the remaining bytes).
+static uint64_t Checksum(const char* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash ^= word;
+        hash *= 1099511628211ULL;
+    }
+    for (; i < size; ++i)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Gets the size and the modification time of the file, returns false if it does not exist.
+static bool GetFileStatus(const wstring& path, SourceEntry& entry)
+{
+#ifdef _WIN32
+    struct _stat64 status;
+    if (_wstat64(path.c_str(), &status) != 0)
+        return false;
+#else
+    struct stat status;
+    if (stat(msra::strfun::utf8(path).c_str(), &status) != 0)
+        return false;
+#endif
+    entry.m_size = status.st_size;
+    entry.m_modificationTime = status.st_mtime;
+    return true;
+}
+
+static uint64_t GetFileChecksum(const wstring& path)
+{
+    MemoryMappedFile file(path);
+    file.Advise(0, file.Size(), MemoryMappedFile::AccessPattern::sequential);
+    return Checksum(file.Data(), file.Size());
+}
+
+MLFLabelArchive::MLFLabelArchive()
+    : m_utterances(nullptr), m_numberOfUtterances(0), m_runs(nullptr), m_numberOfRuns(0), m_keys(nullptr), m_keysSize(0)
+{
+}
+
+void MLFLabelArchive::PointToStorage()
+{
+    m_utterances = m_utteranceStorage.data();
+    m_numberOfUtterances = m_utteranceStorage.size();
+    m_runs = m_runStorage.data();
+    m_numberOfRuns = m_runStorage.size();
+    m_keys = m_keyStorage.data();
+    m_keysSize = m_keyStorage.size();
+}
+
+MLFLabelArchivePtr MLFLabelArchive::Parse(const vector<wstring>& mlfPaths, const wstring& stateListPath, const function<bool(const string&)>& isIncluded)
+{
+    // TODO: Similarly to the old reader, currently we assume all Mlfs will have same root name (key)
+    // restrict MLF reader to these files--will make stuff much faster without having to use shortened input files
+
+    // TODO: currently we do not use symbol and word tables.
+    const msra::lm::CSymbolSet* wordTable = nullptr;
+    unordered_map<const char*, int>* symbolTable = nullptr;
+
+    // TODO: Currently we still use the old IO module. This will be refactored later.
+    const double htkTimeToFrame = 100000.0; // default is 10ms
+    msra::asr::htkmlfreader<msra::asr::htkmlfentry, msra::lattices::lattice::htkmlfwordsequence> labels(mlfPaths, set<wstring>(), stateListPath, wordTable, symbolTable, htkTimeToFrame);
+
+    // Make sure 'msra::asr::htkmlfreader' type has a move constructor
+    static_assert(
+        is_move_constructible<
+        msra::asr::htkmlfreader<msra::asr::htkmlfentry,
+        msra::lattices::lattice::htkmlfwordsequence >> ::value,
+        "Type 'msra::asr::htkmlfreader' should be move constructible!");
+
+    MLFLabelArchivePtr result(new MLFLabelArchive());
+    for (const auto& l : labels)
+    {
+        auto key = msra::strfun::utf8(l.first);
+        if (isIncluded && !isIncluded(key))
+            continue;
+
+        Utterance description;
+        description.m_keyOffset = result->m_keyStorage.size();
+        description.m_keyLength = (uint32_t)key.size();
+        description.m_firstRun = result->m_runStorage.size();
+        result->m_keyStorage += key;
+
+        const auto& utterance = l.second;
+        uint32_t numberOfFrames = 0;
+        foreach_index(i, utterance)
+        {
+            const auto& timespan = utterance[i];
+            if ((i == 0 && timespan.firstframe != 0) ||
+                (i > 0 && utterance[i - 1].firstframe + utterance[i - 1].numframes != timespan.firstframe))
+            {
+                RuntimeError("Labels are not in the consecutive order MLF in label set: %ls", l.first.c_str());
+            }
+
+            if (timespan.classid != static_cast<msra::dbn::CLASSIDTYPE>(timespan.classid))
+            {
+                RuntimeError("CLASSIDTYPE has too few bits");
+            }
+
+            if (SEQUENCELEN_MAX < timespan.firstframe + timespan.numframes)
+            {
+                RuntimeError("Maximum number of sample per sequence exceeded.");
+            }
+
+            if (timespan.numframes == 0)
+            {
+                continue;
+            }
+
+            auto& runs = result->m_runStorage;
+            if (runs.size() > description.m_firstRun && runs.back().m_classId == timespan.classid)
+            {
+                runs.back().m_numberOfFrames += timespan.numframes;
+            }
+            else
+            {
+                runs.push_back(Run { timespan.classid, timespan.numframes });
+            }
+            numberOfFrames += timespan.numframes;
+        }
+
+        description.m_numberOfFrames = numberOfFrames;
+        result->m_utteranceStorage.push_back(description);
+    }
+
+    result->PointToStorage();
+    return result;
+}
+
+MLFLabelArchivePtr MLFLabelArchive::Load(const wstring& path, const vector<wstring>& sources)
+{
+    if (!fexists(path))
+    {
+        return nullptr;
+    }
+
+    auto file = make_shared<MemoryMappedFile>(path);
+    const char* data = file->Data();
+    size_t size = file->Size();
+
+    // Checks that the table of count elements starting at the offset is within the file.
+    auto fits = [size](size_t offset, uint64_t count, size_t elementSize)
+    {
+        return offset <= size && count <= (size - offset) / elementSize;
+    };
+
+    bool valid = fits(0, 1, sizeof(ArchiveHeader));
+    const ArchiveHeader* header = (const ArchiveHeader*)data;
+    valid = valid &&
+            memcmp(header->m_magic, ArchiveMagic, sizeof(ArchiveMagic)) == 0 &&
+            header->m_version == ArchiveVersion &&
+            header->m_numberOfSources == sources.size();
+
+    size_t offset = sizeof(ArchiveHeader);
+    const SourceEntry* sourceEntries = (const SourceEntry*)(data + offset);
+    valid = valid && fits(offset, header->m_numberOfSources, sizeof(SourceEntry));
+    offset += valid ? sizeof(SourceEntry) * header->m_numberOfSources : 0;
+    valid = valid && fits(offset, header->m_numberOfUtterances, sizeof(Utterance));
+    offset += valid ? sizeof(Utterance) * header->m_numberOfUtterances : 0;
+    valid = valid && fits(offset, header->m_numberOfRuns, sizeof(Run));
+    offset += valid ? sizeof(Run) * header->m_numberOfRuns : 0;
+    valid = valid && size - offset == header->m_keysSize;
+
+    // Compare the sources, the checksums only if the sizes and modification times match.
+    for (size_t i = 0; valid && i < sources.size(); ++i)
+    {
+        SourceEntry entry;
+        valid = GetFileStatus(sources[i], entry) &&
+                entry.m_size == sourceEntries[i].m_size &&
+                entry.m_modificationTime == sourceEntries[i].m_modificationTime;
+    }
+
+    for (size_t i = 0; valid && i < sources.size(); ++i)
+    {
+        valid = GetFileChecksum(sources[i]) == sourceEntries[i].m_checksum;
+    }
+
+    if (!valid)
+    {
+        fprintf(stderr, "MLFLabelArchive: label archive '%ls' does not match the MLF files, rebuilding it.\n", path.c_str());
+        return nullptr;
+    }
+
+    MLFLabelArchivePtr result(new MLFLabelArchive());
+    offset = sizeof(ArchiveHeader) + sizeof(SourceEntry) * header->m_numberOfSources;
+    result->m_utterances = (const Utterance*)(data + offset);
+    result->m_numberOfUtterances = header->m_numberOfUtterances;
+    offset += sizeof(Utterance) * header->m_numberOfUtterances;
+    result->m_runs = (const Run*)(data + offset);
+    result->m_numberOfRuns = header->m_numberOfRuns;
+    offset += sizeof(Run) * header->m_numberOfRuns;
+    result->m_keys = data + offset;
+    result->m_keysSize = header->m_keysSize;
+    result->m_file = file;
+
+    // The keys and the runs of each utterance must be within their tables, and the runs must add up to the
+    // number of frames of the utterance, since the labels are expanded from them without further checks.
+    for (size_t i = 0; valid && i < result->m_numberOfUtterances; ++i)
+    {
+        const auto& utterance = result->m_utterances[i];
+        valid = utterance.m_keyOffset <= result->m_keysSize && utterance.m_keyLength <= result->m_keysSize - utterance.m_keyOffset;
+
+        size_t run = utterance.m_firstRun, frames = 0;
+        for (; valid && frames < utterance.m_numberOfFrames; ++run)
+        {
+            valid = run < result->m_numberOfRuns && result->m_runs[run].m_numberOfFrames > 0;
+            frames += valid ? result->m_runs[run].m_numberOfFrames : 0;
+        }
+        valid = valid && frames == utterance.m_numberOfFrames;
+    }
+
+    if (!valid)
+    {
+        fprintf(stderr, "MLFLabelArchive: label archive '%ls' is corrupt, rebuilding it.\n", path.c_str());
+        return nullptr;
+    }
+
+    return result;
+}
+
+bool MLFLabelArchive::Write(const wstring& path, const vector<wstring>& sources) const
+{
+    vector<SourceEntry> sourceEntries(sources.size());
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        if (!GetFileStatus(sources[i], sourceEntries[i]))
+        {
+            return false;
+        }
+        sourceEntries[i].m_checksum = GetFileChecksum(sources[i]);
+    }
+
+    ArchiveHeader header = {};
+    memcpy(header.m_magic, ArchiveMagic, sizeof(header.m_magic));
+    header.m_version = ArchiveVersion;
+    header.m_numberOfSources = (uint32_t)sources.size();
+    header.m_numberOfUtterances = m_numberOfUtterances;
+    header.m_numberOfRuns = m_numberOfRuns;
+    header.m_keysSize = m_keysSize;
+
+    // The archive is first written to a temporary file, which is renamed once complete.
+    // The name is unique per process, since several workers may build the same archive at the same time.
+    wstring temporaryPath = path + L".tmp" + std::to_wstring(GetCurrentProcessId());
+    FILE* f = nullptr;
+    if (_wfopen_s(&f, temporaryPath.c_str(), L"wb") != 0 || f == nullptr)
+    {
+        return false;
+    }
+
+    bool written =
+        fwrite(&header, sizeof(header), 1, f) == 1 &&
+        fwrite(sourceEntries.data(), sizeof(SourceEntry), sourceEntries.size(), f) == sourceEntries.size() &&
+        fwrite(m_utterances, sizeof(Utterance), m_numberOfUtterances, f) == m_numberOfUtterances &&
+        fwrite(m_runs, sizeof(Run), m_numberOfRuns, f) == m_numberOfRuns &&
+        fwrite(m_keys, 1, m_keysSize, f) == m_keysSize;
+    written = fclose(f) == 0 && written;
+
+    try
+    {
+        if (written)
+        {
+            if (fexists(path))
+                unlinkOrDie(path);
+            renameOrDie(temporaryPath, path);
+            return true;
+        }
+    }
+    catch (const std::exception&)
+    {
+    }
+
+    if (fexists(temporaryPath))
+        _wunlink(temporaryPath.c_str());
+    return false;
+}
+
+}}}
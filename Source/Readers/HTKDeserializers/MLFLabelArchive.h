@@ -0,0 +1,95 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "MemoryMappedFile.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class MLFLabelArchive;
+typedef std::shared_ptr<MLFLabelArchive> MLFLabelArchivePtr;
+
+// Run-length encoded labels (class ids) of the utterances of a set of MLF files, together with
+// the index of utterances (keys, number of frames and first run of labels).
+// Either built by parsing the MLF files, or loaded from a binary archive written on a previous run,
+// which is memory mapped and used in place (so that the labels are only expanded for the sequences requested).
+// The archive records the size, modification time and checksum of its source files (the MLFs and the state list),
+// and is only used if they did not change.
+class MLFLabelArchive
+{
+public:
+    // A run of frames with the same class id.
+    struct Run
+    {
+        uint32_t m_classId;
+        uint32_t m_numberOfFrames;
+    };
+
+    struct Utterance
+    {
+        uint64_t m_keyOffset;      // offset of the key in the key table
+        uint32_t m_keyLength;
+        uint32_t m_numberOfFrames;
+        uint64_t m_firstRun;       // index of the first run of the utterance, runs of an utterance are consecutive
+    };
+
+    // Parses the MLF files, keeping only utterances for which isIncluded (if given) returns true.
+    static MLFLabelArchivePtr Parse(const std::vector<std::wstring>& mlfPaths, const std::wstring& stateListPath,
+                                    const std::function<bool(const std::string&)>& isIncluded = nullptr);
+
+    // Maps the archive at the given path, returns nullptr if it does not exist or does not match the source files.
+    static MLFLabelArchivePtr Load(const std::wstring& path, const std::vector<std::wstring>& sources);
+
+    // Writes the archive for the given source files, returns false if it could not be written.
+    bool Write(const std::wstring& path, const std::vector<std::wstring>& sources) const;
+
+    size_t GetNumberOfUtterances() const
+    {
+        return m_numberOfUtterances;
+    }
+
+    const Utterance& GetUtterance(size_t index) const
+    {
+        return m_utterances[index];
+    }
+
+    std::string GetKey(const Utterance& utterance) const
+    {
+        return std::string(m_keys + utterance.m_keyOffset, utterance.m_keyLength);
+    }
+
+    const Run* GetRuns() const
+    {
+        return m_runs;
+    }
+
+private:
+    MLFLabelArchive();
+
+    // Sets the pointers to the owned tables.
+    void PointToStorage();
+
+    // Tables, either owned or pointing into the mapped archive.
+    const Utterance* m_utterances;
+    size_t m_numberOfUtterances;
+    const Run* m_runs;
+    size_t m_numberOfRuns;
+    const char* m_keys;
+    size_t m_keysSize;
+
+    std::vector<Utterance> m_utteranceStorage;
+    std::vector<Run> m_runStorage;
+    std::string m_keyStorage;
+    MemoryMappedFilePtr m_file;
+
+    DISABLE_COPY_AND_MOVE(MLFLabelArchive);
+};
+
+}}}
@@ -655,6 +655,25 @@ public:
         featperiod2 = this->featperiod;
     }
 
+    // get the location of the frames of a feature file inside its physical file, if they are stored there
+    // as plain floats in the machine byte order, i.e. can be used in place (e.g. through a memory mapping)
+    // Returns false if the frames need to be converted while reading (byte swapping, decompression, etc.).
+    // The file must have the expected dimensions, as for read().
+    bool getrawlocation(const parsedpath& ppath, const string& kindstr, const unsigned int period, size_t expecteddim, size_t expectedframes,
+                        wstring& physpath, uint64_t& byteoffset)
+    {
+        if (open(ppath) != expectedframes || expecteddim != featdim)
+            LogicError("read: stripe read called with wrong dimensions");
+        if (kindstr != featkind || period != featperiod)
+            LogicError("getrawlocation: attempting to mixing different feature kinds");
+        if (compressed || isidxformat || needbyteswapping || addEnergy || vecbytesize != featdim * sizeof(float))
+            return false;
+
+        physpath = physicalpath;
+        byteoffset = physicaldatastart + (ppath.isarchive ? ppath.s : 0) * vecbytesize;
+        return true;
+    }
+
     // called to add energy as we read
     void AddEnergy(size_t energyElements2)
     {
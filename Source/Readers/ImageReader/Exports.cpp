@@ -67,6 +67,8 @@ extern "C" DATAREADER_API bool CreateTransformer(Transformer** transformer, cons
         *transformer = new TransposeTransformer(config);
     else if (type == L"Cast")
         *transformer = new CastTransformer(config);
+    else if (type == L"Fused")
+        *transformer = new FusedImageTransformer(config, config(L"transpose", true));
     else
         // Unknown type.
         return false;
@@ -61,15 +61,27 @@ ImageReader::ImageReader(const ConfigParameters& config)
     ConfigParameters featureStream = config(featureName);
 
     std::vector<Transformation> transformations;
-    transformations.push_back(Transformation{ std::make_shared<CropTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<ScaleTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<ColorTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<IntensityTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<MeanTransformer>(featureStream), featureName });
 
-    if (configHelper.GetDataFormat() == CHW)
+    // Without color or intensity jittering, crop, scale, mean and transpose can be done in a single transform.
+    bool hasJittering = featureStream.Exists(L"brightnessRadius") || featureStream.Exists(L"contrastRadius") ||
+        featureStream.Exists(L"saturationRadius") || featureStream.Exists(L"intensityFile");
+    bool fuseTransforms = featureStream(L"fuseTransforms", true);
+    if (fuseTransforms && !hasJittering)
     {
-        transformations.push_back(Transformation{ std::make_shared<TransposeTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<FusedImageTransformer>(featureStream, configHelper.GetDataFormat() == CHW), featureName });
+    }
+    else
+    {
+        transformations.push_back(Transformation{ std::make_shared<CropTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<ScaleTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<ColorTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<IntensityTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<MeanTransformer>(featureStream), featureName });
+
+        if (configHelper.GetDataFormat() == CHW)
+        {
+            transformations.push_back(Transformation{ std::make_shared<TransposeTransformer>(featureStream), featureName });
+        }
     }
 
     // We should always have cast at the end. 
@@ -16,6 +16,11 @@
 #include "SequenceData.h"
 #include "ImageUtil.h"
 
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define IMAGE_TRANSFORMERS_USE_SSE2
+#endif
+
 namespace Microsoft { namespace MSR { namespace CNTK 
 {
 
@@ -84,6 +89,14 @@ void CropTransformer::StartEpoch(const EpochConfiguration &config)
 }
 
 void CropTransformer::Apply(size_t id, cv::Mat &mat)
+{
+    if (Crop(id, mat))
+    {
+        cv::flip(mat, mat, 1);
+    }
+}
+
+bool CropTransformer::Crop(size_t id, cv::Mat &mat)
 {
     auto seed = GetSeed();
     auto rng = m_rngs.pop_or_create([seed]() { return std::make_unique<std::mt19937>(seed); });
@@ -113,13 +126,11 @@ void CropTransformer::Apply(size_t id, cv::Mat &mat)
 
     mat = mat(GetCropRect(m_cropType, viewIndex, mat.rows, mat.cols, ratio, *rng));
     // for MultiView10 m_hFlip is false, hence the first 5 will be unflipped, the later 5 will be flipped
-    if ((m_hFlip && boost::random::bernoulli_distribution<>()(*rng)) ||
-        viewIndex >= 5)
-    {
-        cv::flip(mat, mat, 1);
-    }
+    bool flip = (m_hFlip && boost::random::bernoulli_distribution<>()(*rng)) ||
+        viewIndex >= 5;
 
     m_rngs.push(std::move(rng));
+    return flip;
 }
 
 CropTransformer::RatioJitterType
@@ -284,10 +295,19 @@ StreamDescription ScaleTransformer::Transform(const StreamDescription& inputStre
 void ScaleTransformer::Apply(size_t id, cv::Mat &mat)
 {
     UNUSED(id);
+    mat = Scale(mat, mat);
+}
 
+cv::Mat ScaleTransformer::Scale(const cv::Mat &mat, cv::Mat &buffer)
+{
     if (m_scaleMode == ScaleMode::Fill)
     { // warp the image to the given target size
-        cv::resize(mat, mat, cv::Size((int)m_imgWidth, (int)m_imgHeight), 0, 0, m_interp);
+        cv::Size size((int)m_imgWidth, (int)m_imgHeight);
+        if (mat.size() == size)
+            return mat;
+
+        cv::resize(mat, buffer, size, 0, 0, m_interp);
+        return buffer;
     }
     else
     {
@@ -313,24 +333,26 @@ void ScaleTransformer::Apply(size_t id, cv::Mat &mat)
             targetW = (size_t)round(width * m_imgHeight / (double)height);
         }
 
-        cv::resize(mat, mat, cv::Size((int)targetW, (int)targetH), 0, 0, m_interp);
+        cv::resize(mat, buffer, cv::Size((int)targetW, (int)targetH), 0, 0, m_interp);
 
         if (m_scaleMode == ScaleMode::Crop)
         { // crop the overlap
             size_t xOff = max((size_t)0, (targetW - m_imgWidth) / 2);
             size_t yOff = max((size_t)0, (targetH - m_imgHeight) / 2);
-            mat = mat(cv::Rect((int)xOff, (int)yOff, (int)m_imgWidth, (int)m_imgHeight));
+            return buffer(cv::Rect((int)xOff, (int)yOff, (int)m_imgWidth, (int)m_imgHeight));
         }
         else
         { // ScaleMode::PAD --> center it and pad the rest
-            size_t hdiff = max((size_t)0, (m_imgHeight - mat.rows) / 2);
-            size_t wdiff = max((size_t)0, (m_imgWidth - mat.cols) / 2);
+            size_t hdiff = max((size_t)0, (m_imgHeight - buffer.rows) / 2);
+            size_t wdiff = max((size_t)0, (m_imgWidth - buffer.cols) / 2);
 
             size_t top = hdiff;
-            size_t bottom = m_imgHeight - top - mat.rows;
+            size_t bottom = m_imgHeight - top - buffer.rows;
             size_t left = wdiff;
-            size_t right = m_imgWidth - left - mat.cols;
-            cv::copyMakeBorder(mat, mat, (int)top, (int)bottom, (int)left, (int)right, m_borderType, m_padValue);
+            size_t right = m_imgWidth - left - buffer.cols;
+            cv::Mat result;
+            cv::copyMakeBorder(buffer, result, (int)top, (int)bottom, (int)left, (int)right, m_borderType, m_padValue);
+            return result;
         }
     }
 }
@@ -499,6 +521,197 @@ SequenceDataPtr TransposeTransformer::TypedTranspose<TElementTo>::Apply(ImageSeq
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+FusedImageTransformer::FusedImageTransformer(const ConfigParameters& config, bool transpose) : TransformBase(config),
+    m_crop(config), m_scale(config), m_transpose(transpose), m_floatOutput(this), m_doubleOutput(this)
+{
+    MeanTransformer mean(config);
+    if (!mean.m_meanImg.empty())
+    {
+        mean.m_meanImg.convertTo(m_floatOutput.m_mean, CV_32F);
+        mean.m_meanImg.convertTo(m_doubleOutput.m_mean, CV_64F);
+    }
+}
+
+void FusedImageTransformer::StartEpoch(const EpochConfiguration &config)
+{
+    m_crop.StartEpoch(config);
+    m_scale.StartEpoch(config);
+}
+
+// The method describes how input stream is transformed to the output stream. Called once per applied stream.
+// All samples of the output stream have the size given by the scale parameters, in HWC or CHW layout.
+StreamDescription FusedImageTransformer::Transform(const StreamDescription& inputStream)
+{
+    TransformBase::Transform(inputStream);
+    m_outputStream.m_elementType = m_precision;
+
+    ImageDimensions dimensions(m_scale.m_imgWidth, m_scale.m_imgHeight, m_scale.m_imgChannels);
+    m_outputStream.m_sampleLayout = std::make_shared<TensorShape>(dimensions.AsTensorShape(m_transpose ? CHW : HWC));
+    return m_outputStream;
+}
+
+// Transformation of the sequence.
+SequenceDataPtr FusedImageTransformer::Transform(SequenceDataPtr sequence)
+{
+    auto inputSequence = dynamic_cast<ImageSequenceData*>(sequence.get());
+    if (inputSequence == nullptr)
+        RuntimeError("Currently the fused image transform only works with images.");
+
+    auto scratch = m_scratch.pop_or_create([]() { return std::make_unique<ScratchImages>(); });
+
+    cv::Mat image = inputSequence->m_image;
+    if (m_crop.Crop(sequence->m_id, image))
+    {
+        cv::flip(image, scratch->m_flipped, 1);
+        image = scratch->m_flipped;
+    }
+
+    image = m_scale.Scale(image, scratch->m_scaled);
+
+    SequenceDataPtr result = m_precision == ElementType::tfloat ?
+        m_floatOutput.Apply(image) :
+        m_doubleOutput.Apply(image);
+
+    m_scratch.push(std::move(scratch));
+    result->m_numberOfSamples = inputSequence->m_numberOfSamples;
+    return result;
+}
+
+// Converts a row of values to the output precision, subtracting the mean if given.
+template <class TElementTo, class TElementFrom>
+static void ConvertRow(const TElementFrom* src, const TElementTo* mean, TElementTo* dst, size_t count)
+{
+    if (mean)
+    {
+        for (size_t i = 0; i < count; ++i)
+            dst[i] = static_cast<TElementTo>(src[i]) - mean[i];
+    }
+    else
+    {
+        for (size_t i = 0; i < count; ++i)
+            dst[i] = static_cast<TElementTo>(src[i]);
+    }
+}
+
+// The most common case of 8 bit images in single precision, converting 16 values at a time.
+static void ConvertRow(const unsigned char* src, const float* mean, float* dst, size_t count)
+{
+    size_t i = 0;
+#ifdef IMAGE_TRANSFORMERS_USE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i low = _mm_unpacklo_epi8(bytes, zero);
+        __m128i high = _mm_unpackhi_epi8(bytes, zero);
+        __m128 v0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero));
+        __m128 v1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero));
+        __m128 v2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero));
+        __m128 v3 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero));
+        if (mean)
+        {
+            v0 = _mm_sub_ps(v0, _mm_loadu_ps(mean + i));
+            v1 = _mm_sub_ps(v1, _mm_loadu_ps(mean + i + 4));
+            v2 = _mm_sub_ps(v2, _mm_loadu_ps(mean + i + 8));
+            v3 = _mm_sub_ps(v3, _mm_loadu_ps(mean + i + 12));
+        }
+        _mm_storeu_ps(dst + i, v0);
+        _mm_storeu_ps(dst + i + 4, v1);
+        _mm_storeu_ps(dst + i + 8, v2);
+        _mm_storeu_ps(dst + i + 12, v3);
+    }
+#endif
+    ConvertRow<float, unsigned char>(src + i, mean ? mean + i : nullptr, dst + i, count - i);
+}
+
+template <class TElementTo>
+SequenceDataPtr FusedImageTransformer::TypedOutput<TElementTo>::Apply(const cv::Mat& image)
+{
+    ImageDimensions dimensions(image.cols, image.rows, image.channels());
+    auto result = std::make_shared<DenseSequenceWithBuffer<TElementTo>>(m_memBuffers, (size_t)image.cols * image.rows * image.channels());
+
+    // As in the mean transform, the mean is only subtracted if it has the size of the image.
+    bool subtractMean = !m_mean.empty() && m_mean.size() == image.size() && m_mean.channels() == image.channels();
+    switch (image.depth())
+    {
+    case CV_8U:
+        ConvertRows<unsigned char>(image, subtractMean, result->GetBuffer());
+        break;
+    case CV_32F:
+        ConvertRows<float>(image, subtractMean, result->GetBuffer());
+        break;
+    case CV_64F:
+        ConvertRows<double>(image, subtractMean, result->GetBuffer());
+        break;
+    default:
+        RuntimeError("Unsupported image type for the fused transform.");
+    }
+
+    result->m_sampleLayout = std::make_shared<TensorShape>(dimensions.AsTensorShape(m_parent->m_transpose ? CHW : HWC));
+    result->m_elementType = m_parent->m_precision;
+    return result;
+}
+
+// Converts the image row by row. For CHW, a row is first converted into a small buffer
+// and then split into the channel planes.
+template <class TElementTo>
+template <class TElementFrom>
+void FusedImageTransformer::TypedOutput<TElementTo>::ConvertRows(const cv::Mat& image, bool subtractMean, TElementTo* dst)
+{
+    size_t nRows = image.rows;
+    size_t nCols = image.cols;
+    size_t channelCount = image.channels();
+    size_t rowSize = nCols * channelCount;
+
+    if (!m_parent->m_transpose)
+    {
+        for (size_t i = 0; i < nRows; ++i)
+        {
+            const TElementTo* mean = subtractMean ? m_mean.ptr<TElementTo>((int)i) : nullptr;
+            ConvertRow(image.ptr<TElementFrom>((int)i), mean, dst + i * rowSize, rowSize);
+        }
+        return;
+    }
+
+    auto row = m_rowBuffers.pop_or_create([rowSize]() { return std::vector<TElementTo>(rowSize); });
+    row.resize(rowSize);
+
+    size_t planeSize = nRows * nCols;
+    for (size_t i = 0; i < nRows; ++i)
+    {
+        const TElementTo* mean = subtractMean ? m_mean.ptr<TElementTo>((int)i) : nullptr;
+        ConvertRow(image.ptr<TElementFrom>((int)i), mean, row.data(), rowSize);
+
+        const TElementTo* x = row.data();
+        if (channelCount == 3) // Unrolling for BGR, the most common case.
+        {
+            TElementTo* b = dst + i * nCols;
+            TElementTo* g = b + planeSize;
+            TElementTo* r = g + planeSize;
+            for (size_t j = 0; j < nCols; ++j, x += 3)
+            {
+                b[j] = x[0];
+                g[j] = x[1];
+                r[j] = x[2];
+            }
+        }
+        else
+        {
+            for (size_t j = 0; j < nCols; ++j)
+            {
+                for (size_t c = 0; c < channelCount; ++c)
+                {
+                    dst[c * planeSize + i * nCols + j] = *x++;
+                }
+            }
+        }
+    }
+
+    m_rowBuffers.push(std::move(row));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 IntensityTransformer::IntensityTransformer(const ConfigParameters &config) : ImageTransformerBase(config)
 {
     m_stdDev = config(L"intensityStdDev", ConfigParameters::Array(doubleargvector(vector<double>{0.0})));
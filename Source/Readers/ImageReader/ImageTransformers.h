@@ -83,8 +83,14 @@ public:
     explicit CropTransformer(const ConfigParameters& config);
 
 private:
+    friend class FusedImageTransformer;
+
     void Apply(size_t id, cv::Mat &mat) override;
 
+    // Crops the image (as a view into the original one).
+    // Returns true if the crop has to be flipped horizontally.
+    bool Crop(size_t id, cv::Mat &mat);
+
 private:
     enum class RatioJitterType
     {
@@ -125,8 +131,14 @@ private:
         Crop = 1,
         Pad  = 2
     };
+    friend class FusedImageTransformer;
+
     void Apply(size_t id, cv::Mat &mat) override;
 
+    // Scales the image using the given buffer for the resized image.
+    // The result can be a view into the buffer or into the original image.
+    cv::Mat Scale(const cv::Mat &mat, cv::Mat &buffer);
+
     size_t m_imgWidth;
     size_t m_imgHeight;
     size_t m_imgChannels;
@@ -144,6 +156,8 @@ public:
     explicit MeanTransformer(const ConfigParameters& config);
 
 private:
+    friend class FusedImageTransformer;
+
     void Apply(size_t id, cv::Mat &mat) override;
 
     cv::Mat m_meanImg;
@@ -182,6 +196,63 @@ private:
     TypedTranspose<double> m_doubleTransform;
 };
 
+// Crop, scale, mean subtraction, optional transposition from HWC to CHW and the cast to the
+// required precision in a single transform, taking the same parameters as the individual ones.
+// The cropped image is a view into the decoded one and is resized into a scratch image;
+// conversion, mean subtraction and transposition then happen in one pass into the output buffer.
+// Scratch images and output buffers are reused between sequences.
+// Can only replace the separate transforms when no color or intensity jittering happens in between.
+class FusedImageTransformer : public TransformBase
+{
+public:
+    FusedImageTransformer(const ConfigParameters& config, bool transpose);
+
+    void StartEpoch(const EpochConfiguration &config) override;
+
+    // Transformation of the stream.
+    StreamDescription Transform(const StreamDescription& inputStream) override;
+
+    // Transformation of the sequence.
+    SequenceDataPtr Transform(SequenceDataPtr sequence) override;
+
+private:
+    // Images that are reused between the sequences.
+    struct ScratchImages
+    {
+        cv::Mat m_flipped;
+        cv::Mat m_scaled;
+    };
+
+    // A helper class converting images into the output using a set of typed memory buffers.
+    template <class TElementTo>
+    struct TypedOutput
+    {
+        FusedImageTransformer* m_parent;
+
+        // Mean image in the output precision, empty if there is none.
+        cv::Mat m_mean;
+
+        TypedOutput(FusedImageTransformer* parent) : m_parent(parent) {}
+
+        SequenceDataPtr Apply(const cv::Mat& image);
+
+        template <class TElementFrom>
+        void ConvertRows(const cv::Mat& image, bool subtractMean, TElementTo* dst);
+
+        conc_stack<std::vector<TElementTo>> m_memBuffers;
+        conc_stack<std::vector<TElementTo>> m_rowBuffers;
+    };
+
+    CropTransformer m_crop;
+    ScaleTransformer m_scale;
+    bool m_transpose;
+
+    conc_stack<std::unique_ptr<ScratchImages>> m_scratch;
+
+    TypedOutput<float> m_floatOutput;
+    TypedOutput<double> m_doubleOutput;
+};
+
 // Intensity jittering based on PCA transform as described in original AlexNet paper
 // (http://papers.nips.cc/paper/4824-imagenet-classification-with-deep-convolutional-neural-networks.pdf)
 // Currently uses precomputed values from 
@@ -11,6 +11,7 @@
 #include <algorithm>
 #include <utility>
 #include <deque>
+#include <chrono>
 
 #include "DataReader.h"
 #include "ExceptionCapture.h"
@@ -24,7 +25,10 @@ BlockRandomizer::BlockRandomizer(
     bool shouldPrefetch,
     DecimationMode decimationMode,
     bool useLegacyRandomization,
-    bool multithreadedGetNextSequence)
+    bool multithreadedGetNextSequence,
+    size_t readAheadChunks,
+    size_t readAheadMaxBytes,
+    size_t numReadAheadThreads)
     : m_verbosity(verbosity),
       m_deserializer(deserializer),
       m_decimationMode(decimationMode),
@@ -35,10 +39,16 @@ BlockRandomizer::BlockRandomizer(
       m_sweepTotalNumberOfSamples(0),
       m_chunkRandomizer(std::make_shared<ChunkRandomizer>(deserializer, randomizationRangeInSamples, useLegacyRandomization)),
       m_multithreadedGetNextSequences(multithreadedGetNextSequence),
-      m_prefetchedChunk(CHUNKID_MAX)
+      m_readAheadChunks(readAheadChunks),
+      m_readAheadMaxBytes(readAheadMaxBytes),
+      m_numReadAheadThreads(numReadAheadThreads),
+      m_numActiveLoads(0)
 {
     assert(deserializer != nullptr);
 
+    if (m_numReadAheadThreads == 0)
+        InvalidArgument("The number of read ahead threads must be positive.");
+
     m_launchType = shouldPrefetch ? launch::async : launch::deferred;
 
     m_streams = m_deserializer->GetStreamDescriptions();
@@ -176,9 +186,8 @@ Sequences BlockRandomizer::GetNextSequences(size_t sampleCount)
             process(i);
     }
 
-    // Now it is safe to start the new chunk prefetch.
-    ChunkIdType chunkToPrefetchNext = GetChunkToPrefetch(windowRange);
-    Prefetch(chunkToPrefetchNext);
+    // Now it is safe to start loading the next chunks.
+    ReadAhead(windowRange);
 
     return result;
 }
@@ -297,10 +306,12 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
         }
 
         auto const& chunk = m_chunkRandomizer->GetRandomizedChunks()[i];
-        if (chunk.m_original->m_id == m_prefetchedChunk && m_prefetch.valid())
+        auto readAhead = m_readAhead.find(chunk.m_original->m_id);
+        if (readAhead != m_readAhead.end())
         {
             // Taking prefetched chunk.
-            m_chunks[chunk.m_original->m_id] = m_prefetch.get();
+            m_chunks[chunk.m_original->m_id] = readAhead->second.get();
+            m_readAhead.erase(readAhead);
             if (m_verbosity >= Information)
                 fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in prefetched chunk %u (original chunk: %u), now %" PRIu64 " chunks in memory\n",
                 chunk.m_chunkId,
@@ -309,13 +320,7 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
         }
         else
         {
-            // Make sure we have no outstanding prefetches.
-            if (m_prefetch.valid())
-            {
-                m_prefetch.wait();
-            }
-
-            m_chunks[chunk.m_original->m_id] = m_deserializer->GetChunk(chunk.m_original->m_id);
+            m_chunks[chunk.m_original->m_id] = LoadChunk(chunk.m_original->m_id);
             if (m_verbosity >= Information)
                 fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in randomized chunk %u (original chunk: %u), now %" PRIu64 " chunks in memory\n",
                 chunk.m_chunkId,
@@ -331,50 +336,109 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
                 m_chunkRandomizer->GetRandomizedChunks()[windowRange.m_end - 1].m_chunkId);
 }
 
-// Identifies chunk id that should be prefetched.
+// Identifies the chunks that should be read ahead: the next chunks of this worker
+// following the window in the randomized order, limited by count and total size.
 // TODO: DecimationMode::sequence is not supported because it should eventually go away.
-ChunkIdType BlockRandomizer::GetChunkToPrefetch(const ClosedOpenChunkInterval& windowRange)
+std::vector<ChunkIdType> BlockRandomizer::GetChunksToReadAhead(const ClosedOpenChunkInterval& windowRange)
 {
-    ChunkIdType toBePrefetched = CHUNKID_MAX;
+    std::vector<ChunkIdType> result;
     if (m_decimationMode != DecimationMode::chunk)
     {
         // For non chunked mode, we do not do prefetch currently.
-        return toBePrefetched;
+        return result;
     }
 
-    auto current = windowRange.m_end;
-    while (current < m_chunkRandomizer->GetRandomizedChunks().size())
+    const auto& chunks = m_chunkRandomizer->GetRandomizedChunks();
+    size_t totalSize = 0;
+    for (auto current = windowRange.m_end; current < chunks.size() && result.size() < m_readAheadChunks; ++current)
     {
-        const auto& chunk = m_chunkRandomizer->GetRandomizedChunks()[current];
-        if (chunk.m_chunkId % m_config.m_numberOfWorkers == m_config.m_workerRank &&
-            m_chunks.find(chunk.m_original->m_id) == m_chunks.end())
+        const auto& chunk = chunks[current];
+        if (chunk.m_chunkId % m_config.m_numberOfWorkers != m_config.m_workerRank ||
+            m_chunks.find(chunk.m_original->m_id) != m_chunks.end())
+        {
+            continue;
+        }
+
+        // At least one chunk is always read ahead, independent of its size.
+        totalSize += chunk.m_original->m_byteSize;
+        if (m_readAheadMaxBytes != 0 && totalSize > m_readAheadMaxBytes && !result.empty())
         {
-            toBePrefetched = chunk.m_original->m_id;
             break;
         }
-        ++current;
+
+        result.push_back(chunk.m_original->m_id);
     }
-    return toBePrefetched;
+    return result;
 }
 
-// Performs io prefetch of the specified chunk if needed.
-void BlockRandomizer::Prefetch(ChunkIdType chunkId)
+// Starts loading the chunks that follow the window if needed.
+void BlockRandomizer::ReadAhead(const ClosedOpenChunkInterval& windowRange)
 {
-    // Start new prefetch if necessary.
-    if (m_prefetchedChunk != chunkId && chunkId != CHUNKID_MAX)
+    auto toBeReadAhead = GetChunksToReadAhead(windowRange);
+
+    // Forget the released loads that have finished meanwhile.
+    m_releasedReadAhead.erase(std::remove_if(m_releasedReadAhead.begin(), m_releasedReadAhead.end(),
+        [](const std::future<ChunkPtr>& f) { return f.wait_for(std::chrono::seconds(0)) != std::future_status::timeout; }),
+        m_releasedReadAhead.end());
+
+    // Release the chunks that are not ahead of the window anymore (i.e. after a seek or a new sweep).
+    // Destroying the future of a load that is still running would block until the load finishes,
+    // so such loads are kept aside until they are done.
+    for (auto it = m_readAhead.begin(); it != m_readAhead.end();)
     {
-        // Wait to make sure there is no outstanding prefetches.
-        if (m_prefetch.valid())
+        if (std::find(toBeReadAhead.begin(), toBeReadAhead.end(), it->first) == toBeReadAhead.end())
+        {
+            if (m_verbosity >= Debug)
+                fprintf(stderr, "BlockRandomizer::ReadAhead: releasing original chunk: %u\n", it->first);
+            if (it->second.wait_for(std::chrono::seconds(0)) == std::future_status::timeout) // still running (deferred loads never start)
+                m_releasedReadAhead.push_back(std::move(it->second));
+            it = m_readAhead.erase(it);
+        }
+        else
         {
-            m_prefetch.wait();
+            ++it;
         }
+    }
 
-        m_prefetchedChunk = chunkId;
-        m_prefetch = std::async(m_launchType, [this, chunkId]() { return m_deserializer->GetChunk(chunkId); });
+    // Start the new loads in the randomized order.
+    for (auto chunkId : toBeReadAhead)
+    {
+        if (m_readAhead.find(chunkId) != m_readAhead.end())
+        {
+            continue;
+        }
 
+        m_readAhead[chunkId] = std::async(m_launchType, [this, chunkId]() { return LoadChunk(chunkId); });
         if (m_verbosity >= Debug)
-            fprintf(stderr, "BlockRandomizer::Prefetch: prefetching original chunk: %u\n", chunkId);
+            fprintf(stderr, "BlockRandomizer::ReadAhead: prefetching original chunk: %u\n", chunkId);
+    }
+}
+
+ChunkPtr BlockRandomizer::LoadChunk(ChunkIdType chunkId)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_loadLock);
+        m_loadFinished.wait(lock, [this]() { return m_numActiveLoads < m_numReadAheadThreads; });
+        m_numActiveLoads++;
+    }
+
+    ChunkPtr chunk;
+    try
+    {
+        chunk = m_deserializer->GetChunk(chunkId);
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(m_loadLock);
+        m_numActiveLoads--;
+        m_loadFinished.notify_one();
+        throw;
     }
+
+    std::lock_guard<std::mutex> lock(m_loadLock);
+    m_numActiveLoads--;
+    m_loadFinished.notify_one();
+    return chunk;
 }
 
 void BlockRandomizer::SetCurrentSamplePosition(size_t currentSamplePosition)
@@ -12,6 +12,8 @@
 #include "ChunkRandomizer.h"
 #include "SequenceRandomizer.h"
 #include <future>
+#include <mutex>
+#include <condition_variable>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -31,6 +33,12 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 //
 // This class is responsible for decimation and loading the data chunks in to memory.
 // Actual randomization happens in ChunkRandomizer and SequenceRandomizer.
+//
+// When prefetching is enabled, the chunks following the current window in the randomized chunk order
+// are loaded ahead of time (up to readAheadChunks of them, and not more than readAheadMaxBytes in total
+// according to their descriptions), so that the high latency of a single chunk load is hidden.
+// At most numReadAheadThreads chunks are loaded concurrently; more than one thread requires
+// the deserializer to support concurrent GetChunk calls.
 // TODO: The behavior can be simplified by only randomizing sequences forward.
 class BlockRandomizer : public SequenceEnumerator
 {
@@ -49,7 +57,10 @@ public:
         bool shouldPrefetch,
         DecimationMode decimationMode = DecimationMode::chunk,
         bool useLegacyRandomization = false,
-        bool multithreadedGetNextSequences = false);
+        bool multithreadedGetNextSequences = false,
+        size_t readAheadChunks = 1,
+        size_t readAheadMaxBytes = 0,
+        size_t numReadAheadThreads = 1);
 
     // Starts a new epoch.
     virtual void StartEpoch(const EpochConfiguration& config) override;
@@ -68,10 +79,9 @@ public:
 
     ~BlockRandomizer()
     {
-        if (m_prefetch.valid())
-        {
-            m_prefetch.wait();
-        }
+        // Waits for the outstanding loads.
+        m_readAhead.clear();
+        m_releasedReadAhead.clear();
     }
 
     void SetCurrentSamplePosition(size_t currentSamplePosition) override;
@@ -92,11 +102,15 @@ private:
     // Prepares a new sweep if needed.
     void PrepareNewSweepIfNeeded(size_t samplePosition);
 
-    // Performs io prefetch of the specified chunk if needed.
-    void Prefetch(ChunkIdType chunkId);
+    // Starts loading the chunks that follow the given window,
+    // releases read ahead chunks that are not needed anymore.
+    void ReadAhead(const ClosedOpenChunkInterval& windowRange);
+
+    // Returns the original ids of the next chunks to read ahead after the given window.
+    std::vector<ChunkIdType> GetChunksToReadAhead(const ClosedOpenChunkInterval& windowRange);
 
-    // Returns next candidate for the prefetch in the given range.
-    ChunkIdType GetChunkToPrefetch(const ClosedOpenChunkInterval& windowRange);
+    // Loads a chunk from the deserializer, not running more than m_numReadAheadThreads loads at a time.
+    ChunkPtr LoadChunk(ChunkIdType chunkId);
 
     // Global sample position on the timeline.
     size_t m_globalSamplePosition;
@@ -152,12 +166,23 @@ private:
 
     int m_verbosity;
 
-    // Prefetch future.
-    std::future<ChunkPtr> m_prefetch;
+    // Chunks being loaded ahead of time, by original chunk id.
+    std::map<ChunkIdType, std::future<ChunkPtr>> m_readAhead;
+    // Released loads that were still running, kept until they finish so that releasing does not block.
+    // They still hold their load slot, so a chunk needed right away may wait for one of them to finish.
+    std::vector<std::future<ChunkPtr>> m_releasedReadAhead;
     // Whether to have async or deferred prefetch.
     launch m_launchType;
-    // Prefetched original chunk id.
-    ChunkIdType m_prefetchedChunk;
+    // Maximum number of chunks to read ahead.
+    size_t m_readAheadChunks;
+    // Maximum total size of the chunks to read ahead, 0 if not limited.
+    size_t m_readAheadMaxBytes;
+
+    // Limits the number of concurrent chunk loads.
+    size_t m_numReadAheadThreads;
+    size_t m_numActiveLoads;
+    std::mutex m_loadLock;
+    std::condition_variable m_loadFinished;
 
     // Current loaded chunks.
     ClosedOpenChunkInterval m_currentWindowRange;
@@ -79,6 +79,7 @@ void Bundler::CreateChunkDescriptions()
             auto cd = std::make_shared<BundlerChunkDescription>();
             cd->m_numberOfSamples = c->m_numberOfSamples;
             cd->m_numberOfSequences = c->m_numberOfSequences;
+            cd->m_byteSize = c->m_byteSize; // approximated by the primary deserializer
             cd->m_id = (ChunkIdType) m_chunks.size();
             cd->m_original = c;
             m_chunks.push_back(cd);
@@ -138,6 +139,7 @@ void Bundler::CreateChunkDescriptions()
             auto cd = std::make_shared<BundlerChunkDescription>();
             cd->m_numberOfSamples = numberOfSamples;
             cd->m_numberOfSequences = numberOfSequences;
+            cd->m_byteSize = chunks[chunkIndex]->m_byteSize;
             cd->m_id = (ChunkIdType) m_chunks.size();
             cd->m_original = chunks[chunkIndex];
             m_chunks.push_back(cd);
@@ -4,23 +4,144 @@
 //
 
 #define _CRT_SECURE_NO_WARNINGS
+#define __STDC_FORMAT_MACROS
 
+#include <inttypes.h>
 #include "ChunkCache.h"
+#include "ElementTypeUtils.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+ChunkCache::ChunkCache(IDataDeserializerPtr deserializer, size_t maxSizeInBytes) :
+    m_deserializer(deserializer),
+    m_maxSizeInBytes(maxSizeInBytes),
+    m_sizeInBytes(0),
+    m_hits(0),
+    m_misses(0),
+    m_evictions(0)
+{
+}
+
+ChunkCache::~ChunkCache()
+{
+    PrintStatistics();
+}
+
+ChunkDescriptions ChunkCache::GetChunkDescriptions()
+{
+    auto chunks = m_deserializer->GetChunkDescriptions();
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    for (const auto& chunk : chunks)
+    {
+        m_chunkSizes[chunk->m_id] = chunk->m_byteSize;
+    }
+
+    return chunks;
+}
+
 ChunkPtr ChunkCache::GetChunk(ChunkIdType chunkId)
 {
-    auto it = m_chunkMap.find(chunkId);
-    if (it != m_chunkMap.end())
     {
-        return it->second;
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto it = m_chunkMap.find(chunkId);
+        if (it != m_chunkMap.end())
+        {
+            ++m_hits;
+            m_usage.splice(m_usage.begin(), m_usage, it->second.m_usage);
+            return it->second.m_chunk;
+        }
+        ++m_misses;
     }
- 
+
     ChunkPtr chunk = m_deserializer->GetChunk(chunkId);
-    m_chunkMap[chunkId] = chunk;
- 
+
+    // The size only matters when the cache is limited.
+    size_t size = (m_maxSizeInBytes == 0) ? 0 : GetChunkSize(chunkId, chunk);
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_chunkMap.find(chunkId) != m_chunkMap.end() || (m_maxSizeInBytes != 0 && size > m_maxSizeInBytes))
+    {
+        // already cached in the meantime or too big to ever be cached
+        return chunk;
+    }
+
+    while (m_maxSizeInBytes != 0 && m_sizeInBytes + size > m_maxSizeInBytes)
+    {
+        // evict the least recently used chunk.
+        auto evicted = m_chunkMap.find(m_usage.back());
+        m_sizeInBytes -= evicted->second.m_byteSize;
+        m_chunkMap.erase(evicted);
+        m_usage.pop_back();
+        ++m_evictions;
+    }
+
+    m_usage.push_front(chunkId);
+    m_chunkMap[chunkId] = CacheEntry { chunk, size, m_usage.begin() };
+    m_sizeInBytes += size;
     return chunk;
 }
 
+size_t ChunkCache::GetChunkSize(ChunkIdType chunkId, const ChunkPtr& chunk)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto it = m_chunkSizes.find(chunkId);
+        if (it != m_chunkSizes.end() && it->second != 0)
+        {
+            return it->second;
+        }
+    }
+
+    // Not known in advance, add up the sizes of the sequence data.
+    auto streams = m_deserializer->GetStreamDescriptions();
+    std::vector<SequenceDescription> sequences;
+    m_deserializer->GetSequencesForChunk(chunkId, sequences);
+
+    size_t size = 0;
+    std::vector<SequenceDataPtr> data;
+    for (const auto& sequence : sequences)
+    {
+        data.clear();
+        chunk->GetSequence(sequence.m_id, data);
+        for (size_t i = 0; i < data.size() && i < streams.size(); ++i)
+        {
+            size_t elementSize = GetSizeByType(data[i]->m_elementType != ElementType::tvariant ? data[i]->m_elementType : streams[i]->m_elementType);
+            if (streams[i]->m_storageType == StorageType::dense)
+            {
+                const auto& layout = data[i]->m_sampleLayout ? data[i]->m_sampleLayout : streams[i]->m_sampleLayout;
+                size += data[i]->m_numberOfSamples * layout->GetNumElements() * elementSize;
+            }
+            else
+            {
+                auto sparse = static_cast<SparseSequenceData*>(data[i].get());
+                size += sparse->m_totalNnzCount * (elementSize + sizeof(IndexType)) + sparse->m_nnzCounts.size() * sizeof(IndexType);
+            }
+        }
+    }
+
+    return size;
+}
+
+void ChunkCache::PrintStatistics()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_hits + m_misses > 0)
+    {
+        fprintf(stderr, "ChunkCache: %" PRIu64 " hits, %" PRIu64 " misses (hit rate %.1f%%), %" PRIu64 " evictions; "
+                        "%" PRIu64 " chunks cached",
+                (uint64_t)m_hits, (uint64_t)m_misses, 100.0 * m_hits / (m_hits + m_misses), (uint64_t)m_evictions,
+                (uint64_t)m_chunkMap.size());
+        if (m_maxSizeInBytes != 0)
+        {
+            fprintf(stderr, " (%.1f of %.1f MB)", m_sizeInBytes / (1024. * 1024.), m_maxSizeInBytes / (1024. * 1024.));
+        }
+        fprintf(stderr, ".\n");
+    }
+
+    m_hits = 0;
+    m_misses = 0;
+    m_evictions = 0;
+}
+
 } } }
@@ -5,32 +5,35 @@
 
 #pragma once
 
+#include <list>
 #include <map>
+#include <mutex>
 #include "DataDeserializer.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-// A cache to store the complete dataset (all chunks) in memory. The caching can
-// be switched on/off by a boolean flag in the reader config section, independent 
-// of the randomization and chunking parameters. The caching should only be enabled 
-// when the whole dataset fits in memory.
+// A cache to keep loaded chunks in memory. The caching can be switched on/off
+// by a boolean flag in the reader config section, independent of the randomization
+// and chunking parameters.
 // Implemented as a wrapping proxy around a deserializer that stores pointers to
-// all chunks it sees in an internal map.
+// the chunks it sees. Without a memory budget, all chunks of the dataset are kept
+// (which only makes sense when the whole dataset fits in memory). With a budget,
+// the least recently used chunks are evicted to make room for new ones.
 class ChunkCache : public IDataDeserializer
 {
 public:
+    // maxSizeInBytes == 0 means that the size of the cache is not limited.
+    ChunkCache(IDataDeserializerPtr deserializer, size_t maxSizeInBytes = 0);
 
-    ChunkCache(IDataDeserializerPtr deserializer) : m_deserializer(deserializer) { }
+    // Reports the statistics of the last epoch, which no later epoch start does.
+    ~ChunkCache();
 
     virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
     {
         return m_deserializer->GetStreamDescriptions();
     }
 
-    virtual ChunkDescriptions GetChunkDescriptions() override
-    {
-        return m_deserializer->GetChunkDescriptions();
-    }
+    virtual ChunkDescriptions GetChunkDescriptions() override;
 
     virtual void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& descriptions) override
     {
@@ -45,10 +48,40 @@ public:
     // Gets chunk data given its id.
     virtual ChunkPtr GetChunk(ChunkIdType chunkId);
 
+    // Prints the number of hits, misses and evictions since the last call
+    // (e.g., at the start of an epoch) and resets the counters.
+    void PrintStatistics();
+
 private:
+    struct CacheEntry
+    {
+        ChunkPtr m_chunk;
+        size_t m_byteSize;
+        std::list<ChunkIdType>::iterator m_usage; // position in m_usage
+    };
+
+    // Returns the size of the chunk as given by its description or,
+    // if not known in advance, as measured from the loaded sequences.
+    size_t GetChunkSize(ChunkIdType chunkId, const ChunkPtr& chunk);
+
     // A map of currently loaded chunks
-    std::map<size_t, ChunkPtr> m_chunkMap;
+    std::map<ChunkIdType, CacheEntry> m_chunkMap;
+
+    // Ids of the cached chunks, the most recently used one first.
+    std::list<ChunkIdType> m_usage;
+
+    // Chunk sizes from the chunk descriptions (0 if not known).
+    std::map<ChunkIdType, size_t> m_chunkSizes;
+
     IDataDeserializerPtr m_deserializer;
+    size_t m_maxSizeInBytes;
+    size_t m_sizeInBytes;
+
+    size_t m_hits;
+    size_t m_misses;
+    size_t m_evictions;
+
+    std::mutex m_lock;
 
     DISABLE_COPY_AND_MOVE(ChunkCache);
 };
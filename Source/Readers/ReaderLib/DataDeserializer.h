@@ -138,6 +138,8 @@ struct ChunkDescription
     size_t m_numberOfSamples;
     // Number of sequences in the chunk.
     size_t m_numberOfSequences;
+    // Approximate size of the loaded chunk in memory (in bytes), 0 if not known in advance.
+    size_t m_byteSize;
 };
 
 typedef std::shared_ptr<ChunkDescription> ChunkDescriptionPtr;
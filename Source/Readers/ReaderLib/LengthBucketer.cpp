@@ -0,0 +1,149 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <algorithm>
+
+#include "LengthBucketer.h"
+#include "RandomOrdering.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+LengthBucketer::LengthBucketer(SequenceEnumeratorPtr sequenceProvider, size_t poolSizeInMinibatches)
+    : m_sequenceProvider(sequenceProvider),
+      m_poolSizeInMinibatches(poolSizeInMinibatches),
+      m_poolStartPosition(0),
+      m_endOfEpoch(false)
+{
+    assert(sequenceProvider != nullptr);
+    if (poolSizeInMinibatches == 0)
+    {
+        InvalidArgument("The bucketing pool size has to be at least one minibatch.");
+    }
+
+    m_numberOfStreams = m_sequenceProvider->GetStreamDescriptions().size();
+}
+
+void LengthBucketer::StartEpoch(const EpochConfiguration& config)
+{
+    ResetPool();
+    m_sequenceProvider->StartEpoch(config);
+}
+
+void LengthBucketer::SetCurrentSamplePosition(size_t currentSamplePosition)
+{
+    ResetPool();
+    m_sequenceProvider->SetCurrentSamplePosition(currentSamplePosition);
+}
+
+size_t LengthBucketer::GetCurrentSamplePosition()
+{
+    // Sequences are returned out of order within the pool, so the only position
+    // that can be restored is the beginning of the pool.
+    return m_minibatches.empty() ? m_sequenceProvider->GetCurrentSamplePosition() : m_poolStartPosition;
+}
+
+void LengthBucketer::ResetPool()
+{
+    m_minibatches.clear();
+    m_endOfEpoch = false;
+}
+
+Sequences LengthBucketer::GetNextSequences(size_t sampleCount)
+{
+    if (m_minibatches.empty() && !m_endOfEpoch)
+    {
+        FillPool(sampleCount);
+    }
+
+    Sequences result;
+    if (m_minibatches.empty())
+    {
+        result.m_endOfEpoch = m_endOfEpoch;
+        return result;
+    }
+
+    result = std::move(m_minibatches.front());
+    m_minibatches.pop_front();
+    result.m_endOfEpoch = m_endOfEpoch && m_minibatches.empty();
+    return result;
+}
+
+void LengthBucketer::FillPool(size_t sampleCount)
+{
+    m_poolStartPosition = m_sequenceProvider->GetCurrentSamplePosition();
+
+    // Read sequences worth the requested number of minibatches.
+    std::vector<std::vector<SequenceDataPtr>> pool(m_numberOfStreams);
+    std::vector<size_t> lengths;
+    size_t poolSize = 0;
+    while (!m_endOfEpoch && poolSize < m_poolSizeInMinibatches * sampleCount)
+    {
+        Sequences sequences = m_sequenceProvider->GetNextSequences(sampleCount);
+        m_endOfEpoch = sequences.m_endOfEpoch;
+        if (sequences.m_data.empty())
+        {
+            continue;
+        }
+
+        assert(sequences.m_data.size() == m_numberOfStreams);
+        for (size_t i = 0; i < sequences.m_data.front().size(); ++i)
+        {
+            // The length of a sequence is its maximum length across all streams.
+            size_t length = 0;
+            for (size_t streamIndex = 0; streamIndex < m_numberOfStreams; ++streamIndex)
+            {
+                length = std::max(length, (size_t)sequences.m_data[streamIndex][i]->m_numberOfSamples);
+                pool[streamIndex].push_back(std::move(sequences.m_data[streamIndex][i]));
+            }
+
+            lengths.push_back(length);
+            poolSize += length;
+        }
+    }
+
+    // Sort the pool by length (stable to be reproducible) and cut it into minibatches.
+    std::vector<size_t> order(lengths.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&lengths](size_t a, size_t b) { return lengths[a] < lengths[b]; });
+
+    Sequences minibatch;
+    size_t minibatchSize = 0;
+    for (auto i : order)
+    {
+        if (minibatchSize != 0 && minibatchSize + lengths[i] > sampleCount)
+        {
+            m_minibatches.push_back(std::move(minibatch));
+            minibatch = Sequences();
+            minibatchSize = 0;
+        }
+
+        if (minibatch.m_data.empty())
+        {
+            minibatch.m_data.resize(m_numberOfStreams);
+        }
+
+        for (size_t streamIndex = 0; streamIndex < m_numberOfStreams; ++streamIndex)
+        {
+            minibatch.m_data[streamIndex].push_back(std::move(pool[streamIndex][i]));
+        }
+        minibatchSize += lengths[i];
+    }
+
+    if (minibatchSize != 0)
+    {
+        m_minibatches.push_back(std::move(minibatch));
+    }
+
+    // Otherwise minibatches would come in the order of increasing length.
+    std::mt19937_64 rng(m_poolStartPosition);
+    RandomShuffleMT(m_minibatches, rng);
+}
+
+}}}
@@ -0,0 +1,68 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <deque>
+#include <random>
+#include "SequenceEnumerator.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A sequence enumerator that groups sequences of similar length into the same minibatch,
+// so that the packer can fill the time axis of the minibatch layout densely.
+// Sits between the randomizer (or the transform controller) and the SequencePacker.
+// Reads a pool of sequences worth poolSizeInMinibatches minibatches from the underlying enumerator
+// (i.e. from its randomization window), sorts the pool by length, cuts it into minibatches and
+// returns these minibatches in a random order.
+// The current sample position is the position of the underlying enumerator at the start of the pool,
+// so after restoring from a checkpoint the already returned sequences of the pool are returned again.
+class LengthBucketer : public SequenceEnumerator
+{
+public:
+    LengthBucketer(SequenceEnumeratorPtr sequenceProvider, size_t poolSizeInMinibatches);
+
+    std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return m_sequenceProvider->GetStreamDescriptions();
+    }
+
+    void StartEpoch(const EpochConfiguration& config) override;
+
+    void SetConfiguration(const ReaderConfiguration& config) override
+    {
+        m_sequenceProvider->SetConfiguration(config);
+    }
+
+    void SetCurrentSamplePosition(size_t currentSamplePosition) override;
+
+    size_t GetCurrentSamplePosition() override;
+
+    Sequences GetNextSequences(size_t sampleCount) override;
+
+private:
+    // Reads the next pool of sequences and cuts it into minibatches of at most sampleCount samples.
+    void FillPool(size_t sampleCount);
+
+    // Drops the minibatches of the current pool.
+    void ResetPool();
+
+    SequenceEnumeratorPtr m_sequenceProvider;
+    size_t m_poolSizeInMinibatches;
+    size_t m_numberOfStreams;
+
+    // Minibatches of the current pool that are not returned yet.
+    std::deque<Sequences> m_minibatches;
+
+    // Position of the underlying enumerator at the start of the current pool.
+    size_t m_poolStartPosition;
+
+    // Whether the underlying enumerator has reached the end of the epoch.
+    bool m_endOfEpoch;
+
+    DISABLE_COPY_AND_MOVE(LengthBucketer);
+};
+
+}}}
@@ -0,0 +1,140 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "MemoryMappedFile.h"
+#include <algorithm>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+MemoryMappedFile::MemoryMappedFile(const std::wstring& path)
+    : m_path(path), m_data(nullptr), m_size(0)
+{
+#ifdef _WIN32
+    m_mappingHandle = nullptr;
+    m_fileHandle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_fileHandle == INVALID_HANDLE_VALUE)
+        RuntimeError("MemoryMappedFile: Cannot open file '%ls' (error %x).", path.c_str(), (unsigned int)GetLastError());
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_fileHandle, &size))
+    {
+        CloseHandle(m_fileHandle);
+        RuntimeError("MemoryMappedFile: Cannot retrieve the size of file '%ls'.", path.c_str());
+    }
+    m_size = (size_t)size.QuadPart;
+    if (m_size == 0)
+        return;
+
+    m_mappingHandle = CreateFileMapping(m_fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m_mappingHandle != NULL)
+        m_data = (const char*)MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (m_data == nullptr)
+    {
+        if (m_mappingHandle != NULL)
+            CloseHandle(m_mappingHandle);
+        CloseHandle(m_fileHandle);
+        RuntimeError("MemoryMappedFile: Cannot memory map file '%ls' (error %x).", path.c_str(), (unsigned int)GetLastError());
+    }
+#else
+    m_fileDescriptor = open(msra::strfun::utf8(path).c_str(), O_RDONLY);
+    if (m_fileDescriptor == -1)
+        RuntimeError("MemoryMappedFile: Cannot open file '%ls'.", path.c_str());
+
+    struct stat sb;
+    if (fstat(m_fileDescriptor, &sb) == -1)
+    {
+        close(m_fileDescriptor);
+        RuntimeError("MemoryMappedFile: Cannot retrieve the size of file '%ls'.", path.c_str());
+    }
+    m_size = (size_t)sb.st_size;
+    if (m_size == 0)
+        return;
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+    if (data == MAP_FAILED)
+    {
+        close(m_fileDescriptor);
+        RuntimeError("MemoryMappedFile: Cannot memory map file '%ls'.", path.c_str());
+    }
+    m_data = (const char*)data;
+#endif
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+#ifdef _WIN32
+    if (m_data != nullptr)
+        UnmapViewOfFile(m_data);
+    if (m_mappingHandle != NULL)
+        CloseHandle(m_mappingHandle);
+    CloseHandle(m_fileHandle);
+#else
+    if (m_data != nullptr)
+        munmap((void*)m_data, m_size);
+    close(m_fileDescriptor);
+#endif
+}
+
+#ifndef _WIN32
+// madvise() requires a page-aligned start address.
+static void AdviseRange(const char* data, size_t fileSize, size_t offset, size_t size, int advice)
+{
+    if (data == nullptr || offset >= fileSize)
+        return;
+    size = std::min(size, fileSize - offset);
+    static const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t alignedOffset = offset - offset % pageSize;
+    madvise((void*)(data + alignedOffset), size + offset - alignedOffset, advice);
+}
+#endif
+
+void MemoryMappedFile::Advise(size_t offset, size_t size, AccessPattern pattern) const
+{
+#ifndef _WIN32
+    int advice = pattern == AccessPattern::sequential ? MADV_SEQUENTIAL :
+                 pattern == AccessPattern::random ? MADV_RANDOM : MADV_NORMAL;
+    AdviseRange(m_data, m_size, offset, size, advice);
+#else
+    UNUSED(offset); UNUSED(size); UNUSED(pattern);
+#endif
+}
+
+void MemoryMappedFile::Prefetch(size_t offset, size_t size) const
+{
+#ifndef _WIN32
+    AdviseRange(m_data, m_size, offset, size, MADV_WILLNEED);
+#else
+    if (m_data == nullptr || offset >= m_size)
+        return;
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = (PVOID)(m_data + offset);
+    range.NumberOfBytes = std::min(size, m_size - offset);
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+}
+
+void MemoryMappedFile::Release(size_t offset, size_t size) const
+{
+#ifndef _WIN32
+    AdviseRange(m_data, m_size, offset, size, MADV_DONTNEED);
+#else
+    UNUSED(offset); UNUSED(size);
+#endif
+}
+
+}}}
@@ -0,0 +1,61 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include "Basics.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A read-only memory mapping of a whole file.
+// Deserializers can hand out pointers into the mapping instead of copying the data,
+// as long as the sequences keep a reference to the mapping (e.g. through their chunk).
+class MemoryMappedFile
+{
+public:
+    // Access pattern hints for the OS page cache (ignored where not supported).
+    enum class AccessPattern
+    {
+        normal,
+        sequential,
+        random
+    };
+
+    explicit MemoryMappedFile(const std::wstring& path);
+    ~MemoryMappedFile();
+
+    const char* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+    const std::wstring& Path() const { return m_path; }
+
+    // Sets the expected access pattern for the given byte range.
+    void Advise(size_t offset, size_t size, AccessPattern pattern) const;
+
+    // Asks the OS to start reading the given byte range into the page cache.
+    void Prefetch(size_t offset, size_t size) const;
+
+    // Tells the OS that the given byte range will not be accessed in the near future,
+    // so that its pages can be dropped from the working set.
+    void Release(size_t offset, size_t size) const;
+
+private:
+    std::wstring m_path;
+    const char* m_data;
+    size_t m_size;
+#ifdef _WIN32
+    void* m_fileHandle;
+    void* m_mappingHandle;
+#else
+    int m_fileDescriptor;
+#endif
+
+    DISABLE_COPY_AND_MOVE(MemoryMappedFile);
+};
+
+typedef std::shared_ptr<MemoryMappedFile> MemoryMappedFilePtr;
+
+}}}
@@ -7,6 +7,9 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+
 #ifdef _WIN32
 #include <objbase.h>
 #endif
@@ -18,18 +21,24 @@
 #include "DataReader.h"
 #include "ReaderShim.h"
 #include "DataTransferer.h"
+#include "ReaderStageTimes.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 template <class ElemType>
 ReaderShim<ElemType>::ReaderShim() :
-    m_deviceId(CPUDEVICE),
-    m_dataTransferers(2, DataTransfererPtr()),
-    m_currentDataTransferIndex(0),
-    m_endOfEpoch(false),
-    m_currentSamplePosition(0),
     m_reader(nullptr),
-    m_factory(nullptr)
+    m_factory(nullptr),
+    m_endOfEpoch(false),
+    m_prefetch(true),
+    m_prefetchSlots(1),
+    m_firstQueuedSlot(0),
+    m_numQueuedSlots(0),
+    m_stopPrefetch(false),
+    m_statistics(),
+    m_verbosity(0),
+    m_deviceId(CPUDEVICE),
+    m_currentSamplePosition(0)
 {
 }
 
@@ -53,10 +62,14 @@ void ReaderShim<ElemType>::Init(const ConfigParameters& config)
     intargvector numberOfuttsPerMinibatchForAllEpochs =
         config(L"nbruttsineachrecurrentiter", ConfigParameters::Array(intargvector(vector<int> { 1 })));
 
-    bool prefetch = config(L"prefetch", true);
-    // if prefetch - launching asynchronously,
-    // otherwise deferring - synchronous execution during .get() call
-    m_launchType = prefetch ? launch::async : launch::deferred;
+    // if prefetch - reading on a separate thread up to prefetchDepth minibatches ahead,
+    // otherwise reading synchronously during GetMinibatch call
+    m_prefetch = config(L"prefetch", true);
+    size_t prefetchDepth = config(L"prefetchDepth", (size_t)1);
+    if (prefetchDepth == 0)
+        InvalidArgument("ReaderShim: prefetchDepth must be at least 1.");
+    m_prefetchSlots.resize(m_prefetch ? prefetchDepth : 1);
+    m_verbosity = config(L"verbosity", 0);
 
     m_numParallelSequences = numberOfuttsPerMinibatchForAllEpochs[0];
 
@@ -98,71 +111,34 @@ void ReaderShim<ElemType>::StartDistributedMinibatchLoop(
 template <class ElemType>
 void ReaderShim<ElemType>::SetCurrentSamplePosition(size_t currentSamplePosition)
 {
-    // Make sure there are no outstanding reads.
-    if (m_prefetchTask.valid())
-        m_prefetchTask.wait();
-
-    // Let's check that there is no outstanding copies.
-    // Wait on all events if there are any pending copy operations in flight.
-    if (m_dataTransferers[m_currentDataTransferIndex])
-        m_dataTransferers[m_currentDataTransferIndex]->WaitForCopyCPUToGPU();
+    // Make sure there are no outstanding reads or copies, prefetched minibatches are dropped.
+    StopPrefetch();
 
     // Set current position.
     m_reader->SetCurrentSamplePosition(currentSamplePosition);
     m_currentSamplePosition = m_reader->GetCurrentSamplePosition();
 
-    // Start prefetch.
-    auto localCurrentDataTransferIndex = m_currentDataTransferIndex;
-    // Starting the prefetch task. There is always a single async read in flight.
-    // When the network requests a new minibatch, we wait for the current async to finish, swap the buffers
-    // and kick off the new prefetch.
-    m_prefetchTask = std::async(m_launchType,
-        [this, localCurrentDataTransferIndex]()
-    {
-        return PrefetchMinibatch(localCurrentDataTransferIndex);
-    });
+    StartPrefetch();
 }
 
 template <class ElemType>
 void ReaderShim<ElemType>::SetConfiguration(const ReaderConfiguration& config, const std::map<std::wstring, int>& inputDescriptions)
 {
-    // Make sure there are no outstanding reads.
-    if (m_prefetchTask.valid())
-        m_prefetchTask.wait();
-
-    // Let's check that there is no outstanding copies.
-    // Wait on all events if there are any pending copy operations in flight.
-    if (m_dataTransferers[m_currentDataTransferIndex])
-        m_dataTransferers[m_currentDataTransferIndex]->WaitForCopyCPUToGPU();
+    // Make sure there are no outstanding reads or copies. Minibatches prefetched
+    // with the old configuration are dropped and read again from the current position.
+    StopPrefetch();
 
     m_reader->SetConfiguration(config, inputDescriptions);
     m_reader->SetCurrentSamplePosition(m_currentSamplePosition);
 
-    // Start prefetch.
-    auto localCurrentDataTransferIndex = m_currentDataTransferIndex;
-    // Starting the prefetch task. There is always a single async read in flight.
-    // When the network requests a new minibatch, we wait for the current async to finish, swap the buffers
-    // and kick off the new prefetch.
-    m_prefetchTask = std::async(m_launchType,
-        [this, localCurrentDataTransferIndex]()
-    {
-        return PrefetchMinibatch(localCurrentDataTransferIndex);
-    });
+    StartPrefetch();
 }
 
 template <class ElemType>
 void ReaderShim<ElemType>::StartEpoch(const EpochConfiguration& config, const std::unordered_set<InputStreamDescription>& inputs)
 {
-    // For adaptive minibatch, make sure there are no outstanding reads.
-    if (m_prefetchTask.valid())
-    {
-        m_prefetchTask.wait();
-    }
-
-    // Let's check that there is no outstanding copies.
-    // Wait on all events if there are any pending copy operations in flight.
-    if (m_dataTransferers[m_currentDataTransferIndex])
-        m_dataTransferers[m_currentDataTransferIndex]->WaitForCopyCPUToGPU();
+    // For adaptive minibatch, make sure there are no outstanding reads or copies.
+    StopPrefetch();
 
     // Now we can be sure, no prefetch thread is running and there are no outstanding memcopies.
     // Let's check that requested devices are ok and see whether we need to change our data transferers.
@@ -181,11 +157,10 @@ void ReaderShim<ElemType>::StartEpoch(const EpochConfiguration& config, const st
     if (m_deviceId != deviceId)
     {
         // Device changed. Let's change the data transferers.
+        // We need one per slot in order to support a copy in flight for each prefetched minibatch.
         m_deviceId = deviceId;
-        m_dataTransferers.clear();
-        // We need two in order to support two operations in flight.
-        m_dataTransferers.push_back(m_deviceId == CPUDEVICE ? nullptr : CreatePrefetchDataTransferer(m_deviceId));
-        m_dataTransferers.push_back(m_deviceId == CPUDEVICE ? nullptr : CreatePrefetchDataTransferer(m_deviceId));
+        for (auto& slot : m_prefetchSlots)
+            slot.m_dataTransferer = m_deviceId == CPUDEVICE ? nullptr : CreatePrefetchDataTransferer(m_deviceId);
     }
 
     // Let's create the buffers for the prefetch thread.
@@ -194,26 +169,96 @@ void ReaderShim<ElemType>::StartEpoch(const EpochConfiguration& config, const st
     {
         inputDescriptions[i.GetStreamName()] = i.GetDeviceId();
         // Creating buffers with the same properties the network expects.
-        m_prefetchBuffers[i.GetStreamName()] = StreamPrefetchBuffer
+        for (auto& slot : m_prefetchSlots)
         {
-            std::make_shared<Matrix<ElemType>>(0, 0, i.GetDeviceId(), i.GetMatrixType(), i.GetMatrixFormat()),
-            std::make_shared<MBLayout>()
-        };
+            slot.m_buffers[i.GetStreamName()] = StreamPrefetchBuffer
+            {
+                std::make_shared<Matrix<ElemType>>(0, 0, i.GetDeviceId(), i.GetMatrixType(), i.GetMatrixFormat()),
+                std::make_shared<MBLayout>()
+            };
+        }
     }
 
     m_endOfEpoch = false;
     m_reader->StartEpoch(config, inputDescriptions);
     m_currentSamplePosition = m_reader->GetCurrentSamplePosition();
 
-    auto localCurrentDataTransferIndex = m_currentDataTransferIndex;
-    // Starting the prefetch task. There is always a single async read in flight.
-    // When the network requests a new minibatch, we wait for the current async to finish, swap the buffers
-    // and kick off the new prefetch.
-    m_prefetchTask = std::async(m_launchType,
-    [this, localCurrentDataTransferIndex]()
+    m_statistics = PrefetchStatistics();
+    m_lastMinibatchEnd = std::chrono::steady_clock::time_point();
+
+    StartPrefetch();
+}
+
+template <class ElemType>
+void ReaderShim<ElemType>::StartPrefetch()
+{
+    assert(!m_prefetchThread.joinable() && m_numQueuedSlots == 0);
+    m_firstQueuedSlot = 0;
+    m_stopPrefetch = false;
+    if (m_prefetch)
+        m_prefetchThread = std::thread([this]() { PrefetchLoop(); });
+}
+
+template <class ElemType>
+void ReaderShim<ElemType>::StopPrefetch()
+{
+    if (m_prefetchThread.joinable())
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_prefetchMutex);
+            m_stopPrefetch = true;
+        }
+        m_prefetchCondition.notify_all();
+        m_prefetchThread.join();
+    }
+
+    // Let's check that there is no outstanding copies.
+    // Wait on all events if there are any pending copy operations in flight.
+    for (size_t i = 0; i < m_numQueuedSlots; i++)
+    {
+        const auto& slot = m_prefetchSlots[(m_firstQueuedSlot + i) % m_prefetchSlots.size()];
+        if (slot.m_dataTransferer)
+            slot.m_dataTransferer->WaitForCopyCPUToGPU();
+    }
+    m_numQueuedSlots = 0;
+}
+
+template <class ElemType>
+void ReaderShim<ElemType>::PrefetchLoop()
+{
+    for (;;)
     {
-        return PrefetchMinibatch(localCurrentDataTransferIndex);
-    });
+        size_t slotIndex;
+        {
+            std::unique_lock<std::mutex> lock(m_prefetchMutex);
+            m_prefetchCondition.wait(lock, [this]() { return m_stopPrefetch || m_numQueuedSlots < m_prefetchSlots.size(); });
+            if (m_stopPrefetch)
+                return;
+            slotIndex = (m_firstQueuedSlot + m_numQueuedSlots) % m_prefetchSlots.size();
+        }
+
+        // The slot is not visible to the main thread until it is queued below.
+        auto& slot = m_prefetchSlots[slotIndex];
+        slot.m_exception = nullptr;
+        try
+        {
+            slot.m_result = PrefetchMinibatch(slot);
+        }
+        catch (...)
+        {
+            slot.m_exception = std::current_exception();
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(m_prefetchMutex);
+            m_numQueuedSlots++;
+        }
+        m_prefetchCondition.notify_all();
+
+        // Nothing to read after the end of epoch or a failure.
+        if (slot.m_exception || slot.m_result.m_isEndOfEpoch)
+            return;
+    }
 }
 
 string EnumerateInputs(const unordered_map<wstring, size_t>& nameToStreamId)
@@ -263,37 +308,63 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
         }
     }
 
-    // Make sure the prefetch has finished.
-    assert(m_prefetchTask.valid());
-    auto result = m_prefetchTask.get();
+    // Wait for the next prefetched minibatch, or read it now if prefetch is disabled.
+    auto waitStart = std::chrono::steady_clock::now();
+    if (m_lastMinibatchEnd != std::chrono::steady_clock::time_point())
+        m_statistics.m_computeSeconds += std::chrono::duration<double>(waitStart - m_lastMinibatchEnd).count();
+
+    auto& slot = m_prefetchSlots[m_firstQueuedSlot];
+    if (m_prefetch)
+    {
+        std::unique_lock<std::mutex> lock(m_prefetchMutex);
+        if (m_numQueuedSlots == 0)
+            m_statistics.m_numStalls++;
+        m_prefetchCondition.wait(lock, [this]() { return m_numQueuedSlots > 0; });
+    }
+    else
+    {
+        slot.m_result = PrefetchMinibatch(slot);
+        m_numQueuedSlots = 1;
+    }
+
+    m_statistics.m_numMinibatches++;
+    m_statistics.m_dataWaitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+
+    if (slot.m_exception)
+        std::rethrow_exception(slot.m_exception);
 
     // Ok, prefetch is done.
+    auto result = slot.m_result;
 
     // Let's update our sample position.
-    m_currentSamplePosition = m_reader->GetCurrentSamplePosition();
+    m_currentSamplePosition = slot.m_samplePosition;
 
     m_endOfEpoch = result.m_isEndOfEpoch;
-    if (m_endOfEpoch && !result.m_isDataAvailable)
+    if (m_endOfEpoch)
     {
-        // No data and end of epoch, simply return.
-        return false;
-    }
-
-    // Remember current data transfer, async memcpy for it already started on the prefetch thread.
-    auto currentDataTransferIndex = m_currentDataTransferIndex;
+        if (m_verbosity > 0)
+            fprintf(stderr, "ReaderShim: %" PRIu64 " minibatches (prefetch depth %" PRIu64 "), waited for data %.3fs (%" PRIu64 " stalls), compute %.3fs\n",
+                    m_statistics.m_numMinibatches, m_prefetchSlots.size(), m_statistics.m_dataWaitSeconds,
+                    m_statistics.m_numStalls, m_statistics.m_computeSeconds);
 
-    // Let's update the current data transferer.
-    m_currentDataTransferIndex = (m_currentDataTransferIndex + 1) % 2;
+        if (!result.m_isDataAvailable)
+        {
+            // No data and end of epoch, simply return.
+            ReleasePrefetchSlot();
+            return false;
+        }
+    }
 
-    // Record an event that prefetch can wait on to ensure that prior compute has finished.
-    if (m_dataTransferers[m_currentDataTransferIndex])
-        m_dataTransferers[m_currentDataTransferIndex]->RecordComputeStreamSyncPoint();
+    // Record an event that prefetch can wait on to ensure that prior compute has finished
+    // before reusing the matrices we are about to swap into this slot.
+    if (slot.m_dataTransferer)
+        slot.m_dataTransferer->RecordComputeStreamSyncPoint();
 
     // We have some data - let's swap the matrices.
     // We cannot simply change pointers because it seems they are remembered deeper in the network.
     for (auto i = matrices.begin(); i != matrices.end(); ++i)
     {
-        std::swap(i->second.GetMatrix<ElemType>(), *m_prefetchBuffers[i->first].m_matrix);
+        std::swap(i->second.GetMatrix<ElemType>(), *slot.m_buffers[i->first].m_matrix);
 
         // Resetting layouts.
         i->second.pMBLayout->Init(1, 0);
@@ -305,7 +376,7 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
     // Let's now check the layouts and throw if the same layout is being assigned twice.
     for (auto i = matrices.begin(); i != matrices.end(); ++i)
     {
-        auto streamLayout = m_prefetchBuffers[i->first].m_mbLayout;
+        auto streamLayout = slot.m_buffers[i->first].m_mbLayout;
         auto& layout = i->second.pMBLayout;
         if (layout->GetNumCols() == 0) // just initialized, let's take the layout of the reader.
         {
@@ -326,31 +397,35 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
     // So pick up the first one.
     m_numParallelSequences = matrices.begin()->second.pMBLayout->GetNumParallelSequences();
 
-    // It is time to issue the next prefetch.
-    if (!m_endOfEpoch)
-    {
-        // Starting the prefetch task. There is always a single async read in flight.
-        // When the network requests a new minibatch, we wait for the current async to finish, swap the buffers
-        // and kick off the new prefetch.
-        auto localCurrentDataTransferIndex = m_currentDataTransferIndex;
-        m_prefetchTask = std::async(m_launchType, [this, localCurrentDataTransferIndex]() { return PrefetchMinibatch(localCurrentDataTransferIndex); });
-    }
-
-    // Let's wait till the previous memcopy has finished.
-    if (m_dataTransferers[currentDataTransferIndex])
-        m_dataTransferers[currentDataTransferIndex]->WaitForCopyCPUToGPU();
+    // Let's wait till the memcopy has finished, then the slot can be refilled.
+    if (slot.m_dataTransferer)
+        slot.m_dataTransferer->WaitForCopyCPUToGPU();
 
+    ReleasePrefetchSlot();
+    m_lastMinibatchEnd = std::chrono::steady_clock::now();
     return result.m_isDataAvailable;
 }
 
 template <class ElemType>
-typename ReaderShim<ElemType>::PrefetchResult ReaderShim<ElemType>::PrefetchMinibatch(size_t currentDataTransferIndex)
+void ReaderShim<ElemType>::ReleasePrefetchSlot()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_prefetchMutex);
+        m_firstQueuedSlot = (m_firstQueuedSlot + 1) % m_prefetchSlots.size();
+        m_numQueuedSlots--;
+    }
+    m_prefetchCondition.notify_all();
+}
+
+template <class ElemType>
+typename ReaderShim<ElemType>::PrefetchResult ReaderShim<ElemType>::PrefetchMinibatch(PrefetchSlot& slot)
 {
     // Resetting layouts.
-    for (auto& mx : m_prefetchBuffers)
+    for (auto& mx : slot.m_buffers)
         mx.second.m_mbLayout = std::make_shared<MBLayout>();
 
     Minibatch minibatch = m_reader->ReadMinibatch();
+    slot.m_samplePosition = m_reader->GetCurrentSamplePosition();
 
     // If there is no data we can simply return.
     if (minibatch.m_data.empty())
@@ -360,22 +435,23 @@ typename ReaderShim<ElemType>::PrefetchResult ReaderShim<ElemType>::PrefetchMini
     // But before we need to make sure that corresponding compute has already finished from the last iteration.
 
     // We need to make sure that the compute for the current transfer is finished before we start prefetch.
-    if (m_dataTransferers[currentDataTransferIndex])
-        m_dataTransferers[currentDataTransferIndex]->WaitForSyncPointOnAssignStreamAsync();
+    if (slot.m_dataTransferer)
+        slot.m_dataTransferer->WaitForSyncPointOnAssignStreamAsync();
 
-    for (auto& mx : m_prefetchBuffers)
+    ScopedStageTimer timer(m_stageTimes.get(), ReaderStage::copy);
+    for (auto& mx : slot.m_buffers)
     {
         size_t streamId = m_nameToStreamId[mx.first];
         const auto& stream = minibatch.m_data[streamId];
         mx.second.m_mbLayout = stream->m_layout;
 
         size_t sampleSize = m_streams[streamId]->m_sampleLayout->GetNumElements();
-        FillMatrixFromStream(m_streams[streamId]->m_storageType, mx.second.m_matrix.get(), sampleSize, stream, m_dataTransferers[currentDataTransferIndex].get());
+        FillMatrixFromStream(m_streams[streamId]->m_storageType, mx.second.m_matrix.get(), sampleSize, stream, slot.m_dataTransferer.get());
     }
 
     // Let's record that we started the copy, so that the main thread can wait afterwards.
-    if (m_dataTransferers[currentDataTransferIndex])
-        m_dataTransferers[currentDataTransferIndex]->RecordCPUToGPUCopy();
+    if (slot.m_dataTransferer)
+        slot.m_dataTransferer->RecordCPUToGPUCopy();
 
     return PrefetchResult{ minibatch.m_endOfEpoch, true };
 }
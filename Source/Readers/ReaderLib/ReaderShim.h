@@ -10,7 +10,10 @@
 
 #include <unordered_map>
 #include <string>
-#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include "DataReader.h"
 #include "Reader.h"
 
@@ -21,6 +24,9 @@ namespace CNTK
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+class ReaderStageTimes;
+typedef std::shared_ptr<ReaderStageTimes> ReaderStageTimesPtr;
+
 typedef ReaderPtr (*ReaderFactory)(const ConfigParameters& parameters);
 
 template <class ElemType>
@@ -34,7 +40,7 @@ public:
     explicit ReaderShim(ReaderFactory factory);
     explicit ReaderShim(ReaderPtr reader);
 
-    virtual ~ReaderShim() { }
+    virtual ~ReaderShim() { StopPrefetch(); }
 
     virtual void Init(const ScriptableObjects::IConfigRecord& /*config*/) override
     {
@@ -45,13 +51,7 @@ public:
     virtual void Destroy() override
     {
         // Make sure there are no outstanding reads.
-        // Future destructor does not wait as of 2013 so probably it is not in VS2013:
-        // More info can be found here http://www.open-std.org/jtc1/sc22/wg21/docs/papers/2013/n3679.html.
-        if (m_prefetchTask.valid())
-        {
-            // If there are some, give them time to finish.
-            m_prefetchTask.wait_for(std::chrono::seconds(5));
-        }
+        StopPrefetch();
 
         delete this;
     }
@@ -100,6 +100,27 @@ public:
         return m_endOfEpoch;
     }
 
+    // Where the time went in the current epoch: waiting in GetMinibatch for prefetched data
+    // versus between GetMinibatch calls (i.e. the trainer's compute).
+    struct PrefetchStatistics
+    {
+        size_t m_numMinibatches;
+        size_t m_numStalls;      // Number of minibatches for which the prefetch queue was empty.
+        double m_dataWaitSeconds;
+        double m_computeSeconds;
+    };
+
+    const PrefetchStatistics& GetPrefetchStatistics() const
+    {
+        return m_statistics;
+    }
+
+    // Accounts the copies of minibatches into the matrices to ReaderStage::copy of the given stage times.
+    void SetStageTimes(ReaderStageTimesPtr times)
+    {
+        m_stageTimes = times;
+    }
+
 private:
     struct PrefetchResult
     {
@@ -107,9 +128,48 @@ private:
         bool m_isDataAvailable;
     };
 
-    PrefetchResult PrefetchMinibatch(size_t currentDataTransferIndex);
+    // Data structure required for prefetch.
+    struct StreamPrefetchBuffer
+    {
+        std::shared_ptr<Matrix<ElemType>> m_matrix;
+        MBLayoutPtr m_mbLayout;
+    };
+
+    // One prefetched minibatch.
+    struct PrefetchSlot
+    {
+        // Intermediate buffer where the prefetch thread puts its data to.
+        // When the main thread enters GetMinibatch it swaps the matrices from this buffer
+        // and waits if memCpy is still in progress.
+        std::unordered_map<std::wstring, StreamPrefetchBuffer> m_buffers;
+
+        // Data transfer of this slot, so that copies of all queued minibatches can be in flight.
+        DataTransfererPtr m_dataTransferer;
+
+        PrefetchResult m_result;
+
+        // Sample position of the reader right after this minibatch.
+        size_t m_samplePosition;
+
+        // Exception thrown while prefetching, rethrown on the main thread.
+        std::exception_ptr m_exception;
+    };
+
+    PrefetchResult PrefetchMinibatch(PrefetchSlot& slot);
+
+    // Body of the prefetch thread: reads minibatches ahead until the queue is full or the epoch ends.
+    void PrefetchLoop();
+
+    // Starts prefetching from the current reader position.
+    void StartPrefetch();
+
+    // Stops the prefetch thread, waits for outstanding copies and drops all prefetched minibatches.
+    // The reader position is then ahead of m_currentSamplePosition and must be reset by the caller.
+    void StopPrefetch();
+
+    // Hands the first queued slot back to the prefetch thread.
+    void ReleasePrefetchSlot();
 
-    std::future<PrefetchResult> m_prefetchTask;
     ReaderPtr m_reader;
     ReaderFactory m_factory;
     bool m_endOfEpoch;
@@ -118,34 +178,33 @@ private:
 
     std::unordered_map<std::wstring, size_t> m_nameToStreamId;
     std::vector<StreamDescriptionPtr> m_streams;
-    launch m_launchType;
-
-    // Data structure required for prefetch.
-    struct StreamPrefetchBuffer
-    {
-        std::shared_ptr<Matrix<ElemType>> m_matrix;
-        MBLayoutPtr m_mbLayout;
-    };
-
-    // Intermediate buffer where the prefetch thread puts its data to.
-    // When the main thread enters GetMinibatch it swaps the matrices from this buffer,
-    // triggers the next prefetch and waits if memCpy is still in progress.
-    std::unordered_map<std::wstring, StreamPrefetchBuffer> m_prefetchBuffers;
-
-    // Alternating data transfer operations. In the current version these are only two - 
-    // currently waiting on the main thread and the one that can be started by the prefetch thread 
-    // in the meantime.
-    std::vector<DataTransfererPtr> m_dataTransferers;
 
-    // Current data transfer. Flips 0 and 1.
-    // Can be changed only from the main thread with no ongoing prefetch.
-    size_t m_currentDataTransferIndex; 
+    // Whether to read on a separate thread or synchronously in GetMinibatch.
+    bool m_prefetch;
+
+    // Bounded queue of prefetched minibatches, used as a ring buffer. There is a single prefetch thread, because
+    // the reader delivers minibatches sequentially; it reads ahead up to m_prefetchSlots.size() minibatches
+    // so that a slow minibatch (e.g. at a chunk boundary) does not stall the trainer.
+    // A slot is released to the prefetch thread only after the main thread has swapped its matrices
+    // and waited for its copy to finish.
+    std::vector<PrefetchSlot> m_prefetchSlots;
+    size_t m_firstQueuedSlot;
+    size_t m_numQueuedSlots;
+    bool m_stopPrefetch;
+    std::thread m_prefetchThread;
+    std::mutex m_prefetchMutex;
+    std::condition_variable m_prefetchCondition;
+
+    PrefetchStatistics m_statistics;
+    ReaderStageTimesPtr m_stageTimes;
+    std::chrono::steady_clock::time_point m_lastMinibatchEnd;
+    int m_verbosity;
 
     // Device id.
     int m_deviceId;
 
-    // Current sample position of the reader on the global timeline.
-    // We have to remember the value locally before starting prefetch.
+    // Current sample position of the reader on the global timeline, i.e. after the last minibatch
+    // returned by GetMinibatch. The reader itself is ahead by the prefetched minibatches.
     // The value is updated only from the main thread (in StartEpoch/GetMinibatch)
     size_t m_currentSamplePosition;
 
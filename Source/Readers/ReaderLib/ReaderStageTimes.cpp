@@ -0,0 +1,111 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "Platform.h"
+#include "ReaderStageTimes.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+void ReaderStageTimes::Reset()
+{
+    for (auto& nanoseconds : m_nanoseconds)
+    {
+        nanoseconds = 0;
+    }
+}
+
+const char* ReaderStageTimes::GetName(ReaderStage stage)
+{
+    switch (stage)
+    {
+    case ReaderStage::deserialize:
+        return "deserialize";
+    case ReaderStage::randomize:
+        return "randomize";
+    case ReaderStage::transform:
+        return "transform";
+    case ReaderStage::pack:
+        return "pack";
+    case ReaderStage::copy:
+        return "copy";
+    default:
+        LogicError("Unknown reader stage %d.", (int)stage);
+    }
+}
+
+// The innermost active timer of the current thread.
+static THREAD_LOCAL ScopedStageTimer* s_currentTimer = nullptr;
+
+ScopedStageTimer::ScopedStageTimer(ReaderStageTimes* times, ReaderStage stage)
+    : m_times(times), m_stage(stage), m_parent(nullptr), m_nested(0)
+{
+    if (!m_times)
+    {
+        return;
+    }
+
+    m_parent = s_currentTimer;
+    s_currentTimer = this;
+    m_start = std::chrono::steady_clock::now();
+}
+
+ScopedStageTimer::~ScopedStageTimer()
+{
+    if (!m_times)
+    {
+        return;
+    }
+
+    auto duration = std::chrono::steady_clock::now() - m_start;
+    m_times->Add(m_stage, duration - m_nested);
+
+    s_currentTimer = m_parent;
+    if (m_parent)
+    {
+        m_parent->m_nested += duration;
+    }
+}
+
+// Chunk decorator, accounts GetSequence to ReaderStage::deserialize.
+class TimedChunk : public Chunk
+{
+public:
+    TimedChunk(ChunkPtr chunk, ReaderStageTimesPtr times)
+        : m_chunk(chunk), m_times(times)
+    {
+    }
+
+    void GetSequence(size_t sequenceId, std::vector<SequenceDataPtr>& result) override
+    {
+        ScopedStageTimer timer(m_times.get(), ReaderStage::deserialize);
+        m_chunk->GetSequence(sequenceId, result);
+    }
+
+private:
+    ChunkPtr m_chunk;
+    ReaderStageTimesPtr m_times;
+};
+
+void TimedDeserializer::GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& descriptions)
+{
+    ScopedStageTimer timer(m_times.get(), ReaderStage::deserialize);
+    m_deserializer->GetSequencesForChunk(chunkId, descriptions);
+}
+
+bool TimedDeserializer::GetSequenceDescription(const SequenceDescription& primary, SequenceDescription& description)
+{
+    ScopedStageTimer timer(m_times.get(), ReaderStage::deserialize);
+    return m_deserializer->GetSequenceDescription(primary, description);
+}
+
+ChunkPtr TimedDeserializer::GetChunk(ChunkIdType chunkId)
+{
+    ScopedStageTimer timer(m_times.get(), ReaderStage::deserialize);
+    ChunkPtr chunk = m_deserializer->GetChunk(chunkId);
+    return chunk ? std::make_shared<TimedChunk>(chunk, m_times) : chunk;
+}
+
+}}}
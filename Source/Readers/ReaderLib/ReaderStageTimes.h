@@ -0,0 +1,181 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include "DataDeserializer.h"
+#include "SequenceEnumerator.h"
+#include "Packer.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Stages of the reader pipeline the time is accounted for.
+enum class ReaderStage
+{
+    deserialize, // loading chunks and sequences by the deserializers
+    randomize,   // randomizer (or NoRandomizer), excluding deserialization
+    transform,   // transformers, excluding the stages above
+    pack,        // packer (and bucketing), excluding the stages above
+    copy,        // copying the packed minibatch into the matrices
+    numberOfStages
+};
+
+// Accumulated time spent in the stages of the reader pipeline, over all threads (i.e. in thread-seconds:
+// with parallel deserialization or read ahead the sum can exceed the wall clock time).
+// Times are exclusive: time spent in a nested stage (i.e. deserialization requested by the randomizer)
+// is only accounted to the nested stage.
+class ReaderStageTimes
+{
+public:
+    ReaderStageTimes()
+    {
+        Reset();
+    }
+
+    void Reset();
+
+    void Add(ReaderStage stage, std::chrono::steady_clock::duration duration)
+    {
+        m_nanoseconds[(size_t)stage] += std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    }
+
+    double GetSeconds(ReaderStage stage) const
+    {
+        return m_nanoseconds[(size_t)stage] * 1e-9;
+    }
+
+    static const char* GetName(ReaderStage stage);
+
+private:
+    std::atomic<uint64_t> m_nanoseconds[(size_t)ReaderStage::numberOfStages];
+
+    DISABLE_COPY_AND_MOVE(ReaderStageTimes);
+};
+
+typedef std::shared_ptr<ReaderStageTimes> ReaderStageTimesPtr;
+
+// Accounts the time of its scope to a stage, excluding the time of scopes nested on the same thread.
+// Does nothing if no stage times are given.
+class ScopedStageTimer
+{
+public:
+    ScopedStageTimer(ReaderStageTimes* times, ReaderStage stage);
+    ~ScopedStageTimer();
+
+private:
+    ReaderStageTimes* m_times;
+    ReaderStage m_stage;
+    ScopedStageTimer* m_parent;
+    std::chrono::steady_clock::time_point m_start;
+    std::chrono::steady_clock::duration m_nested;
+
+    DISABLE_COPY_AND_MOVE(ScopedStageTimer);
+};
+
+// Deserializer decorator that accounts chunk and sequence loading to ReaderStage::deserialize.
+class TimedDeserializer : public IDataDeserializer
+{
+public:
+    TimedDeserializer(IDataDeserializerPtr deserializer, ReaderStageTimesPtr times)
+        : m_deserializer(deserializer), m_times(times)
+    {
+    }
+
+    std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return m_deserializer->GetStreamDescriptions();
+    }
+
+    ChunkDescriptions GetChunkDescriptions() override
+    {
+        return m_deserializer->GetChunkDescriptions();
+    }
+
+    void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& descriptions) override;
+
+    bool GetSequenceDescription(const SequenceDescription& primary, SequenceDescription& description) override;
+
+    ChunkPtr GetChunk(ChunkIdType chunkId) override;
+
+private:
+    IDataDeserializerPtr m_deserializer;
+    ReaderStageTimesPtr m_times;
+};
+
+// Sequence enumerator decorator that accounts GetNextSequences to the given stage.
+class TimedSequenceEnumerator : public SequenceEnumerator
+{
+public:
+    TimedSequenceEnumerator(SequenceEnumeratorPtr sequenceEnumerator, ReaderStage stage, ReaderStageTimesPtr times)
+        : m_sequenceEnumerator(sequenceEnumerator), m_stage(stage), m_times(times)
+    {
+    }
+
+    std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return m_sequenceEnumerator->GetStreamDescriptions();
+    }
+
+    void StartEpoch(const EpochConfiguration& config) override
+    {
+        m_sequenceEnumerator->StartEpoch(config);
+    }
+
+    void SetConfiguration(const ReaderConfiguration& config) override
+    {
+        m_sequenceEnumerator->SetConfiguration(config);
+    }
+
+    void SetCurrentSamplePosition(size_t currentSamplePosition) override
+    {
+        m_sequenceEnumerator->SetCurrentSamplePosition(currentSamplePosition);
+    }
+
+    size_t GetCurrentSamplePosition() override
+    {
+        return m_sequenceEnumerator->GetCurrentSamplePosition();
+    }
+
+    Sequences GetNextSequences(size_t sampleCount) override
+    {
+        ScopedStageTimer timer(m_times.get(), m_stage);
+        return m_sequenceEnumerator->GetNextSequences(sampleCount);
+    }
+
+private:
+    SequenceEnumeratorPtr m_sequenceEnumerator;
+    ReaderStage m_stage;
+    ReaderStageTimesPtr m_times;
+};
+
+// Packer decorator that accounts ReadMinibatch to ReaderStage::pack.
+class TimedPacker : public Packer
+{
+public:
+    TimedPacker(PackerPtr packer, ReaderStageTimesPtr times)
+        : m_packer(packer), m_times(times)
+    {
+    }
+
+    void SetConfiguration(const ReaderConfiguration& config, const std::vector<MemoryProviderPtr>& memoryProviders) override
+    {
+        m_packer->SetConfiguration(config, memoryProviders);
+    }
+
+    Minibatch ReadMinibatch() override
+    {
+        ScopedStageTimer timer(m_times.get(), ReaderStage::pack);
+        return m_packer->ReadMinibatch();
+    }
+
+private:
+    PackerPtr m_packer;
+    ReaderStageTimesPtr m_times;
+};
+
+}}}
@@ -44,6 +44,10 @@ Minibatch SequencePacker::ReadMinibatch()
     Minibatch minibatch(sequences.m_endOfEpoch);
     if (batch.empty())
     {
+        if (m_reportPaddingEfficiency)
+        {
+            UpdatePaddingEfficiency(nullptr, sequences.m_endOfEpoch);
+        }
         return minibatch;
     }
 
@@ -73,9 +77,32 @@ Minibatch SequencePacker::ReadMinibatch()
     }
 
     m_currentBufferIndex = (m_currentBufferIndex + 1) % m_numberOfBuffers;
+
+    if (m_reportPaddingEfficiency)
+    {
+        UpdatePaddingEfficiency(minibatch.m_data.front()->m_layout, sequences.m_endOfEpoch);
+    }
+
     return minibatch;
 }
 
+void SequencePacker::UpdatePaddingEfficiency(const MBLayoutPtr& layout, bool endOfEpoch)
+{
+    if (layout)
+    {
+        m_validFrames += layout->GetActualNumSamples();
+        m_allocatedFrames += layout->GetNumCols();
+    }
+
+    if (endOfEpoch && m_allocatedFrames != 0)
+    {
+        fprintf(stderr, "SequencePacker: padding efficiency %.1f%% (%" PRIu64 " valid of %" PRIu64 " allocated frames).\n",
+                100.0 * m_validFrames / m_allocatedFrames, (uint64_t)m_validFrames, (uint64_t)m_allocatedFrames);
+        m_validFrames = 0;
+        m_allocatedFrames = 0;
+    }
+}
+
 void SequencePacker::CheckSampleShape(const std::vector<SequenceDataPtr>& minibatch, StreamDescriptionPtr outputStream)
 {
     assert(!minibatch.empty());
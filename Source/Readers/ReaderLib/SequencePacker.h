@@ -17,13 +17,21 @@ public:
     SequencePacker(
         SequenceEnumeratorPtr sequenceEnumerator,
         const std::vector<StreamDescriptionPtr>& streams,
-        size_t numberOfBuffers = 2) :
-        PackerBase(sequenceEnumerator, streams, numberOfBuffers)
+        size_t numberOfBuffers = 2,
+        bool reportPaddingEfficiency = false) :
+        PackerBase(sequenceEnumerator, streams, numberOfBuffers),
+        m_reportPaddingEfficiency(reportPaddingEfficiency),
+        m_validFrames(0),
+        m_allocatedFrames(0)
     {}
 
     virtual Minibatch ReadMinibatch() override;
 
 protected:
+    // Accumulates the number of valid and allocated (including padding) frames of the minibatch layout
+    // and prints the ratio at the end of the epoch.
+    void UpdatePaddingEfficiency(const MBLayoutPtr& layout, bool endOfEpoch);
+
     virtual MBLayoutPtr PackDenseStream(const StreamBatch& batch, size_t streamIndex);
 
     virtual MBLayoutPtr PackSparseStream(const StreamBatch& batch, size_t streamIndex);
@@ -34,6 +42,10 @@ protected:
 
     // Helper function to check the sample shape of input samples.
     void CheckSampleShape(const std::vector<SequenceDataPtr>& minibatch, StreamDescriptionPtr outputStream);
+
+    bool m_reportPaddingEfficiency;
+    size_t m_validFrames;
+    size_t m_allocatedFrames;
 };
 
 typedef std::shared_ptr<SequencePacker> SequencePackerPtr;
@@ -241,6 +241,8 @@ protected:
     size_t m_numMBsToShowResult = 0;
     size_t m_firstMBsToShowResult = 0;
     int m_numMBsToCUDAProfile;
+    bool m_profileNodes;                  // print per-node forward/backward timings after each epoch
+    std::wstring m_nodeProfileTraceFile;  // if not empty, also write the timeline of all node executions as a Chrome trace
 
     bool m_doGradientCheck;
     double m_gradientCheckSigDigit;
@@ -275,6 +277,8 @@ protected:
     intargvector m_numGradientBits;
     bool m_bufferedAsyncGradientAggregation;
     bool m_zeroThresholdFor1Bit;
+    // FP32/FP64 gradients are aggregated in buckets of this size, see SimpleDistGradAggregator
+    size_t m_gradientBucketSizeInBytes;
 
     // Parallel training related with MA / BM
     size_t m_modelAggregationBlockSize;
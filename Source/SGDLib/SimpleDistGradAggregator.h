@@ -22,12 +22,20 @@ class SimpleDistGradAggregator : public IDistGradAggregator<ElemType>
     UsingIDistGradAggregatorMembers;
 
 public:
-    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int deviceId, int syncStatsTrace)
-        : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_initialized(false), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0), m_nccl(deviceId, mpi)
+    // Gradients are aggregated in buckets of up to 'bucketSizeInBytes' (larger gradients get a bucket of their own).
+    // 0 reduces every gradient matrix separately.
+    static const size_t DefaultBucketSizeInBytes = 4 * 1024 * 1024;
+
+    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int deviceId, int syncStatsTrace, size_t bucketSizeInBytes = DefaultBucketSizeInBytes)
+        : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_initialized(false), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0), m_bucketSizeInBytes(bucketSizeInBytes), m_nccl(deviceId, mpi)
     {}
 
     ~SimpleDistGradAggregator()
     {
+        // The pending async aggregation still uses the headers and buckets
+        if (m_pendingAsyncAggregation.valid())
+            m_pendingAsyncAggregation.wait();
+
         for (size_t i = 0; i < m_recvHeaders.size(); ++i)
             DistGradHeader::Destroy(m_recvHeaders[i]);
 
@@ -154,15 +162,15 @@ private:
                     RuntimeError("Gradient aggregation for sparse gradient matrices is currently unsupported!");
 
                 if (!m_nccl.IsSupported() && deviceId != CPUDEVICE)
-                {
                     m_gpuDataTransferers.push_back(std::make_unique<GPUDataTransferer>(deviceId, m_useAsyncAggregation));
-                    m_intermediateCPUBuffers.push_back(AllocateIntermediateBuffer(deviceId, gradients[i]->GetNumElements()));
-                }
 
                 if (m_useAsyncAggregation)
                     m_bufferedGradients[gradients[i]].reset(new Matrix<ElemType>(gradients[i]->GetNumRows(), gradients[i]->GetNumCols(), deviceId));
             }
 
+            if (!m_nccl.IsSupported())
+                CreateBuckets(gradients, deviceId);
+
             if (m_useAsyncAggregation)
             {
                 m_bufferedGradHeader = DistGradHeader::Create(numEvalNodes);
@@ -192,6 +200,34 @@ private:
         }
     }
 
+    // Packs consecutive gradient matrices into buckets of up to m_bucketSizeInBytes.
+    void CreateBuckets(const std::vector<Matrix<ElemType>*>& gradients, int deviceId)
+    {
+        size_t maxBucketElements = m_bucketSizeInBytes / sizeof(ElemType);
+        m_buckets.clear();
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            size_t numElements = gradients[i]->GetNumElements();
+            if (m_buckets.empty() || (m_buckets.back().m_numElements > 0 && m_buckets.back().m_numElements + numElements > maxBucketElements))
+                m_buckets.push_back(GradientBucket());
+
+            auto& bucket = m_buckets.back();
+            bucket.m_gradientIndices.push_back(i);
+            bucket.m_offsets.push_back(bucket.m_numElements);
+            bucket.m_numElements += numElements;
+        }
+
+        // GPU gradients are always staged through a (pinned) CPU buffer; on the CPU a bucket holding
+        // a single gradient is reduced in place, and only buckets of several gradients need to be packed.
+        for (auto& bucket : m_buckets)
+        {
+            if (deviceId != CPUDEVICE)
+                bucket.m_buffer = AllocateIntermediateBuffer(deviceId, bucket.m_numElements);
+            else if (bucket.m_gradientIndices.size() > 1)
+                bucket.m_buffer = std::shared_ptr<ElemType>(new ElemType[bucket.m_numElements], [](ElemType* p) { delete[] p; });
+        }
+    }
+
     void AggregateGradientsImpl(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool showSyncPerfStats)
     {
         Timer aggregationTimer;
@@ -223,11 +259,17 @@ private:
             }
         }
 
-        // Initiate transfer of the gradient matrices to the CPU if needed
+        // Initiate transfer of the gradient matrices to the CPU if needed, directly into their place in the bucket
         if (!m_nccl.IsSupported() && deviceId >= 0)
         {
-            for (size_t i = 0; i < numGradMatrices; ++i)
-                m_gpuDataTransferers[i]->CopyGPUToCPUAsync(gradients[i]->Data(), gradients[i]->GetNumElements(), m_intermediateCPUBuffers[i].get());
+            for (const auto& bucket : m_buckets)
+            {
+                for (size_t k = 0; k < bucket.m_gradientIndices.size(); ++k)
+                {
+                    size_t i = bucket.m_gradientIndices[k];
+                    m_gpuDataTransferers[i]->CopyGPUToCPUAsync(gradients[i]->Data(), gradients[i]->GetNumElements(), bucket.m_buffer.get() + bucket.m_offsets[k]);
+                }
+            }
         }
 
         // Initiate receive of the header on the main node
@@ -247,23 +289,33 @@ private:
         if (!m_mpi->IsMainNode())
             MPI_Isend(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank(), numGradMatrices, m_mpi->Communicator(), &sendHeaderRequest) || MpiFail("MPI_Isend");
 
-        // Perform async allreduce on the gradient data
-        std::vector<MPI_Request> allReduceRequests(numGradMatrices);
+        // Perform async allreduce on the gradient data, one bucket at a time. Each bucket is reduced as soon as
+        // its gradients have been packed, so its reduction overlaps with packing of the following buckets.
+        size_t numBuckets = m_buckets.size();
+        std::vector<MPI_Request> allReduceRequests(numBuckets);
+        std::vector<Timer> bucketTimers(showSyncPerfStats ? numBuckets : 0);
         if (!m_nccl.IsSupported())
         {
-            for (size_t i = 0; i < numGradMatrices; ++i)
+            for (size_t b = 0; b < numBuckets; ++b)
             {
-                ElemType* reductionBuffer = gradients[i]->Data();
-                if (deviceId >= 0)
+                const auto& bucket = m_buckets[b];
+                ElemType* reductionBuffer = bucket.m_buffer ? bucket.m_buffer.get() : gradients[bucket.m_gradientIndices[0]]->Data();
+                for (size_t k = 0; k < bucket.m_gradientIndices.size(); ++k)
                 {
-                    m_gpuDataTransferers[i]->WaitForCopyGPUToCPUAsync();
-                    reductionBuffer = m_intermediateCPUBuffers[i].get();
+                    size_t i = bucket.m_gradientIndices[k];
+                    if (deviceId >= 0)
+                        m_gpuDataTransferers[i]->WaitForCopyGPUToCPUAsync();
+                    else if (bucket.m_buffer)
+                        memcpy(reductionBuffer + bucket.m_offsets[k], gradients[i]->Data(), sizeof(ElemType) * gradients[i]->GetNumElements());
                 }
 
+                if (showSyncPerfStats)
+                    bucketTimers[b].Start();
+
                 // On Windows this async MPI_Iallreduce call requires MS MPI v7 or higher to be installed
-                MPI_Iallreduce(MPI_IN_PLACE, reductionBuffer, gradients[i]->GetNumElements(),
+                MPI_Iallreduce(MPI_IN_PLACE, reductionBuffer, bucket.m_numElements,
                                MPIWrapper::GetDataType(reductionBuffer), MPI_SUM,
-                               m_mpi->Communicator(), &allReduceRequests[i]) || MpiFail("MPI_Iallreduce");
+                               m_mpi->Communicator(), &allReduceRequests[b]) || MpiFail("MPI_Iallreduce");
             }
         }
         else
@@ -307,14 +359,33 @@ private:
             }
         }
 
-        // Wait for the allreduce operations to finish and initiate transfer back to the GPU if needed
+        // Wait for the allreduce operations to finish, in whatever order they complete, and unpack
+        // each bucket (initiating the transfer back to the GPU if needed)
         if (!m_nccl.IsSupported())
         {
-            for (size_t i = 0; i < numGradMatrices; ++i)
+            for (size_t numBucketsReduced = 0; numBucketsReduced < numBuckets; ++numBucketsReduced)
             {
-                MPI_Wait(&allReduceRequests[i], MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
-                if (deviceId >= 0)
-                    m_gpuDataTransferers[i]->CopyCPUToGPUAsync(m_intermediateCPUBuffers[i].get(), gradients[i]->GetNumElements(), gradients[i]->Data());
+                int b = MPI_UNDEFINED;
+                MPI_Waitany(allReduceRequests.size(), allReduceRequests.data(), &b, MPI_STATUS_IGNORE) || MpiFail("MPI_Waitany");
+                if (b == MPI_UNDEFINED)
+                    break;
+
+                if (showSyncPerfStats)
+                    bucketTimers[b].Stop();
+
+                const auto& bucket = m_buckets[b];
+                if (!bucket.m_buffer)
+                    continue;
+
+                for (size_t k = 0; k < bucket.m_gradientIndices.size(); ++k)
+                {
+                    size_t i = bucket.m_gradientIndices[k];
+                    ElemType* reducedGradient = bucket.m_buffer.get() + bucket.m_offsets[k];
+                    if (deviceId >= 0)
+                        m_gpuDataTransferers[i]->CopyCPUToGPUAsync(reducedGradient, gradients[i]->GetNumElements(), gradients[i]->Data());
+                    else
+                        memcpy(gradients[i]->Data(), reducedGradient, sizeof(ElemType) * gradients[i]->GetNumElements());
+                }
             }
         }
 
@@ -342,12 +413,32 @@ private:
             aggregationTimer.Stop();
             double gradientAggregationTime = aggregationTimer.ElapsedSeconds();
             fprintf(stderr, "Actual gradient aggregation time: %.6g\n", gradientAggregationTime);
+
+            for (size_t b = 0; b < bucketTimers.size(); ++b)
+                fprintf(stderr, "    Gradient bucket %d: %d matrices, %d elements, allreduce time: %.6g\n",
+                        (int) b, (int) m_buckets[b].m_gradientIndices.size(), (int) m_buckets[b].m_numElements, bucketTimers[b].ElapsedSeconds());
         }
     }
 
 private:
     std::unique_ptr<CUDAPageLockedMemAllocator> m_allocator;
-    std::vector<std::shared_ptr<ElemType>> m_intermediateCPUBuffers;
+
+    // A contiguous range of gradient matrices that is aggregated with a single allreduce
+    struct GradientBucket
+    {
+        GradientBucket() : m_numElements(0) {}
+
+        std::vector<size_t> m_gradientIndices; // gradient matrices in this bucket
+        std::vector<size_t> m_offsets;         // element offset of each of these matrices in the bucket
+        size_t m_numElements;
+
+        // Buffer the gradients are packed into (pinned memory for GPU gradients).
+        // Null if the bucket holds a single CPU gradient, which is then reduced in place.
+        std::shared_ptr<ElemType> m_buffer;
+    };
+
+    size_t m_bucketSizeInBytes;
+    std::vector<GradientBucket> m_buckets;
 
     std::vector<std::unique_ptr<GPUDataTransferer>> m_gpuDataTransferers;
 
@@ -0,0 +1,138 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// EvalPerformanceTests.cpp : Measures the inference throughput of evaluators that share one model
+// (see GetSharedEvalExtended()), for an increasing number of threads, and checks that they compute the same
+// as the evaluator they were created from.
+//
+// Usage: evalperftests [maxThreads] [numRequests]
+//     maxThreads=<number of cores>   the number of threads is doubled from 1 up to this
+//     numRequests=256                ForwardPass() calls per run, distributed over the threads
+//
+#include "stdafx.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::MSR::CNTK;
+
+// Runs numRequests ForwardPass() calls on shared evaluators, on 1, 2, 4 ... maxThreads threads.
+// sequenceLengths gives the number of samples fed to each input.
+// Returns false if a shared evaluator's outputs differ from those of the original evaluator.
+static bool MeasureSharedEvaluators(const char* description, const std::string& modelDefinition, const std::vector<size_t>& sequenceLengths,
+                                    size_t maxThreads, size_t numRequests)
+{
+    IEvaluateModelExtended<float>* eval;
+    GetEvalExtendedF(&eval);
+    eval->CreateNetwork(modelDefinition);
+    VariableSchema outputLayouts = eval->GetOutputSchema();
+    std::vector<std::wstring> outputNames;
+    for (const auto& layout : outputLayouts)
+        outputNames.push_back(layout.m_name);
+    eval->StartForwardEvaluation(outputNames);
+    outputLayouts = eval->GetOutputSchema();
+    VariableSchema inputLayouts = eval->GetInputSchema();
+
+    size_t numSamples = 0;
+    Values<float> inputBuffer(inputLayouts.size());
+    for (size_t i = 0; i < inputLayouts.size(); i++)
+    {
+        for (size_t k = 0; k < inputLayouts[i].m_numElements * sequenceLengths[i]; k++)
+            inputBuffer[i].m_buffer.push_back((float)((k + i) % 11) / 11);
+        numSamples += sequenceLengths[i];
+    }
+    // no output is longer than the longest input
+    std::vector<size_t> maxLengths(outputLayouts.size(), *std::max_element(sequenceLengths.begin(), sequenceLengths.end()));
+
+    Values<float> expected = outputLayouts.CreateBuffers<float>(maxLengths);
+    eval->ForwardPass(inputBuffer, expected);
+
+    std::vector<IEvaluateModelExtended<float>*> sharedEvals(maxThreads);
+    for (auto& sharedEval : sharedEvals)
+        GetSharedEvalExtendedF(eval, &sharedEval);
+
+    bool matches = true;
+    for (size_t numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+    {
+        std::vector<Values<float>> outputs;
+        for (size_t t = 0; t < numThreads; t++)
+            outputs.push_back(outputLayouts.CreateBuffers<float>(maxLengths));
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < numThreads; t++)
+        {
+            threads.push_back(std::thread([&, t]()
+            {
+                for (size_t request = t; request < numRequests; request += numThreads)
+                    sharedEvals[t]->ForwardPass(inputBuffer, outputs[t]);
+            }));
+        }
+        for (auto& thread : threads)
+            thread.join();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (size_t t = 0; t < numThreads; t++)
+            for (size_t o = 0; o < outputLayouts.size(); o++)
+                matches &= outputs[t][o].m_buffer == expected[o].m_buffer;
+
+        fprintf(stderr, "Shared evaluators, %s, %d thread(s): %.0f samples/s\n", description, (int)numThreads, numRequests * numSamples / seconds);
+    }
+
+    if (!matches)
+        fprintf(stderr, "ERROR: Shared evaluators, %s: outputs differ from those of the original evaluator\n", description);
+
+    for (auto sharedEval : sharedEvals)
+        sharedEval->Destroy();
+    eval->Destroy();
+    return matches;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t maxThreads = argc > 1 ? (size_t)atoi(argv[1]) : std::max(std::thread::hardware_concurrency(), 1u);
+    size_t numRequests = argc > 2 ? (size_t)atoi(argv[2]) : 256;
+
+    // a feed-forward network of a size typical for serving
+    std::string feedForwardModel =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 0 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(256) \n"
+        "W1 = Parameter(512, 256, init = \"uniform\", initValueScale = 1) \n"
+        "h1 = Sigmoid(Times(W1, i1)) \n"
+        "W2 = Parameter(512, 512, init = \"uniform\", initValueScale = 1) \n"
+        "h2 = Sigmoid(Times(W2, h1)) \n"
+        "W3 = Parameter(64, 512, init = \"uniform\", initValueScale = 1) \n"
+        "o1 = Times(W3, h2, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    // the same layers applied to a query and a document, each with its own dynamic axis;
+    // a shared evaluator must keep the inputs on their own axes, or the sequence lengths would clash
+    std::string twoAxesModel =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 0 \n"
+        "BrainScriptNetworkBuilder={ \n"
+        "queryAxis = DynamicAxis() \n"
+        "documentAxis = DynamicAxis() \n"
+        "query = Input(256, dynamicAxis=queryAxis) \n"
+        "document = Input(256, dynamicAxis=documentAxis) \n"
+        "W1 = Parameter(512, 256, init='uniform', initValueScale=1) \n"
+        "W2 = Parameter(64, 512, init='uniform', initValueScale=1) \n"
+        "queryOut = Times(W2, Sigmoid(Times(W1, query))) \n"
+        "documentOut = Times(W2, Sigmoid(Times(W1, document))) \n"
+        "featureNodes = (query:document) \n"
+        "outputNodes = (queryOut:documentOut) \n"
+        "} \n";
+
+    bool matches = MeasureSharedEvaluators("feed-forward", feedForwardModel, { 16 }, maxThreads, numRequests);
+    matches &= MeasureSharedEvaluators("two dynamic axes", twoAxesModel, { 8, 16 }, maxThreads, numRequests);
+    return matches ? 0 : 1;
+}
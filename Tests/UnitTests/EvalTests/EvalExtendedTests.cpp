@@ -7,6 +7,7 @@
 #include "EvalTestHelper.h"
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <thread>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -420,5 +421,68 @@ BOOST_AUTO_TEST_CASE(EvalRNNTest)
     eval->Destroy();
 }
 
+BOOST_AUTO_TEST_CASE(EvalSharedEvaluatorsTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(16) \n"
+        "W1 = Parameter(32, 16, init = \"uniform\", initValueScale = 1) \n"
+        "b1 = Parameter(32, 1, init = \"uniform\", initValueScale = 1) \n"
+        "h1 = Sigmoid(Plus(Times(W1, i1), b1)) \n"
+        "W2 = Parameter(8, 32, init = \"uniform\", initValueScale = 1) \n"
+        "o1 = Times(W2, h1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    const size_t numSamples = 5;
+    Values<float> inputBuffer(1);
+    for (size_t i = 0; i < 16 * numSamples; i++)
+        inputBuffer[0].m_buffer.push_back((float)(i % 7) - 3);
+
+    // Reference result from the original evaluator
+    Values<float> expected = outputLayouts.CreateBuffers<float>({ numSamples });
+    eval->ForwardPass(inputBuffer, expected);
+
+    // Evaluators sharing the parameters compute the same, also concurrently and after the original is gone
+    const size_t numThreads = 4;
+    std::vector<IEvaluateModelExtended<float>*> sharedEvals(numThreads);
+    for (auto& sharedEval : sharedEvals)
+        GetSharedEvalExtendedF(eval, &sharedEval);
+    BOOST_CHECK_EQUAL(sharedEvals[0]->GetInputSchema()[0].m_numElements, 16);
+    eval->Destroy();
+
+    std::vector<Values<float>> outputs;
+    for (size_t t = 0; t < numThreads; t++)
+        outputs.push_back(outputLayouts.CreateBuffers<float>({ numSamples }));
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < numThreads; t++)
+    {
+        threads.push_back(std::thread([&, t]()
+        {
+            for (size_t iteration = 0; iteration < 20; iteration++)
+                sharedEvals[t]->ForwardPass(inputBuffer, outputs[t]);
+        }));
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    for (size_t t = 0; t < numThreads; t++)
+    {
+        auto& buf = outputs[t][0].m_buffer;
+        BOOST_CHECK_EQUAL_COLLECTIONS(buf.begin(), buf.end(), expected[0].m_buffer.begin(), expected[0].m_buffer.end());
+        sharedEvals[t]->Destroy();
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }}}}
\ No newline at end of file
@@ -9,12 +9,17 @@
 //#include "Windows.h"
 #include "Matrix.h"
 #include "CPUMatrix.h"
+#include "CPUSparseMatrix.h"
 #include "TensorView.h"
+#include "ConvolutionEngine.h"
 #include "Sequences.h"
+#include "TensorOpsSIMD.h"
 #include <chrono>
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <omp.h>
+#include <random>
 
 using namespace Microsoft::MSR::CNTK;
 using namespace std;
@@ -279,6 +284,203 @@ struct TensorTest
     }
 };
 
+// Measure where going parallel starts to pay off for CPU tensor ops: for increasing sizes, time the same
+// elementwise op forced serial and forced parallel. The crossover is a good value for
+// CPUMatrix::SetTensorOpMinWorkPerThread() (times the number of threads).
+template <class ElemType>
+void TensorOpParallelismTest(int count)
+{
+    cout << "Testing CPU tensor op parallelization threshold with " << omp_get_max_threads() << " threads" << endl;
+    for (size_t rowLength : { 16, 1024 })
+    {
+        for (size_t numElements = 1024; numElements <= 4 * 1024 * 1024; numElements *= 4)
+        {
+            let shape = TensorShape(rowLength, numElements / rowLength);
+            auto a = TensorView<ElemType>(make_shared<Matrix<ElemType>>(numElements, 1, CPUDEVICE), shape);
+            auto b = TensorView<ElemType>(make_shared<Matrix<ElemType>>(numElements, 1, CPUDEVICE), shape);
+            auto c = TensorView<ElemType>(make_shared<Matrix<ElemType>>(numElements, 1, CPUDEVICE), shape);
+            a.GetSOB().SetUniformRandomValue(-1, 1, 1);
+            b.GetSOB().SetUniformRandomValue(-1, 1, 2);
+
+            double seconds[2];
+            for (size_t parallel = 0; parallel < 2; parallel++)
+            {
+                CPUMatrix<ElemType>::SetTensorOpMinWorkPerThread(parallel ? 1 : SIZE_MAX);
+                auto t_start = chrono::steady_clock::now();
+                for (int i = 0; i < count; ++i)
+                    c.AssignSumOf(a, b);
+                seconds[parallel] = chrono::duration<double>(chrono::steady_clock::now() - t_start).count() / count;
+            }
+            cout << "[" << string(shape) << "]: serial " << seconds[0] * 1e6 << " us, parallel " << seconds[1] * 1e6 << " us" << endl;
+        }
+    }
+    CPUMatrix<ElemType>::SetTensorOpMinWorkPerThread(0);
+}
+
+// Compare CPU convolution engines on the 3x3 and 1x1 layer shapes of ResNet (and its 7x7 stride-2 first layer).
+// "auto" is whatever ConvolutionEngine::Create() selects when all engines are enabled.
+template <class ElemType>
+void ConvolutionEngineTest(size_t batchSize, int count)
+{
+    struct Layer
+    {
+        size_t w, c, k, mapCount, stride;
+    };
+    vector<Layer> layers = {
+        { 224,   3, 7,  64, 2 },
+        {  56,  64, 3,  64, 1 },
+        {  56,  64, 1, 256, 1 },
+        {  28, 128, 3, 128, 1 },
+        {  14, 256, 3, 256, 1 },
+        {   7, 512, 3, 512, 1 },
+    };
+    vector<pair<string, ConvolutionEngineKind>> engines = {
+        { "reference", ConvolutionEngineKind::Reference },
+        { "gemm", ConvolutionEngineKind::Gemm },
+        { "direct", ConvolutionEngineKind::Direct },
+        { "auto", ConvolutionEngineKind::All },
+    };
+    cout << "Testing CPU convolution engines with " << omp_get_max_threads() << " threads, batch size " << batchSize << endl;
+    for (const auto& l : layers)
+    {
+        auto g = make_shared<ConvolveGeometry>(TensorShape(l.w, l.w, l.c), TensorShape(l.k, l.k, l.c), TensorShape(l.mapCount),
+                                               TensorShape(l.stride, l.stride, l.c), ConvolveGeometry::BoolVec{true},
+                                               ConvolveGeometry::BoolVec{true, true, false}, TensorShape(0), TensorShape(0));
+        Matrix<ElemType> in(g->InputShape().GetNumElements(), batchSize, CPUDEVICE);
+        Matrix<ElemType> kernel(l.mapCount, g->KernelShape().GetNumElements(), CPUDEVICE);
+        Matrix<ElemType> out(g->OutputShape().GetNumElements(), batchSize, CPUDEVICE);
+        in.SetUniformRandomValue(-1, 1, 1);
+        kernel.SetUniformRandomValue(-1, 1, 2);
+        double flops = 2.0 * g->OutputShape().GetNumElements() * g->KernelShape().GetNumElements() * batchSize;
+
+        cout << (string)*g << endl;
+        for (const auto& engine : engines)
+        {
+            // The reference engine is too slow to run more than once.
+            int iterations = engine.second == ConvolutionEngineKind::Reference ? 1 : count;
+            auto eng = ConvolutionEngine<ElemType>::Create(g, CPUDEVICE, ImageLayoutKind::CHW, 0, PoolKind::None, engine.second);
+            Matrix<ElemType> workspace(CPUDEVICE);
+            eng->Forward(in, kernel, out, workspace); // warm-up, allocates the workspace
+            auto t_start = chrono::steady_clock::now();
+            for (int i = 0; i < iterations; ++i)
+                eng->Forward(in, kernel, out, workspace);
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - t_start).count() / iterations;
+            cout << "    " << engine.first << ": " << seconds * 1e3 << " ms, " << flops / seconds * 1e-9 << " GFlop/s, workspace "
+                 << workspace.GetNumElements() * sizeof(ElemType) / 1024 << " KB" << endl;
+        }
+    }
+}
+
+// Compare the quantized products of QuantizedTimesNode against the float product of TimesNode on CPU inference shapes:
+// weights W [outputDim x inputDim] times a minibatch of inputs. Errors are relative to the float product (Frobenius norm).
+void QuantizedTimesTest(int count)
+{
+    struct Shape
+    {
+        int outputDim, inputDim, batchSize;
+    };
+    vector<Shape> shapes = {
+        { 1024, 1024,   1 },
+        { 1024, 1024,  16 },
+        { 1024, 1024, 128 },
+        { 4096, 1024,  32 },
+        {  512, 2048,  32 },
+    };
+    cout << "Testing quantized products with " << omp_get_max_threads() << " threads" << endl;
+    for (const auto& s : shapes)
+    {
+        Matrix<float> W(s.outputDim, s.inputDim, CPUDEVICE);
+        Matrix<float> X(s.inputDim, s.batchSize, CPUDEVICE);
+        W.SetUniformRandomValue(-1, 1, 1);
+        X.SetUniformRandomValue(-1, 1, 2);
+        double flops = 2.0 * s.outputDim * s.inputDim * s.batchSize;
+
+        Matrix<float> reference(s.outputDim, s.batchSize, CPUDEVICE);
+        Matrix<float>::MultiplyAndWeightedAdd(1, W, false, X, false, 0, reference);
+        double referenceNorm = reference.FrobeniusNorm();
+
+        // The 16-bit sums overflow for inner dimensions in the thousands unless the quantization range is shifted down by 3 bits.
+        auto int16 = [] { return make_shared<QuantizedMultiplier<float>>(make_shared<SymmetricQuantizer<float, short>>(3), true,
+                                                                         make_shared<SymmetricQuantizer<float, short>>(3), false); };
+        auto int8 = [] { return shared_ptr<QuantizedMultiplier<float>>(make_shared<Int8QuantizedMultiplier<float>>(true, false)); };
+        vector<tuple<string, shared_ptr<QuantizedMultiplier<float>>, CPUInstructionSet>> multipliers = {
+            make_tuple("float", nullptr, GetSupportedCPUInstructionSet()),
+            make_tuple("int16", int16(), GetSupportedCPUInstructionSet()),
+            make_tuple("int8 scalar", int8(), CPUInstructionSet::None),
+            make_tuple("int8", int8(), GetSupportedCPUInstructionSet()),
+        };
+
+        cout << "W [" << s.outputDim << " x " << s.inputDim << "] * X [" << s.inputDim << " x " << s.batchSize << "]" << endl;
+        double floatSeconds = 0;
+        for (const auto& multiplier : multipliers)
+        {
+            SetCPUInstructionSet(get<2>(multiplier));
+            Matrix<float> C(s.outputDim, s.batchSize, CPUDEVICE);
+            Matrix<float>::MultiplyAndWeightedAdd(1, W, false, X, false, 0, C, get<1>(multiplier)); // warm-up, quantizes and packs W
+            auto t_start = chrono::steady_clock::now();
+            for (int i = 0; i < count; ++i)
+                Matrix<float>::MultiplyAndWeightedAdd(1, W, false, X, false, 0, C, get<1>(multiplier));
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - t_start).count() / count;
+            if (!get<1>(multiplier))
+                floatSeconds = seconds;
+
+            C -= reference;
+            cout << "    " << get<0>(multiplier) << ": " << seconds * 1e6 << " us, " << flops / seconds * 1e-9 << " GOp/s, "
+                 << floatSeconds / seconds << "x float, relative error " << C.FrobeniusNorm() / referenceNorm << endl;
+        }
+        SetCPUInstructionSet(GetSupportedCPUInstructionSet());
+    }
+}
+
+// Time the weight gradient of an embedding or of an output layer over a large vocabulary on CPU: dY [hiddenDim x batchSize]
+// times the transpose of the sparse one-hot input X [vocabSize x batchSize], into a block-column sparse matrix (CPUSparseMatrix::MultiplyAndAdd()).
+// Words are drawn from a log-uniform (roughly Zipfian) distribution, so frequent words repeat within a minibatch.
+void SparseGradientTest(int count)
+{
+    const size_t hiddenDim = 512;
+    const size_t batchSize = 4096;
+    const int maxThreads = omp_get_max_threads();
+    cout << "Testing dense * sparse' -> block-column sparse, hidden dim " << hiddenDim << ", " << batchSize << " words per minibatch" << endl;
+    for (size_t vocabSize : { 10000, 100000, 1000000, 10000000 })
+    {
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<double> uniform(0, 1);
+        vector<CPUSPARSE_INDEX_TYPE> colStarts(batchSize + 1), rowIndices(batchSize);
+        vector<float> values(batchSize, 1);
+        for (size_t j = 0; j < batchSize; j++)
+        {
+            colStarts[j + 1] = (CPUSPARSE_INDEX_TYPE) (j + 1);
+            rowIndices[j] = (CPUSPARSE_INDEX_TYPE) min((size_t) exp(uniform(rng) * log((double) vocabSize)), vocabSize - 1);
+        }
+        CPUSparseMatrix<float> X(matrixFormatSparseCSC);
+        X.SetMatrixFromCSCFormat(colStarts.data(), rowIndices.data(), values.data(), batchSize, vocabSize, batchSize);
+
+        for (bool transposeA : { false, true })
+        {
+            CPUMatrix<float> dY = transposeA ? CPUMatrix<float>(batchSize, hiddenDim) : CPUMatrix<float>(hiddenDim, batchSize);
+            dY.SetUniformRandomValue(-1, 1, 1);
+            CPUSparseMatrix<float> dW(matrixFormatSparseBlockCol);
+            CPUSparseMatrix<float>::MultiplyAndAdd(1, dY, transposeA, X, true, dW); // warm-up, allocates dW
+
+            cout << "    vocabulary " << vocabSize << (transposeA ? ", dY transposed" : "") << ": " << dW.NzCount() / hiddenDim << " distinct words";
+            double serialSeconds = 0;
+            for (int numThreads : { 1, maxThreads })
+            {
+                omp_set_num_threads(numThreads);
+                auto t_start = chrono::steady_clock::now();
+                for (int i = 0; i < count; ++i)
+                    CPUSparseMatrix<float>::MultiplyAndAdd(1, dY, transposeA, X, true, dW);
+                double seconds = chrono::duration<double>(chrono::steady_clock::now() - t_start).count() / count;
+                if (numThreads == 1)
+                    serialSeconds = seconds;
+                cout << ", " << numThreads << " threads " << seconds * 1e6 << " us (" << serialSeconds / seconds << "x)";
+            }
+            omp_set_num_threads(maxThreads);
+            cout << endl;
+        }
+    }
+}
+
 template <class ElemType>
 void MandSTest(int count, int devId)
 {
@@ -340,6 +542,18 @@ int wmain()
 {
     // MandSTest<float>(100, 2);
 
+    cout << endl << "********************CPU TensorOp parallelization TEST********************" << endl;
+    TensorOpParallelismTest<float>(100);
+
+    cout << endl << "********************CPU convolution engines TEST********************" << endl;
+    ConvolutionEngineTest<float>(8, 5);
+
+    cout << endl << "********************Quantized Times TEST********************" << endl;
+    QuantizedTimesTest(20);
+
+    cout << endl << "********************CPU sparse gradient TEST********************" << endl;
+    SparseGradientTest(20);
+
     /*cout<<endl<<"********************Matrix SquareMultiplyAndWeightedAdd10TimesAvg TEST********************"<<endl;
     SquareMultiplyAndAdd10TimesAvgTest<float>(4096,10);
 
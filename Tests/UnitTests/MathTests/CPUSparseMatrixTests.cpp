@@ -7,6 +7,9 @@
 #include <crtdefs.h>
 #endif
 #include "../../../Source/Math/CPUSparseMatrix.h"
+#include <algorithm>
+#include <random>
+#include <set>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -61,6 +64,194 @@ BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixCopyColumnSliceToDense, RandomSeedFixture
     BOOST_CHECK(dm1.IsEqualTo(dm2, c_epsilonFloatE4));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixMultiplyAndAddBlockCol, RandomSeedFixture)
+{
+    // dense * sparse -> block-column sparse (the weight gradient of a layer with sparse input), for all transpositions
+    const size_t hiddenDim = 7;
+    const size_t vocabDim = 50;
+    const size_t firstCol = 3; // the sparse input is a column slice, as minibatches are
+    const size_t numCols = 12;
+    const double alpha = 0.7;
+
+    // a few nonzeros per column, from a small set of rows so that they repeat across columns; one column is empty
+    std::mt19937 rng(IncrementCounter());
+    vector<CPUSPARSE_INDEX_TYPE> colStarts(1, 0), rowIndices;
+    vector<double> values;
+    for (size_t j = 0; j < firstCol + numCols; j++)
+    {
+        std::set<CPUSPARSE_INDEX_TYPE> rows;
+        size_t numNonzeros = j == firstCol + 4 ? 0 : 1 + rng() % 3;
+        while (rows.size() < numNonzeros)
+            rows.insert((CPUSPARSE_INDEX_TYPE) (3 * (rng() % 10) + 1));
+        for (auto row : rows)
+        {
+            rowIndices.push_back(row);
+            values.push_back((double) (rng() % 1000) / 500 - 1);
+        }
+        colStarts.push_back((CPUSPARSE_INDEX_TYPE) rowIndices.size());
+    }
+    SparseMatrix full(MatrixFormat::matrixFormatSparseCSC);
+    full.SetMatrixFromCSCFormat(colStarts.data(), rowIndices.data(), values.data(), values.size(), vocabDim, firstCol + numCols);
+    SparseMatrix sparse = full.ColumnSlice(firstCol, numCols);
+    DenseMatrix sparseAsDense = sparse.CopyColumnSliceToDense(0, numCols);
+
+    for (bool transposeA : { false, true })
+    {
+        for (bool transposeB : { false, true })
+        {
+            // op(dense) is [hiddenDim x inner], op(sparse) is [inner x outer]
+            size_t inner = transposeB ? numCols : vocabDim;
+            size_t outer = transposeB ? vocabDim : numCols;
+            DenseMatrix dense = transposeA ? DenseMatrix(inner, hiddenDim) : DenseMatrix(hiddenDim, inner);
+            dense.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+            DenseMatrix expected(hiddenDim, outer);
+            DenseMatrix::MultiplyAndWeightedAdd(alpha, dense, transposeA, sparseAsDense, transposeB, 0, expected);
+
+            SparseMatrix product(MatrixFormat::matrixFormatSparseBlockCol);
+            SparseMatrix::MultiplyAndAdd(alpha, dense, transposeA, sparse, transposeB, product);
+            DenseMatrix actual(hiddenDim, outer);
+            actual.SetValue(0);
+            SparseMatrix::ScaleAndAdd(1, product, actual);
+            BOOST_CHECK(actual.IsEqualTo(expected, c_epsilonFloatE4));
+
+            // one block per column that can be nonzero, in increasing order
+            std::set<size_t> nonzeroColumns;
+            for (size_t j = 0; j < numCols; j++)
+            {
+                for (auto p = colStarts[firstCol + j]; p < colStarts[firstCol + j + 1]; p++)
+                    nonzeroColumns.insert(transposeB ? rowIndices[p] : j);
+            }
+            size_t numBlocks = product.NzCount() / hiddenDim;
+            BOOST_REQUIRE_EQUAL(numBlocks, nonzeroColumns.size());
+            BOOST_CHECK(std::equal(nonzeroColumns.begin(), nonzeroColumns.end(), product.BlockIdsLocation()));
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixLazyUpdates, RandomSeedFixture)
+{
+    // Lazy updates with block-column gradients only touch the columns present in each step, applying the steps a column
+    // missed when it reappears. Once the last step has touched all columns, they must match the dense updates.
+    const size_t hiddenDim = 5;
+    const size_t vocabDim = 20;
+    const size_t numSteps = 6;
+    const double learnRate = 0.1;
+    const double momentum = 0.9;
+
+    std::mt19937 rng(IncrementCounter());
+    vector<SparseMatrix> gradients;
+    for (size_t step = 0; step < numSteps; step++)
+    {
+        // the gradient of an embedding: dense [hiddenDim x batch] times the transposed one-hot input [vocabDim x batch]
+        vector<CPUSPARSE_INDEX_TYPE> colStarts(1, 0), rowIndices;
+        vector<double> values;
+        for (size_t word = 0; word < vocabDim; word++)
+        {
+            if (step + 1 == numSteps || word == step || rng() % 3 == 0)
+            {
+                rowIndices.push_back((CPUSPARSE_INDEX_TYPE) word);
+                values.push_back(1);
+                colStarts.push_back((CPUSPARSE_INDEX_TYPE) rowIndices.size());
+            }
+        }
+        size_t batchSize = rowIndices.size();
+        SparseMatrix input(MatrixFormat::matrixFormatSparseCSC);
+        input.SetMatrixFromCSCFormat(colStarts.data(), rowIndices.data(), values.data(), values.size(), vocabDim, batchSize);
+        DenseMatrix outputGradient(hiddenDim, batchSize);
+        outputGradient.SetUniformRandomValue(-1, 1, IncrementCounter());
+        SparseMatrix gradient(MatrixFormat::matrixFormatSparseBlockCol);
+        SparseMatrix::MultiplyAndAdd(1, outputGradient, false, input, true, gradient);
+        gradients.push_back(gradient);
+    }
+    auto toDense = [=](const SparseMatrix& gradient)
+    {
+        DenseMatrix dense(hiddenDim, vocabDim);
+        dense.SetValue(0);
+        SparseMatrix::ScaleAndAdd(1, gradient, dense);
+        return dense;
+    };
+
+    DenseMatrix initialValues(hiddenDim, vocabDim);
+    initialValues.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+    // momentum SGD and NAG, against the dense update of Matrix::NormalGrad()
+    for (bool useNesterovMomentum : { false, true })
+    {
+        DenseMatrix values(initialValues), expectedValues(initialValues);
+        DenseMatrix smoothed(hiddenDim, vocabDim), expectedSmoothed(hiddenDim, vocabDim);
+        smoothed.SetValue(0);
+        expectedSmoothed.SetValue(0);
+        vector<size_t> lastUpdates(vocabDim, 0);
+        for (size_t step = 0; step < numSteps; step++)
+        {
+            gradients[step].LazyNormalGrad(smoothed, values, learnRate, momentum, useNesterovMomentum, lastUpdates, step);
+
+            DenseMatrix dense = toDense(gradients[step]);
+            for (size_t i = 0; i < dense.GetNumElements(); i++)
+            {
+                double g = (1 - momentum) * learnRate * dense.Data()[i];
+                double v = momentum * expectedSmoothed.Data()[i] + g;
+                expectedSmoothed.Data()[i] = v;
+                expectedValues.Data()[i] -= useNesterovMomentum ? momentum * v + g : v;
+            }
+        }
+        BOOST_CHECK(std::all_of(lastUpdates.begin(), lastUpdates.end(), [=](size_t t) { return t == numSteps; }));
+        BOOST_CHECK(smoothed.IsEqualTo(expectedSmoothed, c_epsilonFloatE4));
+        BOOST_CHECK(values.IsEqualTo(expectedValues, c_epsilonFloatE4));
+    }
+
+    // FSAdaGrad
+    {
+        DenseMatrix values(initialValues), expectedValues(initialValues);
+        DenseMatrix smoothed(hiddenDim, 2 * vocabDim), expectedSmoothed(hiddenDim, 2 * vocabDim);
+        smoothed.SetValue(0);
+        expectedSmoothed.SetValue(0);
+        vector<size_t> lastUpdates(vocabDim, 0);
+        for (size_t step = 0; step < numSteps; step++)
+        {
+            gradients[step].LazyFSAdagrad(smoothed, values, learnRate, momentum, 0.95, 0.5, lastUpdates, step);
+            DenseMatrix dense = toDense(gradients[step]);
+            expectedSmoothed.FSAdagrad(dense, expectedValues, learnRate, momentum, 0.95, 0.5);
+        }
+        BOOST_CHECK(smoothed.IsEqualTo(expectedSmoothed, c_epsilonFloatE4));
+        BOOST_CHECK(values.IsEqualTo(expectedValues, c_epsilonFloatE4));
+    }
+
+    // RmsProp, which scales the gradients in place. A column without gradient does not move, so the values match the
+    // dense update at every step, as does the state of the columns present in the step.
+    {
+        DenseMatrix values(initialValues), expectedValues(initialValues);
+        DenseMatrix smoothed(hiddenDim, 3 * vocabDim), expectedSmoothed(hiddenDim, 3 * vocabDim);
+        smoothed.SetValue(0);
+        expectedSmoothed.SetValue(0);
+        vector<size_t> lastUpdates(vocabDim, 0);
+        for (size_t step = 0; step < numSteps; step++)
+        {
+            DenseMatrix dense = toDense(gradients[step]);
+            SparseMatrix gradient = gradients[step];
+            gradient.LazyRmsProp(smoothed, 0.9, 1.2, 10, 0.75, 0.1, lastUpdates, step);
+            SparseMatrix::ScaleAndAdd(-learnRate, gradient, values);
+
+            BOOST_CHECK_EQUAL(expectedSmoothed.RmsProp(dense, 0.9, 1.2, 10, 0.75, 0.1, false), 1);
+            for (size_t i = 0; i < dense.GetNumElements(); i++)
+                expectedValues.Data()[i] -= learnRate * dense.Data()[i];
+            BOOST_CHECK(values.IsEqualTo(expectedValues, c_epsilonFloatE4));
+
+            for (size_t j = 0; j < gradient.NzCount() / hiddenDim; j++)
+            {
+                size_t col = gradient.BlockIdsLocation()[j];
+                for (size_t k = 0; k < 3; k++)
+                {
+                    for (size_t i = 0; i < hiddenDim; i++)
+                        BOOST_CHECK_CLOSE(smoothed(i, k * vocabDim + col), expectedSmoothed(i, k * vocabDim + col), 1e-3);
+                }
+            }
+        }
+        BOOST_CHECK(smoothed.IsEqualTo(expectedSmoothed, c_epsilonFloatE4));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -583,6 +583,97 @@ BOOST_AUTO_TEST_CASE(MaxUnpooling)
     }
 }
 
+// Direct engine runs on CPU only so compare it against CPU reference engine. In addition to the usual 2D
+// configurations, use ResNet-like ones with enough channels to take the Winograd F(2x2,3x3) and F(4x4,3x3) paths.
+BOOST_AUTO_TEST_CASE(DirectConvolutionForward)
+{
+    std::mt19937 rng(0);
+    boost::random::uniform_int_distribution<> batchSizeG(1, 4);
+    boost::random::normal_distribution<float> nd;
+
+    auto initMat = [&](SingleMatrix& buf, size_t r, size_t c, vec& data) -> SingleMatrix
+    {
+        data.resize(r * 3 * c);
+        std::fill(begin(data), end(data), std::numeric_limits<float>::quiet_NaN());
+        std::generate(begin(data) + r * c, begin(data) + 2 * r * c, [&] { return nd(rng); });
+        buf.SetValue(r, 3 * c, buf.GetDeviceId(), data.data());
+        // Get center slice.
+        return buf.ColumnSlice(c, c);
+    };
+
+    auto configs = GenerateConvTestConfigs();
+    auto conv2D = [&](size_t w, size_t h, size_t c, size_t k, size_t mapCount, size_t stride, bool pad)
+    {
+        configs.push_back(std::make_shared<ConvolveGeometry>(TensorShape(w, h, c),
+            TensorShape(k, k, c), TensorShape(mapCount), TensorShape(stride, stride, c),
+            ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{pad, pad, false},
+            TensorShape(0), TensorShape(0)));
+    };
+    // Winograd needs at least 8 input channels and 8 maps (WinogradMinChannels).
+    // Winograd F(4x4,3x3), including partial tiles at the borders.
+    conv2D(14, 14, 16, 3, 16, 1, true);
+    conv2D(13, 10, 8, 3, 8, 1, true);
+    conv2D(14, 12, 8, 3, 8, 1, false);
+    conv2D(19, 17, 16, 3, 12, 1, false);
+    // Winograd F(2x2,3x3).
+    conv2D(7, 7, 32, 3, 8, 1, true);
+    conv2D(9, 6, 8, 3, 8, 1, false);
+    conv2D(5, 9, 8, 3, 16, 1, false);
+    // Direct: 3x3 with too few maps for Winograd, strided 3x3, 1x1 projection, 7x7 stride 2 first layer.
+    conv2D(13, 10, 8, 3, 6, 1, true);
+    conv2D(9, 6, 8, 3, 5, 1, false);
+    conv2D(16, 16, 8, 3, 12, 2, true);
+    conv2D(8, 8, 16, 1, 32, 1, false);
+    conv2D(15, 13, 3, 7, 8, 2, true);
+
+    int deviceId = -1;
+    for (const auto& g : configs)
+    {
+        if (g->InputShape().GetRank() != 3)
+            continue;
+        auto baseEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Reference);
+        auto testEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Direct);
+
+        size_t n = batchSizeG(rng);
+        vec buf;
+        buf.resize(g->InputShape().GetNumElements() * n);
+        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+        SingleMatrix in(g->InputShape().GetNumElements(), n, buf.data(), deviceId, matrixFlagNormal);
+
+        size_t mapCount = g->GetMapCount(g->InputShape().GetRank() - 1);
+        buf.resize(g->KernelShape().GetNumElements() * mapCount);
+        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+        SingleMatrix kernel(mapCount, g->KernelShape().GetNumElements(), buf.data(), deviceId, matrixFlagNormal);
+
+        size_t crowOut = g->OutputShape().GetNumElements();
+        SingleMatrix outBuf(deviceId);
+        SingleMatrix out = initMat(outBuf, crowOut, n, buf);
+        SingleMatrix outB(out.DeepClone(), deviceId);
+
+        SingleMatrix workspace(deviceId);
+        SingleMatrix workspaceB(deviceId);
+
+        testEng->Forward(in, kernel, out, workspace);
+        baseEng->Forward(in, kernel, outB, workspaceB);
+
+        std::stringstream tmsg;
+        tmsg << "Geometry: " << (std::string)(*g) << ", Batch: " << n;
+        std::string msg = " are not equal, " + tmsg.str();
+        std::string msgNan = " has NaNs, " + tmsg.str();
+        std::string msgNotNan = " has buffer overflow/underflow, " + tmsg.str();
+
+        // Winograd transforms change the order and number of floating point operations so
+        // the error grows with the number of accumulated products.
+        float relErr = Err<float>::Rel * 100;
+        float absErr = Err<float>::Abs * g->KernelShape().GetNumElements() * 100;
+        std::string emsg;
+
+        BOOST_REQUIRE_MESSAGE(!out.HasNan("out"), "out" << msgNan);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, relErr, absErr), "out" << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CountNans(outBuf) == crowOut * 2 * n, "out" << msgNotNan);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
@@ -5,6 +5,8 @@
 #include "stdafx.h"
 #include "../../../Source/Math/QuantizedOperations.h"
 #include "../../../Source/Math/Helpers.h"
+#include "../../../Source/Math/TensorOpsSIMD.h"
+#include <random>
 
 using namespace Microsoft::MSR::CNTK;
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
@@ -51,6 +53,107 @@ BOOST_FIXTURE_TEST_CASE(MultiplyIntToShort, RandomSeedFixture)
 }
 
 
+// Column-major A[m,k] and B[k,n] with values in [-1, 1], and their product C[m,n] computed in double precision.
+struct RandomProduct
+{
+    int m, n, k;
+    std::vector<float> A, B;
+    std::vector<double> C;
+
+    RandomProduct(int m, int n, int k, unsigned long seed) : m(m), n(n), k(k), A(m*k), B(k*n), C(m*n)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> dist(-1, 1);
+        for (auto& a : A)
+            a = dist(rng);
+        for (auto& b : B)
+            b = dist(rng);
+        for (int i = 0; i < m; i++)
+            for (int j = 0; j < n; j++)
+                for (int l = 0; l < k; l++)
+                    C[i + j*m] += (double)A[i + l*m] * B[l + j*k];
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE(MultiplyShortBlockSizes, RandomSeedFixture)
+{
+    // k hits all block sizes of the block multiplier (128, 64, 32, 16, 8 and the remainder),
+    // n = 8 multiplies four rows at a time, n = 7 one row at a time.
+    for (int n : { 8, 7 })
+    {
+        RandomProduct p(13, n, 128 + 64 + 32 + 16 + 8 + 3, IncrementCounter());
+        shared_ptr<QuantizerBase<float, short>> quantA(new SymmetricQuantizer<float, short>(2));
+        shared_ptr<QuantizerBase<float, short>> quantB(new SymmetricQuantizer<float, short>(2));
+        QuantizedMultiplier<float> mult(quantA, true, quantB, false);
+
+        std::vector<float> C(p.m * p.n);
+        for (int pass = 0; pass < 2; pass++)
+        {
+            mult.Multiply(p.m, p.n, p.k, p.A.data(), p.B.data(), C.data());
+            for (size_t i = 0; i < C.size(); i++)
+                BOOST_CHECK_SMALL(C[i] - p.C[i], 1e-2);
+        }
+    }
+}
+
+// Each element of the 8-bit product can be off by the quantization errors (up to half a step) of its terms.
+static double Int8ErrorBound(const RandomProduct& p, int i, int j)
+{
+    float absMaxA = 0, absMaxB = 0;
+    for (int l = 0; l < p.k; l++)
+    {
+        absMaxA = max(absMaxA, fabs(p.A[i + l*p.m]));
+        absMaxB = max(absMaxB, fabs(p.B[l + j*p.k]));
+    }
+    double stepA = absMaxA / 127, stepB = absMaxB / 127;
+    double bound = 0;
+    for (int l = 0; l < p.k; l++)
+        bound += stepA / 2 * fabs(p.B[l + j*p.k]) + stepB / 2 * fabs(p.A[i + l*p.m]) + stepA * stepB / 4;
+    return bound * 1.001 + 1e-5;
+}
+
+BOOST_FIXTURE_TEST_CASE(MultiplyInt8, RandomSeedFixture)
+{
+    // m = 4 * 9 + 1 covers the partial block of rows, k = 8 * 32 + 5 the padding.
+    RandomProduct p(37, 5, 261, IncrementCounter());
+    Int8QuantizedMultiplier<float> mult(true, false);
+
+    std::vector<float> C(p.m * p.n);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        mult.Multiply(p.m, p.n, p.k, p.A.data(), p.B.data(), C.data());
+        for (int i = 0; i < p.m; i++)
+            for (int j = 0; j < p.n; j++)
+                BOOST_CHECK_SMALL(C[i + j*p.m] - p.C[i + j*p.m], Int8ErrorBound(p, i, j));
+    }
+
+    // A row of zeros has a zero scale.
+    for (int l = 0; l < p.k; l++)
+        p.A[2 + l*p.m] = 0;
+    Int8QuantizedMultiplier<float> multZeroRow;
+    multZeroRow.Multiply(p.m, p.n, p.k, p.A.data(), p.B.data(), C.data());
+    for (int j = 0; j < p.n; j++)
+        BOOST_CHECK_EQUAL(C[2 + j*p.m], 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(MultiplyInt8InstructionSets, RandomSeedFixture)
+{
+    // The scalar and the vectorized kernels compute the same integer dot products.
+    RandomProduct p(22, 9, 100, IncrementCounter());
+    auto savedInstructionSet = GetCPUInstructionSet();
+    SetCPUInstructionSet(CPUInstructionSet::None);
+    std::vector<float> expected(p.m * p.n);
+    Int8QuantizedMultiplier<float>().Multiply(p.m, p.n, p.k, p.A.data(), p.B.data(), expected.data());
+
+    SetCPUInstructionSet(GetSupportedCPUInstructionSet());
+    std::vector<float> actual(p.m * p.n);
+    Int8QuantizedMultiplier<float>().Multiply(p.m, p.n, p.k, p.A.data(), p.B.data(), actual.data());
+    SetCPUInstructionSet(savedInstructionSet);
+
+    for (size_t i = 0; i < actual.size(); i++)
+        BOOST_CHECK_EQUAL(actual[i], expected[i]);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
\ No newline at end of file
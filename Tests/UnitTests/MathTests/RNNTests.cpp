@@ -0,0 +1,294 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests of the CPU implementation of the RNN stack behind OptimizedRNNStackNode (CPURNN.h).
+//
+#include "stdafx.h"
+#include "../../../Source/Math/Matrix.h"
+#include "../../../Source/Math/RNNCommon.h"
+#include "../../../Source/Math/TensorOpsSIMD.h"
+#include <random>
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// one vector of dim * length values per sequence
+typedef vector<vector<double>> Sequences;
+
+static size_t NumGates(const RnnAttributes& attributes)
+{
+    return attributes.m_recurrentOp == L"lstm" ? 4 : attributes.m_recurrentOp == L"gru" ? 3 : 1;
+}
+
+static double ReferenceSigmoid(double z)
+{
+    return 1 / (1 + exp(-z));
+}
+
+// Unrolled reference of the RNN stack, written like the BrainScript recurrences (RNNs.LSTMBlock without peepholes and
+// stabilization, and the GRU and plain RNN equivalents): for every layer, direction, sequence and time step, one
+// product with the input and one with the previous hidden state, and the gate equations element by element.
+// The parameters are taken from the packed cuDNN layout documented in CPURNN.h.
+static Sequences ReferenceForward(const RnnAttributes& attributes, size_t xDim, const vector<double>& w, const Sequences& x)
+{
+    const size_t H = attributes.m_hiddenSize;
+    const size_t G = NumGates(attributes) * H;
+    const size_t numDirections = attributes.m_bidirectional ? 2 : 1;
+    const size_t yDim = numDirections * H;
+    const wstring& op = attributes.m_recurrentOp;
+
+    size_t biasOffset = 0;
+    for (size_t layer = 0; layer < attributes.m_numLayers; layer++)
+        biasOffset += numDirections * ((layer == 0 ? xDim : yDim) + H) * G;
+
+    Sequences input = x;
+    size_t inputDim = xDim;
+    size_t weightsOffset = 0;
+    for (size_t layer = 0; layer < attributes.m_numLayers; layer++)
+    {
+        Sequences output(input.size());
+        for (size_t s = 0; s < input.size(); s++)
+            output[s].resize(input[s].size() / inputDim * yDim);
+
+        for (size_t direction = 0; direction < numDirections; direction++)
+        {
+            const double* W = &w[weightsOffset];
+            const double* R = W + inputDim * G;
+            const double* bW = &w[biasOffset];
+            const double* bR = bW + G;
+            weightsOffset += (inputDim + H) * G;
+            biasOffset += 2 * G;
+
+            for (size_t s = 0; s < input.size(); s++)
+            {
+                const size_t T = input[s].size() / inputDim;
+                vector<double> h(H, 0), c(H, 0), px(G), ph(G);
+                for (size_t step = 0; step < T; step++)
+                {
+                    const size_t t = direction == 0 ? step : T - 1 - step;
+                    const double* xt = &input[s][t * inputDim];
+                    // projections of input and previous hidden state, kept apart since the GRU candidate needs that
+                    for (size_t g = 0; g < G; g++)
+                    {
+                        px[g] = bW[g];
+                        for (size_t i = 0; i < inputDim; i++)
+                            px[g] += W[i + g * inputDim] * xt[i];
+                        ph[g] = bR[g];
+                        for (size_t k = 0; k < H; k++)
+                            ph[g] += R[k + g * H] * h[k];
+                    }
+                    for (size_t k = 0; k < H; k++)
+                    {
+                        if (op == L"lstm")
+                        {
+                            double it = ReferenceSigmoid(px[k] + ph[k]);
+                            double ft = ReferenceSigmoid(px[H + k] + ph[H + k]);
+                            double bit = it * tanh(px[2 * H + k] + ph[2 * H + k]);
+                            double ot = ReferenceSigmoid(px[3 * H + k] + ph[3 * H + k]);
+                            c[k] = ft * c[k] + bit;
+                            h[k] = ot * tanh(c[k]);
+                        }
+                        else if (op == L"gru")
+                        {
+                            double rt = ReferenceSigmoid(px[k] + ph[k]);
+                            double ut = ReferenceSigmoid(px[H + k] + ph[H + k]);
+                            double ct = tanh(px[2 * H + k] + rt * ph[2 * H + k]);
+                            h[k] = (1 - ut) * ct + ut * h[k];
+                        }
+                        else if (op == L"rnnTanh")
+                            h[k] = tanh(px[k] + ph[k]);
+                        else
+                            h[k] = max(0.0, px[k] + ph[k]);
+                    }
+                    for (size_t k = 0; k < H; k++)
+                        output[s][t * yDim + direction * H + k] = h[k];
+                }
+            }
+        }
+        input = move(output);
+        inputDim = yDim;
+    }
+    return input;
+}
+
+// minibatch packing of OptimizedRNNStackNode: time-step major, sequences sorted by decreasing length
+static vector<size_t> NumSequencesForFrame(const vector<size_t>& lengths)
+{
+    vector<size_t> numSequencesForFrame(lengths[0]);
+    for (size_t t = 0; t < lengths[0]; t++)
+        numSequencesForFrame[t] = count_if(lengths.begin(), lengths.end(), [t](size_t length) { return length > t; });
+    return numSequencesForFrame;
+}
+
+template <class ElemType>
+static vector<ElemType> Pack(const Sequences& sequences, size_t dim)
+{
+    vector<ElemType> packed;
+    for (size_t t = 0; t < sequences[0].size() / dim; t++)
+        for (const auto& sequence : sequences)
+            if (t < sequence.size() / dim)
+                packed.insert(packed.end(), sequence.begin() + t * dim, sequence.begin() + (t + 1) * dim);
+    return packed;
+}
+
+template <class ElemType>
+static Sequences Unpack(const ElemType* packed, const vector<size_t>& lengths, size_t dim)
+{
+    Sequences sequences(lengths.size());
+    for (size_t t = 0; t < lengths[0]; t++)
+        for (size_t s = 0; s < lengths.size() && t < lengths[s]; s++, packed += dim)
+            sequences[s].insert(sequences[s].end(), packed, packed + dim);
+    return sequences;
+}
+
+static double InnerProduct(const Sequences& a, const Sequences& b)
+{
+    double sum = 0;
+    for (size_t s = 0; s < a.size(); s++)
+        for (size_t i = 0; i < a[s].size(); i++)
+            sum += a[s][i] * b[s][i];
+    return sum;
+}
+
+struct RNNTestData
+{
+    RnnAttributes attributes;
+    size_t xDim, yDim;
+    vector<size_t> lengths;
+    vector<double> w;
+    Sequences x, dy; // input, and the gradient of the output (i.e. the loss is the inner product of dy and the output)
+
+    RNNTestData(const wstring& op, bool bidirectional, size_t numLayers)
+        : attributes(bidirectional, numLayers, 4, op, -1), xDim(3), yDim((bidirectional ? 2 : 1) * 4), lengths({ 6, 5, 5, 2, 1 })
+    {
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<double> uniform(-1, 1);
+        auto numParameters = attributes.GetNumParameters(xDim);
+        w.resize(numParameters.first * numParameters.second);
+        for (auto& v : w)
+            v = uniform(rng);
+        for (size_t length : lengths)
+        {
+            x.push_back(vector<double>(xDim * length));
+            for (auto& v : x.back())
+                v = uniform(rng);
+            dy.push_back(vector<double>(yDim * length));
+            for (auto& v : dy.back())
+                v = uniform(rng);
+        }
+    }
+};
+
+template <class ElemType>
+static void CheckForward(const RNNTestData& data, double tolerance)
+{
+    auto numSequencesForFrame = NumSequencesForFrame(data.lengths);
+    auto w = vector<ElemType>(data.w.begin(), data.w.end());
+    auto x = Pack<ElemType>(data.x, data.xDim);
+    const size_t numColumns = x.size() / data.xDim;
+    Matrix<ElemType> W(w.size(), 1, w.data(), CPUDEVICE);
+    Matrix<ElemType> X(data.xDim, numColumns, x.data(), CPUDEVICE);
+    Matrix<ElemType> Y(data.yDim, numColumns, CPUDEVICE);
+    Matrix<ElemType> reserve(CPUDEVICE), workspace(CPUDEVICE);
+
+    Y.RNNForward(X, W, data.xDim, data.yDim, numSequencesForFrame, data.attributes, reserve, workspace);
+
+    Sequences expected = ReferenceForward(data.attributes, data.xDim, data.w, data.x);
+    Sequences actual = Unpack(Y.Data(), data.lengths, data.yDim);
+    for (size_t s = 0; s < expected.size(); s++)
+        for (size_t i = 0; i < expected[s].size(); i++)
+            BOOST_REQUIRE_SMALL(actual[s][i] - expected[s][i], tolerance);
+}
+
+// compares the gradients of the CPU RNN with central differences of the reference
+static void CheckGradients(const RNNTestData& data)
+{
+    auto numSequencesForFrame = NumSequencesForFrame(data.lengths);
+    auto w = data.w;
+    auto x = Pack<double>(data.x, data.xDim);
+    auto dy = Pack<double>(data.dy, data.yDim);
+    const size_t numColumns = x.size() / data.xDim;
+    Matrix<double> W(w.size(), 1, w.data(), CPUDEVICE);
+    Matrix<double> X(data.xDim, numColumns, x.data(), CPUDEVICE);
+    Matrix<double> Y(data.yDim, numColumns, CPUDEVICE);
+    Matrix<double> dY(data.yDim, numColumns, dy.data(), CPUDEVICE);
+    Matrix<double> dX(data.xDim, numColumns, CPUDEVICE);
+    Matrix<double> dW(w.size(), 1, CPUDEVICE);
+    Matrix<double> reserve(CPUDEVICE), workspace(CPUDEVICE);
+    dW.SetValue(1); // weight gradients are accumulated
+
+    Y.RNNForward(X, W, data.xDim, data.yDim, numSequencesForFrame, data.attributes, reserve, workspace);
+    Y.RNNBackwardData(dY, W, dX, data.attributes, reserve, workspace);
+    Y.RNNBackwardWeights(X, Y, dW, data.attributes, reserve, workspace);
+
+    const double epsilon = 1e-6;
+    auto loss = [&](const vector<double>& w, const Sequences& x)
+    {
+        return InnerProduct(data.dy, ReferenceForward(data.attributes, data.xDim, w, x));
+    };
+
+    for (size_t i = 0; i < w.size(); i++)
+    {
+        auto wPlus = data.w, wMinus = data.w;
+        wPlus[i] += epsilon;
+        wMinus[i] -= epsilon;
+        double expected = (loss(wPlus, data.x) - loss(wMinus, data.x)) / (2 * epsilon);
+        BOOST_REQUIRE_SMALL(dW.Data()[i] - 1 - expected, 1e-6);
+    }
+
+    Sequences dx = Unpack(dX.Data(), data.lengths, data.xDim);
+    for (size_t s = 0; s < data.x.size(); s++)
+    {
+        for (size_t i = 0; i < data.x[s].size(); i++)
+        {
+            auto xPlus = data.x, xMinus = data.x;
+            xPlus[s][i] += epsilon;
+            xMinus[s][i] -= epsilon;
+            double expected = (loss(data.w, xPlus) - loss(data.w, xMinus)) / (2 * epsilon);
+            BOOST_REQUIRE_SMALL(dx[s][i] - expected, 1e-6);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(RNNSuite)
+
+BOOST_FIXTURE_TEST_CASE(RNNForward, RandomSeedFixture)
+{
+    for (auto op : { L"lstm", L"gru", L"rnnTanh", L"rnnReLU" })
+    {
+        for (bool bidirectional : { false, true })
+        {
+            for (size_t numLayers : { 1, 3 })
+            {
+                RNNTestData data(op, bidirectional, numLayers);
+                CheckForward<double>(data, 1e-12);
+                CheckForward<float>(data, 1e-5);
+            }
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(RNNForwardInstructionSets, RandomSeedFixture)
+{
+    // the gate nonlinearities of the float version use the vectorized kernels if available; compare with the scalar ones
+    const auto instructionSet = GetCPUInstructionSet();
+    SetCPUInstructionSet(CPUInstructionSet::None);
+    for (auto op : { L"lstm", L"gru" })
+        CheckForward<float>(RNNTestData(op, true, 2), 1e-5);
+    SetCPUInstructionSet(instructionSet);
+}
+
+BOOST_FIXTURE_TEST_CASE(RNNBackward, RandomSeedFixture)
+{
+    for (auto op : { L"lstm", L"gru", L"rnnTanh", L"rnnReLU" })
+    {
+        for (bool bidirectional : { false, true })
+        {
+            for (size_t numLayers : { 1, 2 })
+                CheckGradients(RNNTestData(op, bidirectional, numLayers));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}}}}
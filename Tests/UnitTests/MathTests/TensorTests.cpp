@@ -7,6 +7,10 @@
 #include "TensorView.h"
 #include "Sequences.h"
 #include "TensorTestsHelper.h"
+#include "TensorOpsSIMD.h"
+#include <omp.h>
+#include <functional>
+#include <math.h>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -100,6 +104,331 @@ BOOST_AUTO_TEST_CASE(OldRnnForwardProp)
     TestOldRnnForwardPropSRP<float>();
 }
 
+// run a CPU tensor op once with the generic scalar loops and once for each supported vectorized instruction set,
+// and check that they agree within a tolerance, relative to max(1, |expected|), or if 'strict' to |expected| with
+// an allowance of two denormal ulps
+template <typename FN>
+static void SIMDTensorTest(const char* what, double tolerance, const FN& fn, bool strict = false)
+{
+    let savedInstructionSet = GetCPUInstructionSet();
+    SetCPUInstructionSet(CPUInstructionSet::None);
+    let reference = fn();
+    let numElements = reference.GetShape().GetNumElements();
+    unique_ptr<float[]> expected(reference.GetSOB().CopyToArray());
+    for (int instructionSet = (int) CPUInstructionSet::AVX2; instructionSet <= (int) GetSupportedCPUInstructionSet(); instructionSet++)
+    {
+        SetCPUInstructionSet((CPUInstructionSet) instructionSet);
+        let result = fn();
+        unique_ptr<float[]> actual(result.GetSOB().CopyToArray());
+        size_t numMismatches = 0;
+        for (size_t i = 0; i < numElements; i++)
+        {
+            let e = expected[i], a = actual[i];
+            if (a == e || (std::isnan(e) && std::isnan(a))) // (also covers infinities)
+                continue;
+            if (!(fabs(a - e) <= (strict ? tolerance * fabs(e) + 2 * std::numeric_limits<float>::denorm_min() : tolerance * max(1.0f, fabs(e)))))
+            {
+                if (numMismatches++ < 5)
+                    fprintf(stderr, "SIMD tensor test '%s' (instruction set %d): element %d is %.9g, expected %.9g\n", what, instructionSet, (int) i, a, e);
+            }
+        }
+        BOOST_CHECK_MESSAGE(numMismatches == 0, what);
+    }
+    SetCPUInstructionSet(savedInstructionSet);
+}
+
+BOOST_AUTO_TEST_CASE(SIMDUnaryOps)
+{
+    Test::TensorTest<float> tensorTester;
+    vector<ElementWiseOperator> ops;
+#define AddOp(oper) ops.push_back(ElementWiseOperator::op##oper)
+    ForAllUnaryOps(AddOp);
+#undef AddOp
+
+    // odd row length so that the remainder is handled; inputs in [-8, 8] to cover both branches of exp/tanh
+    for (let op : ops)
+    {
+        for (let betaAlpha : vector<pair<float, float>>{ { 0.0f, 1.0f }, { 0.5f, -2.0f } })
+        {
+            SIMDTensorTest("unary op", 1e-5, [&]()
+            {
+                auto a = tensorTester.CreateTensor(TensorShape{ 517, 3 }, 1, CPUDEVICE);
+                a.DoUnaryOpOf(0, a, 8, ElementWiseOperator::opCopy, ElementWiseOperator::opSum);
+                auto result = tensorTester.CreateTensor(TensorShape{ 517, 3 }, 2, CPUDEVICE, true);
+                result.DoUnaryOpOf(betaAlpha.first, a, betaAlpha.second, op, ElementWiseOperator::opSum);
+                return result;
+            });
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(SIMDUnaryOpsSpecialValues)
+{
+    Test::TensorTest<float> tensorTester;
+    vector<ElementWiseOperator> ops;
+#define AddOp(oper) ops.push_back(ElementWiseOperator::op##oper)
+    ForAllUnaryOps(AddOp);
+#undef AddOp
+
+    // infinities, NaN, arguments where exp() overflows or underflows to a denormal, and denormal arguments
+    const float denormal = std::numeric_limits<float>::denorm_min();
+    vector<float> special = { INFINITY, -INFINITY, NAN, 100, -100, 88.5f, 88.8f, -87.5f, -95, -103, -104, -110, -1000,
+                              denormal, -denormal, 1000 * denormal, -1000 * denormal, std::numeric_limits<float>::min() / 2, 0, -0.0f, 1, -1 };
+    // repeated to an odd length, so that each value is seen by both the vector loop and the remainder
+    vector<float> data;
+    for (size_t i = 0; i < 3 * special.size() + 1; i++)
+        data.push_back(special[i % special.size()]);
+    let a = TensorView<float>(make_shared<Matrix<float>>(data.size(), 1, data.data(), CPUDEVICE), TensorShape{ data.size() });
+
+    for (let op : ops)
+    {
+        SIMDTensorTest("unary op, special values", 1e-5, [&]()
+        {
+            auto result = tensorTester.CreateTensor(TensorShape{ data.size() }, 2, CPUDEVICE, true);
+            result.DoUnaryOpOf(0, a, 1, op, ElementWiseOperator::opSum);
+            return result;
+        }, /*strict=*/true);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(SIMDBinaryOps)
+{
+    Test::TensorTest<float> tensorTester;
+    vector<ElementWiseOperator> ops;
+#define AddOp(oper) ops.push_back(ElementWiseOperator::op##oper)
+    ForAllBinaryOps(AddOp);
+#undef AddOp
+
+    // contiguous, broadcasting along the row (stride 0), and broadcasting across rows
+    let shapes = vector<pair<TensorShape, TensorShape>>{
+        { TensorShape{ 37, 5 }, TensorShape{ 37, 5 } },
+        { TensorShape{ 37, 5 }, TensorShape{ 1, 5 } },
+        { TensorShape{ 1, 5 }, TensorShape{ 37, 5 } },
+        { TensorShape{ 37, 5 }, TensorShape{ 37, 1 } },
+    };
+    for (let op : ops)
+    {
+        for (let& shape : shapes)
+        {
+            SIMDTensorTest("binary op", 1e-5, [&]()
+            {
+                auto a = tensorTester.CreateTensor(shape.first, 1, CPUDEVICE);
+                auto b = tensorTester.CreateTensor(shape.second, 2, CPUDEVICE);
+                a.DoUnaryOpOf(0, a, 4, ElementWiseOperator::opCopy, ElementWiseOperator::opSum);
+                // make some elements equal so that the comparison ops see all cases
+                b.DoBinaryOpOf(0, b, b, 1, ElementWiseOperator::opMaskNegative, ElementWiseOperator::opSum);
+                auto result = tensorTester.CreateTensor(TensorShape{ 37, 5 }, 3, CPUDEVICE, true);
+                result.DoBinaryOpOf(0.5f, a, b, 2, op, ElementWiseOperator::opSum);
+                return result;
+            });
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(SIMDTernaryOps)
+{
+    Test::TensorTest<float> tensorTester;
+    vector<ElementWiseOperator> ops;
+#define AddOp(oper) ops.push_back(ElementWiseOperator::op##oper)
+    ForAllTernaryOps(AddOp);
+#undef AddOp
+
+    for (let op : ops)
+    {
+        for (let& shape : vector<TensorShape>{ TensorShape{ 37, 5 }, TensorShape{ 1, 5 } })
+        {
+            SIMDTensorTest("ternary op", 1e-5, [&]()
+            {
+                auto a = tensorTester.CreateTensor(TensorShape{ 37, 5 }, 1, CPUDEVICE);
+                auto b = tensorTester.CreateTensor(shape, 2, CPUDEVICE);
+                auto c = tensorTester.CreateTensor(TensorShape{ 37, 5 }, 3, CPUDEVICE);
+                auto result = tensorTester.CreateTensor(TensorShape{ 37, 5 }, 4, CPUDEVICE, true);
+                result.DoTernaryOpOf(0, a, b, c, 1, op, ElementWiseOperator::opSum);
+                return result;
+            });
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ParallelTensorOpsMatchSerial)
+{
+    Test::TensorTest<float> tensorTester;
+
+    // force the generic loops on several threads, and compare each parallelization strategy with a serial run
+    let savedInstructionSet = GetCPUInstructionSet();
+    let savedNumThreads = omp_get_max_threads();
+    SetCPUInstructionSet(CPUInstructionSet::None);
+    omp_set_num_threads(4);
+
+    let runAll = [&]()
+    {
+        vector<TensorView<float>> results;
+        // long rows: parallel over the innermost dimension
+        auto r1 = tensorTester.CreateTensor(TensorShape{ 4096, 2 }, 1, CPUDEVICE, true);
+        r1.DoBinaryOpOf(0.5f, tensorTester.CreateTensor(TensorShape{ 4096, 2 }, 2, CPUDEVICE), tensorTester.CreateTensor(TensorShape{ 4096, 1 }, 3, CPUDEVICE), 1, ElementWiseOperator::opSum, ElementWiseOperator::opSum);
+        results.push_back(r1);
+        // short rows: parallel over the outermost dimension
+        auto r2 = tensorTester.CreateTensor(TensorShape{ 7, 3, 1000 }, 4, CPUDEVICE, true);
+        r2.DoUnaryOpOf(0, tensorTester.CreateTensor(TensorShape{ 7, 3, 1000 }, 5, CPUDEVICE), 2, ElementWiseOperator::opTanh, ElementWiseOperator::opSum);
+        results.push_back(r2);
+        // ternary op, which has no specialized innermost loop
+        auto r3 = tensorTester.CreateTensor(TensorShape{ 512, 64 }, 6, CPUDEVICE, true);
+        r3.DoTernaryOpOf(0, tensorTester.CreateTensor(TensorShape{ 512, 64 }, 7, CPUDEVICE), tensorTester.CreateTensor(TensorShape{ 512, 1 }, 8, CPUDEVICE), tensorTester.CreateTensor(TensorShape{ 512, 64 }, 9, CPUDEVICE), 1, ElementWiseOperator::opClip, ElementWiseOperator::opSum);
+        results.push_back(r3);
+        // reductions, parallel over the outputs
+        auto r4 = tensorTester.CreateTensor(TensorShape{ 1024 }, 10, CPUDEVICE, true);
+        r4.DoUnaryOpOf(0, tensorTester.CreateTensor(TensorShape{ 1024, 64 }, 11, CPUDEVICE), 1, ElementWiseOperator::opCopy, ElementWiseOperator::opSum);
+        results.push_back(r4);
+        auto r5 = tensorTester.CreateTensor(TensorShape{ 1, 1024 }, 12, CPUDEVICE, true);
+        r5.DoUnaryOpOf(0, tensorTester.CreateTensor(TensorShape{ 64, 1024 }, 13, CPUDEVICE), 1, ElementWiseOperator::opExp, ElementWiseOperator::opLogSum);
+        results.push_back(r5);
+        return results;
+    };
+
+    CPUMatrix<float>::SetTensorOpMinWorkPerThread(SIZE_MAX);
+    let serial = runAll();
+    CPUMatrix<float>::SetTensorOpMinWorkPerThread(1);
+    let parallel = runAll();
+
+    CPUMatrix<float>::SetTensorOpMinWorkPerThread(0);
+    omp_set_num_threads(savedNumThreads);
+    SetCPUInstructionSet(savedInstructionSet);
+
+    // every output element is computed by exactly one thread in the same order, so results must be identical
+    for (size_t i = 0; i < serial.size(); i++)
+        BOOST_CHECK(parallel[i].GetSOB().IsEqualTo(serial[i].GetSOB(), 0));
+}
+
+BOOST_AUTO_TEST_CASE(ReductionsMatchLongDoubleReference)
+{
+    Test::TensorTest<float> tensorTester;
+
+    // rows longer than the pairwise block size of 128, reduced along the contiguous dimension (vectorized leaf blocks),
+    // along the strided one, and fully
+    const size_t rows = 1000, cols = 37;
+    let a = tensorTester.CreateTensor(TensorShape{ rows, cols }, 1, CPUDEVICE);
+    let b = tensorTester.CreateTensor(TensorShape{ 1, cols }, 2, CPUDEVICE); // broadcast along the reduction
+    unique_ptr<float[]> aData(a.GetSOB().CopyToArray());
+    unique_ptr<float[]> bData(b.GetSOB().CopyToArray());
+
+    struct Case
+    {
+        ElementWiseOperator op, reductionOp;
+        function<long double(size_t, size_t)> term;
+    };
+    vector<Case> cases = {
+        { ElementWiseOperator::opCopy, ElementWiseOperator::opSum, [&](size_t i, size_t j) { return (long double) aData[i + rows * j]; } },
+        { ElementWiseOperator::opSqr, ElementWiseOperator::opSum, [&](size_t i, size_t j) { return (long double) aData[i + rows * j] * aData[i + rows * j]; } },
+        { ElementWiseOperator::opExp, ElementWiseOperator::opSum, [&](size_t i, size_t j) { return expl(aData[i + rows * j]); } },
+        { ElementWiseOperator::opCopy, ElementWiseOperator::opLogSum, [&](size_t i, size_t j) { return (long double) aData[i + rows * j]; } },
+        { ElementWiseOperator::opCopy, ElementWiseOperator::opMax, [&](size_t i, size_t j) { return (long double) aData[i + rows * j]; } },
+        { ElementWiseOperator::opElementwiseProduct, ElementWiseOperator::opSum, [&](size_t i, size_t j) { return (long double) aData[i + rows * j] * bData[j]; } },
+    };
+
+    let savedInstructionSet = GetCPUInstructionSet();
+    for (let instructionSet : { CPUInstructionSet::None, GetSupportedCPUInstructionSet() })
+    {
+        SetCPUInstructionSet(instructionSet);
+        for (let& c : cases)
+        {
+            for (let reduce : vector<pair<bool, bool>>{ { true, false }, { false, true }, { true, true } }) // (rows, cols)
+            {
+                const size_t resultRows = reduce.first ? 1 : rows, resultCols = reduce.second ? 1 : cols;
+                auto result = tensorTester.CreateTensor(TensorShape{ resultRows, resultCols }, 3, CPUDEVICE, true);
+                if (c.op == ElementWiseOperator::opElementwiseProduct)
+                    result.DoBinaryOpOf(0, a, b, 1, c.op, c.reductionOp);
+                else
+                    result.DoUnaryOpOf(0, a, 1, c.op, c.reductionOp);
+                unique_ptr<float[]> resultData(result.GetSOB().CopyToArray());
+
+                // reference in long double, and the error allowed for it: relative to the sum of magnitudes, which bounds
+                // the rounding error of any summation order; the vectorized exp() is accurate to a few ulp
+                vector<long double> reference(resultRows * resultCols, c.reductionOp == ElementWiseOperator::opMax ? -INFINITY : 0);
+                vector<long double> magnitude(resultRows * resultCols, 0);
+                for (size_t j = 0; j < cols; j++)
+                {
+                    for (size_t i = 0; i < rows; i++)
+                    {
+                        const size_t k = (reduce.first ? 0 : i) + resultRows * (reduce.second ? 0 : j);
+                        const long double term = c.term(i, j);
+                        if (c.reductionOp == ElementWiseOperator::opSum)
+                            reference[k] += term;
+                        else if (c.reductionOp == ElementWiseOperator::opLogSum)
+                            reference[k] += expl(term);
+                        else
+                            reference[k] = max(reference[k], term);
+                        magnitude[k] += fabsl(term);
+                    }
+                }
+                size_t numMismatches = 0;
+                for (size_t k = 0; k < reference.size(); k++)
+                {
+                    if (c.reductionOp == ElementWiseOperator::opLogSum)
+                        reference[k] = logl(reference[k]);
+                    const long double tolerance = c.reductionOp == ElementWiseOperator::opSum ? 1e-6 * magnitude[k] : 1e-6 * (fabsl(reference[k]) + 1);
+                    if (fabsl(resultData[k] - reference[k]) > tolerance)
+                        numMismatches++;
+                }
+                BOOST_CHECK_MESSAGE(numMismatches == 0, "reduction differs from the long double reference: op " << (int) c.op << ", reduction op " << (int) c.reductionOp
+                                                        << ", instruction set " << (int) instructionSet << ", reducing rows " << reduce.first << ", cols " << reduce.second);
+            }
+        }
+    }
+    SetCPUInstructionSet(savedInstructionSet);
+}
+
+BOOST_AUTO_TEST_CASE(DeterministicParallelReductions)
+{
+    Test::TensorTest<float> tensorTester;
+
+    let savedNumThreads = omp_get_max_threads();
+    CPUMatrix<float>::SetTensorOpMinWorkPerThread(1);
+
+    let input = tensorTester.CreateTensor(TensorShape{ 999, 1001 }, 1, CPUDEVICE);
+    let input2 = tensorTester.CreateTensor(TensorShape{ 2, 50000 }, 3, CPUDEVICE);
+    unique_ptr<float[]> inputData(input.GetSOB().CopyToArray());
+
+    // full reduction to a scalar, and to fewer outputs than threads, split the reduction itself over the threads
+    let reduce = [&](const TensorView<float>& operand, const TensorShape& resultShape, ElementWiseOperator reductionOp)
+    {
+        auto result = tensorTester.CreateTensor(resultShape, 2, CPUDEVICE, true);
+        result.DoUnaryOpOf(0, operand, 1, ElementWiseOperator::opCopy, reductionOp);
+        return result;
+    };
+
+    // the pairwise sum must be close to the exact one
+    double sum = 0;
+    for (size_t i = 0; i < 999 * 1001; i++)
+        sum += inputData[i];
+    for (int numThreads = 1; numThreads <= 4; numThreads++)
+    {
+        omp_set_num_threads(numThreads);
+        BOOST_CHECK_CLOSE(reduce(input, TensorShape{ 1 }, ElementWiseOperator::opSum).GetSOB().Get00Element(), sum, 1e-3);
+    }
+
+    // in deterministic mode, the results must be bit-identical for any number of threads
+    CPUMatrix<float>::SetDeterministicTensorReductions(true);
+    vector<TensorView<float>> reference;
+    for (int numThreads = 1; numThreads <= 4; numThreads++)
+    {
+        omp_set_num_threads(numThreads);
+        vector<TensorView<float>> results = {
+            reduce(input, TensorShape{ 1 }, ElementWiseOperator::opSum),
+            reduce(input, TensorShape{ 1 }, ElementWiseOperator::opLogSum),
+            reduce(input, TensorShape{ 1, 1001 }, ElementWiseOperator::opSum),
+            reduce(input2, TensorShape{ 2, 1 }, ElementWiseOperator::opSum),
+        };
+        if (reference.empty())
+            reference = results;
+        for (size_t i = 0; i < results.size(); i++)
+            BOOST_CHECK(results[i].GetSOB().IsEqualTo(reference[i].GetSOB(), 0));
+    }
+
+    CPUMatrix<float>::SetDeterministicTensorReductions(false);
+    CPUMatrix<float>::SetTensorOpMinWorkPerThread(0);
+    omp_set_num_threads(savedNumThreads);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }}}}
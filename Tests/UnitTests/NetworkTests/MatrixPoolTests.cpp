@@ -0,0 +1,121 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNode.h"
+#include "../../../Source/ComputationNetworkLib/MatrixPool.h"
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// The pool only hands out matrix objects, so the device does not matter.
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+template <class ElemType>
+void MatrixPoolBestFitTestImpl()
+{
+    MatrixPool pool;
+    auto small = pool.Request<ElemType>(c_deviceId, 10);
+    auto medium = pool.Request<ElemType>(c_deviceId, 100);
+    auto large = pool.Request<ElemType>(c_deviceId, 1000);
+    BOOST_REQUIRE(small != medium && medium != large && small != large);
+    pool.Release(small);
+    pool.Release(medium);
+    pool.Release(large);
+
+    // the smallest one that is large enough
+    BOOST_REQUIRE(pool.Request<ElemType>(c_deviceId, 50) == medium);
+    BOOST_REQUIRE(pool.Request<ElemType>(c_deviceId, 10) == small);
+
+    // none is large enough: the largest one, which grows the least
+    auto grown = pool.Request<ElemType>(c_deviceId, 2000);
+    BOOST_REQUIRE(grown == large);
+    pool.Release(grown);
+
+    // it keeps the size it has grown to
+    auto another = pool.Request<ElemType>(c_deviceId, 1500);
+    BOOST_REQUIRE(another == large);
+    pool.Release(another);
+
+    // no hint: the smallest released one
+    auto unknown = pool.Request<ElemType>(c_deviceId);
+    BOOST_REQUIRE(unknown == large);
+    BOOST_REQUIRE_EQUAL(pool.GetNumMatrices(), 3);
+}
+
+template <class ElemType>
+void MatrixPoolMemoryPlanTestImpl()
+{
+    MatrixPool pool;
+    auto first = pool.Request<ElemType>(c_deviceId, 100);
+    auto second = pool.Request<ElemType>(c_deviceId, 50);
+    pool.Release(first);
+    auto third = pool.Request<ElemType>(c_deviceId, 200); // reuses and grows 'first'
+    BOOST_REQUIRE(third == first);
+    pool.Release(second);
+    pool.Release(third);
+
+    BOOST_REQUIRE_EQUAL(pool.GetNumMatrices(), 2);
+    BOOST_REQUIRE_EQUAL(pool.GetRequestedBytes(), 350 * sizeof(ElemType));
+    BOOST_REQUIRE_EQUAL(pool.GetAllocatedBytes(), 250 * sizeof(ElemType));
+    BOOST_REQUIRE_EQUAL(pool.GetPeakLiveBytes(), 250 * sizeof(ElemType));
+}
+
+template <class ElemType>
+void MatrixPoolReleaseTestImpl()
+{
+    MatrixPool pool;
+
+    // a matrix the pool never handed out
+    auto foreign = make_shared<Matrix<ElemType>>(c_deviceId);
+    BOOST_REQUIRE_THROW(pool.Release(foreign), std::logic_error);
+
+    // released twice
+    auto requested = pool.Request<ElemType>(c_deviceId, 10);
+    pool.Release(requested);
+    BOOST_REQUIRE_THROW(pool.Release(requested), std::logic_error);
+
+    // a matrix created elsewhere can be released once the pool has adopted it, and is then shared
+    pool.Adopt(foreign, 20);
+    pool.Adopt(foreign, 20); // already handed out: no-op
+    pool.Release(foreign);
+    BOOST_REQUIRE(pool.Request<ElemType>(c_deviceId, 15) == foreign);
+    BOOST_REQUIRE_EQUAL(pool.GetNumMatrices(), 2);
+
+    // adopting a released matrix would hand it out twice
+    BOOST_REQUIRE_THROW(pool.Adopt(requested), std::logic_error);
+
+    // the pool does not keep the matrices it has handed out alive
+    weak_ptr<Matrix<ElemType>> dropped = pool.Request<ElemType>(c_deviceId, 1000);
+    BOOST_REQUIRE(dropped.expired());
+}
+
+BOOST_AUTO_TEST_SUITE(MatrixPoolTestSuite)
+
+BOOST_AUTO_TEST_CASE(MatrixPoolBestFitTest)
+{
+    MatrixPoolBestFitTestImpl<float>();
+    MatrixPoolBestFitTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolMemoryPlanTest)
+{
+    MatrixPoolMemoryPlanTestImpl<float>();
+    MatrixPoolMemoryPlanTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolReleaseTest)
+{
+    MatrixPoolReleaseTestImpl<float>();
+    MatrixPoolReleaseTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
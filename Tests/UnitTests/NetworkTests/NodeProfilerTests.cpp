@@ -0,0 +1,207 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/LinearAlgebraNodes.h"
+#include "../../../Source/ComputationNetworkLib/NodeProfiler.h"
+#include "../../../Source/ComputationNetworkLib/NonlinearityNodes.h"
+#include <boost/filesystem.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <map>
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// We perform test on CPU.
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+const size_t c_inputDim = 3;
+const size_t c_hiddenDim = 4;
+const size_t c_numSequences = 2;
+const size_t c_numTimeSteps = 5;
+const size_t c_numMinibatches = 3;
+
+// A recurrent layer h = Tanh(W * features + R * PastValue(h)) trained against the labels with a square error.
+// 'input' and 'criterion' run in PAR mode, 'recurrence', 'sum', 'h' and 'pastValue' form a SEQ loop.
+template <class ElemType>
+static ComputationNetworkPtr CreateRecurrentNetwork()
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+
+    auto features = builder.CreateInputNode(L"features", c_inputDim);
+    auto labels = builder.CreateInputNode(L"labels", c_hiddenDim);
+    auto W = builder.CreateLearnableParameter(L"W", c_hiddenDim, c_inputDim);
+    auto R = builder.CreateLearnableParameter(L"R", c_hiddenDim, c_hiddenDim);
+    net->RandomInitLearnableParameters(W, true /*uniformInit*/, 1 /*randomSeed*/, 1 /*initValueScale*/);
+    net->RandomInitLearnableParameters(R, true /*uniformInit*/, 2 /*randomSeed*/, 1 /*initValueScale*/);
+
+    auto pastValue = builder.PastValue(nullptr, 0, c_hiddenDim, 1, L"pastValue");
+    auto h = builder.Tanh(builder.Plus(builder.Times(W, features, 1, L"input"), builder.Times(R, pastValue, 1, L"recurrence"), L"sum"), L"h");
+    pastValue->AttachInputs({h});
+    auto criterion = builder.SquareError(labels, h, L"criterion");
+
+    net->AddToNodeGroup(L"feature", features);
+    net->AddToNodeGroup(L"label", labels);
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+    net->AllocateAllMatrices({}, {}, criterion);
+    return net;
+}
+
+// Fills the inputs with random sequences, as a reader would.
+template <class ElemType>
+static void SetRandomMinibatch(const ComputationNetworkPtr& net, unsigned long randomSeed)
+{
+    auto& pMBLayout = net->GetMBLayoutPtrOfNetwork();
+    pMBLayout->Init(c_numSequences, c_numTimeSteps);
+    for (size_t s = 0; s < c_numSequences; s++)
+        pMBLayout->AddSequence(s /*seqId*/, s, 0, c_numTimeSteps);
+
+    for (const auto& inputNode : net->InputNodes(net->GetNodeFromName(L"criterion")))
+    {
+        auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(inputNode);
+        node->Value().Resize(node->GetSampleMatrixNumRows(), pMBLayout->GetNumCols());
+        node->Value().SetUniformRandomValue(-1, 1, randomSeed++);
+        node->BumpEvalTimeStamp();
+    }
+}
+
+struct TraceEventSummary
+{
+    size_t m_numEvents;
+    double m_totalSeconds;
+};
+
+template <class ElemType>
+void NodeProfilerTestImpl()
+{
+    auto traceFilePath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("NodeProfilerTest-%%%%-%%%%.json");
+    auto profiler = make_shared<NodeProfiler>(traceFilePath.wstring());
+
+    auto net = CreateRecurrentNetwork<ElemType>();
+    auto criterion = net->GetNodeFromName(L"criterion");
+    net->Environment().nodeProfiler = profiler;
+    {
+        ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+        net->StartEvaluateMinibatchLoop(criterion);
+        for (size_t i = 0; i < c_numMinibatches; i++)
+        {
+            SetRandomMinibatch<ElemType>(net, (unsigned long)(10 * i + 1));
+            net->ForwardProp(criterion);
+            net->Backprop(criterion);
+        }
+    }
+    net->Environment().nodeProfiler = nullptr;
+
+    auto getStatistics = [&](const wstring& nodeName)
+    {
+        auto statistics = profiler->GetNodeStatistics(nodeName);
+        BOOST_REQUIRE_MESSAGE(statistics != nullptr, "No statistics for node " << string(nodeName.begin(), nodeName.end()));
+        return *statistics;
+    };
+    const size_t forward = (size_t)NodeProfilerPass::forward;
+    const size_t backward = (size_t)NodeProfilerPass::backward;
+
+    // PAR nodes are accounted once per minibatch, each member of the loop once per time step
+    for (const auto& nodeName : {L"input", L"criterion"})
+    {
+        auto statistics = getStatistics(nodeName);
+        BOOST_REQUIRE_EQUAL(statistics.m_numCalls[forward], c_numMinibatches);
+        BOOST_REQUIRE_EQUAL(statistics.m_numCalls[backward], c_numMinibatches);
+        BOOST_REQUIRE(statistics.m_flops[forward] > 0 && statistics.m_flops[backward] > 0);
+    }
+    for (const auto& nodeName : {L"recurrence", L"sum", L"h", L"pastValue"})
+    {
+        auto statistics = getStatistics(nodeName);
+        BOOST_REQUIRE_EQUAL(statistics.m_numCalls[forward], c_numMinibatches * c_numTimeSteps);
+        BOOST_REQUIRE_EQUAL(statistics.m_numCalls[backward], c_numMinibatches * c_numTimeSteps);
+    }
+    // leaves are not forward-propagated
+    auto parameterStatistics = getStatistics(L"W");
+    BOOST_REQUIRE_EQUAL(parameterStatistics.m_numCalls[forward], (size_t)0);
+    BOOST_REQUIRE_EQUAL(parameterStatistics.m_numCalls[backward], c_numMinibatches);
+    BOOST_REQUIRE(getStatistics(L"input").m_operationName == OperationNameOf(TimesNode));
+    BOOST_REQUIRE(getStatistics(L"h").m_operationName == OperationNameOf(TanhNode));
+
+    // keep what is needed to cross-check the trace, since Report() resets the aggregates
+    auto inputStatistics = getStatistics(L"input");
+    double loopForwardSeconds = 0;
+    for (const auto& nodeName : {L"recurrence", L"sum", L"h", L"pastValue"})
+        loopForwardSeconds += getStatistics(nodeName).m_seconds[forward];
+
+    const string title = "NodeProfilerTest";
+    profiler->Report(title);
+    BOOST_REQUIRE(profiler->GetNodeStatistics(L"input") == nullptr);
+
+    // the trace must be valid JSON in the Chrome trace event format
+    boost::property_tree::ptree trace;
+    BOOST_REQUIRE_NO_THROW(boost::property_tree::read_json(traceFilePath.string(), trace));
+    boost::filesystem::remove(traceFilePath);
+    BOOST_REQUIRE_EQUAL(trace.get<string>("displayTimeUnit"), "ms");
+
+    size_t numThreadNames = 0;
+    size_t numMarkers = 0;
+    map<pair<string, int>, TraceEventSummary> events; // [(name or category for loops, tid)]
+    for (const auto& iter : trace.get_child("traceEvents"))
+    {
+        const auto& event = iter.second;
+        auto phase = event.get<string>("ph");
+        if (phase == "M")
+            numThreadNames++;
+        else if (phase == "i")
+        {
+            BOOST_REQUIRE_EQUAL(event.get<string>("name"), title);
+            numMarkers++;
+        }
+        else
+        {
+            BOOST_REQUIRE_EQUAL(phase, "X");
+            auto tid = event.get<int>("tid");
+            BOOST_REQUIRE(tid == (int)forward || tid == (int)backward);
+            auto category = event.get<string>("cat");
+            auto& summary = events[make_pair(category == "Loop" ? category : event.get<string>("name"), tid)];
+            summary.m_numEvents++;
+            summary.m_totalSeconds += event.get<double>("dur") / 1e6;
+            BOOST_REQUIRE(event.get<double>("dur") >= 0 && event.get<double>("ts") >= 0);
+        }
+    }
+    BOOST_REQUIRE_EQUAL(numThreadNames, 2);
+    BOOST_REQUIRE_EQUAL(numMarkers, 1);
+
+    // PAR nodes have one event per call, whose durations add up to the aggregated time
+    for (size_t pass = forward; pass <= backward; pass++)
+    {
+        const auto& summary = events[make_pair(string("input"), (int)pass)];
+        BOOST_REQUIRE_EQUAL(summary.m_numEvents, c_numMinibatches);
+        BOOST_REQUIRE_SMALL(summary.m_totalSeconds - inputStatistics.m_seconds[pass], 1e-9 * c_numMinibatches); // the trace is written with 1 ns resolution
+        BOOST_REQUIRE_EQUAL(events[make_pair(string("criterion"), (int)pass)].m_numEvents, c_numMinibatches);
+    }
+
+    // a loop adds one event per minibatch only, which covers the time of all of its members
+    // (not in the backward pass, where its members also propagate into the outside of the loop after the event)
+    BOOST_REQUIRE_EQUAL(events[make_pair(string("Loop"), (int)forward)].m_numEvents, c_numMinibatches);
+    BOOST_REQUIRE_EQUAL(events[make_pair(string("Loop"), (int)backward)].m_numEvents, c_numMinibatches);
+    BOOST_REQUIRE(loopForwardSeconds <= events[make_pair(string("Loop"), (int)forward)].m_totalSeconds + 1e-9 * c_numMinibatches);
+    BOOST_REQUIRE(events.find(make_pair(string("h"), (int)forward)) == events.end());
+}
+
+BOOST_AUTO_TEST_SUITE(NodeProfilerTestSuite)
+
+BOOST_AUTO_TEST_CASE(NodeProfilerRecurrentNetworkTest)
+{
+    NodeProfilerTestImpl<float>();
+    NodeProfilerTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
@@ -0,0 +1,138 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// We perform test on CPU.
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+const size_t c_inputDim = 3;
+const size_t c_hiddenDim = 4;
+const size_t c_numSequences = 2;
+const size_t c_numTimeSteps = 5;
+
+// Two stacked recurrent layers
+//   h1 = Tanh(W1 * features + R1 * PastValue(h1))
+//   h2 = Tanh(h1 + R2 * PastValue(h2))
+// trained against the labels with a square error. 'sum2' is a member of the second loop that consumes 'h1', a member of
+// the first loop, directly; its gradient into 'h1' must be computed outside of the second loop's time steps.
+static ComputationNetworkPtr CreateStackedRecurrentNetwork()
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<double> builder(*net);
+
+    auto features = builder.CreateInputNode(L"features", c_inputDim);
+    auto labels = builder.CreateInputNode(L"labels", c_hiddenDim);
+    auto W1 = builder.CreateLearnableParameter(L"W1", c_hiddenDim, c_inputDim);
+    auto R1 = builder.CreateLearnableParameter(L"R1", c_hiddenDim, c_hiddenDim);
+    auto R2 = builder.CreateLearnableParameter(L"R2", c_hiddenDim, c_hiddenDim);
+    net->RandomInitLearnableParameters(W1, true /*uniformInit*/, 1 /*randomSeed*/, 1 /*initValueScale*/);
+    net->RandomInitLearnableParameters(R1, true /*uniformInit*/, 2 /*randomSeed*/, 1 /*initValueScale*/);
+    net->RandomInitLearnableParameters(R2, true /*uniformInit*/, 3 /*randomSeed*/, 1 /*initValueScale*/);
+
+    auto pastValue1 = builder.PastValue(nullptr, 0, c_hiddenDim, 1, L"pastValue1");
+    auto h1 = builder.Tanh(builder.Plus(builder.Times(W1, features), builder.Times(R1, pastValue1), L"sum1"), L"h1");
+    pastValue1->AttachInputs({h1});
+
+    auto pastValue2 = builder.PastValue(nullptr, 0, c_hiddenDim, 1, L"pastValue2");
+    auto h2 = builder.Tanh(builder.Plus(h1, builder.Times(R2, pastValue2), L"sum2"), L"h2");
+    pastValue2->AttachInputs({h2});
+
+    auto criterion = builder.SquareError(labels, h2, L"criterion");
+
+    net->AddToNodeGroup(L"feature", features);
+    net->AddToNodeGroup(L"label", labels);
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+    net->AllocateAllMatrices({}, {}, criterion);
+    return net;
+}
+
+// Fills the inputs with random sequences, as a reader would.
+static void SetRandomMinibatch(const ComputationNetworkPtr& net, unsigned long randomSeed)
+{
+    auto& pMBLayout = net->GetMBLayoutPtrOfNetwork();
+    pMBLayout->Init(c_numSequences, c_numTimeSteps);
+    for (size_t s = 0; s < c_numSequences; s++)
+        pMBLayout->AddSequence(s /*seqId*/, s, 0, c_numTimeSteps);
+
+    for (const auto& inputNode : net->InputNodes(net->GetNodeFromName(L"criterion")))
+    {
+        auto node = dynamic_pointer_cast<ComputationNode<double>>(inputNode);
+        node->Value().Resize(node->GetSampleMatrixNumRows(), pMBLayout->GetNumCols());
+        node->Value().SetUniformRandomValue(-1, 1, randomSeed++);
+        node->BumpEvalTimeStamp();
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(RecurrentLoopTestSuite)
+
+BOOST_AUTO_TEST_CASE(StackedRecurrentLoopsGradientTest)
+{
+    auto net = CreateStackedRecurrentNetwork();
+    auto criterion = net->GetNodeFromName(L"criterion");
+
+    // the layers form separate loops, and 'sum2' propagates from the second into the first one
+    auto h1 = net->GetNodeFromName(L"h1");
+    auto sum2 = net->GetNodeFromName(L"sum2");
+    BOOST_REQUIRE(h1->IsPartOfLoop() && sum2->IsPartOfLoop());
+    BOOST_REQUIRE(!h1->IsPartOfSameLoop(*sum2));
+    BOOST_REQUIRE(h1->IsPartOfSameLoop(*net->GetNodeFromName(L"pastValue1")));
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    net->StartEvaluateMinibatchLoop(criterion);
+    SetRandomMinibatch(net, 1);
+
+    // Backprop() raises a LogicError ("Inefficiency") if a loop propagates into another loop's node once per time step
+    net->ForwardProp(criterion);
+    BOOST_REQUIRE_NO_THROW(net->Backprop(criterion));
+
+    // compare the gradients of all parameters with central finite differences of the criterion
+    const double epsilon = 1e-6;
+    for (const auto& parameterName : {L"W1", L"R1", L"R2"})
+    {
+        auto parameter = dynamic_pointer_cast<ComputationNode<double>>(net->GetNodeFromName(parameterName));
+        auto& value = parameter->Value();
+        vector<double> gradient(parameter->Gradient().Data(), parameter->Gradient().Data() + value.GetNumElements());
+
+        for (size_t i = 0; i < value.GetNumRows(); i++)
+        {
+            for (size_t j = 0; j < value.GetNumCols(); j++)
+            {
+                double original = value(i, j);
+                value(i, j) = original + epsilon;
+                parameter->BumpEvalTimeStamp();
+                net->ForwardProp(criterion);
+                double criterionPlus = criterion->Get00Element();
+
+                value(i, j) = original - epsilon;
+                parameter->BumpEvalTimeStamp();
+                net->ForwardProp(criterion);
+                double criterionMinus = criterion->Get00Element();
+
+                value(i, j) = original;
+                parameter->BumpEvalTimeStamp();
+
+                double numericGradient = (criterionPlus - criterionMinus) / (2 * epsilon);
+                BOOST_CHECK_SMALL(gradient[j * value.GetNumRows() + i] - numericGradient, 1e-6 * max(1.0, fabs(numericGradient)));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
@@ -0,0 +1,346 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ReaderPerformanceTests.cpp : Measures the throughput of a composite reader configuration without a network.
+//
+// Arguments are given as name=value pairs, as for cntk:
+//     readerperftests format=ctf|htk|image [dataDir=ReaderPerformanceData] [numSequences=...] [frameMode=...] [randomize=true]
+//         generates synthetic data in dataDir and reads it with a default configuration of the corresponding deserializers.
+//     readerperftests configFile=<file> section=<name>
+//         reads with the reader configuration in the 'reader' block of the given section.
+// Common options:
+//     seconds=10          time to read per run
+//     minibatchSize=256   minibatch size in samples
+//     threads=1:2:4       numbers of threads to sweep (OpenMP threads, read ahead threads, parallel deserialization
+//                         and parsing threads per CNTK text format chunk)
+//
+#include "stdafx.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <omp.h>
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <unistd.h>
+#endif
+#include "Basics.h"
+#include "Config.h"
+#include "fileutil.h"
+#include "DataReader.h"
+#include "ReaderShim.h"
+#include "ReaderStageTimes.h"
+#include "../../../Source/Readers/CompositeDataReader/CompositeDataReader.h"
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+// Current resident memory of the process in bytes.
+// (Not the peak the OS keeps track of: that is a high-water mark over the whole process, which would carry over
+// from one run of the sweep to the next.)
+static size_t GetResidentMemory()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.WorkingSetSize;
+#else
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f)
+        return 0;
+    size_t totalPages = 0, residentPages = 0;
+    int numRead = fscanf(f, "%zu %zu", &totalPages, &residentPages);
+    fclose(f);
+    return numRead == 2 ? residentPages * (size_t)sysconf(_SC_PAGESIZE) : 0;
+#endif
+}
+
+// Sequences of random length with dense features and a sparse one-hot label per sample, in the CNTK text format.
+static string GenerateTextFormatData(const string& dataDir, size_t numSequences)
+{
+    const size_t featureDim = 64, labelDim = 10, maxLength = 32;
+    string path = dataDir + "/data.ctf";
+    msra::files::make_intermediate_dirs(msra::strfun::utf16(path));
+    FILE* f = fopenOrDie(path, "w");
+
+    mt19937 rng(0);
+    uniform_real_distribution<float> value(-1, 1);
+    for (size_t s = 0; s < numSequences; ++s)
+    {
+        size_t length = 1 + rng() % maxLength;
+        for (size_t t = 0; t < length; ++t)
+        {
+            fprintf(f, "%d |features", (int)s);
+            for (size_t i = 0; i < featureDim; ++i)
+                fprintf(f, " %.4f", value(rng));
+            fprintf(f, " |labels %d:1\n", (int)(rng() % labelDim));
+        }
+    }
+    fcloseOrDie(f);
+
+    return "deserializers = ([\n"
+           "    type = \"CNTKTextFormatDeserializer\"\n"
+           "    module = \"CNTKTextFormatReader\"\n"
+           "    file = \"" + path + "\"\n"
+           "    input = [\n"
+           "        features = [ dim = " + to_string(featureDim) + " ; format = \"dense\" ]\n"
+           "        labels = [ dim = " + to_string(labelDim) + " ; format = \"sparse\" ]\n"
+           "    ]\n"
+           "])\n";
+}
+
+// Utterances of random length in a single HTK feature archive (in the natural byte order, as written by HTK with
+// NATURALWRITEORDER = T), and their state labels in an MLF.
+static string GenerateHTKData(const string& dataDir, size_t numSequences)
+{
+    const int featureDim = 40, labelDim = 100, minLength = 100, maxLength = 500, maxRun = 10;
+    const int htkPeriod = 100000; // 10ms in HTK units of 100ns.
+    string archivePath = dataDir + "/features.ark";
+    string scpPath = dataDir + "/features.scp";
+    string mlfPath = dataDir + "/labels.mlf";
+    string stateListPath = dataDir + "/states.list";
+
+    mt19937 rng(0);
+    vector<int> lengths(numSequences);
+    int totalFrames = 0;
+    for (auto& length : lengths)
+    {
+        length = minLength + rng() % (maxLength - minLength + 1);
+        totalFrames += length;
+    }
+
+    msra::files::make_intermediate_dirs(msra::strfun::utf16(archivePath));
+
+    // Header of the archive: number of samples, sample period, sample size in bytes and parameter kind (USER).
+    FILE* archive = fopenOrDie(archivePath, "wb");
+    int header[2] = { totalFrames, htkPeriod };
+    short sampleHeader[2] = { (short)(featureDim * sizeof(float)), 9 };
+    fwriteOrDie(header, sizeof(header), 1, archive);
+    fwriteOrDie(sampleHeader, sizeof(sampleHeader), 1, archive);
+
+    FILE* scp = fopenOrDie(scpPath, "w");
+    FILE* mlf = fopenOrDie(mlfPath, "w");
+    fprintf(mlf, "#!MLF!#\n");
+
+    uniform_real_distribution<float> value(-1, 1);
+    vector<float> frame(featureDim);
+    int firstFrame = 0;
+    for (size_t u = 0; u < numSequences; ++u)
+    {
+        for (int t = 0; t < lengths[u]; ++t)
+        {
+            for (auto& v : frame)
+                v = value(rng);
+            fwriteOrDie(frame.data(), sizeof(float), frame.size(), archive);
+        }
+
+        fprintf(scp, "u%d.mfc=%s[%d,%d]\n", (int)u, archivePath.c_str(), firstFrame, firstFrame + lengths[u] - 1);
+        firstFrame += lengths[u];
+
+        fprintf(mlf, "\"*/u%d.lab\"\n", (int)u);
+        for (int t = 0; t < lengths[u];)
+        {
+            int run = min(lengths[u] - t, 1 + (int)(rng() % maxRun));
+            fprintf(mlf, "%d %d s%d\n", t * htkPeriod, (t + run) * htkPeriod, (int)(rng() % labelDim));
+            t += run;
+        }
+        fprintf(mlf, ".\n");
+    }
+    fcloseOrDie(archive);
+    fcloseOrDie(scp);
+    fcloseOrDie(mlf);
+
+    FILE* stateList = fopenOrDie(stateListPath, "w");
+    for (int i = 0; i < labelDim; ++i)
+        fprintf(stateList, "s%d\n", i);
+    fcloseOrDie(stateList);
+
+    return "deserializers = ([\n"
+           "    type = \"HTKFeatureDeserializer\"\n"
+           "    module = \"HTKDeserializers\"\n"
+           "    input = [ features = [ dim = " + to_string(featureDim) + " ; scpFile = \"" + scpPath + "\" ] ]\n"
+           "]:[\n"
+           "    type = \"HTKMLFDeserializer\"\n"
+           "    module = \"HTKDeserializers\"\n"
+           "    input = [ labels = [ dim = " + to_string(labelDim) + " ; mlfFile = \"" + mlfPath + "\" ; labelMappingFile = \"" + stateListPath + "\" ] ]\n"
+           "])\n";
+}
+
+// Color images (binary PPM) with a random label each, scaled to a fixed size by the reader.
+static string GenerateImageData(const string& dataDir, size_t numSequences)
+{
+    const int width = 64, height = 64, labelDim = 10, scaledSize = 32;
+    string mapPath = dataDir + "/images.txt";
+    msra::files::make_intermediate_dirs(msra::strfun::utf16(dataDir + "/images/0.ppm"));
+    FILE* map = fopenOrDie(mapPath, "w");
+
+    mt19937 rng(0);
+    vector<unsigned char> pixels(width * height * 3);
+    for (size_t i = 0; i < numSequences; ++i)
+    {
+        string imagePath = dataDir + "/images/" + to_string(i) + ".ppm";
+        FILE* image = fopenOrDie(imagePath, "wb");
+        fprintf(image, "P6\n%d %d\n255\n", width, height);
+        for (auto& p : pixels)
+            p = (unsigned char)rng();
+        fwriteOrDie(pixels.data(), 1, pixels.size(), image);
+        fcloseOrDie(image);
+
+        fprintf(map, "%s\t%d\n", imagePath.c_str(), (int)(rng() % labelDim));
+    }
+    fcloseOrDie(map);
+
+    return "deserializers = ([\n"
+           "    type = \"ImageDeserializer\"\n"
+           "    module = \"ImageReader\"\n"
+           "    file = \"" + mapPath + "\"\n"
+           "    input = [\n"
+           "        features = [ transforms = ([ type = \"Scale\" ; width = " + to_string(scaledSize) + " ; height = " + to_string(scaledSize) + " ; channels = 3 ]) ]\n"
+           "        labels = [ labelDim = " + to_string(labelDim) + " ]\n"
+           "    ]\n"
+           "])\n";
+}
+
+// Size of the minibatch data in the matrix (the allocated size for sparse matrices).
+static size_t GetMatrixBytes(const Matrix<float>& matrix)
+{
+    return matrix.GetMatrixType() == MatrixType::SPARSE ? matrix.BufferSize() : matrix.GetNumElements() * sizeof(float);
+}
+
+// Reads minibatches for the given time with the given number of threads and prints the throughput
+// and the time spent in the stages of the reader.
+static void ReaderThroughputTest(const ConfigParameters& baseConfig, int numThreads, double seconds, size_t minibatchSize)
+{
+    omp_set_num_threads(numThreads);
+    const size_t memoryBefore = GetResidentMemory();
+
+    ConfigParameters config = baseConfig;
+    config.Insert("profileStages", "true");
+    config.Insert("numReadAheadThreads", to_string(numThreads));
+    config.Insert("numParsingThreads", to_string(numThreads));
+    if (numThreads > 1)
+        config.Insert("multiThreadedDeserialization", "true");
+
+    auto reader = make_shared<CompositeDataReader>(config);
+    ReaderShim<float> shim(reader);
+    shim.Init(config);
+    shim.SetStageTimes(reader->GetStageTimes());
+
+    // Each stream gets its own layout, so that streams with different sequence lengths can be read.
+    StreamMinibatchInputs inputs;
+    for (const auto& stream : reader->GetStreamDescriptions())
+    {
+        auto matrix = make_shared<Matrix<float>>(CPUDEVICE);
+        if (stream->m_storageType == StorageType::sparse_csc)
+            matrix->SwitchToMatrixType(MatrixType::SPARSE, MatrixFormat::matrixFormatSparseCSC, false);
+        inputs.insert(make_pair(stream->m_name, StreamMinibatchInputs::Input(matrix, make_shared<MBLayout>(1, 0, stream->m_name), TensorShape())));
+    }
+
+    size_t numMinibatches = 0, numSamples = 0, numBytes = 0, numEpochs = 0;
+    size_t peakMemory = GetResidentMemory(); // of this run, sampled after each minibatch
+    auto start = chrono::steady_clock::now();
+    double elapsed = 0;
+    while (elapsed < seconds)
+    {
+        shim.StartMinibatchLoop(minibatchSize, numEpochs++, inputs.GetStreamDescriptions(), requestDataSize);
+        while (elapsed < seconds && shim.GetMinibatch(inputs))
+        {
+            size_t samples = 0;
+            for (auto& input : inputs)
+            {
+                samples = max(samples, input.second.pMBLayout->GetActualNumSamples());
+                numBytes += GetMatrixBytes(input.second.GetMatrix<float>());
+            }
+            numSamples += samples;
+            numMinibatches++;
+            peakMemory = max(peakMemory, GetResidentMemory());
+            elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        }
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+
+    cout << "threads " << numThreads << ": " << numMinibatches << " minibatches, " << numSamples << " samples in "
+         << elapsed << " s (" << numEpochs << " epochs): " << numSamples / elapsed << " samples/s, "
+         << numBytes / elapsed / (1 << 20) << " MB/s, peak memory " << peakMemory / (1 << 20) << " MB ("
+         << ((double)peakMemory - (double)memoryBefore) / (1 << 20) << " MB more than before the run)" << endl;
+
+    // Stage times are summed over threads, so that they can exceed the elapsed time.
+    const auto& times = *reader->GetStageTimes();
+    double total = 0;
+    for (size_t i = 0; i < (size_t)ReaderStage::numberOfStages; ++i)
+        total += times.GetSeconds((ReaderStage)i);
+
+    cout << "    stage thread-seconds:";
+    for (size_t i = 0; i < (size_t)ReaderStage::numberOfStages; ++i)
+    {
+        auto stage = (ReaderStage)i;
+        cout << " " << ReaderStageTimes::GetName(stage) << " " << times.GetSeconds(stage)
+             << " (" << (total > 0 ? 100 * times.GetSeconds(stage) / total : 0) << "%)";
+    }
+    cout << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        vector<wstring> arguments;
+        for (int i = 0; i < argc; ++i)
+            arguments.push_back(msra::strfun::utf16(argv[i]));
+        vector<wchar_t*> argumentPointers;
+        for (auto& argument : arguments)
+            argumentPointers.push_back(&argument[0]);
+
+        ConfigParameters config;
+        ConfigParameters::ParseCommandLine((int)argumentPointers.size(), argumentPointers.data(), config);
+
+        ConfigParameters readerConfig;
+        if (config.Exists(L"section"))
+        {
+            string section = config(L"section");
+            ConfigParameters sectionConfig = config(section);
+            readerConfig = sectionConfig("reader");
+        }
+        else
+        {
+            string format = config(L"format", "ctf");
+            string dataDir = config(L"dataDir", "ReaderPerformanceData");
+
+            string deserializers;
+            if (format == "ctf")
+                deserializers = GenerateTextFormatData(dataDir, config(L"numSequences", (size_t)10000));
+            else if (format == "htk")
+                deserializers = GenerateHTKData(dataDir, config(L"numSequences", (size_t)1000));
+            else if (format == "image")
+                deserializers = GenerateImageData(dataDir, config(L"numSequences", (size_t)2000));
+            else
+                InvalidArgument("Unknown format '%s', expected ctf, htk or image.", format.c_str());
+
+            bool frameMode = config(L"frameMode", format == "htk");
+            bool randomize = config(L"randomize", true);
+            readerConfig.Parse(deserializers +
+                               "frameMode = " + (frameMode ? "true" : "false") + "\n" +
+                               "randomize = " + (randomize ? "true" : "false") + "\n");
+        }
+
+        double seconds = config(L"seconds", 10.0);
+        size_t minibatchSize = config(L"minibatchSize", (size_t)256);
+        intargvector threads = config(L"threads", ConfigParameters::Array(intargvector(vector<int>{ 1 })));
+
+        cout << "Reading for " << seconds << " s per run with minibatch size " << minibatchSize << endl;
+        for (size_t i = 0; i < threads.size(); ++i)
+            ReaderThroughputTest(readerConfig, threads[i], seconds, minibatchSize);
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "EXCEPTION occurred: %s\n", e.what());
+        return -1;
+    }
+
+    return 0;
+}
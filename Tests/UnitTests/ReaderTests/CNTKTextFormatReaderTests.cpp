@@ -4,6 +4,7 @@
 //
 #include "stdafx.h"
 #include <algorithm>
+#include <random>
 #ifdef _WIN32
 #include <io.h>
 #else // On Linux
@@ -16,6 +17,8 @@
 #include <boost/scope_exit.hpp>
 #include "Common/ReaderTestHelper.h"
 #include "TextParser.h"
+#include "Indexer.h"
+#include "BinaryFormat.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -33,11 +36,12 @@ public:
     ChunkPtr m_chunk;
 
     CNTKTextFormatReaderTestRunner(const string& filename,
-        const vector<StreamDescriptor>& streams, unsigned int maxErrors) :
+        const vector<StreamDescriptor>& streams, unsigned int maxErrors, bool verbose = true, size_t numParsingThreads = 1) :
         m_parser(std::make_shared<CorpusDescriptor>(true), wstring(filename.begin(), filename.end()), streams, true)
     {
+        m_parser.SetNumParsingThreads(numParsingThreads);
         m_parser.SetMaxAllowedErrors(maxErrors);
-        m_parser.SetTraceLevel(TextParser<ElemType>::TraceLevel::Info);
+        m_parser.SetTraceLevel(verbose ? TextParser<ElemType>::TraceLevel::Info : TextParser<ElemType>::TraceLevel::Error);
         m_parser.SetChunkSize(SIZE_MAX);
         m_parser.SetNumRetries(0);
         m_parser.Initialize();
@@ -47,6 +51,19 @@ public:
     {
         m_chunk = m_parser.GetChunk(0);
     }
+
+    // Returns the data of all streams of the given sequence of the loaded chunk.
+    vector<SequenceDataPtr> GetSequence(size_t sequenceId)
+    {
+        vector<SequenceDataPtr> result;
+        m_chunk->GetSequence(sequenceId, result);
+        return result;
+    }
+
+    size_t GetNumberOfSequences()
+    {
+        return m_parser.m_indexer->GetIndex().m_chunks[0].m_sequences.size();
+    }
 };
 
 namespace Test {
@@ -76,6 +93,67 @@ void SortLinesInFile(string filename, size_t expectedNumLines = 1)
 }
 
 
+// (key, offset, size, number of samples, chunk id) of every sequence in the index of a text file.
+typedef vector<tuple<size_t, int64_t, size_t, size_t, size_t>> IndexDump;
+
+// Builds the index of a text file with small chunks; sequentially if numThreads is 0,
+// otherwise with the given number of threads and ranges of any size.
+IndexDump BuildIndex(const string& filename, bool skipSequenceIds, size_t numThreads, const wstring& cacheFile = L"")
+{
+    wstring path(filename.begin(), filename.end());
+    FILE* file = fopenOrDie(path, L"rbS");
+    BOOST_SCOPE_EXIT(file) { fclose(file); } BOOST_SCOPE_EXIT_END
+
+    Indexer indexer(file, true, skipSequenceIds, 256);
+    auto corpus = make_shared<CorpusDescriptor>(true);
+    if (numThreads == 0)
+        indexer.Build(corpus);
+    else
+        indexer.Build(corpus, path, numThreads, cacheFile, 1);
+
+    IndexDump result;
+    for (const auto& chunk : indexer.GetIndex().m_chunks)
+        for (const auto& sequence : chunk.m_sequences)
+            result.push_back(make_tuple((size_t)sequence.m_key.m_sequence, sequence.m_fileOffsetBytes, sequence.m_byteSize,
+                                        (size_t)sequence.m_numberOfSamples, (size_t)sequence.m_chunkId));
+    return result;
+}
+
+// Writes 'numSequences' sequences of 'sequenceLength' samples, each sample either a dense vector
+// of 'dimension' values or a sparse vector with 'nnz' non-zero values out of 'dimension'.
+void GenerateTextFormatFile(const string& filename, size_t numSequences, size_t sequenceLength,
+                            size_t dimension, size_t nnz, bool sparse)
+{
+    std::mt19937 rng(17);
+    std::uniform_real_distribution<float> valueDistribution(-10.f, 10.f);
+    std::uniform_int_distribution<size_t> indexDistribution(0, dimension - 1);
+
+    FILE* file = fopenOrDie(filename, "w");
+    for (size_t i = 0; i < numSequences; ++i)
+    {
+        for (size_t j = 0; j < sequenceLength; ++j)
+        {
+            fprintf(file, "%u |x", (unsigned int)i);
+            if (sparse)
+            {
+                vector<size_t> indices(nnz);
+                for (auto& index : indices)
+                    index = indexDistribution(rng);
+                sort(indices.begin(), indices.end());
+                for (auto index : indices)
+                    fprintf(file, " %u:%g", (unsigned int)index, valueDistribution(rng));
+            }
+            else
+            {
+                for (size_t k = 0; k < dimension; ++k)
+                    fprintf(file, " %g", valueDistribution(rng));
+            }
+            fprintf(file, "\n");
+        }
+    }
+    fclose(file);
+}
+
 struct CNTKTextFormatReaderFixture : ReaderFixture
 {
     CNTKTextFormatReaderFixture()
@@ -103,6 +181,28 @@ BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_Simple_dense)
         1);
 };
 
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_Simple_dense_prefetch_depth)
+{
+    // Reading several minibatches ahead must not change the data or the epoch boundaries.
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/CNTKTextFormatReader/dense.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/Simple_dense.txt",
+        testDataPath() + "/Control/CNTKTextFormatReader/Simple_dense_prefetch_depth_Output.txt",
+        "Simple",
+        "reader",
+        1000, // epoch size
+        250,  // mb size
+        10,   // num epochs
+        1,
+        1,
+        0,
+        1,
+        false,
+        false,
+        true,
+        { L"Simple=[reader=[prefetchDepth=4]]" });
+};
+
 BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_Simple_dense_single_stream)
 {
     HelperRunReaderTest<float>(
@@ -416,6 +516,87 @@ BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_20x10_MI_jagged_samples_sparse)
         true);
 };
 
+// Same as above, read from the binary format (sparse values and indices are not copied)
+BOOST_AUTO_TEST_CASE(CNTKBinaryFormatDeserializer_20x10_MI_jagged_samples_sparse)
+{
+    boost::filesystem::remove("20x10_MI_jagged_samples_sparse.bin");
+
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/CNTKTextFormatReader/sparse.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/20x10_MI_jagged_samples_sparse.txt",
+        testDataPath() + "/Control/CNTKTextFormatReader/20x10_MI_jagged_samples_binary_Output.txt",
+        "20x10_MI_jagged_samples_binary",
+        "reader",
+        200, // epoch size
+        200, // mb size
+        1, // num epochs
+        3,
+        0, // no labels
+        0,
+        1,
+        true);
+
+    boost::filesystem::remove("20x10_MI_jagged_samples_sparse.bin");
+};
+
+// Locations in the footer that point beyond the end of the file must be rejected when the file is opened
+BOOST_AUTO_TEST_CASE(CNTKBinaryFormatDeserializer_corrupt_offsets)
+{
+    const string binaryFile = "20x10_MI_jagged_samples_sparse.bin";
+    BOOST_SCOPE_EXIT(&binaryFile)
+    {
+        boost::filesystem::remove(binaryFile);
+    } BOOST_SCOPE_EXIT_END
+
+    boost::filesystem::remove(binaryFile);
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/CNTKTextFormatReader/sparse.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/20x10_MI_jagged_samples_sparse.txt",
+        testDataPath() + "/Control/CNTKTextFormatReader/20x10_MI_jagged_samples_binary_Output.txt",
+        "20x10_MI_jagged_samples_binary",
+        "reader",
+        200, // epoch size
+        200, // mb size
+        1, // num epochs
+        3,
+        0, // no labels
+        0,
+        1,
+        true);
+
+    std::vector<char> original;
+    {
+        std::ifstream file(binaryFile, std::ios::binary);
+        original.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    BinaryFileTrailer trailer;
+    memcpy(&trailer, original.data() + original.size() - sizeof(trailer), sizeof(trailer));
+    const size_t chunksOffset = trailer.m_footerOffset + sizeof(BinaryStreamHeader) * trailer.m_numStreams;
+    const size_t entriesOffset = chunksOffset + sizeof(BinaryChunkHeader) * trailer.m_numChunks + sizeof(BinarySequenceHeader) * trailer.m_numSequences;
+    const uint64_t beyondEnd = original.size() + 1;
+
+    // the values, indices and nnz counts of the first sequence, the sample dimension of the first stream, and the first chunk
+    for (size_t patchOffset : { entriesOffset + offsetof(BinarySequenceStreamEntry, m_valuesOffset),
+                                entriesOffset + offsetof(BinarySequenceStreamEntry, m_indicesOffset),
+                                entriesOffset + offsetof(BinarySequenceStreamEntry, m_nnzCountsOffset),
+                                trailer.m_footerOffset + offsetof(BinaryStreamHeader, m_sampleDimension),
+                                chunksOffset + offsetof(BinaryChunkHeader, m_offset) })
+    {
+        std::vector<char> corrupt = original;
+        const uint64_t value = patchOffset == trailer.m_footerOffset + offsetof(BinaryStreamHeader, m_sampleDimension) ? 0 : beyondEnd;
+        memcpy(corrupt.data() + patchOffset, &value, sizeof(value));
+        {
+            std::ofstream file(binaryFile, std::ios::binary | std::ios::trunc);
+            file.write(corrupt.data(), corrupt.size());
+        }
+
+        HelperRunReaderTestWithException<float, std::runtime_error>(
+            testDataPath() + "/Config/CNTKTextFormatReader/sparse.cntk",
+            "20x10_MI_jagged_samples_binary",
+            "reader");
+    }
+};
+
 // 50 sequences with up to 20 samples each (536 samples in total)
 BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_50x20_jagged_sequences_sparse)
 {
@@ -826,6 +1007,245 @@ BOOST_AUTO_TEST_CASE(CompositeCNTKTextFormatReader_5x5_and_5x10_jagged_minibatch
         false);
 };
 
+// Same data as above, read from the binary format
+BOOST_AUTO_TEST_CASE(CNTKBinaryFormatDeserializer_5x5_and_5x10_jagged_minibatch_10)
+{
+    // The binary files are created from the text files by the deserializer.
+    boost::filesystem::remove("5x10_jagged.bin");
+    boost::filesystem::remove("5x5_jagged.bin");
+
+    // Text output to compare with.
+    HelperRunReaderTest<double>(
+        testDataPath() + "/Config/CNTKTextFormatReader/dense.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/5x10_and_5x5_jagged_composite_Output.txt",
+        testDataPath() + "/Control/CNTKTextFormatReader/5x10_and_5x5_jagged_composite_Output.txt",
+        "5x10_and_5x5_jagged_composite",
+        "reader",
+        40,     // epoch size
+        10,     // mb size
+        3,      // num epochs
+        2,
+        0,
+        0,
+        1,
+        false,
+        false,
+        false);
+
+    // The first run converts the text files, the second one reads the existing binary files.
+    for (int i = 0; i < 2; ++i)
+    {
+        HelperRunReaderTest<double>(
+            testDataPath() + "/Config/CNTKTextFormatReader/dense.cntk",
+            testDataPath() + "/Control/CNTKTextFormatReader/5x10_and_5x5_jagged_composite_Output.txt",
+            testDataPath() + "/Control/CNTKTextFormatReader/5x10_and_5x5_jagged_binary_Output.txt",
+            "5x10_and_5x5_jagged_binary",
+            "reader",
+            40,     // epoch size
+            10,     // mb size
+            3,      // num epochs
+            2,
+            0,
+            0,
+            1,
+            false,
+            false,
+            false);
+
+        BOOST_CHECK(boost::filesystem::exists("5x10_jagged.bin"));
+    }
+
+    boost::filesystem::remove("5x10_jagged.bin");
+    boost::filesystem::remove("5x5_jagged.bin");
+};
+
+// The index built from ranges of the input in parallel must be identical to the sequential one,
+// also when sequences span several ranges.
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_parallel_index)
+{
+    for (string filename : { "50x20_jagged_sequences_dense.txt", "100x100_jagged_sequences_sparse.txt", "Simple_dense.txt",
+                             "contains_blank_lines.txt", "missing_trailing_newline.txt", "invalid_inputs.txt" })
+    {
+        for (bool skipSequenceIds : { false, true })
+        {
+            auto expected = BuildIndex(filename, skipSequenceIds, 0);
+            BOOST_REQUIRE(!expected.empty());
+            for (size_t numThreads : { 1, 2, 3, 16 })
+            {
+                auto actual = BuildIndex(filename, skipSequenceIds, numThreads);
+                BOOST_CHECK_MESSAGE(expected == actual, filename << ", " << numThreads << " threads, skipSequenceIds = " << skipSequenceIds);
+            }
+        }
+    }
+};
+
+// The index cache is reused while the input file is unchanged and rebuilt otherwise.
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_index_cache)
+{
+    const string filename = "index_cache.txt";
+    const wstring cacheFile = L"index_cache.txt.idx";
+    boost::filesystem::copy_file("50x20_jagged_sequences_dense.txt", filename, boost::filesystem::copy_option::overwrite_if_exists);
+    BOOST_SCOPE_EXIT(&filename, &cacheFile)
+    {
+        boost::filesystem::remove(filename);
+        boost::filesystem::remove(cacheFile);
+    } BOOST_SCOPE_EXIT_END
+
+    auto expected = BuildIndex(filename, false, 0);
+    BOOST_CHECK(expected == BuildIndex(filename, false, 2, cacheFile));
+    BOOST_REQUIRE(boost::filesystem::exists(cacheFile));
+    BOOST_CHECK(expected == BuildIndex(filename, false, 2, cacheFile));
+    BOOST_CHECK(expected == BuildIndex(filename, false, 1, cacheFile));
+
+    // the cache does not apply to a differently configured index
+    BOOST_CHECK(BuildIndex(filename, true, 0) == BuildIndex(filename, true, 2, cacheFile));
+    BOOST_CHECK(expected == BuildIndex(filename, false, 2, cacheFile));
+
+    // a changed input file invalidates the cache
+    {
+        ofstream file(filename, ios::app);
+        file << "50|F0 1 2 3\n";
+    }
+    expected = BuildIndex(filename, false, 0);
+    BOOST_CHECK_EQUAL(get<0>(expected.back()), 50);
+    BOOST_CHECK(expected == BuildIndex(filename, false, 2, cacheFile));
+};
+
+// Sequences parsed by several threads must be identical to the ones parsed sequentially.
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_parallel_parsing)
+{
+    for (bool sparse : { false, true })
+    {
+        const string filename = "parallel_parsing.txt";
+        GenerateTextFormatFile(filename, 100, 3, sparse ? 1000 : 10, 5, sparse);
+        BOOST_SCOPE_EXIT(&filename) { boost::filesystem::remove(filename); } BOOST_SCOPE_EXIT_END
+
+        vector<StreamDescriptor> streams(1);
+        streams[0].m_alias = "x";
+        streams[0].m_name = L"x";
+        streams[0].m_storageType = sparse ? StorageType::sparse_csc : StorageType::dense;
+        streams[0].m_sampleDimension = sparse ? 1000 : 10;
+
+        CNTKTextFormatReaderTestRunner<float> serial(filename, streams, 0, false, 1);
+        CNTKTextFormatReaderTestRunner<float> parallel(filename, streams, 0, false, 7);
+        serial.LoadChunk();
+        parallel.LoadChunk();
+
+        BOOST_REQUIRE_EQUAL(serial.GetNumberOfSequences(), 100);
+        for (size_t i = 0; i < serial.GetNumberOfSequences(); ++i)
+        {
+            auto expected = serial.GetSequence(i)[0];
+            auto actual = parallel.GetSequence(i)[0];
+            BOOST_REQUIRE_EQUAL(expected->m_numberOfSamples, actual->m_numberOfSamples);
+            if (sparse)
+            {
+                auto expectedSparse = static_cast<SparseSequenceData*>(expected.get());
+                auto actualSparse = static_cast<SparseSequenceData*>(actual.get());
+                BOOST_REQUIRE_EQUAL(expectedSparse->m_totalNnzCount, actualSparse->m_totalNnzCount);
+                BOOST_CHECK(expectedSparse->m_nnzCounts == actualSparse->m_nnzCounts);
+                BOOST_CHECK(equal(expectedSparse->m_indices, expectedSparse->m_indices + expectedSparse->m_totalNnzCount, actualSparse->m_indices));
+            }
+            size_t count = sparse ? static_cast<SparseSequenceData*>(expected.get())->m_totalNnzCount : 10 * expected->m_numberOfSamples;
+            auto expectedValues = static_cast<const float*>(expected->GetDataBuffer());
+            auto actualValues = static_cast<const float*>(actual->GetDataBuffer());
+            BOOST_CHECK(equal(expectedValues, expectedValues + count, actualValues));
+        }
+    }
+};
+
+// Chunks read ahead by several threads (whose GetChunk calls the parser serializes) must yield the same data as a single thread.
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_read_ahead_threads)
+{
+    string singleThreadOutput = testDataPath() + "/Control/CNTKTextFormatReader/100x100_jagged_sparse_read_ahead_1_Output.txt";
+    string multiThreadOutput = testDataPath() + "/Control/CNTKTextFormatReader/100x100_jagged_sparse_read_ahead_4_Output.txt";
+    BOOST_SCOPE_EXIT(&singleThreadOutput, &multiThreadOutput)
+    {
+        boost::filesystem::remove(singleThreadOutput);
+        boost::filesystem::remove(multiThreadOutput);
+    } BOOST_SCOPE_EXIT_END
+
+    // small chunks and a window of a few chunks, so that several chunks are read ahead at a time
+    for (auto numThreads : { 1, 4 })
+    {
+        HelperReadInAndWriteOut<float>(
+            testDataPath() + "/Config/CNTKTextFormatReader/sparse.cntk",
+            numThreads == 1 ? singleThreadOutput : multiThreadOutput,
+            "100x100_jagged",
+            "reader",
+            4887, // epoch size
+            500,  // mb size
+            3,    // num epochs
+            1,
+            0,
+            0,
+            1,
+            true,
+            false,
+            true,
+            { L"100x100_jagged=[reader=[randomize=true;chunkSizeInBytes=30000;randomizationWindow=1000;readAheadChunks=4;numReadAheadThreads=" + to_wstring(numThreads) + L"]]" });
+    }
+
+    CheckFilesEquivalent(singleThreadOutput, multiThreadOutput);
+};
+
+// Values are rounded to the nearest float/double, as by strtof/strtod.
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_correctly_rounded_values)
+{
+    vector<string> values =
+    {
+        "0", "-0", "1", "-1.5", "0.1", "3.14159265358979323846", "1e-5", "2.5E+10", "1.7976931348623157e308",
+        "4.9406564584124654e-324", "1.175494351e-38", "3.4028234e38", "123456789012345678901234567890",
+        "0.000000000000000000000000000001", "9007199254740993", "1.00000005960464477539062500001",
+        "7.038531e-26", "0.5000000000000000277555756156289135105907917022705078125",
+        // longer than the parser's 64 character buffer
+        "1.0000000596046447753906250000000000000000000000000000000000000000000000000001",
+        "-0.000000000000000000000000000000000000000000000000000000000000000000000000012345678901234567890123e75",
+        "12345678901234567890123456789012345678901234567890123456789012345678901234567890e-70",
+    };
+
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<double> mantissaDistribution(-1., 1.);
+    std::uniform_int_distribution<int> exponentDistribution(-40, 40);
+    for (size_t i = 0; i < 200; ++i)
+    {
+        char buffer[64];
+        sprintf(buffer, (i % 2) ? "%.9g" : "%.17g", ldexp(mantissaDistribution(rng), exponentDistribution(rng)));
+        values.push_back(buffer);
+    }
+
+    const string filename = "correctly_rounded_values.txt";
+    {
+        ofstream file(filename);
+        file << "|x";
+        for (const auto& value : values)
+            file << " " << value;
+        file << "\n";
+    }
+    BOOST_SCOPE_EXIT(&filename) { boost::filesystem::remove(filename); } BOOST_SCOPE_EXIT_END
+
+    vector<StreamDescriptor> streams(1);
+    streams[0].m_alias = "x";
+    streams[0].m_name = L"x";
+    streams[0].m_storageType = StorageType::dense;
+    streams[0].m_sampleDimension = values.size();
+
+    CNTKTextFormatReaderTestRunner<float> floatRunner(filename, streams, 0, false);
+    floatRunner.LoadChunk();
+    auto floats = static_cast<const float*>(floatRunner.GetSequence(0)[0]->GetDataBuffer());
+
+    CNTKTextFormatReaderTestRunner<double> doubleRunner(filename, streams, 0, false);
+    doubleRunner.LoadChunk();
+    auto doubles = static_cast<const double*>(doubleRunner.GetSequence(0)[0]->GetDataBuffer());
+
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        float expectedFloat = strtof(values[i].c_str(), nullptr);
+        double expectedDouble = strtod(values[i].c_str(), nullptr);
+        BOOST_CHECK_MESSAGE(memcmp(&floats[i], &expectedFloat, sizeof(float)) == 0, values[i] << " (float)");
+        BOOST_CHECK_MESSAGE(memcmp(&doubles[i], &expectedDouble, sizeof(double)) == 0, values[i] << " (double)");
+    }
+};
+
 BOOST_AUTO_TEST_CASE(CNTKTextFormatReaderNoFirstMinibatchData)
 {
     HelperRunReaderTest<double>(
@@ -4,6 +4,7 @@
 //
 #include "stdafx.h"
 #include "Common/ReaderTestHelper.h"
+#include "../../../Source/Readers/HTKDeserializers/MLFLabelArchive.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -815,6 +816,268 @@ BOOST_AUTO_TEST_CASE(HTKIVectorBptt)
 
 BOOST_AUTO_TEST_SUITE_END()
 
+// Writes a small HTK archive in the machine byte order, which the AN4 archives (big-endian) are not, so that the
+// HTKDeserializers can memory map it. Also writes its script, MLF and state list.
+struct HTKMemoryMapFixture : ReaderFixture
+{
+    HTKMemoryMapFixture()
+        : ReaderFixture("/Data")
+    {
+        const int dimension = 4;
+        const int numberOfFrames[] = { 10, 7, 12 };
+        int totalNumberOfFrames = 0;
+        for (int frames : numberOfFrames)
+            totalNumberOfFrames += frames;
+
+        // HTK header: number of frames, sample period (100ns), bytes per frame and kind (USER).
+        FILE* archive = fopenOrDie(L"HTKDeserializersMemoryMap.htk", L"wb");
+        int32_t samplePeriod = 100000;
+        uint16_t sampleSize = dimension * sizeof(float);
+        int16_t sampleKind = 9;
+        fwriteOrDie(&totalNumberOfFrames, sizeof(totalNumberOfFrames), 1, archive);
+        fwriteOrDie(&samplePeriod, sizeof(samplePeriod), 1, archive);
+        fwriteOrDie(&sampleSize, sizeof(sampleSize), 1, archive);
+        fwriteOrDie(&sampleKind, sizeof(sampleKind), 1, archive);
+
+        FILE* script = fopenOrDie(L"HTKDeserializersMemoryMap.scp", L"wb");
+        FILE* mlf = fopenOrDie(L"HTKDeserializersMemoryMap.mlf", L"wb");
+        fprintf(mlf, "#!MLF!#\n");
+        int firstFrame = 0;
+        for (int u = 0; u < _countof(numberOfFrames); u++)
+        {
+            for (int t = 0; t < numberOfFrames[u]; t++)
+            {
+                for (int d = 0; d < dimension; d++)
+                {
+                    float value = 100.0f * u + t + 0.25f * d;
+                    fwriteOrDie(&value, sizeof(value), 1, archive);
+                }
+            }
+            fprintf(script, "utterance%d.mfc=HTKDeserializersMemoryMap.htk[%d,%d]\n", u, firstFrame, firstFrame + numberOfFrames[u] - 1);
+
+            // two labels per utterance, times in 100ns
+            int half = numberOfFrames[u] / 2;
+            fprintf(mlf, "\"utterance%d.lab\"\n", u);
+            fprintf(mlf, "0 %d s%d\n", half * samplePeriod, u % 3);
+            fprintf(mlf, "%d %d s%d\n", half * samplePeriod, numberOfFrames[u] * samplePeriod, (u + 1) % 3);
+            fprintf(mlf, ".\n");
+            firstFrame += numberOfFrames[u];
+        }
+        fclose(archive);
+        fclose(script);
+        fclose(mlf);
+
+        FILE* stateList = fopenOrDie(L"HTKDeserializersMemoryMap.statelist", L"wb");
+        fprintf(stateList, "s0\ns1\ns2\n");
+        fclose(stateList);
+    }
+
+    ~HTKMemoryMapFixture()
+    {
+        for (auto name : { "HTKDeserializersMemoryMap.htk", "HTKDeserializersMemoryMap.scp", "HTKDeserializersMemoryMap.mlf",
+                           "HTKDeserializersMemoryMap.statelist", "HTKDeserializersMemoryMap_Output.txt", "HTKDeserializersMemoryMap_NoMap_Output.txt" })
+            boost::filesystem::remove(name);
+    }
+
+    // Reads with the given overrides of the reader and feature sections, with and without memory mapping,
+    // and compares the minibatches.
+    void CheckMemoryMappedEqualsRead(const std::wstring& readerOverrides, const std::wstring& featureOverrides, size_t epochSize, size_t mbSize)
+    {
+        for (bool memoryMap : { true, false })
+        {
+            HelperReadInAndWriteOut<float>(
+                testDataPath() + "/Config/HTKDeserializersMemoryMap_Config.cntk",
+                memoryMap ? "HTKDeserializersMemoryMap_Output.txt" : "HTKDeserializersMemoryMap_NoMap_Output.txt",
+                "Simple_Test",
+                "reader",
+                epochSize,
+                mbSize,
+                2,
+                1,
+                1,
+                0,
+                1,
+                false,
+                false,
+                true,
+                { L"Simple_Test=[reader=[" + readerOverrides + L"features=[" + featureOverrides + L"memoryMap=" + (memoryMap ? L"true" : L"false") + L"]]]" });
+        }
+
+        BOOST_REQUIRE(boost::filesystem::file_size("HTKDeserializersMemoryMap_Output.txt") > 0);
+        CheckFilesEquivalent("HTKDeserializersMemoryMap_Output.txt", "HTKDeserializersMemoryMap_NoMap_Output.txt");
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(HTKMemoryMapSuite, HTKMemoryMapFixture)
+
+BOOST_AUTO_TEST_CASE(HTKDeserializersMemoryMapFrameMode)
+{
+    CheckMemoryMappedEqualsRead(L"", L"", 29, 8);
+}
+
+BOOST_AUTO_TEST_CASE(HTKDeserializersMemoryMapSequenceMode)
+{
+    CheckMemoryMappedEqualsRead(L"frameMode=false;", L"", 29, 20);
+}
+
+BOOST_AUTO_TEST_CASE(HTKDeserializersMemoryMapContext)
+{
+    // symmetric and asymmetric windows, the frames are augmented from the mapping
+    CheckMemoryMappedEqualsRead(L"", L"contextWindow=3;", 29, 8);
+    CheckMemoryMappedEqualsRead(L"frameMode=false;", L"contextWindow=1:2;", 29, 20);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+// The label archive does not need external data, the MLF files are written by the tests.
+struct MLFLabelArchiveFixture
+{
+    MLFLabelArchiveFixture()
+        : m_mlfPath(L"MLFLabelArchive_test.mlf"), m_archivePath(L"MLFLabelArchive_test.mlf.labelcache")
+    {
+    }
+
+    ~MLFLabelArchiveFixture()
+    {
+        _wunlink(m_mlfPath.c_str());
+        _wunlink(m_archivePath.c_str());
+    }
+
+    // Writes an MLF file in the 4-column format (start and end time, state name, class id), times are in 100ns.
+    void WriteMlf(const std::string& content)
+    {
+        FILE* f = fopenOrDie(m_mlfPath, L"wb");
+        fputs(content.c_str(), f);
+        fclose(f);
+    }
+
+    // Expands the labels of the utterance into the class id of each frame.
+    static std::vector<uint32_t> ExpandLabels(const MLFLabelArchive& archive, const MLFLabelArchive::Utterance& utterance)
+    {
+        std::vector<uint32_t> labels;
+        for (auto run = archive.GetRuns() + utterance.m_firstRun; labels.size() < utterance.m_numberOfFrames; ++run)
+            labels.insert(labels.end(), run->m_numberOfFrames, run->m_classId);
+        return labels;
+    }
+
+    static void CheckEqual(const MLFLabelArchive& expected, const MLFLabelArchive& actual)
+    {
+        BOOST_REQUIRE_EQUAL(expected.GetNumberOfUtterances(), actual.GetNumberOfUtterances());
+        for (size_t i = 0; i < expected.GetNumberOfUtterances(); ++i)
+        {
+            const auto& expectedUtterance = expected.GetUtterance(i);
+            const auto& actualUtterance = actual.GetUtterance(i);
+            BOOST_CHECK_EQUAL(expected.GetKey(expectedUtterance), actual.GetKey(actualUtterance));
+            BOOST_REQUIRE_EQUAL(expectedUtterance.m_numberOfFrames, actualUtterance.m_numberOfFrames);
+            auto expectedLabels = ExpandLabels(expected, expectedUtterance);
+            auto actualLabels = ExpandLabels(actual, actualUtterance);
+            BOOST_CHECK_EQUAL_COLLECTIONS(expectedLabels.begin(), expectedLabels.end(), actualLabels.begin(), actualLabels.end());
+        }
+    }
+
+    const std::wstring m_mlfPath;
+    const std::wstring m_archivePath;
+};
+
+static const char* const c_testMlf =
+    "#!MLF!#\n"
+    "\"utterance1.lab\"\n"
+    "0 200000 s2 2\n"
+    "200000 300000 s2 2\n"
+    "300000 600000 s7 7\n"
+    ".\n"
+    "\"utterance2.lab\"\n"
+    "0 100000 s0 0\n"
+    "100000 300000 s5 5\n"
+    "300000 400000 s0 0\n"
+    ".\n";
+
+BOOST_FIXTURE_TEST_SUITE(MLFLabelArchiveSuite, MLFLabelArchiveFixture)
+
+BOOST_AUTO_TEST_CASE(MLFLabelArchiveMatchesParsedLabels)
+{
+    WriteMlf(c_testMlf);
+    std::vector<std::wstring> sources = { m_mlfPath };
+    auto parsed = MLFLabelArchive::Parse(sources, L"");
+
+    // Consecutive entries of the same class are merged into one run.
+    BOOST_REQUIRE_EQUAL(parsed->GetNumberOfUtterances(), (size_t)2);
+    const auto& first = parsed->GetUtterance(0);
+    BOOST_CHECK_EQUAL(parsed->GetKey(first), "utterance1");
+    auto labels = ExpandLabels(*parsed, first);
+    std::vector<uint32_t> expectedLabels = { 2, 2, 2, 7, 7, 7 };
+    BOOST_CHECK_EQUAL_COLLECTIONS(labels.begin(), labels.end(), expectedLabels.begin(), expectedLabels.end());
+    const auto& second = parsed->GetUtterance(1);
+    BOOST_CHECK_EQUAL(parsed->GetKey(second), "utterance2");
+    labels = ExpandLabels(*parsed, second);
+    expectedLabels = { 0, 5, 5, 0 };
+    BOOST_CHECK_EQUAL_COLLECTIONS(labels.begin(), labels.end(), expectedLabels.begin(), expectedLabels.end());
+
+    BOOST_REQUIRE(parsed->Write(m_archivePath, sources));
+    auto loaded = MLFLabelArchive::Load(m_archivePath, sources);
+    BOOST_REQUIRE(loaded != nullptr);
+    CheckEqual(*parsed, *loaded);
+}
+
+BOOST_AUTO_TEST_CASE(MLFLabelArchiveStaleAfterMlfChange)
+{
+    WriteMlf(c_testMlf);
+    std::vector<std::wstring> sources = { m_mlfPath };
+    BOOST_REQUIRE(MLFLabelArchive::Parse(sources, L"")->Write(m_archivePath, sources));
+
+    // Same size, and possibly the same modification time, only the checksum differs.
+    std::string changedMlf = c_testMlf;
+    changedMlf.replace(changedMlf.find("s7 7"), 4, "s8 8");
+    WriteMlf(changedMlf);
+    BOOST_CHECK(MLFLabelArchive::Load(m_archivePath, sources) == nullptr);
+
+    // Rebuilding the archive picks up the new labels.
+    auto parsed = MLFLabelArchive::Parse(sources, L"");
+    BOOST_REQUIRE(parsed->Write(m_archivePath, sources));
+    auto loaded = MLFLabelArchive::Load(m_archivePath, sources);
+    BOOST_REQUIRE(loaded != nullptr);
+    CheckEqual(*parsed, *loaded);
+    BOOST_CHECK_EQUAL(ExpandLabels(*loaded, loaded->GetUtterance(0)).back(), 8u);
+}
+
+BOOST_AUTO_TEST_CASE(MLFLabelArchiveCorruptFile)
+{
+    WriteMlf(c_testMlf);
+    std::vector<std::wstring> sources = { m_mlfPath };
+    BOOST_REQUIRE(MLFLabelArchive::Parse(sources, L"")->Write(m_archivePath, sources));
+
+    std::vector<char> archive;
+    {
+        FILE* f = fopenOrDie(m_archivePath, L"rb");
+        archive.resize(filesize(f));
+        freadOrDie(archive.data(), 1, archive.size(), f);
+        fclose(f);
+    }
+    auto writeArchive = [&](size_t size)
+    {
+        FILE* f = fopenOrDie(m_archivePath, L"wb");
+        fwriteOrDie(archive.data(), 1, size, f);
+        fclose(f);
+    };
+
+    // A truncated archive is not used, so that the deserializer parses the MLF files instead.
+    for (size_t size : { (size_t)16, archive.size() / 2, archive.size() - 1 })
+    {
+        writeArchive(size);
+        BOOST_CHECK(MLFLabelArchive::Load(m_archivePath, sources) == nullptr);
+    }
+
+    // Neither is one whose utterances point past the runs (the first run index of the second utterance).
+    // Layout: 40 bytes of header, 24 bytes per source and per utterance, the first run index is at offset 16.
+    const size_t firstRunOffset = 40 + 24 + 24 + 16;
+    uint64_t firstRun = 1000;
+    memcpy(archive.data() + firstRunOffset, &firstRun, sizeof(firstRun));
+    writeArchive(archive.size());
+    BOOST_CHECK(MLFLabelArchive::Load(m_archivePath, sources) == nullptr);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
 }
 
 }}}
@@ -36,6 +36,27 @@ BOOST_AUTO_TEST_CASE(ImageReaderSimple)
         1);
 }
 
+BOOST_AUTO_TEST_CASE(ImageReaderSimpleUnfused)
+{
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/ImageReaderSimple_Config.cntk",
+        testDataPath() + "/Control/ImageReaderSimple_Control.txt",
+        testDataPath() + "/Control/ImageReaderSimpleUnfused_Output.txt",
+        "Simple_Test",
+        "reader",
+        4,
+        4,
+        1,
+        1,
+        0,
+        0,
+        1,
+        false,
+        false,
+        true,
+        { L"FuseTransforms=false" });
+}
+
 BOOST_AUTO_TEST_CASE(ImageAndTextReaderSimple)
 {
     HelperRunReaderTest<float>(
@@ -277,6 +298,37 @@ BOOST_AUTO_TEST_CASE(ImageReaderEmptyTransforms)
         1);
 }
 
+BOOST_AUTO_TEST_CASE(ImageReaderFusedTransforms)
+{
+    // The output of the separate crop, scale, mean and transpose transforms is the control for the fused one.
+    HelperReadInAndWriteOut<float>(
+        testDataPath() + "/Config/ImageTransforms_Config.cntk",
+        testDataPath() + "/Control/ImageReaderUnfusedTransforms_Output.txt",
+        "UnfusedTransforms_Test",
+        "reader",
+        2,
+        1,
+        1,
+        1,
+        0,
+        0,
+        1);
+
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/ImageTransforms_Config.cntk",
+        testDataPath() + "/Control/ImageReaderUnfusedTransforms_Output.txt",
+        testDataPath() + "/Control/ImageReaderFusedTransforms_Output.txt",
+        "FusedTransforms_Test",
+        "reader",
+        2,
+        1,
+        1,
+        1,
+        0,
+        0,
+        1);
+}
+
 BOOST_AUTO_TEST_CASE(ImageReaderInvalidEmptyTransforms)
 {
     BOOST_REQUIRE_EXCEPTION(
@@ -10,6 +10,8 @@
 #include "NoRandomizer.h"
 #include "DataDeserializer.h"
 #include "BlockRandomizer.h"
+#include "ChunkCache.h"
+#include "LengthBucketer.h"
 #include "CorpusDescriptor.h"
 #include "SequentialDeserializer.h"
 
@@ -273,6 +275,41 @@ BOOST_AUTO_TEST_CASE(CheckSetCurrentCursorForRandomizers)
     test(expectedNo, unterTestNo, epochSize);
 }
 
+BOOST_AUTO_TEST_CASE(BlockRandomizerReadAheadDoesNotChangeOrder)
+{
+    size_t chunkSizeInSamples = 10000;
+    size_t sweepNumberOfSamples = 500000;
+    uint32_t maxSequenceLength = 300;
+    size_t randomizationWindow = chunkSizeInSamples * 5;
+    auto deserializer = make_shared<SequentialDeserializer>(0, chunkSizeInSamples, sweepNumberOfSamples, maxSequenceLength);
+
+    auto expected = make_shared<BlockRandomizer>(0, randomizationWindow, deserializer, true, BlockRandomizer::DecimationMode::chunk, false);
+
+    // Several chunks ahead, loaded concurrently (the sequential deserializer supports concurrent loads).
+    auto readAhead = make_shared<BlockRandomizer>(0, randomizationWindow, deserializer, true, BlockRandomizer::DecimationMode::chunk, false, false,
+                                                  8, 0, 3);
+
+    // Several chunks ahead, but limited by size to a single one at a time.
+    auto limited = make_shared<BlockRandomizer>(0, randomizationWindow, deserializer, true, BlockRandomizer::DecimationMode::chunk, false, false,
+                                                8, 1, 2);
+
+    // Epochs cross the sweep boundary.
+    size_t epochSize = (size_t)(sweepNumberOfSamples / 1.5);
+    for (size_t epoch = 0; epoch < 3; ++epoch)
+    {
+        auto expectedEpoch = ReadFullEpoch(expected, epochSize, epoch);
+        auto readAheadEpoch = ReadFullEpoch(readAhead, epochSize, epoch);
+        auto limitedEpoch = ReadFullEpoch(limited, epochSize, epoch);
+        BOOST_CHECK_EQUAL_COLLECTIONS(expectedEpoch.begin(), expectedEpoch.end(), readAheadEpoch.begin(), readAheadEpoch.end());
+        BOOST_CHECK_EQUAL_COLLECTIONS(expectedEpoch.begin(), expectedEpoch.end(), limitedEpoch.begin(), limitedEpoch.end());
+    }
+
+    // Rereading an earlier epoch releases the chunks read ahead for the later one.
+    auto expectedFirst = ReadFullEpoch(expected, epochSize, 0);
+    auto readAheadFirst = ReadFullEpoch(readAhead, epochSize, 0);
+    BOOST_CHECK_EQUAL_COLLECTIONS(expectedFirst.begin(), expectedFirst.end(), readAheadFirst.begin(), readAheadFirst.end());
+}
+
 BOOST_AUTO_TEST_CASE(RandRollbackToEarlierEpochBetweenSweeps)
 {
     size_t chunkSizeInSamples = 10000;
@@ -682,6 +719,117 @@ BOOST_AUTO_TEST_CASE(NoRandomizerOneEpoch)
                                   actual.begin(), actual.end());
 }
 
+BOOST_AUTO_TEST_CASE(ChunkCacheUnlimited)
+{
+    vector<float> data(10);
+    iota(data.begin(), data.end(), 0.0f);
+    auto mockDeserializer = make_shared<MockDeserializer>(5, 2, data);
+    auto cache = make_shared<ChunkCache>(mockDeserializer);
+    cache->GetChunkDescriptions();
+
+    vector<ChunkPtr> chunks;
+    for (ChunkIdType i = 0; i < 5; ++i)
+        chunks.push_back(cache->GetChunk(i));
+
+    // all chunks stay cached
+    for (ChunkIdType i = 0; i < 5; ++i)
+        BOOST_CHECK(cache->GetChunk(i) == chunks[i]);
+}
+
+BOOST_AUTO_TEST_CASE(ChunkCacheEvictsLeastRecentlyUsed)
+{
+    vector<float> data(10);
+    iota(data.begin(), data.end(), 0.0f);
+    auto mockDeserializer = make_shared<MockDeserializer>(5, 2, data);
+
+    // The mock chunk descriptions do not give a size, so it is measured:
+    // 2 sequences of 1 float sample each, i.e. 8 bytes per chunk. The budget fits 2 chunks.
+    auto cache = make_shared<ChunkCache>(mockDeserializer, 2 * 2 * sizeof(float));
+    cache->GetChunkDescriptions();
+
+    auto chunk0 = cache->GetChunk(0);
+    auto chunk1 = cache->GetChunk(1);
+    BOOST_CHECK(cache->GetChunk(0) == chunk0); // hit, chunk 1 is now the least recently used
+
+    auto chunk2 = cache->GetChunk(2);          // evicts chunk 1
+    BOOST_CHECK(cache->GetChunk(0) == chunk0);
+    BOOST_CHECK(cache->GetChunk(2) == chunk2);
+    BOOST_CHECK(cache->GetChunk(1) != chunk1); // reloaded, evicts chunk 0
+    BOOST_CHECK(cache->GetChunk(2) == chunk2);
+    BOOST_CHECK(cache->GetChunk(0) != chunk0);
+
+    // The loaded data is the same regardless of caching.
+    vector<SequenceDataPtr> sequences;
+    cache->GetChunk(1)->GetSequence(3, sequences);
+    BOOST_REQUIRE_EQUAL(sequences.size(), 1u);
+    BOOST_CHECK_EQUAL(*(const float*)sequences[0]->GetDataBuffer(), 3.0f);
+}
+
+BOOST_AUTO_TEST_CASE(LengthBucketerOneEpoch)
+{
+    size_t chunkSizeInSamples = 10000;
+    size_t sweepNumberOfSamples = 200000;
+    uint32_t maxSequenceLength = 300;
+    size_t minibatchSize = 2000;
+    auto deserializer = make_shared<SequentialDeserializer>(0, chunkSizeInSamples, sweepNumberOfSamples, maxSequenceLength);
+
+    auto randomizer = make_shared<BlockRandomizer>(0, chunkSizeInSamples * 5, deserializer, true, BlockRandomizer::DecimationMode::chunk, false);
+    auto bucketer = make_shared<LengthBucketer>(randomizer, 10);
+
+    EpochConfiguration config;
+    config.m_numberOfWorkers = 1;
+    config.m_workerRank = 0;
+    config.m_minibatchSizeInSamples = minibatchSize;
+    config.m_totalEpochSizeInSamples = sweepNumberOfSamples;
+    config.m_epochIndex = 0;
+
+    // Padding is the difference between the samples a packed minibatch allocates
+    // (the longest sequence times the number of sequences) and the actual samples.
+    auto readEpoch = [&](SequenceEnumeratorPtr enumerator, size_t& padding)
+    {
+        enumerator->StartEpoch(config);
+        vector<float> epoch;
+        padding = 0;
+        for (;;)
+        {
+            auto sequences = enumerator->GetNextSequences(minibatchSize);
+            if (!sequences.m_data.empty())
+            {
+                size_t samples = 0, maxLength = 0;
+                for (const auto& s : sequences.m_data[0])
+                {
+                    const float* data = (const float*)s->GetDataBuffer();
+                    epoch.insert(epoch.end(), data, data + s->m_numberOfSamples);
+                    samples += s->m_numberOfSamples;
+                    maxLength = max(maxLength, (size_t)s->m_numberOfSamples);
+                }
+                BOOST_CHECK(samples <= minibatchSize || sequences.m_data[0].size() == 1);
+                padding += maxLength * sequences.m_data[0].size() - samples;
+            }
+
+            if (sequences.m_endOfEpoch)
+                break;
+        }
+        return epoch;
+    };
+
+    size_t expectedPadding, bucketedPadding;
+    auto expected = readEpoch(randomizer, expectedPadding);
+    auto bucketed = readEpoch(bucketer, bucketedPadding);
+
+    // The same sequences, in a different order and with less padding.
+    BOOST_CHECK(CheckFullSweep(sweepNumberOfSamples, bucketed));
+    sort(expected.begin(), expected.end());
+    sort(bucketed.begin(), bucketed.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), bucketed.begin(), bucketed.end());
+    BOOST_CHECK_LT(bucketedPadding * 4, expectedPadding);
+
+    // The order is reproducible.
+    auto first = readEpoch(bucketer, bucketedPadding);
+    auto second = readEpoch(bucketer, bucketedPadding);
+    BOOST_CHECK_EQUAL_COLLECTIONS(first.begin(), first.end(), second.begin(), second.end());
+}
+
 BOOST_AUTO_TEST_CASE(DefaultCorpusDescriptor)
 {
     const int seed = 13;
@@ -31,7 +31,7 @@ namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
     class SequentialDeserializer : public IDataDeserializer
     {
     public:
-        struct SequentialChunk : Chunk
+        struct SequentialChunk : Chunk, std::enable_shared_from_this<Chunk>
         {
             std::vector<std::vector<float>> m_data;
             size_t m_sizeInSamples;
@@ -73,6 +73,8 @@ namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
                 s->m_data = (void*)&data[0];
                 s->m_numberOfSamples = (uint32_t)data.size();
                 s->m_sampleLayout = m_sampleLayout;
+                // the data points into the chunk, keep it alive as long as the sequence is
+                s->m_chunk = shared_from_this();
                 result.push_back(s);
             }
         };
@@ -169,7 +171,7 @@ namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
             for (size_t i = 0; i < m_chunks.size(); ++i)
             {
                 result.push_back(std::make_shared<ChunkDescription>(
-                    ChunkDescription{ (ChunkIdType)i, m_chunks[i]->SizeInSamples(), m_chunks[i]->SizeInSequences() }));
+                    ChunkDescription{ (ChunkIdType)i, m_chunks[i]->SizeInSamples(), m_chunks[i]->SizeInSequences(), m_chunks[i]->SizeInSamples() * sizeof(float) }));
             }
             return result;
         }
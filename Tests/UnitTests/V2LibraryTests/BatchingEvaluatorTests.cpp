@@ -0,0 +1,105 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "CNTKLibrary.h"
+#include "CNTKLibraryExperimental.h"
+#include <functional>
+#include "Common.h"
+
+using namespace CNTK;
+using namespace CNTK::Experimental;
+
+template <typename ElementType>
+std::vector<ElementType> CopyToVector(const ValuePtr& value)
+{
+    auto cpuData = value->Data()->DeepClone(DeviceDescriptor::CPUDevice(), true);
+    const ElementType* dataBuffer = cpuData->DataBuffer<ElementType>();
+    return std::vector<ElementType>(dataBuffer, dataBuffer + cpuData->Shape().TotalSize());
+}
+
+template <typename ElementType>
+void TestBatchingEvaluator(const DeviceDescriptor& device)
+{
+    const size_t inputDim = 16;
+    const size_t cellDim = 12;
+    const size_t hiddenDim = 8;
+    const size_t numOutputClasses = 5;
+    const size_t numRequests = 24;
+    const size_t maxAllowedSequenceLength = 9;
+
+    auto features = InputVariable({ inputDim }, AsDataType<ElementType>(), L"features");
+    auto pastValueRecurrenceHook = [](const Variable& x) { return PastValue(x); };
+    auto LSTMOutput = LSTMPComponentWithSelfStabilization<ElementType>(features, { hiddenDim }, { cellDim }, pastValueRecurrenceHook, pastValueRecurrenceHook, device).first;
+    auto W = Parameter(NDArrayView::RandomUniform<ElementType>({ numOutputClasses, hiddenDim }, -0.5, 0.5, 1, device));
+    auto b = Parameter({ numOutputClasses }, (ElementType)0.1, device);
+    auto perStepOutput = Plus(Times(W, LSTMOutput), b, L"perStepOutput");
+    auto lastStepOutput = Sequence::Last(perStepOutput, L"lastStepOutput");
+    auto model = Combine({ perStepOutput, lastStepOutput });
+
+    srand(3);
+    auto sequenceLengths = GenerateSequenceLengths(numRequests, maxAllowedSequenceLength);
+    auto sequences = GenerateSequences<ElementType>(sequenceLengths, features.Shape());
+    auto sequenceValue = [&](size_t i) {
+        NDShape sequenceShape = features.Shape().AppendShape({ sequenceLengths[i], 1 });
+        return MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(sequenceShape, sequences[i].data(), sequences[i].size(), DeviceDescriptor::CPUDevice(), true));
+    };
+
+    // Reference: evaluate each sequence separately
+    std::vector<std::vector<ElementType>> expectedPerStepOutputs, expectedLastStepOutputs;
+    for (size_t i = 0; i < numRequests; ++i)
+    {
+        std::unordered_map<Variable, ValuePtr> outputs = { { perStepOutput, nullptr }, { lastStepOutput, nullptr } };
+        model->Forward({ { features, MakeSharedObject<Value>(sequenceValue(i)->Data()->DeepClone(device, true)) } }, outputs, device);
+        expectedPerStepOutputs.push_back(CopyToVector<ElementType>(outputs[perStepOutput]));
+        expectedLastStepOutputs.push_back(CopyToVector<ElementType>(outputs[lastStepOutput]));
+    }
+
+    BatchingEvaluatorConfig config;
+    config.m_maxBatchSizeInSequences = 8;
+    config.m_maxWaitTimeInMicroseconds = 100000;
+    config.m_device = device;
+    auto evaluator = CreateBatchingEvaluator(model, { perStepOutput, lastStepOutput }, config);
+
+    std::vector<std::future<std::unordered_map<Variable, ValuePtr>>> results;
+    for (size_t i = 0; i < numRequests; ++i)
+        results.push_back(evaluator->Evaluate({ { features, sequenceValue(i) } }));
+
+    for (size_t i = 0; i < numRequests; ++i)
+    {
+        auto outputs = results[i].get();
+        if (outputs[perStepOutput]->Shape() != NDShape({ numOutputClasses, sequenceLengths[i], 1 }))
+            ReportFailure("BatchingEvaluator: Unexpected shape of the per step output of request %d", (int)i);
+
+        FloatingPointVectorCompare(CopyToVector<ElementType>(outputs[perStepOutput]), expectedPerStepOutputs[i], "BatchingEvaluator: per step output does not match the separately evaluated sequence");
+        FloatingPointVectorCompare(CopyToVector<ElementType>(outputs[lastStepOutput]), expectedLastStepOutputs[i], "BatchingEvaluator: last step output does not match the separately evaluated sequence");
+    }
+
+    auto statistics = evaluator->GetStatistics();
+    if (statistics.m_numRequests != numRequests)
+        ReportFailure("BatchingEvaluator: Expected %d completed requests, found %d", (int)numRequests, (int)statistics.m_numRequests);
+
+    if ((statistics.m_maxBatchSizeInSequences < 2) || (statistics.m_maxBatchSizeInSequences > config.m_maxBatchSizeInSequences))
+        ReportFailure("BatchingEvaluator: Unexpected maximum batch size %d", (int)statistics.m_maxBatchSizeInSequences);
+
+    if (statistics.m_p50LatencyInMilliseconds > statistics.m_p99LatencyInMilliseconds || statistics.m_p99LatencyInMilliseconds > statistics.m_maxLatencyInMilliseconds)
+        ReportFailure("BatchingEvaluator: Inconsistent latency percentiles");
+
+    fprintf(stderr, "BatchingEvaluator: %d requests in %d batches (average %.1f sequences), p50 latency %.2f ms, p99 latency %.2f ms\n",
+            (int)statistics.m_numRequests, (int)statistics.m_numBatches, statistics.m_averageBatchSizeInSequences,
+            statistics.m_p50LatencyInMilliseconds, statistics.m_p99LatencyInMilliseconds);
+
+    // A request must contain a single sequence
+    VerifyException([&]() {
+        evaluator->Evaluate({ { features, Value::Create(features.Shape(), std::vector<std::vector<ElementType>>({ sequences[0], sequences[1] }), device, true) } });
+    }, "BatchingEvaluator: Was able to submit a request containing multiple sequences");
+}
+
+void BatchingEvaluatorTests()
+{
+    fprintf(stderr, "\nBatchingEvaluatorTests..\n");
+
+    TestBatchingEvaluator<float>(DeviceDescriptor::CPUDevice());
+    if (IsGPUAvailable())
+        TestBatchingEvaluator<double>(DeviceDescriptor::GPUDevice(0));
+}
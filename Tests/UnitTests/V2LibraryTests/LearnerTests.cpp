@@ -7,6 +7,7 @@
 #include <string>
 #include <random>
 #include <initializer_list>
+#include <functional>
 
 
 using namespace CNTK;
@@ -104,6 +105,118 @@ void TestRMSPropLearner(size_t numParameters, size_t numMinibatches, const Devic
     TestUpdate<ElementType>(learner, shape, numMinibatches, device);
 }
 
+// An embedding trained with sparse input gets block-column gradients, which the learners apply lazily on the CPU with
+// lazySparseUpdates: only the columns of the words in a minibatch are updated, catching up on the steps they missed.
+// The last minibatches do not contain all words; once the pending steps are applied, the parameters must match those
+// trained on the same data as dense input. The learner is also checkpointed while some columns lag behind, and the
+// restored one must continue exactly like the uninterrupted one, also if it applies the pending steps in between.
+template <typename ElementType>
+void TestLazyUpdates(const function<LearnerPtr(const vector<Parameter>&)>& createLearner, const char* learnerName)
+{
+    const auto device = DeviceDescriptor::CPUDevice();
+    const size_t vocabDim = 12;
+    const size_t embeddingDim = 4;
+    const size_t checkpointAfter = 3;
+    const vector<vector<size_t>> minibatchWords = { { 0, 1, 5 }, { 1, 2 }, { 7, 3, 3 }, { 4, 9 }, { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 }, { 0, 10, 2 }, { 6 } };
+    auto initialValue = NDArrayView::RandomUniform<ElementType>({ embeddingDim, vocabDim }, -1.0, 1.0, 1, device);
+
+    vector<vector<vector<ElementType>>> targets;
+    for (size_t i = 0; i < minibatchWords.size(); i++)
+    {
+        targets.push_back({});
+        for (size_t j = 0; j < minibatchWords[i].size(); j++)
+        {
+            vector<ElementType> target(embeddingDim);
+            for (auto& t : target)
+                t = ElementType((rng() % 200) / 100.0 - 1);
+            targets[i].push_back(target);
+        }
+    }
+
+    auto train = [&](bool isSparse, bool restoreFromCheckpoint)
+    {
+        auto input = InputVariable({ vocabDim }, isSparse, AsDataType<ElementType>(), L"features");
+        auto targetInput = InputVariable({ embeddingDim }, AsDataType<ElementType>(), L"targets");
+        auto embedding = Parameter(initialValue->DeepClone(), L"embedding");
+        auto output = Times(embedding, input);
+        auto loss = SquaredError(output, targetInput);
+        auto learner = createLearner({ embedding });
+        Trainer trainer(output, loss, { learner });
+
+        Dictionary checkpoint;
+        NDArrayViewPtr checkpointValue;
+        auto trainMinibatch = [&](size_t i)
+        {
+            vector<vector<size_t>> oneHotSequences;
+            vector<vector<ElementType>> denseSequences;
+            for (auto word : minibatchWords[i])
+            {
+                oneHotSequences.push_back({ word });
+                vector<ElementType> oneHot(vocabDim, 0);
+                oneHot[word] = 1;
+                denseSequences.push_back(oneHot);
+            }
+            auto inputValue = isSparse ? Value::Create<ElementType>(vocabDim, oneHotSequences, device) : Value::Create<ElementType>({ vocabDim }, denseSequences, device);
+            auto targetValue = Value::Create<ElementType>({ embeddingDim }, targets[i], device);
+            trainer.TrainMinibatch({ { input, inputValue }, { targetInput, targetValue } }, device);
+        };
+
+        for (size_t i = 0; i < minibatchWords.size(); i++)
+        {
+            if (restoreFromCheckpoint && i == checkpointAfter)
+            {
+                checkpoint = learner->Serialize();
+                checkpointValue = embedding.Value()->DeepClone();
+            }
+            trainMinibatch(i);
+        }
+
+        if (restoreFromCheckpoint)
+        {
+            embedding.Value()->CopyFrom(*checkpointValue);
+            learner->RestoreFromCheckpoint(checkpoint);
+            learner->ApplyPendingUpdates();
+            for (size_t i = checkpointAfter; i < minibatchWords.size(); i++)
+                trainMinibatch(i);
+        }
+        learner->ApplyPendingUpdates();
+
+        const ElementType* data = embedding.Value()->DataBuffer<ElementType>();
+        return vector<ElementType>(data, data + embeddingDim * vocabDim);
+    };
+
+    auto dense = train(/*isSparse=*/false, /*restoreFromCheckpoint=*/false);
+    auto lazy = train(/*isSparse=*/true, /*restoreFromCheckpoint=*/false);
+    auto restored = train(/*isSparse=*/true, /*restoreFromCheckpoint=*/true);
+    FloatingPointVectorCompare(lazy, dense, (string("Lazy updates of the ") + learnerName + " learner do not match the dense ones").c_str());
+    FloatingPointVectorCompare(restored, lazy, (string("Lazy updates of the ") + learnerName + " learner restored from a checkpoint do not match uninterrupted ones").c_str());
+}
+
+void TestLazyUpdates()
+{
+    AdditionalLearningOptions options;
+    options.lazySparseUpdates = true;
+    TestLazyUpdates<float>([=](const vector<Parameter>& parameters)
+    {
+        return MomentumSGDLearner(parameters, LearningRatePerMinibatchSchedule(0.1), MomentumPerMinibatchSchedule(0.9), options);
+    }, "momentum SGD");
+    TestLazyUpdates<double>([=](const vector<Parameter>& parameters)
+    {
+        return NesterovLearner(parameters, LearningRatePerMinibatchSchedule(0.1), MomentumPerMinibatchSchedule(0.8), options);
+    }, "Nesterov");
+    TestLazyUpdates<float>([=](const vector<Parameter>& parameters)
+    {
+        return AdamLearner(parameters, LearningRatePerSampleSchedule(0.05), MomentumPerMinibatchSchedule(0.9), DefaultVarianceMomentum, /*lowMemory=*/true, options);
+    }, "FSAdaGrad");
+    for (bool needAveMultiplier : { false, true })
+    {
+        TestLazyUpdates<float>([=](const vector<Parameter>& parameters)
+        {
+            return RMSPropLearner(parameters, LearningRatePerMinibatchSchedule(0.05), 0.9, 1.2, 0.75, 10, 0.1, needAveMultiplier, options);
+        }, needAveMultiplier ? "RMSProp (with average multiplier)" : "RMSProp");
+    }
+}
+
 void TestTrainingParametersSchedule()
 {
     VerifyException([]() {
@@ -252,4 +365,6 @@ void LearnerTests()
     
     TestFSAdaGradLearner<double>(10, 2, DeviceDescriptor::CPUDevice());
     TestRMSPropLearner<float>(3, 3, DeviceDescriptor::CPUDevice());
+
+    TestLazyUpdates();
 }
\ No newline at end of file
@@ -24,6 +24,7 @@ void TrainTruncatedLSTMAcousticModelClassifer();
 void DeviceSelectionTests();
 void MultiThreadsEvaluation(bool);
 void MinibatchSourceTests();
+void BatchingEvaluatorTests();
 
 int main()
 {
@@ -70,6 +71,8 @@ int main()
 
     MultiThreadsEvaluation(IsGPUAvailable());
 
+    BatchingEvaluatorTests();
+
     fprintf(stderr, "\nCNTKv2Library tests: Passed\n");
     fflush(stderr);
 
@@ -1465,8 +1465,9 @@ def past_value(x, initial_state=None, time_step=1, name=''):
 def optimized_rnnstack(operand, weights, hidden_size, num_layers,
                        bidirectional=False, recurrent_op='lstm', name=''):
     '''
-    An RNN implementation that uses the primitives in cuDNN.
-    If cuDNN is not available it fails.
+    An RNN implementation that uses the primitives in cuDNN on the GPU.
+    On the CPU an implementation with the same parameter layout is used, so models
+    can be trained on one and evaluated on the other.
 
     Args:
         operand: input of the optimized RNN stack.